@@ -3,6 +3,7 @@
 #include "lib/core_config.h"
 #include "lib/message_schema.h"
 #include "lib/protocol_constants.h"
+#include "lib/telemetry_keys.h"
 #include "remote_sensor_config.h"
 #include "secrets.h"  // Device-specific secrets
 
@@ -14,8 +15,9 @@
 #define DEVICE_TYPE         "water_monitor"
 #define FIRMWARE_VERSION    "2.0.0"
 
-inline MessageSchema::Schema buildDeviceSchema() {
-    return MessageSchema::SchemaBuilder(1)
+// Built at compile time and stored in flash; fails to compile if it exceeds
+// the schema limits
+inline constexpr MessageSchema::Schema DEVICE_SCHEMA = MessageSchema::SchemaBuilder(1)
         // Telemetry fields (sensor readings) — state_class for display/placement
         .addField("pd", "PulseDelta", "", MessageSchema::FieldType::UINT32, 0, 65535,
                   MessageSchema::FieldCategory::TELEMETRY, MessageSchema::FLAG_READABLE, MessageSchema::STATE_CLASS_DELTA)
@@ -35,7 +37,21 @@ inline MessageSchema::Schema buildDeviceSchema() {
         .addControl("pump", "Water Pump", {"off", "on"})
         .addControl("valve", "Valve", {"closed", "open"})
         .build();
-}
+
+// Registration lists (fields=, sys=, states=), rendered at compile time
+inline constexpr MessageSchema::RegistrationText DEVICE_REGISTRATION =
+    MessageSchema::renderRegistration(DEVICE_SCHEMA);
+
+static_assert(!DEVICE_REGISTRATION.overflow, "registration item lists exceed their buffers");
+static_assert(DEVICE_SCHEMA.findFieldIndex(TelemetryKeys::BatteryPercent) >= 0 &&
+              DEVICE_SCHEMA.findFieldIndex(TelemetryKeys::ErrorCount) >= 0 &&
+              DEVICE_SCHEMA.findFieldIndex(TelemetryKeys::TimeSinceReset) >= 0,
+              "schema must define the mandatory system fields bp, ec, tsr");
+static_assert(DEVICE_SCHEMA.field_index.valid && DEVICE_SCHEMA.control_index.valid,
+              "schema keys must be unique");
+
+// Callers keep a reference; the schema is never copied into RAM
+inline const MessageSchema::Schema& buildDeviceSchema() { return DEVICE_SCHEMA; }
 
 inline RemoteConfig buildDeviceConfig() {
     RemoteConfig cfg = RemoteConfig::create(3);
@@ -14,7 +14,7 @@ inline void setupDeviceSensors(
 ) {
     if (!cfg.enableSensorSystem) return;
 
-    // Add in schema field order (pd, tv, bp) so readAll() matches rule evaluation indices
+    // Fields bind to schema slots when added, so order does not matter
     auto waterFlow = SensorFactory::createYFS201WaterFlowSensor(cfg.waterFlow, persistenceHal);
     mgr.addSensor(waterFlow);
     if (outWaterFlow) *outWaterFlow = waterFlow;
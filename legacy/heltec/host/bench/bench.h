@@ -0,0 +1,124 @@
+#pragma once
+
+// =============================================================================
+// Micro-benchmark harness for the host build
+// =============================================================================
+//   BENCH(name) { setup...; s.run([&] { op(); }); }
+//   BENCH_ARGS(name, 1, 8, 32) { ...s.arg()...; s.run([&] { op(); }); }
+//
+// run() measures only the op: ns/op for the fastest of three batches sized
+// to last --min-time, heap allocations (operator new) per op in that batch, and the
+// peak stack one call of the op uses below its caller (painted-stack probe,
+// same idea as uxTaskGetStackHighWaterMark). Setup is free to allocate.
+//
+// Numbers are host numbers (x86-64 ABI, glibc, muted Serial); compare runs
+// of the same build machine against each other, not against the device.
+// =============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+namespace HostBench {
+
+struct Result {
+    uint64_t iterations = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double bytesPerOp = 0;
+    uint32_t peakStack = 0;
+};
+
+class State {
+public:
+    State(int arg, uint32_t minTimeMs) : _arg(arg), _minTimeMs(minTimeMs) {}
+
+    /** Parameter from BENCH_ARGS (0 for BENCH). */
+    int arg() const { return _arg; }
+
+    template <typename F>
+    void run(F&& op) {
+        using Op = typename std::remove_reference<F>::type;
+        // Warm-up call first: lazy symbol binding and first-use paths would
+        // otherwise show up as stack
+        op();
+        _result.peakStack = probeStack(&invoke<Op>, &op);
+
+        // Grow the batch until it lasts min-time, then keep the fastest of
+        // REPEATS batches of that size (host noise only ever adds time)
+        uint64_t n = 1;
+        uint8_t repeats = 0;
+        for (;;) {
+            uint64_t allocs = allocCount(), bytes = allocBytes();
+            uint64_t start = nowNs();
+            for (uint64_t i = 0; i < n; i++) op();
+            uint64_t elapsed = nowNs() - start;
+            if (repeats == 0 && elapsed < (uint64_t)_minTimeMs * 1000000u && n < MAX_ITERATIONS) {
+                n = nextBatch(n, elapsed);
+                continue;
+            }
+            double nsPerOp = (double)elapsed / n;
+            if (repeats == 0 || nsPerOp < _result.nsPerOp) _result.nsPerOp = nsPerOp;
+            _result.iterations = n;
+            _result.allocsPerOp = (double)(allocCount() - allocs) / n;
+            _result.bytesPerOp = (double)(allocBytes() - bytes) / n;
+            if (++repeats == REPEATS) break;
+        }
+        _ran = true;
+    }
+
+    bool ran() const { return _ran; }
+    const Result& result() const { return _result; }
+
+private:
+    static constexpr uint64_t MAX_ITERATIONS = 1ull << 32;
+    static constexpr uint8_t REPEATS = 3;
+
+    template <typename Op>
+    static void invoke(void* op) { (*static_cast<Op*>(op))(); }
+
+    uint64_t nextBatch(uint64_t n, uint64_t elapsedNs) const;
+    static uint32_t probeStack(void (*fn)(void*), void* ctx);
+    static uint64_t nowNs();
+    static uint64_t allocCount();
+    static uint64_t allocBytes();
+
+    int _arg;
+    uint32_t _minTimeMs;
+    bool _ran = false;
+    Result _result;
+};
+
+struct Case {
+    const char* name;
+    void (*fn)(State&);
+    std::vector<int> args;   // Empty: single run with arg 0
+};
+
+std::vector<Case>& registry();
+
+struct Registrar {
+    Registrar(const char* name, void (*fn)(State&), std::vector<int> args = {}) {
+        registry().push_back(Case{name, fn, args});
+    }
+};
+
+/** Keep a value alive so the optimizer cannot drop the op that produced it. */
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace HostBench
+
+#define BENCH(name)                                                            \
+    static void bench_##name(HostBench::State& s);                            \
+    static HostBench::Registrar bench_registrar_##name(#name, bench_##name);  \
+    static void bench_##name(HostBench::State& s)
+
+#define BENCH_ARGS(name, ...)                                                  \
+    static void bench_##name(HostBench::State& s);                            \
+    static HostBench::Registrar bench_registrar_##name(#name, bench_##name,   \
+                                                       {__VA_ARGS__});         \
+    static void bench_##name(HostBench::State& s)
@@ -0,0 +1,322 @@
+#include "bench.h"
+#include <Arduino.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+
+// =============================================================================
+// farmon_bench: runs every BENCH in bench/ and reports per-op cost
+// =============================================================================
+//   farmon_bench [--filter s] [--min-time ms] [--out file.json]
+//                [--baseline file.json] [--tolerance pct] [--list]
+//
+// --out writes the results as JSON (one scenario per line). --baseline reads
+// such a file and exits 1 when a scenario got slower than --tolerance percent
+// (default 25), allocates more per op, or uses more stack.
+// =============================================================================
+
+// ─── Allocation counting ─────────────────────────────────────────────────────
+
+namespace {
+std::atomic<uint64_t> g_allocCount{0};
+std::atomic<uint64_t> g_allocBytes{0};
+
+void* countedAlloc(size_t size) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void countedFree(void* p) { free(p); }
+} // namespace
+
+void* operator new(size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+// ─── Stack probe ─────────────────────────────────────────────────────────────
+// Benchmarks run on a thread whose stack we own. Before the probed call the
+// stack below the call site is painted; afterwards the lowest overwritten
+// byte gives the depth the op reached.
+
+namespace {
+
+constexpr size_t STACK_SIZE = 512 * 1024;
+constexpr uint8_t PAINT = 0xA5;
+
+uint8_t* g_stackLo = nullptr;
+uint8_t* g_paintTop = nullptr;
+uint32_t g_probeFloor = 0;       // What an empty op measures (probe overhead)
+
+__attribute__((noinline)) void paintStack(void*) {
+    uint8_t* frame = (uint8_t*)__builtin_frame_address(0);
+    // Leave this frame and the red zone alone; plain loop, no calls below us
+    volatile uint8_t* p = g_stackLo;
+    uint8_t* top = frame - 160;
+    while (p < top) *p++ = PAINT;
+    g_paintTop = top;
+}
+
+__attribute__((noinline)) void callAtProbeDepth(void (*fn)(void*), void* ctx) {
+    fn(ctx);
+    asm volatile("" ::: "memory");   // Keep the call out of tail position
+}
+
+} // namespace
+
+namespace HostBench {
+
+uint32_t State::probeStack(void (*fn)(void*), void* ctx) {
+    if (!g_stackLo) return 0;
+    callAtProbeDepth(&paintStack, nullptr);
+    callAtProbeDepth(fn, ctx);
+    uint8_t* deepest = g_paintTop;
+    for (uint8_t* p = g_stackLo; p < g_paintTop; p++) {
+        if (*p != PAINT) {
+            deepest = p;
+            break;
+        }
+    }
+    uint32_t used = (uint32_t)(g_paintTop + 160 - deepest);
+    return used > g_probeFloor ? used - g_probeFloor : 0;
+}
+
+uint64_t State::nextBatch(uint64_t n, uint64_t elapsedNs) const {
+    // Aim 20% past min-time, growing at most 10x per step
+    uint64_t target = (uint64_t)_minTimeMs * 1200000u;
+    uint64_t next = elapsedNs ? (uint64_t)((double)n * target / elapsedNs) : n * 10;
+    if (next > n * 10) next = n * 10;
+    if (next <= n) next = n + 1;
+    return next < MAX_ITERATIONS ? next : MAX_ITERATIONS;
+}
+
+uint64_t State::nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t State::allocCount() { return g_allocCount.load(std::memory_order_relaxed); }
+uint64_t State::allocBytes() { return g_allocBytes.load(std::memory_order_relaxed); }
+
+std::vector<Case>& registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+} // namespace HostBench
+
+// ─── Runner ──────────────────────────────────────────────────────────────────
+
+namespace {
+
+struct Options {
+    std::string filter;
+    uint32_t minTimeMs = 200;
+    std::string outPath;
+    std::string baselinePath;
+    double tolerance = 25;
+    bool list = false;
+};
+
+struct Row {
+    std::string name;
+    HostBench::Result result;
+};
+
+std::vector<std::pair<std::string, const HostBench::Case*>> expand() {
+    std::vector<std::pair<std::string, const HostBench::Case*>> out;
+    for (const HostBench::Case& c : HostBench::registry()) {
+        if (c.args.empty()) {
+            out.push_back({c.name, &c});
+            continue;
+        }
+        for (int a : c.args) out.push_back({std::string(c.name) + "/" + std::to_string(a), &c});
+    }
+    return out;
+}
+
+int argOf(const std::string& name) {
+    size_t slash = name.rfind('/');
+    return slash == std::string::npos ? 0 : atoi(name.c_str() + slash + 1);
+}
+
+struct RunContext {
+    const Options* opt;
+    std::vector<Row>* rows;
+};
+
+void* runAll(void* arg) {
+    RunContext* ctx = (RunContext*)arg;
+
+    // Calibrate the probe so an empty op reports 0 bytes
+    HostBench::State empty(0, 1);
+    empty.run([] {});
+    g_probeFloor = empty.result().peakStack;
+
+    for (auto& entry : expand()) {
+        if (!ctx->opt->filter.empty() && entry.first.find(ctx->opt->filter) == std::string::npos) continue;
+        Sim::setClockManual(0);
+        HostBench::State s(argOf(entry.first), ctx->opt->minTimeMs);
+        entry.second->fn(s);
+        if (!s.ran()) {
+            fprintf(stderr, "%s: benchmark never called run()\n", entry.first.c_str());
+            continue;
+        }
+        ctx->rows->push_back(Row{entry.first, s.result()});
+        const HostBench::Result& r = s.result();
+        printf("%-32s %12llu %12.1f %10.2f %10.1f %8u\n", entry.first.c_str(),
+               (unsigned long long)r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp,
+               (unsigned)r.peakStack);
+        fflush(stdout);
+    }
+    return nullptr;
+}
+
+bool runOnOwnStack(RunContext* ctx) {
+    void* stack = nullptr;
+    if (posix_memalign(&stack, 4096, STACK_SIZE) != 0) return false;
+    g_stackLo = (uint8_t*)stack;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, STACK_SIZE);
+    pthread_t thread;
+    bool ok = pthread_create(&thread, &attr, runAll, ctx) == 0;
+    if (ok) pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+    g_stackLo = nullptr;
+    free(stack);
+    return ok;
+}
+
+bool writeJson(const std::string& path, const Options& opt, const std::vector<Row>& rows) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"format\": \"farmon-bench-1\",\n  \"min_time_ms\": %u,\n  \"results\": [\n",
+            (unsigned)opt.minTimeMs);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const HostBench::Result& r = rows[i].result;
+        fprintf(f, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, "
+                   "\"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f, \"peak_stack\": %u}%s\n",
+                rows[i].name.c_str(), (unsigned long long)r.iterations, r.nsPerOp, r.allocsPerOp,
+                r.bytesPerOp, (unsigned)r.peakStack, i + 1 < rows.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+/** Reads a file written by writeJson (one result object per line). */
+bool readJson(const std::string& path, std::map<std::string, HostBench::Result>* out) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        char name[128];
+        unsigned long long iterations;
+        unsigned stack;
+        HostBench::Result r;
+        if (sscanf(line, " {\"name\": \"%127[^\"]\", \"iterations\": %llu, \"ns_per_op\": %lf, "
+                         "\"allocs_per_op\": %lf, \"bytes_per_op\": %lf, \"peak_stack\": %u",
+                   name, &iterations, &r.nsPerOp, &r.allocsPerOp, &r.bytesPerOp, &stack) == 6) {
+            r.iterations = iterations;
+            r.peakStack = stack;
+            (*out)[name] = r;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/** Prints one line per scenario that regressed; returns how many did. */
+int compare(const std::vector<Row>& rows, const std::map<std::string, HostBench::Result>& base,
+            double tolerance) {
+    int regressions = 0;
+    for (const Row& row : rows) {
+        auto it = base.find(row.name);
+        if (it == base.end()) continue;
+        const HostBench::Result& b = it->second;
+        const HostBench::Result& r = row.result;
+        char why[160] = "";
+        if (r.nsPerOp > b.nsPerOp * (1 + tolerance / 100)) {
+            snprintf(why, sizeof(why), "ns/op %.1f -> %.1f (+%.0f%%)", b.nsPerOp, r.nsPerOp,
+                     (r.nsPerOp / b.nsPerOp - 1) * 100);
+        } else if (r.allocsPerOp > b.allocsPerOp + 0.01) {
+            snprintf(why, sizeof(why), "allocs/op %.2f -> %.2f", b.allocsPerOp, r.allocsPerOp);
+        } else if (r.peakStack > b.peakStack + 16) {
+            snprintf(why, sizeof(why), "stack %u -> %u bytes", (unsigned)b.peakStack, (unsigned)r.peakStack);
+        }
+        if (why[0]) {
+            printf("REGRESSION %s: %s\n", row.name.c_str(), why);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+void usage() {
+    fprintf(stderr, "usage: farmon_bench [--filter s] [--min-time ms] [--out file.json] "
+                    "[--baseline file.json] [--tolerance pct] [--list]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--filter" && hasValue) opt.filter = argv[++i];
+        else if (a == "--min-time" && hasValue) opt.minTimeMs = (uint32_t)atol(argv[++i]);
+        else if (a == "--out" && hasValue) opt.outPath = argv[++i];
+        else if (a == "--baseline" && hasValue) opt.baselinePath = argv[++i];
+        else if (a == "--tolerance" && hasValue) opt.tolerance = atof(argv[++i]);
+        else if (a == "--list") opt.list = true;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (opt.list) {
+        for (auto& entry : expand()) printf("%s\n", entry.first.c_str());
+        return 0;
+    }
+
+    std::map<std::string, HostBench::Result> baseline;
+    if (!opt.baselinePath.empty() && !readJson(opt.baselinePath, &baseline)) {
+        fprintf(stderr, "cannot read baseline %s\n", opt.baselinePath.c_str());
+        return 2;
+    }
+
+    Serial.setMuted(true);
+    printf("%-32s %12s %12s %10s %10s %8s\n", "benchmark", "iterations", "ns/op", "allocs/op",
+           "bytes/op", "stack");
+
+    std::vector<Row> rows;
+    RunContext ctx{&opt, &rows};
+    if (!runOnOwnStack(&ctx)) {
+        fprintf(stderr, "cannot start benchmark thread\n");
+        return 2;
+    }
+
+    if (!opt.outPath.empty() && !writeJson(opt.outPath, opt, rows)) {
+        fprintf(stderr, "cannot write %s\n", opt.outPath.c_str());
+        return 2;
+    }
+    int regressions = baseline.empty() ? 0 : compare(rows, baseline, opt.tolerance);
+    fflush(stdout);
+    // Firmware objects may hold RTOS handles; skip static destructors as farmon_sim does
+    std::_Exit(regressions ? 1 : 0);
+}
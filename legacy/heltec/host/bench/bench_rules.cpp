@@ -0,0 +1,100 @@
+#include "bench.h"
+#include "lib/edge_rules.h"
+#include "devices/remote/device_config.h"
+
+using namespace EdgeRules;
+using HostBench::keep;
+
+namespace {
+
+// fPort 30 rule payload (see EdgeRule::fromBinary)
+void addRule(EdgeRulesEngine& engine, uint8_t id, uint8_t field, RuleOperator op, float threshold,
+             uint8_t control, uint8_t state, uint8_t priority) {
+    uint8_t p[12];
+    p[0] = id;
+    p[1] = 0x80 | ((uint8_t)op << 4);
+    p[2] = field;
+    memcpy(p + 3, &threshold, sizeof(float));
+    p[7] = control;
+    p[8] = state;
+    p[9] = 0;
+    p[10] = 0;
+    p[11] = priority;
+    engine.addOrUpdateRule(p, sizeof(p));
+}
+
+// n rules that never fire, spread over every field and control
+void addQuietRules(EdgeRulesEngine& engine, const MessageSchema::Schema& schema, int n) {
+    for (int i = 0; i < n; i++) {
+        addRule(engine, (uint8_t)i, (uint8_t)(i % schema.field_count), RuleOperator::GT, 1e9f,
+                (uint8_t)(i % schema.control_count), 1, (uint8_t)(i % 4));
+    }
+}
+
+} // namespace
+
+// Per-uplink case: every field moved since the last report, no condition flips
+BENCH_ARGS(rules_evaluate, 1, 8, 32, 128) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    EdgeRulesEngine engine(schema, nullptr);
+    addQuietRules(engine, schema, s.arg());
+    float values[MessageSchema::MAX_FIELDS] = {0};
+    uint32_t now = 0;
+    s.run([&] {
+        now += 60000;
+        for (uint8_t f = 0; f < schema.field_count; f++) values[f] += 1.0f;
+        engine.evaluate(values, schema.field_count, now);
+    });
+}
+
+// Baseline for rules_evaluate: the same inputs through the full scan
+// (every rule re-tested, every control resolved over the whole rule list)
+BENCH_ARGS(rules_evaluate_linear, 1, 8, 32, 128) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    EdgeRulesEngine engine(schema, nullptr);
+    addQuietRules(engine, schema, s.arg());
+    float values[MessageSchema::MAX_FIELDS] = {0};
+    uint32_t now = 0;
+    s.run([&] {
+        now += 60000;
+        for (uint8_t f = 0; f < schema.field_count; f++) values[f] += 1.0f;
+        engine.evaluateLinear(values, schema.field_count, now);
+    });
+}
+
+// Worst case: conditions flip every call, so each control changes state
+// (executor, state change queue, log line)
+BENCH_ARGS(rules_evaluate_flip, 2, 32) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    EdgeRulesEngine engine(schema, nullptr);
+    for (int i = 0; i < s.arg(); i += 2) {
+        uint8_t field = (uint8_t)((i / 2) % schema.field_count);
+        uint8_t control = (uint8_t)((i / 2) % schema.control_count);
+        addRule(engine, (uint8_t)i, field, RuleOperator::GT, 0.5f, control, 1, 1);
+        addRule(engine, (uint8_t)(i + 1), field, RuleOperator::LT, 0.5f, control, 0, 1);
+    }
+    float values[MessageSchema::MAX_FIELDS] = {0};
+    uint32_t now = 0;
+    s.run([&] {
+        now += 60000;
+        float v = (now / 60000) & 1 ? 1.0f : 0.0f;
+        for (uint8_t f = 0; f < schema.field_count; f++) values[f] = v;
+        engine.evaluate(values, schema.field_count, now);
+        engine.clearStateChangeBatch(STATE_CHANGE_QUEUE_CAP);
+    });
+}
+
+// Full queue packed into the largest payload (what the state_tx task sends)
+BENCH(state_change_batch) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    EdgeRulesEngine engine(schema, nullptr);
+    for (uint32_t i = 0; i < STATE_CHANGE_QUEUE_CAP; i++) {
+        engine.setControlState(0, (uint8_t)((i + 1) & 1), TriggerSource::DOWNLINK, 0, i * 1000);
+    }
+    uint8_t buffer[256];
+    s.run([&] {
+        size_t events = 0;
+        keep(engine.formatStateChangeBatch(buffer, STATE_CHANGE_QUEUE_CAP * 11, &events));
+        keep(events);
+    });
+}
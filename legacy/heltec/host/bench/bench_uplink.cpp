@@ -0,0 +1,153 @@
+#include "bench.h"
+#include "lib/telemetry_codec.h"
+#include "lib/telemetry_keys.h"
+#include "lib/registration_manager.h"
+#include "lib/ota_receiver.h"
+#include "lib/crc.h"
+#include "lib/core_logger.h"
+#include "devices/remote/device_config.h"
+#include "sensor_interface.hpp"
+
+using HostBench::keep;
+
+// The periodic report as lorawan_tx builds it: sensor and system readings
+// written into schema slots, then keyframe/delta encoded by sendTelemetry()
+// (acked mode, every frame delivered)
+BENCH(telemetry_encode) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    TelemetryCodec::TelemetryCompressor compressor(schema, true);
+    Readings readings(schema);
+    FieldSlot pd(TelemetryKeys::PulseDelta), tv(TelemetryKeys::TotalVolume), bp(TelemetryKeys::BatteryPercent),
+        ec(TelemetryKeys::ErrorCount), tsr(TelemetryKeys::TimeSinceReset);
+    for (FieldSlot* field : {&pd, &tv, &bp, &ec, &tsr}) field->bind(schema);
+    float pulses = 0, volume = 0, uptime = 0;
+
+    uint8_t buffer[TelemetryCodec::MAX_FRAME_SIZE];
+    s.run([&] {
+        pulses += 3;
+        volume += 0.75f;
+        uptime += 60;
+
+        readings.clear(0);
+        readings.set(pd, pulses);
+        readings.set(tv, volume);
+        readings.set(bp, 90.0f);
+        readings.set(ec, 0.0f);
+        readings.set(tsr, uptime);
+
+        TelemetryCodec::FieldValues values;
+        for (uint8_t i = 0; i < readings.fieldCount(); i++) {
+            if (readings.has(i)) values.set(i, readings.value(i));
+        }
+        size_t len = compressor.encode(values, buffer, sizeof(buffer));
+        compressor.onUplinkComplete(buffer[0], buffer[1], true, true);
+        keep(len);
+    });
+}
+
+BENCH(telemetry_snapshot) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    TelemetryCodec::FieldValues values;
+    for (uint8_t i = 0; i < schema.field_count; i++) values.set(i, 100.0f + i);
+    uint8_t buffer[TelemetryCodec::MAX_FRAME_SIZE];
+    s.run([&] {
+        values.values[0] += 1;
+        keep(TelemetryCodec::encodeSnapshot(schema, values, buffer, sizeof(buffer)));
+    });
+}
+
+// A whole registration sequence at a data rate, drained frame by frame the
+// way the radio task does (DR0 chunks every part into 11-byte frames, DR3
+// sends each part whole)
+BENCH_ARGS(registration_send, 0, 3) {
+    TxScheduler tx;
+    tx.begin();
+    PayloadBudget budget;
+    budget.update(LoRaWANRegion::US915, (uint8_t)s.arg());
+    RegistrationManager reg;
+    reg.setTxScheduler(&tx);
+    reg.setRegistrationText(DEVICE_REGISTRATION);
+    reg.setDeviceInfo("water_monitor", "2.0.0");
+    reg.setPayloadBudget(&budget);
+    LoRaWANTxMsg m;
+    TxClass cls;
+    s.run([&] {
+        reg.forceReregister();
+        size_t frames = 0;
+        while (tx.dequeue(&m, &cls, 0)) {
+            tx.complete();
+            frames++;
+            reg.tick(0);
+        }
+        keep(frames);
+    });
+}
+
+// Per-chunk check of every OTA chunk (OtaReceiver::crc16Payload is a private
+// wrapper around this call)
+BENCH(ota_crc16_payload) {
+    uint8_t chunk[OtaReceiver::OTA_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i * 31 + 7);
+    s.run([&] {
+        chunk[0]++;
+        keep(Crc::crc16Ccitt(chunk, sizeof(chunk)));
+    });
+}
+
+// Baseline for ota_crc16_payload: the bitwise CRC the table replaced
+BENCH(ota_crc16_payload_reference) {
+    uint8_t chunk[OtaReceiver::OTA_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i * 31 + 7);
+    s.run([&] {
+        chunk[0]++;
+        keep(Crc::crc16CcittReference(chunk, sizeof(chunk)));
+    });
+}
+
+// Running image CRC32 over each OTA chunk (OtaReceiver with verifyImage).
+// Slice-by-4 on the host; the device uses the ROM CRC32 when it has one.
+BENCH(ota_crc32_chunk) {
+    uint8_t chunk[OtaReceiver::OTA_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i * 31 + 7);
+    uint32_t crc = 0;
+    s.run([&] { crc = Crc::crc32Update(crc, chunk, sizeof(chunk)); });
+    keep(crc);
+}
+
+// Baseline for ota_crc32_chunk: bitwise CRC32
+BENCH(ota_crc32_chunk_reference) {
+    uint8_t chunk[OtaReceiver::OTA_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i * 31 + 7);
+    uint32_t crc = 0;
+    s.run([&] { crc = Crc::crc32Reference(crc, chunk, sizeof(chunk)); });
+    keep(crc);
+}
+
+// Lookup of every schema key in turn (first key hits at once, last scans all)
+BENCH(schema_find_field) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    size_t next = 0;
+    s.run([&] {
+        keep(schema.findFieldIndex(schema.fields[next].key));
+        if (++next == schema.field_count) next = 0;
+    });
+}
+
+BENCH(schema_find_field_miss) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    s.run([&] { keep(schema.findFieldIndex(TelemetryKeys::ErrorPersistence)); });
+}
+
+// Formatting and the Serial prints (Serial is muted, so no UART time)
+BENCH(logger_vprintf) {
+    Logger::setLevel(Logger::Level::Info);
+    uint32_t n = 0;
+    s.run([&] { LOGI("Remote", "Enqueue telemetry %s (%d bytes, %d fields) on fPort %d", "delta", 14, 5, ++n); });
+}
+
+// A LOGD call site while the level is Info: only the level check runs
+BENCH(logger_vprintf_filtered) {
+    Logger::setLevel(Logger::Level::Info);
+    uint32_t n = 0;
+    s.run([&] { LOGD("Remote", "Enqueue telemetry %s (%d bytes, %d fields) on fPort %d", "delta", 14, 5, ++n); });
+}
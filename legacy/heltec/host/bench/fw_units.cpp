@@ -0,0 +1,7 @@
+// Firmware translation units the benchmarks call into, compiled once
+// (remote_app.cpp includes the same files for the device build)
+#include "lib/ota_receiver.cpp"
+#include "lib/delta_patch.cpp"
+#include "lib/lzss_decoder.cpp"
+#include "lib/tx_scheduler.cpp"
+#include "lib/registration_manager.cpp"
@@ -0,0 +1,291 @@
+#pragma once
+
+// =============================================================================
+// Fleet: discrete-event LoRaWAN capacity simulator
+// =============================================================================
+// Many remote nodes share one virtual gateway. Each node runs the firmware
+// pieces that decide what goes on air and when - TxScheduler, PayloadBudget,
+// AirtimeLedger, RegistrationManager, TelemetryCompressor, EdgeRulesEngine -
+// driven by the same task cadences as RemoteApplicationImpl and a TX cycle
+// that mirrors radioTaskServiceTx(). Radio and network are modelled:
+//
+//   Node -> Gateway   log-distance path loss + shadowing, per-SF sensitivity,
+//                     collisions per (channel, SF) with 6 dB capture, eight
+//                     demodulator paths, half-duplex (no RX while sending)
+//   Gateway -> Node   Class A RX1 (+1 s, DR10+up) / RX2 (+2 s, DR8), one
+//                     transmitter: a busy RX1 falls back to RX2, then drops
+//   Network server    dedup by fCnt, ACKs, registration ACK after the last
+//                     frame, ADR (LinkADRReq) from the best SNR of 20 uplinks
+//
+// Time is simulated in microseconds; firmware code reads millis() from the
+// manual sim clock, which the event loop sets before each handler.
+// =============================================================================
+
+#include "lib/tx_scheduler.h"
+#include "lib/payload_budget.h"
+#include "lib/airtime.h"
+#include "lib/registration_manager.h"
+#include "lib/telemetry_codec.h"
+#include "lib/edge_rules.h"
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Fleet {
+
+constexpr uint8_t UPLINK_CHANNELS = 8;          // US915 sub-band: 8 x 125 kHz
+constexpr uint8_t WIDE_CHANNEL = UPLINK_CHANNELS; // The sub-band's 500 kHz channel (DR4)
+constexpr uint8_t DEMOD_PATHS = 8;              // SX1301/SX1302 concurrent receptions
+
+struct Params {
+    uint32_t nodes = 100;
+    double hours = 6;
+    uint32_t txIntervalMs = 60000;      // lorawan_tx period
+    bool confirmed = true;              // useConfirmedUplinks (telemetry)
+    uint32_t stateTxMs = 5000;          // state_tx period
+    uint32_t stateChangeMs = 0;         // Mean time between control changes per node (0 = none)
+    uint8_t retries = 0;                // Confirmed retransmissions (RadioLib sends once: 0)
+    uint8_t dataRate = 3;               // DR after join
+    uint8_t minDataRate = 0;
+    bool adr = true;
+    uint32_t airtimeBudgetMsPerHour = 36000;
+    uint8_t txPowerDbm = 22;
+    double radiusKm = 3;                // Nodes placed uniformly in a disc around the gateway
+    uint32_t staggerMs = 60000;         // Power-on spread
+    uint32_t seed = 1;
+
+    /** Defaults from a device's buildDeviceConfig(). */
+    static Params fromConfig(const LoRaWANConfig& cfg, uint32_t nodes);
+};
+
+// -----------------------------------------------------------------------------
+// Link model
+// -----------------------------------------------------------------------------
+namespace Link {
+
+constexpr double GATEWAY_TX_DBM = 27;
+constexpr double FADING_SIGMA_DB = 3;      // Per packet
+constexpr double SHADOWING_SIGMA_DB = 6;   // Per node (obstacles, antenna height)
+
+/** Log-distance path loss (suburban, 915 MHz). */
+double pathLossDb(double distanceKm);
+
+/** SNR of a frame at a receiver (noise floor depends on bandwidth). */
+double snr(double rssi, uint32_t bwHz);
+
+/** Demodulation floor: lowest SNR a spreading factor decodes. */
+double requiredSnr(uint8_t sf);
+
+inline bool decodes(double snr, uint8_t sf) { return snr >= requiredSnr(sf); }
+
+/** RX1 (+1 s) and RX2 (+2 s) downlink modulation for an uplink data rate (US915). */
+Airtime::Modulation rx1Modulation(uint8_t upDataRate);
+Airtime::Modulation rx2Modulation();
+
+} // namespace Link
+
+// One uplink as the gateway hears it
+struct Transmission {
+    uint32_t node;
+    uint64_t startUs;
+    uint64_t endUs;
+    uint8_t channel;
+    uint8_t dataRate;
+    uint8_t sf;
+    double rssi;
+    double snr;
+};
+
+// What the network server gets with an uplink
+struct Uplink {
+    uint8_t port;               // 0 = join request
+    uint32_t fCnt;              // Retransmissions repeat it
+    bool confirmed;
+    bool adrAckReq;             // Device asks for any downlink (ADR backoff)
+    const uint8_t* payload;
+    size_t len;
+};
+
+enum class LossCause : uint8_t { None, Sensitivity, Collision, DemodBusy, HalfDuplex };
+
+struct Downlink {
+    bool sent = false;
+    uint8_t window = 0;          // 1 or 2
+    uint64_t startUs = 0;
+    uint64_t endUs = 0;
+    Airtime::Modulation mod = {};
+    uint8_t port = 0;            // 0 = ACK / MAC commands only
+    uint8_t adrDataRate = 0xFF;  // LinkADRReq (0xFF = none)
+    bool ack = false;
+    bool joinAccept = false;
+};
+
+struct Reception {
+    LossCause loss = LossCause::None;
+    bool duplicate = false;      // Same fCnt as a frame already received
+    Downlink downlink;
+};
+
+struct Stats;
+class Node;
+
+// -----------------------------------------------------------------------------
+// Gateway + network server
+// -----------------------------------------------------------------------------
+class Network {
+public:
+    Network(const Params& params, Stats* stats) : _params(params), _stats(stats) {}
+
+    void addNode();
+
+    /** Uplink on air; the outcome is resolved at its end. */
+    void beginUplink(const Transmission& t);
+
+    /**
+     * End of an uplink: resolve reception (every overlapping uplink has
+     * started by now) and, when the network answers, schedule the downlink
+     * in RX1 or RX2 (join accept: +5 s / +6 s).
+     */
+    Reception endUplink(const Transmission& t, const Uplink& up);
+
+private:
+    struct NodeState {
+        int64_t lastFCnt = -1;
+        std::vector<double> snrHistory;
+        bool regAckPending = false;
+        uint8_t adrDataRate = 0xFF;     // Commanded DR until the node uses it
+    };
+
+    static constexpr uint8_t ADR_HISTORY = 20;
+    static constexpr double ADR_MARGIN_DB = 10;
+    static constexpr uint8_t ADR_MAX_DR = 3;   // 125 kHz channels only
+
+    LossCause resolve(const Transmission& t) const;
+    void adr(NodeState& ns, const Transmission& t);
+    bool scheduleDownlink(const Transmission& t, uint64_t rx1DelayUs, size_t phyLen, Downlink* dl);
+    void prune(uint64_t nowUs);
+
+    const Params& _params;
+    Stats* _stats;
+    std::vector<Transmission> _onAir;                    // Recent uplinks (for overlap checks)
+    std::vector<std::pair<uint64_t, uint64_t>> _gwTx;    // Scheduled downlinks [start, end)
+    std::vector<NodeState> _nodes;
+};
+
+// -----------------------------------------------------------------------------
+// Event loop
+// -----------------------------------------------------------------------------
+enum class EventType : uint8_t {
+    Boot,
+    JoinStart,
+    JoinEnd,        // Join request off air
+    JoinDone,       // RX windows over
+    AppTick,        // 1 s display task: registration onJoin/tick
+    Telemetry,      // lorawan_tx task
+    StateTx,        // state_tx task
+    ControlChange,  // Something toggles a control (scenario load)
+    RadioKick,      // Radio task looks at the scheduler
+    TxEnd,          // Uplink off air
+    TxDone,         // RX windows over, sendReceive() returns
+};
+
+struct Event {
+    uint64_t atUs;
+    uint64_t seq;
+    uint32_t node;
+    EventType type;
+    bool operator>(const Event& o) const { return atUs != o.atUs ? atUs > o.atUs : seq > o.seq; }
+};
+
+class EventQueue {
+public:
+    void push(uint64_t atUs, uint32_t node, EventType type) { _q.push(Event{atUs, _seq++, node, type}); }
+    bool empty() const { return _q.empty(); }
+    Event pop() {
+        Event e = _q.top();
+        _q.pop();
+        return e;
+    }
+
+private:
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _q;
+    uint64_t _seq = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Statistics
+// -----------------------------------------------------------------------------
+struct PortStats {
+    uint32_t produced = 0;       // Frames the node enqueued
+    uint32_t uplinks = 0;        // Transmissions (incl. retransmissions)
+    uint32_t delivered = 0;      // Unique frames the network received
+    uint64_t bytes = 0;          // Delivered application bytes
+    std::vector<uint32_t> latencyMs;   // Enqueue -> network reception
+};
+
+struct NodeStats {
+    double distanceKm = 0;
+    uint64_t txUs = 0;
+    uint64_t rxUs = 0;
+    uint32_t joinAttempts = 0;
+    uint32_t noAck = 0;
+    uint32_t tooLarge = 0;
+    uint32_t queueFull = 0;
+    uint8_t finalDataRate = 0;
+    bool registered = false;
+};
+
+struct Stats {
+    std::map<uint8_t, PortStats> ports;
+    std::vector<NodeStats> nodes;
+    uint32_t lostSensitivity = 0;
+    uint32_t lostCollision = 0;
+    uint32_t lostDemodBusy = 0;
+    uint32_t lostHalfDuplex = 0;
+    uint32_t downlinksRx1 = 0;
+    uint32_t downlinksRx2 = 0;
+    uint32_t downlinksDropped = 0;   // Gateway transmitter busy in both windows
+    uint32_t downlinksMissed = 0;    // Sent but the node did not hear it
+    uint32_t adrCommands = 0;
+    uint64_t uplinkAirUs = 0;
+    uint64_t downlinkAirUs = 0;
+    double simulatedS = 0;
+};
+
+class Simulation {
+public:
+    explicit Simulation(const Params& params);
+    ~Simulation();
+
+    void run();
+    const Stats& stats() const { return _stats; }
+
+    // Used by nodes
+    void schedule(uint64_t atUs, uint32_t node, EventType type) { _events.push(atUs, node, type); }
+    Network& network() { return _network; }
+    Stats& mutableStats() { return _stats; }
+    std::mt19937& rng() { return _rng; }
+    const Params& params() const { return _params; }
+
+private:
+    Params _params;
+    Stats _stats;
+    std::mt19937 _rng;
+    Network _network;
+    EventQueue _events;
+    std::vector<std::unique_ptr<Node>> _nodes;
+};
+
+// -----------------------------------------------------------------------------
+// Reports
+// -----------------------------------------------------------------------------
+void printReport(const Params& params, const Stats& stats);
+void printSweepRow(const Params& params, const Stats& stats, bool header);
+/** JSON object for one run (no trailing newline). */
+std::string toJson(const Params& params, const Stats& stats);
+
+} // namespace Fleet
@@ -0,0 +1,5 @@
+// Firmware translation units the fleet simulator runs per node, compiled once
+// (remote_app.cpp includes the same files for the device build)
+#include "lib/tx_scheduler.cpp"
+#include "lib/registration_manager.cpp"
+#include "lib/core_config.cpp"
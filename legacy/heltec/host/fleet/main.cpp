@@ -0,0 +1,99 @@
+// =============================================================================
+// farmon_fleet: LoRaWAN capacity planning for a fleet of remote nodes
+// =============================================================================
+// Simulates N nodes against one gateway (see fleet.h) and reports delivery,
+// latency percentiles per fPort, losses by cause and radio time per node.
+// Defaults come from the device's buildDeviceConfig().
+//
+//   farmon_fleet [--nodes n[,n...]] [--hours h] [--tx-interval s]
+//                [--confirmed 0|1] [--state-tx s] [--state-change s]
+//                [--retries n] [--dr n] [--adr 0|1] [--radius km]
+//                [--stagger s] [--seed n] [--json file]
+//
+// Several --nodes values run a sweep and print one row per fleet size.
+// --json writes one JSON object per run, one per line.
+// =============================================================================
+
+#include "fleet.h"
+#include "devices/remote/device_config.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+void usage() {
+    fprintf(stderr, "usage: farmon_fleet [--nodes n[,n...]] [--hours h] [--tx-interval s] "
+                    "[--confirmed 0|1] [--state-tx s] [--state-change s] [--retries n] "
+                    "[--dr n] [--adr 0|1] [--radius km] [--stagger s] [--seed n] [--json file]\n");
+}
+
+bool parseList(const std::string& text, std::vector<uint32_t>* out) {
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        long n = atol(item.c_str());
+        if (n <= 0) return false;
+        out->push_back((uint32_t)n);
+    }
+    return !out->empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Fleet::Params params = Fleet::Params::fromConfig(buildDeviceConfig().communication.lorawan, 100);
+    std::vector<uint32_t> fleetSizes;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (opt == "--nodes" && hasValue) {
+            if (!parseList(argv[++i], &fleetSizes)) {
+                usage();
+                return 2;
+            }
+        }
+        else if (opt == "--hours" && hasValue) params.hours = atof(argv[++i]);
+        else if (opt == "--tx-interval" && hasValue) params.txIntervalMs = (uint32_t)(atof(argv[++i]) * 1000);
+        else if (opt == "--confirmed" && hasValue) params.confirmed = atoi(argv[++i]) != 0;
+        else if (opt == "--state-tx" && hasValue) params.stateTxMs = (uint32_t)(atof(argv[++i]) * 1000);
+        else if (opt == "--state-change" && hasValue) params.stateChangeMs = (uint32_t)(atof(argv[++i]) * 1000);
+        else if (opt == "--retries" && hasValue) params.retries = (uint8_t)atoi(argv[++i]);
+        else if (opt == "--dr" && hasValue) params.dataRate = (uint8_t)atoi(argv[++i]);
+        else if (opt == "--adr" && hasValue) params.adr = atoi(argv[++i]) != 0;
+        else if (opt == "--radius" && hasValue) params.radiusKm = atof(argv[++i]);
+        else if (opt == "--stagger" && hasValue) params.staggerMs = (uint32_t)(atof(argv[++i]) * 1000);
+        else if (opt == "--seed" && hasValue) params.seed = (uint32_t)atol(argv[++i]);
+        else if (opt == "--json" && hasValue) jsonPath = argv[++i];
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (fleetSizes.empty()) fleetSizes.push_back(params.nodes);
+    if (params.txIntervalMs == 0 || params.stateTxMs == 0 || params.hours <= 0 || params.dataRate > 4) {
+        usage();
+        return 2;
+    }
+
+    FILE* json = nullptr;
+    if (!jsonPath.empty() && !(json = fopen(jsonPath.c_str(), "w"))) {
+        fprintf(stderr, "cannot write %s\n", jsonPath.c_str());
+        return 2;
+    }
+
+    for (size_t i = 0; i < fleetSizes.size(); i++) {
+        params.nodes = fleetSizes[i];
+        Fleet::Simulation sim(params);
+        sim.run();
+        if (fleetSizes.size() == 1) Fleet::printReport(params, sim.stats());
+        else Fleet::printSweepRow(params, sim.stats(), i == 0);
+        if (json) fprintf(json, "%s\n", Fleet::toJson(params, sim.stats()).c_str());
+        fflush(stdout);
+    }
+
+    if (json) fclose(json);
+    return 0;
+}
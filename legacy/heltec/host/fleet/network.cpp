@@ -0,0 +1,194 @@
+#include "fleet.h"
+#include "lib/protocol_constants.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Fleet {
+
+// =============================================================================
+// Link model
+// =============================================================================
+
+namespace Link {
+
+double pathLossDb(double distanceKm) {
+    // Okumura-Hata style log-distance fit: 120 dB at 1 km, exponent 3.76
+    return 120.0 + 37.6 * std::log10(distanceKm < 0.01 ? 0.01 : distanceKm);
+}
+
+double snr(double rssi, uint32_t bwHz) {
+    // Thermal noise -174 dBm/Hz plus a 6 dB receiver noise figure
+    double noiseDbm = -174.0 + 10.0 * std::log10((double)bwHz) + 6.0;
+    return rssi - noiseDbm;
+}
+
+double requiredSnr(uint8_t sf) {
+    // SX126x datasheet demodulator floors, 2.5 dB per SF step
+    return sf < 7 ? -5.0 : -7.5 - 2.5 * (sf - 7);
+}
+
+Airtime::Modulation rx1Modulation(uint8_t upDataRate) {
+    // US915: RX1 uses DR10 + upstream DR on 500 kHz (DR10 = SF10 .. DR13 = SF7)
+    return {(uint8_t)(upDataRate >= 3 ? 7 : 10 - upDataRate), 500000, 1};
+}
+
+Airtime::Modulation rx2Modulation() {
+    return {12, 500000, 1};     // US915 DR8
+}
+
+} // namespace Link
+
+// =============================================================================
+// Network
+// =============================================================================
+
+static constexpr uint64_t KEEP_US = 5000000;        // Longer than any frame plus RX windows
+static constexpr uint8_t CAPTURE_DB = 6;
+static constexpr size_t JOIN_ACCEPT_LEN = 17;       // PHY bytes, no CFList
+static constexpr size_t DOWNLINK_HEADER_LEN = 12;   // MHDR + FHDR + MIC
+static constexpr size_t LINK_ADR_REQ_LEN = 5;       // FOpts
+
+void Network::addNode() {
+    _nodes.emplace_back();
+}
+
+void Network::beginUplink(const Transmission& t) {
+    _onAir.push_back(t);
+    _stats->uplinkAirUs += t.endUs - t.startUs;
+}
+
+void Network::prune(uint64_t nowUs) {
+    if (nowUs < KEEP_US) return;
+    uint64_t cutoff = nowUs - KEEP_US;
+    _onAir.erase(std::remove_if(_onAir.begin(), _onAir.end(),
+                                [cutoff](const Transmission& o) { return o.endUs < cutoff; }),
+                 _onAir.end());
+    _gwTx.erase(std::remove_if(_gwTx.begin(), _gwTx.end(),
+                               [cutoff](const std::pair<uint64_t, uint64_t>& d) { return d.second < cutoff; }),
+                _gwTx.end());
+}
+
+LossCause Network::resolve(const Transmission& t) const {
+    if (!Link::decodes(t.snr, t.sf)) return LossCause::Sensitivity;
+
+    for (const auto& d : _gwTx) {
+        if (d.first < t.endUs && d.second > t.startUs) return LossCause::HalfDuplex;
+    }
+
+    uint8_t busyPaths = 0;
+    for (const Transmission& o : _onAir) {
+        if (o.node == t.node && o.startUs == t.startUs) continue;
+        if (o.startUs >= t.endUs || o.endUs <= t.startUs) continue;
+
+        // Every path is locked by a frame that was already being received
+        if (o.startUs <= t.startUs && o.endUs > t.startUs && Link::decodes(o.snr, o.sf)) busyPaths++;
+
+        // Same channel and SF: survives only if CAPTURE_DB stronger than each interferer
+        if (o.channel == t.channel && o.sf == t.sf && o.rssi > t.rssi - CAPTURE_DB) {
+            return LossCause::Collision;
+        }
+    }
+    return busyPaths >= DEMOD_PATHS ? LossCause::DemodBusy : LossCause::None;
+}
+
+Reception Network::endUplink(const Transmission& t, const Uplink& up) {
+    prune(t.endUs);
+
+    Reception r;
+    r.loss = resolve(t);
+    switch (r.loss) {
+        case LossCause::None: break;
+        case LossCause::Sensitivity: _stats->lostSensitivity++; return r;
+        case LossCause::Collision: _stats->lostCollision++; return r;
+        case LossCause::DemodBusy: _stats->lostDemodBusy++; return r;
+        case LossCause::HalfDuplex: _stats->lostHalfDuplex++; return r;
+    }
+
+    NodeState& ns = _nodes[t.node];
+    if (up.port == 0) {
+        // Join request: new session
+        ns = NodeState();
+        r.downlink.joinAccept = true;
+        scheduleDownlink(t, 5000000, JOIN_ACCEPT_LEN, &r.downlink);
+        return r;
+    }
+
+    r.duplicate = (int64_t)up.fCnt <= ns.lastFCnt;
+    if (!r.duplicate) {
+        ns.lastFCnt = up.fCnt;
+        ns.snrHistory.push_back(t.snr);
+        if (ns.snrHistory.size() > ADR_HISTORY) ns.snrHistory.erase(ns.snrHistory.begin());
+
+        // The server ACKs registration once the last frame arrives: cmds
+        // whole, or its last chunk at low data rates
+        static const char REG_LAST[] = "reg:cmds|";
+        static const char REG_LAST_CHUNK[] = "~C";
+        if (up.port == FPORT_REGISTRATION &&
+            ((up.len >= sizeof(REG_LAST) - 1 && memcmp(up.payload, REG_LAST, sizeof(REG_LAST) - 1) == 0) ||
+             (up.len >= sizeof(REG_LAST_CHUNK) - 1 &&
+              memcmp(up.payload, REG_LAST_CHUNK, sizeof(REG_LAST_CHUNK) - 1) == 0))) {
+            ns.regAckPending = true;
+        }
+        if (ns.adrDataRate == t.dataRate) ns.adrDataRate = 0xFF;
+        adr(ns, t);
+    }
+
+    bool sendAdr = ns.adrDataRate != 0xFF;
+    if (!up.confirmed && !ns.regAckPending && !sendAdr && !up.adrAckReq) return r;
+
+    Downlink& dl = r.downlink;
+    dl.ack = up.confirmed;
+    dl.port = ns.regAckPending ? FPORT_REG_ACK : 0;
+    dl.adrDataRate = ns.adrDataRate;
+    size_t phyLen = DOWNLINK_HEADER_LEN + (sendAdr ? LINK_ADR_REQ_LEN : 0) + (dl.port ? 2 : 0);
+    if (scheduleDownlink(t, 1000000, phyLen, &dl)) {
+        if (dl.port) ns.regAckPending = false;
+        if (sendAdr) _stats->adrCommands++;
+    }
+    return r;
+}
+
+// Simplified ADR (ChirpStack-style): best SNR of the last uplinks against the
+// SF floor and a 10 dB installation margin, one DR step per 3 dB of headroom
+void Network::adr(NodeState& ns, const Transmission& t) {
+    if (!_params.adr || ns.snrHistory.size() < ADR_HISTORY) return;
+    double maxSnr = *std::max_element(ns.snrHistory.begin(), ns.snrHistory.end());
+    int steps = (int)std::floor((maxSnr - Link::requiredSnr(t.sf) - ADR_MARGIN_DB) / 3.0);
+    uint8_t dr = t.dataRate;
+    while (steps-- > 0 && dr < ADR_MAX_DR) dr++;
+    if (dr != t.dataRate) {
+        ns.adrDataRate = dr;
+        ns.snrHistory.clear();
+    }
+}
+
+bool Network::scheduleDownlink(const Transmission& t, uint64_t rx1DelayUs, size_t phyLen, Downlink* dl) {
+    for (uint8_t window = 1; window <= 2; window++) {
+        Airtime::Modulation mod = window == 1 ? Link::rx1Modulation(t.dataRate) : Link::rx2Modulation();
+        uint64_t startUs = t.endUs + rx1DelayUs + (window == 2 ? 1000000 : 0);
+        uint64_t endUs = startUs + Airtime::timeOnAirUs(mod, phyLen);
+        bool busy = false;
+        for (const auto& d : _gwTx) {
+            if (d.first < endUs && d.second > startUs) {
+                busy = true;
+                break;
+            }
+        }
+        if (busy) continue;
+
+        _gwTx.emplace_back(startUs, endUs);
+        dl->sent = true;
+        dl->window = window;
+        dl->startUs = startUs;
+        dl->endUs = endUs;
+        dl->mod = mod;
+        _stats->downlinkAirUs += endUs - startUs;
+        (window == 1 ? _stats->downlinksRx1 : _stats->downlinksRx2)++;
+        return true;
+    }
+    _stats->downlinksDropped++;
+    return false;
+}
+
+} // namespace Fleet
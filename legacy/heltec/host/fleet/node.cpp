@@ -0,0 +1,403 @@
+#include "node.h"
+#include "lib/protocol_constants.h"
+#include "lib/telemetry_keys.h"
+#include "devices/remote/device_config.h"
+#include <Arduino.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace Fleet {
+
+static constexpr LoRaWANRegion REGION = LoRaWANRegion::US915;
+
+Node::Node(uint32_t id, Simulation& sim, double distanceKm, double shadowDb)
+    : _id(id), _sim(sim), _distanceKm(distanceKm),
+      _pathLossDb(Link::pathLossDb(distanceKm) + shadowDb),
+      _clockScale(1.0 + std::uniform_real_distribution<double>(-CLOCK_PPM, CLOCK_PPM)(sim.rng()) * 1e-6),
+      _schema(buildDeviceSchema()),
+      _compressor(_schema, sim.params().confirmed),
+      _rules(_schema, nullptr) {
+    _tx.begin();
+    _airtime.setBudget(sim.params().airtimeBudgetMsPerHour);
+    _reg.setTxScheduler(&_tx);
+    _reg.setPayloadBudget(&_budget);
+    _reg.setRegistrationText(DEVICE_REGISTRATION);
+    _reg.setDeviceInfo(DEVICE_TYPE, FIRMWARE_VERSION);
+    _stats.distanceKm = distanceKm;
+}
+
+void Node::handle(const Event& e) {
+    switch (e.type) {
+        case EventType::Boot:
+            _bootUs = e.atUs;
+            // Scheduler tasks start at boot; they idle until joined/registered
+            _sim.schedule(e.atUs + periodUs(_sim.params().txIntervalMs), _id, EventType::Telemetry);
+            _sim.schedule(e.atUs + periodUs(_sim.params().stateTxMs), _id, EventType::StateTx);
+            join(e.atUs);
+            break;
+        case EventType::JoinStart: join(e.atUs); break;
+        case EventType::JoinEnd: joinEnd(e.atUs); break;
+        case EventType::JoinDone: joinDone(e.atUs); break;
+        case EventType::AppTick: appTick(e.atUs); break;
+        case EventType::Telemetry:
+            _sim.schedule(e.atUs + periodUs(_sim.params().txIntervalMs), _id, EventType::Telemetry);
+            telemetry(e.atUs, false);
+            break;
+        case EventType::StateTx:
+            _sim.schedule(e.atUs + periodUs(_sim.params().stateTxMs), _id, EventType::StateTx);
+            stateTx(e.atUs);
+            break;
+        case EventType::ControlChange: controlChange(e.atUs); break;
+        case EventType::RadioKick: radioKick(e.atUs); break;
+        case EventType::TxEnd: txEnd(e.atUs); break;
+        case EventType::TxDone: txDone(e.atUs); break;
+    }
+}
+
+NodeStats Node::finish() const {
+    NodeStats s = _stats;
+    s.finalDataRate = _budget.dataRate;
+    s.registered = _reg.getState() == RegistrationManager::State::Complete;
+    return s;
+}
+
+PortStats& Node::port(uint8_t p) {
+    return _sim.mutableStats().ports[p];
+}
+
+// =============================================================================
+// Join (radioTaskRun)
+// =============================================================================
+
+void Node::join(uint64_t nowUs) {
+    _stats.joinAttempts++;
+    _dataRate = 0;      // Join requests go out at the most robust DR
+    transmit(nowUs, JOIN_REQUEST_LEN);
+    _sim.schedule(_current.endUs, _id, EventType::JoinEnd);
+}
+
+void Node::joinEnd(uint64_t nowUs) {
+    Uplink up = {0, 0, false, false, nullptr, 0};
+    _reception = _sim.network().endUplink(_current, up);
+    _sim.schedule(listen(5000000, _reception.downlink), _id, EventType::JoinDone);
+}
+
+void Node::joinDone(uint64_t nowUs) {
+    _busy = false;
+    if (!_heard) {
+        _sim.schedule(nowUs + (uint64_t)JOIN_RETRY_MS * 1000, _id, EventType::JoinStart);
+        return;
+    }
+    const Params& p = _sim.params();
+    _joined = true;
+    _dataRate = p.dataRate < p.minDataRate ? p.minDataRate : p.dataRate;
+    _budget.update(REGION, _dataRate);
+    _sim.schedule(nowUs, _id, EventType::AppTick);
+    if (p.stateChangeMs > 0) {
+        std::exponential_distribution<double> gap(1.0 / p.stateChangeMs);
+        _sim.schedule(nowUs + (uint64_t)(gap(_sim.rng()) * 1000), _id, EventType::ControlChange);
+    }
+}
+
+// =============================================================================
+// Producers (RemoteApplicationImpl tasks)
+// =============================================================================
+
+// Display task: registration state machine and the post-join reports. Only
+// scheduled until registration completes; after that the tick does nothing.
+void Node::appTick(uint64_t nowUs) {
+    if (_reg.getState() == RegistrationManager::State::NotStarted) _reg.onJoin();
+    // tick() starts a sequence when Pending (and again 30 s after an
+    // unanswered one), then feeds it a few frames per tick
+    bool wasSending = _reg.sending();
+    uint32_t queued = _reg.framesQueued();
+    _reg.tick((uint32_t)(nowUs / 1000));
+    if (!wasSending && _reg.framesQueued() != queued) _regSendUs = nowUs;
+    port(FPORT_REGISTRATION).produced += _reg.framesQueued() - queued;
+    if (_reg.getState() == RegistrationManager::State::Sent && _prevRegState == RegistrationManager::State::NotStarted) {
+        diagnostics(nowUs);
+        telemetry(nowUs, true);
+    }
+    _prevRegState = _reg.getState();
+    kick(nowUs);
+
+    if (_reg.getState() != RegistrationManager::State::Complete) {
+        _sim.schedule(nowUs + periodUs(APP_TICK_MS), _id, EventType::AppTick);
+    }
+}
+
+// lorawan_tx (snapshot = post-join report): pulse delta, volume, battery,
+// error total and time since reset, encoded the way sendTelemetry() does
+void Node::telemetry(uint64_t nowUs, bool snapshot) {
+    if (!_joined) return;
+    if (!snapshot && _reg.getState() != RegistrationManager::State::Complete) return;
+
+    uint32_t pulses = (uint32_t)(_sim.rng()() % 20);
+    _totalVolume += pulses / 450.0f;
+    struct { const char* key; float value; } readings[] = {
+        {TelemetryKeys::PulseDelta, snapshot ? 0.0f : (float)pulses},
+        {TelemetryKeys::TotalVolume, snapshot ? 0.0f : _totalVolume},
+        {TelemetryKeys::BatteryPercent, 90.0f},
+        {TelemetryKeys::ErrorCount, (float)(_stats.noAck + _stats.joinAttempts - 1)},
+        {TelemetryKeys::TimeSinceReset, (float)((nowUs - _bootUs) / 1000000)},
+    };
+    TelemetryCodec::FieldValues values;
+    for (const auto& r : readings) {
+        int8_t idx = _schema.findFieldIndex(r.key);
+        if (idx >= 0) values.set((uint8_t)idx, r.value);
+    }
+
+    uint8_t buffer[TelemetryCodec::MAX_FRAME_SIZE];
+    uint8_t maxPayload = _budget.maxPayload();
+    size_t cap = sizeof(buffer) < maxPayload ? sizeof(buffer) : maxPayload;
+    size_t len = 0;
+    for (;;) {
+        len = snapshot ? TelemetryCodec::encodeSnapshot(_schema, values, buffer, cap)
+                       : _compressor.encode(values, buffer, cap);
+        if (len > 0 || !TelemetryCodec::dropLowestPriority(_schema, &values)) break;
+    }
+    if (len == 0) return;
+
+    LoRaWANTxMsg msg;
+    msg.port = FPORT_TELEMETRY;
+    msg.len = len;
+    msg.confirmed = _sim.params().confirmed;
+    memcpy(msg.payload, buffer, len);
+    enqueue(nowUs, TxClass::Telemetry, msg);
+}
+
+// sendDiagnostics(): same key:value text, cut to the payload budget
+void Node::diagnostics(uint64_t nowUs) {
+    char buffer[128];
+    int len = snprintf(buffer, sizeof(buffer),
+        "reg:%d,err:%u,na:%u,jf:%u,sf:0,sr:0,dr:0,dp:0,cs:0,wf:0,tm:0,mm:0,qf:%u,ts:0,rf:0,cv:0,pf:0,up:%lu,bat:90,rssi:%d,snr:%.1f,ul:%lu,dl:0,fw:%s",
+        0, (unsigned)(_stats.noAck + _stats.joinAttempts - 1), (unsigned)_stats.noAck,
+        (unsigned)(_stats.joinAttempts - 1), (unsigned)_stats.queueFull,
+        (unsigned long)((nowUs - _bootUs) / 1000000), (int)_current.rssi, _current.snr,
+        (unsigned long)_fCnt, FIRMWARE_VERSION);
+    if (len < 0 || len >= (int)sizeof(buffer)) len = sizeof(buffer) - 1;
+    if (len > _budget.maxPayload()) {
+        len = (int)PayloadFit::fitItems(buffer, len, _budget.maxPayload());
+        if (len == 0) return;
+    }
+
+    LoRaWANTxMsg msg;
+    msg.port = FPORT_DIAGNOSTICS;
+    msg.len = len;
+    msg.confirmed = false;
+    memcpy(msg.payload, buffer, len);
+    enqueue(nowUs, TxClass::Diagnostics, msg);
+}
+
+// state_tx: batch queued control changes in 11-byte events (always confirmed)
+void Node::stateTx(uint64_t nowUs) {
+    if (!_joined || _reg.getState() != RegistrationManager::State::Complete) return;
+    if (!_rules.hasPendingStateChange()) return;
+
+    const uint8_t maxPayload = _budget.maxPayload();
+    if (maxPayload < 11) return;
+    uint8_t buffer[256];
+    size_t maxLen = (size_t)(maxPayload / 11) * 11;
+    size_t events = 0;
+    size_t len = _rules.formatStateChangeBatch(buffer, maxLen, &events);
+    if (len == 0 || events == 0) return;
+
+    LoRaWANTxMsg msg;
+    msg.port = FPORT_STATE_CHANGE;
+    msg.len = len;
+    msg.confirmed = true;
+    memcpy(msg.payload, buffer, len);
+    if (enqueue(nowUs, TxClass::StateChange, msg)) _rules.clearStateChangeBatch(events);
+}
+
+// Scenario load: a rule (or the UI) flips a random control
+void Node::controlChange(uint64_t nowUs) {
+    std::mt19937& rng = _sim.rng();
+    if (_schema.control_count > 0) {
+        uint8_t ctrl = (uint8_t)(rng() % _schema.control_count);
+        uint8_t state = (uint8_t)(rng() % _schema.controls[ctrl].state_count);
+        _rules.setControlState(ctrl, state, EdgeRules::TriggerSource::RULE, 0, (uint32_t)(nowUs / 1000));
+    }
+    std::exponential_distribution<double> gap(1.0 / _sim.params().stateChangeMs);
+    _sim.schedule(nowUs + (uint64_t)(gap(rng) * 1000) + 1, _id, EventType::ControlChange);
+}
+
+bool Node::enqueue(uint64_t nowUs, TxClass cls, const LoRaWANTxMsg& msg) {
+    port(msg.port).produced++;
+    std::deque<uint64_t>& created = _created[(uint8_t)cls];
+    switch (_tx.enqueue(cls, msg)) {
+        case TxScheduler::Result::Queued:
+            created.push_back(nowUs);
+            break;
+        case TxScheduler::Result::Replaced:
+            if (TxScheduler::CONFIG[(uint8_t)cls].policy == TxScheduler::Policy::DropOldest) {
+                created.pop_front();
+                created.push_back(nowUs);
+            } else {
+                created.back() = nowUs;
+            }
+            break;
+        case TxScheduler::Result::Full:
+            _stats.queueFull++;
+            return false;
+    }
+    kick(nowUs);
+    return true;
+}
+
+// =============================================================================
+// Radio task (radioTaskServiceTx)
+// =============================================================================
+
+// The radio task re-checks the scheduler whenever a producer signals it, so
+// an earlier kick supersedes a later one (e.g. a state change enqueued while
+// telemetry waits for airtime)
+void Node::kick(uint64_t atUs) {
+    if (_busy && !_retransmit) return;
+    if (atUs >= _kickAtUs) return;
+    _kickAtUs = atUs;
+    _sim.schedule(atUs, _id, EventType::RadioKick);
+}
+
+void Node::radioKick(uint64_t nowUs) {
+    if (nowUs != _kickAtUs) return;    // Superseded
+    _kickAtUs = NO_KICK;
+    if (_retransmit) {
+        _retransmit = false;
+        transmit(nowUs, _msg.len + Airtime::LORAWAN_OVERHEAD);
+        _sim.schedule(_current.endUs, _id, EventType::TxEnd);
+        return;
+    }
+    if (_busy || !_joined) return;
+
+    uint32_t nowMs = (uint32_t)(nowUs / 1000);
+    uint8_t allowed = _airtime.admissibleClasses(nowMs);
+    TxClass cls;
+    if (!_tx.dequeue(&_msg, &cls, 0, allowed)) {
+        // Deferred by the airtime ledger: look again when the next bucket opens
+        if (_tx.pendingTotal() > 0) {
+            uint64_t nextMinute = ((uint64_t)nowMs / Airtime::AirtimeLedger::BUCKET_MS + 1) *
+                                  Airtime::AirtimeLedger::BUCKET_MS;
+            kick(nextMinute * 1000);
+        }
+        return;
+    }
+
+    // Registration frames are enqueued by RegistrationManager itself
+    std::deque<uint64_t>& created = _created[(uint8_t)cls];
+    if (cls == TxClass::Registration || created.empty()) {
+        _msgCreatedUs = _regSendUs;
+    } else {
+        _msgCreatedUs = created.front();
+        created.pop_front();
+    }
+
+    if (_msg.len > _budget.maxPayload()) {
+        _stats.tooLarge++;
+        kick(nowUs);
+        return;
+    }
+
+    _fCnt++;
+    _attemptsLeft = _msg.confirmed ? _sim.params().retries : 0;
+    transmit(nowUs, _msg.len + Airtime::LORAWAN_OVERHEAD);
+    _sim.schedule(_current.endUs, _id, EventType::TxEnd);
+}
+
+void Node::transmit(uint64_t nowUs, size_t phyLen) {
+    std::mt19937& rng = _sim.rng();
+    std::normal_distribution<double> fading(0, Link::FADING_SIGMA_DB);
+    Airtime::Modulation mod = Airtime::modulationFor(REGION, _dataRate);
+
+    Transmission& t = _current;
+    t.node = _id;
+    t.startUs = nowUs;
+    t.endUs = nowUs + Airtime::timeOnAirUs(mod, phyLen);
+    t.channel = _dataRate == 4 ? WIDE_CHANNEL : (uint8_t)(rng() % UPLINK_CHANNELS);
+    t.dataRate = _dataRate;
+    t.sf = mod.sf;
+    t.rssi = _sim.params().txPowerDbm - _pathLossDb + fading(rng);
+    t.snr = Link::snr(t.rssi, mod.bwHz);
+
+    _busy = true;
+    _stats.txUs += t.endUs - t.startUs;
+    _sim.network().beginUplink(t);
+}
+
+void Node::txEnd(uint64_t nowUs) {
+    Uplink up = {_msg.port, _fCnt, _msg.confirmed, _sinceDownlink >= ADR_ACK_LIMIT, _msg.payload, _msg.len};
+    _reception = _sim.network().endUplink(_current, up);
+
+    PortStats& ps = port(_msg.port);
+    ps.uplinks++;
+    if (_reception.loss == LossCause::None && !_reception.duplicate) {
+        ps.delivered++;
+        ps.bytes += _msg.len;
+        ps.latencyMs.push_back((uint32_t)((nowUs - _msgCreatedUs) / 1000));
+    }
+    _sim.schedule(listen(1000000, _reception.downlink), _id, EventType::TxDone);
+}
+
+uint64_t Node::listen(uint64_t rx1DelayUs, const Downlink& dl) {
+    std::normal_distribution<double> fading(0, Link::FADING_SIGMA_DB);
+    _heard = false;
+    uint64_t doneUs = _current.endUs;
+    for (uint8_t window = 1; window <= 2 && !_heard; window++) {
+        uint64_t openUs = _current.endUs + rx1DelayUs + (window == 2 ? 1000000 : 0);
+        Airtime::Modulation mod = window == 1 ? Link::rx1Modulation(_current.dataRate) : Link::rx2Modulation();
+        if (dl.sent && dl.window == window) {
+            // Preamble detected: the radio stays in RX for the whole frame
+            double rssi = Link::GATEWAY_TX_DBM - _pathLossDb + fading(_sim.rng());
+            _heard = Link::decodes(Link::snr(rssi, mod.bwHz), mod.sf);
+            if (!_heard) _sim.mutableStats().downlinksMissed++;
+            _stats.rxUs += dl.endUs - dl.startUs;
+            doneUs = dl.endUs;
+        } else {
+            // No preamble: the window times out after 8 symbols
+            uint32_t symbolUs = (uint32_t)(((uint64_t)1000000 << mod.sf) / mod.bwHz);
+            _stats.rxUs += 8 * symbolUs;
+            doneUs = openUs + 8 * symbolUs;
+        }
+    }
+    return doneUs;
+}
+
+void Node::txDone(uint64_t nowUs) {
+    const Params& p = _sim.params();
+    const Downlink& dl = _reception.downlink;
+    bool acked = _msg.confirmed && _heard && dl.ack;
+
+    if (_msg.confirmed && !acked && _attemptsLeft > 0) {
+        _attemptsLeft--;
+        _retransmit = true;
+        std::uniform_int_distribution<uint32_t> backoffMs(1000, 3000);
+        kick(nowUs + (uint64_t)backoffMs(_sim.rng()) * 1000);
+        return;
+    }
+
+    // sendReceive() returned without a radio error
+    uint32_t nowMs = (uint32_t)(nowUs / 1000);
+    _budget.update(REGION, _current.dataRate);
+    _airtime.record(nowMs, Airtime::uplinkTimeOnAirUs(REGION, _current.dataRate, _msg.len));
+    if (_msg.confirmed && !acked) _stats.noAck++;
+    if (_msg.port == FPORT_TELEMETRY && _msg.len > 1) {
+        _compressor.onUplinkComplete(_msg.payload[0], _msg.payload[1], true, acked);
+    }
+
+    if (_heard) {
+        _sinceDownlink = 0;
+        if (dl.adrDataRate != 0xFF && p.adr) {
+            _dataRate = dl.adrDataRate < p.minDataRate ? p.minDataRate : dl.adrDataRate;
+        }
+        if (dl.port == FPORT_REG_ACK) _reg.onRegAck();
+    } else if (p.adr && ++_sinceDownlink >= ADR_ACK_LIMIT + ADR_ACK_DELAY &&
+               (_sinceDownlink - ADR_ACK_LIMIT) % ADR_ACK_DELAY == 0 && _dataRate > p.minDataRate) {
+        _dataRate--;    // No answer to ADRACKReq: step towards a more robust DR
+    }
+
+    _busy = false;
+    kick(nowUs);
+}
+
+} // namespace Fleet
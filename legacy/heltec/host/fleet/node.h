@@ -0,0 +1,96 @@
+#pragma once
+
+#include "fleet.h"
+#include <deque>
+
+namespace Fleet {
+
+// -----------------------------------------------------------------------------
+// Node: one remote device
+// -----------------------------------------------------------------------------
+// Producers follow RemoteApplicationImpl (registration on the display tick,
+// post-join diagnostics + snapshot, lorawan_tx, state_tx); the TX cycle
+// follows radioTaskServiceTx(): airtime admission, highest-priority frame,
+// size check against the budget, budget and airtime updated from the DR
+// used, completion fed back to the telemetry compressor.
+// -----------------------------------------------------------------------------
+class Node {
+public:
+    Node(uint32_t id, Simulation& sim, double distanceKm, double shadowDb);
+
+    void handle(const Event& e);
+
+    /** Final per-node figures (call after the run). */
+    NodeStats finish() const;
+
+private:
+    static constexpr uint8_t JOIN_REQUEST_LEN = 23;      // PHY bytes
+    static constexpr uint32_t JOIN_RETRY_MS = 10000;     // radioTaskRun
+    static constexpr uint32_t APP_TICK_MS = 1000;        // Display task
+    static constexpr uint32_t ADR_ACK_LIMIT = 64;        // LoRaWAN ADR backoff
+    static constexpr uint32_t ADR_ACK_DELAY = 32;
+    static constexpr uint64_t NO_KICK = UINT64_MAX;
+    static constexpr double CLOCK_PPM = 20;              // Crystal tolerance
+
+    void join(uint64_t nowUs);
+    void joinEnd(uint64_t nowUs);
+    void joinDone(uint64_t nowUs);
+    void appTick(uint64_t nowUs);
+    void telemetry(uint64_t nowUs, bool snapshot);
+    void diagnostics(uint64_t nowUs);
+    void stateTx(uint64_t nowUs);
+    void controlChange(uint64_t nowUs);
+    void radioKick(uint64_t nowUs);
+    void txEnd(uint64_t nowUs);
+    void txDone(uint64_t nowUs);
+
+    /** A task period on this node's clock (task phases drift apart between nodes). */
+    uint64_t periodUs(uint32_t ms) const { return (uint64_t)(ms * _clockScale * 1000); }
+    bool enqueue(uint64_t nowUs, TxClass cls, const LoRaWANTxMsg& msg);
+    void kick(uint64_t atUs);
+    void transmit(uint64_t nowUs, size_t phyLen);
+    /** Listen in RX1/RX2 after an uplink; returns when the radio is idle again. */
+    uint64_t listen(uint64_t rx1DelayUs, const Downlink& dl);
+    PortStats& port(uint8_t p);
+
+    uint32_t _id;
+    Simulation& _sim;
+    double _distanceKm;
+    double _pathLossDb;         // Mean, including this node's shadowing
+    double _clockScale;
+
+    const MessageSchema::Schema& _schema;
+    TxScheduler _tx;
+    PayloadBudget _budget = {};
+    Airtime::AirtimeLedger _airtime = {};
+    RegistrationManager _reg;
+    TelemetryCodec::TelemetryCompressor _compressor;
+    EdgeRules::EdgeRulesEngine _rules;
+    RegistrationManager::State _prevRegState = RegistrationManager::State::NotStarted;
+
+    bool _joined = false;
+    uint8_t _dataRate = 0;          // DR of the next uplink (ADR / backoff move it)
+    uint32_t _fCnt = 0;
+    uint32_t _sinceDownlink = 0;    // Uplinks since the last downlink heard
+    uint64_t _bootUs = 0;
+    uint64_t _regSendUs = 0;
+    float _totalVolume = 0;
+
+    // Radio task
+    bool _busy = false;
+    uint64_t _kickAtUs = NO_KICK;   // Next RadioKick that is still live
+    bool _retransmit = false;
+    LoRaWANTxMsg _msg = {};
+    uint64_t _msgCreatedUs = 0;
+    uint8_t _attemptsLeft = 0;
+    Transmission _current = {};
+    Reception _reception;
+    bool _heard = false;
+
+    // Enqueue time of each queued frame, per class, in ring order
+    std::deque<uint64_t> _created[TxScheduler::CLASS_COUNT];
+
+    NodeStats _stats;
+};
+
+} // namespace Fleet
@@ -0,0 +1,234 @@
+#include "node.h"
+#include "lib/core_logger.h"
+#include "lib/protocol_constants.h"
+#include "sim.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace Fleet {
+
+// SX1262 at 22 dBm and in RX (datasheet, DC-DC); used for the battery figure
+static constexpr double TX_MA = 118.0;
+static constexpr double RX_MA = 5.3;
+
+Params Params::fromConfig(const LoRaWANConfig& cfg, uint32_t nodes) {
+    Params p;
+    p.nodes = nodes;
+    p.txIntervalMs = cfg.txIntervalMs;
+    p.confirmed = cfg.useConfirmedUplinks;
+    p.dataRate = cfg.dataRate;
+    p.minDataRate = cfg.minDataRate;
+    p.adr = cfg.adrEnabled;
+    p.airtimeBudgetMsPerHour = cfg.airtimeBudgetMsPerHour;
+    p.txPowerDbm = cfg.txPower;
+    return p;
+}
+
+// =============================================================================
+// Event loop
+// =============================================================================
+
+Simulation::Simulation(const Params& params)
+    : _params(params), _rng(params.seed), _network(_params, &_stats) {}
+
+Simulation::~Simulation() = default;
+
+void Simulation::run() {
+    // Thousands of firmware objects log; keep only errors
+    Logger::setLevel(Logger::Level::Error);
+    Serial.setMuted(true);
+    Sim::setClockManual(0);
+
+    // Uniform in a disc around the gateway, lognormal shadowing per node
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> shadowing(0.0, Link::SHADOWING_SIGMA_DB);
+    for (uint32_t id = 0; id < _params.nodes; id++) {
+        double distanceKm = _params.radiusKm * std::sqrt(unit(_rng));
+        _nodes.emplace_back(new Node(id, *this, distanceKm, shadowing(_rng)));
+        _network.addNode();
+        uint64_t bootUs = (uint64_t)(unit(_rng) * _params.staggerMs * 1000);
+        schedule(bootUs, id, EventType::Boot);
+    }
+
+    const uint64_t endUs = (uint64_t)(_params.hours * 3600e6);
+    while (!_events.empty()) {
+        Event e = _events.pop();
+        if (e.atUs > endUs) break;
+        Sim::setClockManual((uint32_t)(e.atUs / 1000));
+        _nodes[e.node]->handle(e);
+    }
+
+    _stats.nodes.clear();
+    for (const auto& node : _nodes) _stats.nodes.push_back(node->finish());
+    _stats.simulatedS = _params.hours * 3600;
+}
+
+// =============================================================================
+// Reports
+// =============================================================================
+
+namespace {
+
+const char* portName(uint8_t port) {
+    switch (port) {
+        case FPORT_REGISTRATION: return "reg";
+        case FPORT_TELEMETRY: return "telemetry";
+        case FPORT_STATE_CHANGE: return "state";
+        case FPORT_COMMAND_ACK: return "cmd-ack";
+        case FPORT_DIAGNOSTICS: return "diag";
+        default: return "other";
+    }
+}
+
+// Nearest-rank percentile
+uint32_t percentile(std::vector<uint32_t> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+    return values[rank > 0 ? rank - 1 : 0];
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+struct Summary {
+    uint64_t uplinks = 0;
+    uint64_t lost = 0;
+    double txSPerHourAvg = 0;
+    double txSPerHourMax = 0;
+    double rxSPerHourAvg = 0;
+    double mAhPerDayAvg = 0;
+    double mAhPerDayMax = 0;
+    uint32_t registered = 0;
+    uint32_t noAck = 0;
+    uint32_t queueFull = 0;
+    uint32_t tooLarge = 0;
+    double joinsAvg = 0;
+    uint32_t finalDr[8] = {};
+};
+
+Summary summarize(const Stats& stats) {
+    Summary s;
+    for (const auto& kv : stats.ports) s.uplinks += kv.second.uplinks;
+    s.lost = stats.lostSensitivity + stats.lostCollision + stats.lostDemodBusy + stats.lostHalfDuplex;
+
+    double hours = stats.simulatedS / 3600.0;
+    if (stats.nodes.empty() || hours <= 0) return s;
+    for (const NodeStats& n : stats.nodes) {
+        double txS = n.txUs / 1e6;
+        double rxS = n.rxUs / 1e6;
+        double mAhPerDay = (txS * TX_MA + rxS * RX_MA) / 3600.0 * (24.0 / hours);
+        s.txSPerHourAvg += txS / hours;
+        s.txSPerHourMax = std::max(s.txSPerHourMax, txS / hours);
+        s.rxSPerHourAvg += rxS / hours;
+        s.mAhPerDayAvg += mAhPerDay;
+        s.mAhPerDayMax = std::max(s.mAhPerDayMax, mAhPerDay);
+        s.registered += n.registered;
+        s.noAck += n.noAck;
+        s.queueFull += n.queueFull;
+        s.tooLarge += n.tooLarge;
+        s.joinsAvg += n.joinAttempts;
+        if (n.finalDataRate < 8) s.finalDr[n.finalDataRate]++;
+    }
+    double count = (double)stats.nodes.size();
+    s.txSPerHourAvg /= count;
+    s.rxSPerHourAvg /= count;
+    s.mAhPerDayAvg /= count;
+    s.joinsAvg /= count;
+    return s;
+}
+
+const PortStats& telemetryStats(const Stats& stats) {
+    static const PortStats none;
+    auto it = stats.ports.find(FPORT_TELEMETRY);
+    return it != stats.ports.end() ? it->second : none;
+}
+
+} // namespace
+
+void printReport(const Params& params, const Stats& stats) {
+    Summary s = summarize(stats);
+    double hours = stats.simulatedS / 3600.0;
+
+    printf("[fleet] %u nodes, %.1f h, telemetry every %u s (%s), state_tx %u s, retries %u, radius %.1f km\n",
+           (unsigned)params.nodes, hours, (unsigned)(params.txIntervalMs / 1000),
+           params.confirmed ? "confirmed" : "unconfirmed", (unsigned)(params.stateTxMs / 1000),
+           (unsigned)params.retries, params.radiusKm);
+    printf("[fleet] %-10s %9s %9s %9s %7s %10s %8s %8s %8s\n", "fPort", "produced", "uplinks",
+           "delivered", "deliv%", "bytes", "p50 ms", "p95 ms", "p99 ms");
+    for (const auto& kv : stats.ports) {
+        const PortStats& p = kv.second;
+        printf("[fleet] %2u %-7s %9u %9u %9u %6.1f%% %10llu %8u %8u %8u\n", (unsigned)kv.first,
+               portName(kv.first), (unsigned)p.produced, (unsigned)p.uplinks, (unsigned)p.delivered,
+               percent(p.delivered, p.produced), (unsigned long long)p.bytes,
+               (unsigned)percentile(p.latencyMs, 50), (unsigned)percentile(p.latencyMs, 95),
+               (unsigned)percentile(p.latencyMs, 99));
+    }
+    printf("[fleet] uplinks lost %.1f%%: sensitivity %u, collision %u, demodulators busy %u, half-duplex %u\n",
+           percent(s.lost, s.uplinks), (unsigned)stats.lostSensitivity, (unsigned)stats.lostCollision,
+           (unsigned)stats.lostDemodBusy, (unsigned)stats.lostHalfDuplex);
+    printf("[fleet] downlinks RX1 %u, RX2 %u, dropped (gateway busy) %u, not heard %u, ADR commands %u\n",
+           (unsigned)stats.downlinksRx1, (unsigned)stats.downlinksRx2, (unsigned)stats.downlinksDropped,
+           (unsigned)stats.downlinksMissed, (unsigned)stats.adrCommands);
+    if (hours > 0) {
+        printf("[fleet] channel load %.2f%% per uplink channel, gateway TX duty %.2f%%\n",
+               stats.uplinkAirUs / (hours * 3600e6 * UPLINK_CHANNELS) * 100.0,
+               stats.downlinkAirUs / (hours * 3600e6) * 100.0);
+    }
+    printf("[fleet] nodes registered %u/%u, join attempts %.1f avg, no-ACK %u, queue full %u, too large %u\n",
+           (unsigned)s.registered, (unsigned)stats.nodes.size(), s.joinsAvg, (unsigned)s.noAck,
+           (unsigned)s.queueFull, (unsigned)s.tooLarge);
+    printf("[fleet] radio per node: TX %.1f s/h avg (max %.1f), RX %.1f s/h, %.2f mAh/day avg (max %.2f)\n",
+           s.txSPerHourAvg, s.txSPerHourMax, s.rxSPerHourAvg, s.mAhPerDayAvg, s.mAhPerDayMax);
+    printf("[fleet] final DR:");
+    for (uint8_t dr = 0; dr < 8; dr++) {
+        if (s.finalDr[dr]) printf(" DR%u %u", (unsigned)dr, (unsigned)s.finalDr[dr]);
+    }
+    printf("\n");
+}
+
+void printSweepRow(const Params& params, const Stats& stats, bool header) {
+    if (header) {
+        printf("[fleet] %6s %8s %8s %9s %8s %8s %9s %10s\n", "nodes", "deliv%", "p95 ms", "lost%",
+               "coll%", "reg", "TX s/h", "mAh/day");
+    }
+    Summary s = summarize(stats);
+    const PortStats& t = telemetryStats(stats);
+    printf("[fleet] %6u %7.1f%% %8u %8.1f%% %7.1f%% %8u %9.1f %10.2f\n", (unsigned)params.nodes,
+           percent(t.delivered, t.produced), (unsigned)percentile(t.latencyMs, 95),
+           percent(s.lost, s.uplinks), percent(stats.lostCollision, s.uplinks), (unsigned)s.registered,
+           s.txSPerHourAvg, s.mAhPerDayAvg);
+}
+
+std::string toJson(const Params& params, const Stats& stats) {
+    Summary s = summarize(stats);
+    std::ostringstream o;
+    o << "{\"nodes\":" << params.nodes << ",\"hours\":" << params.hours
+      << ",\"tx_interval_ms\":" << params.txIntervalMs << ",\"confirmed\":" << (params.confirmed ? "true" : "false")
+      << ",\"state_tx_ms\":" << params.stateTxMs << ",\"state_change_ms\":" << params.stateChangeMs
+      << ",\"retries\":" << (unsigned)params.retries << ",\"radius_km\":" << params.radiusKm
+      << ",\"seed\":" << params.seed << ",\"ports\":{";
+    bool first = true;
+    for (const auto& kv : stats.ports) {
+        const PortStats& p = kv.second;
+        o << (first ? "" : ",") << "\"" << (unsigned)kv.first << "\":{\"produced\":" << p.produced
+          << ",\"uplinks\":" << p.uplinks << ",\"delivered\":" << p.delivered << ",\"bytes\":" << p.bytes
+          << ",\"p50_ms\":" << percentile(p.latencyMs, 50) << ",\"p95_ms\":" << percentile(p.latencyMs, 95)
+          << ",\"p99_ms\":" << percentile(p.latencyMs, 99) << "}";
+        first = false;
+    }
+    o << "},\"lost\":{\"sensitivity\":" << stats.lostSensitivity << ",\"collision\":" << stats.lostCollision
+      << ",\"demod_busy\":" << stats.lostDemodBusy << ",\"half_duplex\":" << stats.lostHalfDuplex
+      << "},\"downlinks\":{\"rx1\":" << stats.downlinksRx1 << ",\"rx2\":" << stats.downlinksRx2
+      << ",\"dropped\":" << stats.downlinksDropped << ",\"missed\":" << stats.downlinksMissed
+      << ",\"adr\":" << stats.adrCommands << "},\"registered\":" << s.registered
+      << ",\"tx_s_per_hour\":" << s.txSPerHourAvg << ",\"rx_s_per_hour\":" << s.rxSPerHourAvg
+      << ",\"mah_per_day_avg\":" << s.mAhPerDayAvg << ",\"mah_per_day_max\":" << s.mAhPerDayMax << "}";
+    return o.str();
+}
+
+} // namespace Fleet
@@ -0,0 +1,193 @@
+// =============================================================================
+// farmon_sim: the Heltec firmware as a Linux process
+// =============================================================================
+// Runs setup()/loop() from heltec.ino on the simulated HAL with a scaled
+// clock, applies a timed script of network and pin events, and prints an
+// uplink summary at the end.
+//
+//   farmon_sim [--duration s] [--speed x] [--script file] [--nvs file]
+//              [--seed n] [--quiet]
+//
+// Script lines (times in simulated seconds, '#' starts a comment):
+//   at 0 join-fail 2            next 2 join attempts time out
+//   at 120 downlink 10 0100     queue fPort 10 payload (hex) for the next RX window
+//   at 300 uplink-loss 30       percent of uplinks lost
+//   at 300 downlink-loss 10     percent of RX windows lost
+//   at 600 dr 1                 network moves the device to DR1 (ADR)
+//   at 60 link -110 -7          RSSI/SNR reported by the radio
+//   at 10 pin 7 1               drive a GPIO (fires attached interrupts)
+//   at 10 analog 1 1013 816     ADC raw value and millivolts on a pin
+//
+// A firmware restart (ESP.restart) saves the NVS file and exits with status
+// Sim::EXIT_RESTART, so a wrapper can relaunch with the same --nvs file.
+// =============================================================================
+
+#include <Arduino.h>
+#include "sim_nvs.h"
+#include "sim_radio.h"
+#include "lib/airtime.h"
+#include <map>
+#include <sstream>
+#include <fstream>
+
+void setup();
+void loop();
+
+namespace {
+
+struct Event {
+    uint32_t atMs;
+    std::string command;
+    std::vector<std::string> args;
+};
+
+std::vector<uint8_t> parseHex(const std::string& hex) {
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        out.push_back((uint8_t)strtoul(hex.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return out;
+}
+
+bool loadScript(const std::string& path, std::vector<Event>* events) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream words(line);
+        std::string at;
+        double seconds;
+        Event e;
+        if (!(words >> at)) continue;
+        if (at != "at" || !(words >> seconds >> e.command)) {
+            fprintf(stderr, "%s:%d: expected 'at <seconds> <command> ...'\n", path.c_str(), lineNo);
+            return false;
+        }
+        e.atMs = (uint32_t)(seconds * 1000);
+        for (std::string arg; words >> arg;) e.args.push_back(arg);
+        events->push_back(e);
+    }
+    std::stable_sort(events->begin(), events->end(),
+                     [](const Event& a, const Event& b) { return a.atMs < b.atMs; });
+    return true;
+}
+
+void apply(const Event& e) {
+    Sim::Network& net = Sim::Network::instance();
+    auto arg = [&e](size_t i) { return i < e.args.size() ? atol(e.args[i].c_str()) : 0; };
+    fprintf(stderr, "[sim] %u ms: %s\n", (unsigned)e.atMs, e.command.c_str());
+    if (e.command == "downlink") {
+        net.queueDownlink((uint8_t)arg(0), parseHex(e.args.size() > 1 ? e.args[1] : ""));
+    } else if (e.command == "uplink-loss") {
+        net.setUplinkLoss((uint8_t)arg(0));
+    } else if (e.command == "downlink-loss") {
+        net.setDownlinkLoss((uint8_t)arg(0));
+    } else if (e.command == "dr") {
+        net.commandDataRate((uint8_t)arg(0));
+    } else if (e.command == "join-fail") {
+        net.failJoins((uint32_t)arg(0));
+    } else if (e.command == "link") {
+        net.setLink((int16_t)arg(0), (int8_t)arg(1));
+    } else if (e.command == "pin") {
+        Sim::setPin((uint8_t)arg(0), (int)arg(1));
+    } else if (e.command == "analog") {
+        Sim::setAnalog((uint8_t)arg(0), (uint16_t)arg(1), (uint32_t)arg(2));
+    } else {
+        fprintf(stderr, "[sim] unknown command '%s'\n", e.command.c_str());
+    }
+}
+
+void printSummary(uint32_t durationMs) {
+    std::vector<Sim::Uplink> ups = Sim::Network::instance().uplinks();
+    struct PortStats { uint32_t count = 0, delivered = 0, bytes = 0; uint64_t airtimeUs = 0; };
+    std::map<uint8_t, PortStats> ports;
+    PortStats total;
+    for (const Sim::Uplink& u : ups) {
+        uint32_t toa = Airtime::uplinkTimeOnAirUs(LoRaWANRegion::US915, u.dataRate, u.payload.size());
+        for (PortStats* s : {&ports[u.port], &total}) {
+            s->count++;
+            s->delivered += u.delivered;
+            s->bytes += u.payload.size();
+            s->airtimeUs += toa;
+        }
+    }
+    printf("\n[sim] %.1f s simulated, %u join attempts, %u NVS writes, %u flash erases\n",
+           durationMs / 1000.0, (unsigned)Sim::Network::instance().joinAttempts(),
+           (unsigned)Sim::Nvs::writeCount(), (unsigned)Sim::flashEraseCount());
+    printf("[sim] %-6s %8s %10s %10s %12s\n", "fPort", "uplinks", "delivered", "bytes", "airtime_ms");
+    for (auto& p : ports) {
+        printf("[sim] %-6u %8u %10u %10u %12.1f\n", (unsigned)p.first, (unsigned)p.second.count,
+               (unsigned)p.second.delivered, (unsigned)p.second.bytes, p.second.airtimeUs / 1000.0);
+    }
+    printf("[sim] %-6s %8u %10u %10u %12.1f\n", "total", (unsigned)total.count,
+           (unsigned)total.delivered, (unsigned)total.bytes, total.airtimeUs / 1000.0);
+}
+
+void usage() {
+    fprintf(stderr, "usage: farmon_sim [--duration s] [--speed x] [--script file] "
+                    "[--nvs file] [--seed n] [--quiet]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double durationS = 600;
+    double speed = 60;
+    std::string scriptPath, nvsPath;
+    uint32_t seed = 1;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (opt == "--duration" && hasValue) durationS = atof(argv[++i]);
+        else if (opt == "--speed" && hasValue) speed = atof(argv[++i]);
+        else if (opt == "--script" && hasValue) scriptPath = argv[++i];
+        else if (opt == "--nvs" && hasValue) nvsPath = argv[++i];
+        else if (opt == "--seed" && hasValue) seed = (uint32_t)atol(argv[++i]);
+        else if (opt == "--quiet") quiet = true;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    std::vector<Event> events;
+    if (!scriptPath.empty() && !loadScript(scriptPath, &events)) {
+        fprintf(stderr, "cannot load script %s\n", scriptPath.c_str());
+        return 2;
+    }
+    if (!nvsPath.empty()) {
+        Sim::loadNvs(nvsPath);
+        Sim::setNvsFile(nvsPath);
+    }
+
+    Sim::setClockScaled(speed);
+    Sim::Network::instance().seed(seed);
+    randomSeed(seed);
+    Sim::setAnalog(1, 1013, 816);     // VBAT divider at ~4.0 V
+    Serial.setMuted(quiet);
+
+    const uint32_t endMs = (uint32_t)(durationS * 1000);
+    size_t nextEvent = 0;
+    auto applyDue = [&] {
+        while (nextEvent < events.size() && events[nextEvent].atMs <= Sim::nowMs()) apply(events[nextEvent++]);
+    };
+
+    applyDue();
+    setup();
+    while (Sim::nowMs() < endMs) {
+        applyDue();
+        loop();
+    }
+
+    printSummary(Sim::nowMs());
+    if (!nvsPath.empty()) Sim::saveNvs(nvsPath);
+    fflush(stdout);
+    // Firmware tasks never return; leave without running static destructors under them
+    std::_Exit(0);
+}
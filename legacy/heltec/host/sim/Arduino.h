@@ -0,0 +1,206 @@
+#pragma once
+
+// =============================================================================
+// Arduino core shim for the host build
+// =============================================================================
+// Subset of the ESP32 Arduino core used by the firmware. Time and pin state
+// come from sim.h; Serial writes to stdout.
+// =============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include "sim.h"
+#include "freertos/FreeRTOS.h"
+
+#define ARDUINO_SIM 1
+
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define F(x) (x)
+
+#define HEX 16
+#define DEC 10
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// Heltec WiFi LoRa 32 V3 pins (pins_arduino.h)
+#define Vext 36
+#define LED_BUILTIN 35
+#define SDA_OLED 17
+#define SCL_OLED 18
+#define RST_OLED 21
+
+using std::min;
+using std::max;
+
+// -----------------------------------------------------------------------------
+// String
+// -----------------------------------------------------------------------------
+class String {
+public:
+    String() = default;
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int v, int base = DEC) : _s(format((long)v, base)) {}
+    String(unsigned int v, int base = DEC) : _s(formatU((unsigned long)v, base)) {}
+    String(long v, int base = DEC) : _s(format(v, base)) {}
+    String(unsigned long v, int base = DEC) : _s(formatU(v, base)) {}
+    String(unsigned char v, int base = DEC) : _s(formatU(v, base)) {}
+    String(float v, int decimals = 2) : _s(formatF(v, decimals)) {}
+    String(double v, int decimals = 2) : _s(formatF(v, decimals)) {}
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator!=(const String& o) const { return _s != o._s; }
+    String& operator+=(const String& o) { _s += o._s; return *this; }
+    String& operator+=(const char* o) { _s += o ? o : ""; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    friend String operator+(String a, const String& b) { a += b; return a; }
+    friend String operator+(String a, const char* b) { a += b; return a; }
+    String substring(unsigned int from, unsigned int to = 0xFFFFFFFF) const {
+        if (from > _s.size()) return String();
+        return String(_s.substr(from, to == 0xFFFFFFFF ? std::string::npos : to - from));
+    }
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t p = _s.find(c, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(_s.c_str(), nullptr); }
+
+private:
+    static std::string format(long v, int base) {
+        if (base == DEC) return std::to_string(v);
+        return formatU((unsigned long)v, base);
+    }
+    static std::string formatU(unsigned long v, int base) {
+        char buf[40];
+        snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+        return buf;
+    }
+    static std::string formatF(double v, int decimals) {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        return buf;
+    }
+
+    std::string _s;
+};
+
+// -----------------------------------------------------------------------------
+// Print / Serial
+// -----------------------------------------------------------------------------
+class Print {
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len) {
+        size_t n = 0;
+        while (len--) n += write(*buf++);
+        return n;
+    }
+
+    size_t print(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned int v, int base = DEC) { return print(String(v, base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned char v, int base = DEC) { return print(String(v, base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+    size_t println() { return print("\n"); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[512];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buf, std::min((size_t)n, sizeof(buf) - 1));
+    }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    void flush() { fflush(stdout); }
+    operator bool() const { return true; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override;
+    /** Mute output (benchmarks, quiet test runs). */
+    void setMuted(bool muted);
+};
+
+extern HardwareSerial Serial;
+
+// -----------------------------------------------------------------------------
+// Time
+// -----------------------------------------------------------------------------
+inline unsigned long millis() { return Sim::nowMs(); }
+inline unsigned long micros() { return (uint32_t)Sim::nowUs(); }
+inline void delay(unsigned long ms) { Sim::sleepMs(ms); }
+inline void delayMicroseconds(uint32_t) {}
+inline void yield() {}
+
+// -----------------------------------------------------------------------------
+// GPIO / ADC / interrupts
+// -----------------------------------------------------------------------------
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) { Sim::setPin(pin, level); }
+inline int digitalRead(uint8_t pin) { return Sim::pinLevel(pin); }
+inline uint16_t analogRead(uint8_t pin) { return Sim::analogRaw(pin); }
+inline uint32_t analogReadMilliVolts(uint8_t pin) { return Sim::analogMillivolts(pin); }
+inline void analogReadResolution(uint8_t) {}
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+// -----------------------------------------------------------------------------
+// Misc
+// -----------------------------------------------------------------------------
+inline long random(long howbig) { return howbig > 0 ? ::random() % howbig : 0; }
+inline long random(long lo, long hi) { return lo >= hi ? lo : lo + random(hi - lo); }
+inline void randomSeed(unsigned long seed) { srandom((unsigned)seed); }
+
+class EspClass {
+public:
+    uint64_t getEfuseMac();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getHeapSize() { return Sim::HEAP_SIZE; }
+    void restart() { Sim::restart(); }
+};
+
+extern EspClass ESP;
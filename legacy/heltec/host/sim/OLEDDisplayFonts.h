@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// Font headers only (width, height, first char, char count): the sim display
+// does not rasterize text
+const uint8_t ArialMT_Plain_10[] = {0x0A, 0x0D, 0x20, 0x00};
+const uint8_t ArialMT_Plain_16[] = {0x10, 0x13, 0x20, 0x00};
+const uint8_t ArialMT_Plain_24[] = {0x18, 0x1C, 0x20, 0x00};
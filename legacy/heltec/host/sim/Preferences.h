@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Arduino.h>
+#include "sim_nvs.h"
+
+// =============================================================================
+// Preferences shim: ESP32 NVS API on the in-memory Sim::Nvs store
+// =============================================================================
+// Typed like the real NVS: reading a key with a different type returns the
+// default. Namespace and key names are limited to 15 characters as on device.
+// =============================================================================
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* = nullptr) {
+        if (!name || strlen(name) > 15) return false;
+        _ns = name;
+        _readOnly = readOnly;
+        _open = true;
+        return true;
+    }
+    void end() { _open = false; }
+
+    bool clear() {
+        if (!writable()) return false;
+        Sim::Nvs::clearNamespace(_ns);
+        return true;
+    }
+    bool remove(const char* key) { return writable() && Sim::Nvs::remove(_ns, key); }
+    bool isKey(const char* key) { return _open && Sim::Nvs::has(_ns, key); }
+
+    size_t putUChar(const char* key, uint8_t v) { return put(key, Sim::Nvs::Type::U8, &v, sizeof(v)); }
+    size_t putUShort(const char* key, uint16_t v) { return put(key, Sim::Nvs::Type::U16, &v, sizeof(v)); }
+    size_t putUInt(const char* key, uint32_t v) { return put(key, Sim::Nvs::Type::U32, &v, sizeof(v)); }
+    size_t putULong(const char* key, uint32_t v) { return putUInt(key, v); }
+    size_t putULong64(const char* key, uint64_t v) { return put(key, Sim::Nvs::Type::U64, &v, sizeof(v)); }
+    size_t putInt(const char* key, int32_t v) { return put(key, Sim::Nvs::Type::I32, &v, sizeof(v)); }
+    size_t putFloat(const char* key, float v) { return put(key, Sim::Nvs::Type::Float, &v, sizeof(v)); }
+    size_t putBool(const char* key, bool v) { return putUChar(key, v ? 1 : 0); }
+    size_t putString(const char* key, const char* v) {
+        return v ? put(key, Sim::Nvs::Type::Str, v, strlen(v)) : 0;
+    }
+    size_t putString(const char* key, const String& v) { return putString(key, v.c_str()); }
+    size_t putBytes(const char* key, const void* v, size_t len) {
+        return put(key, Sim::Nvs::Type::Blob, v, len);
+    }
+
+    uint8_t getUChar(const char* key, uint8_t def = 0) { return get(key, Sim::Nvs::Type::U8, def); }
+    uint16_t getUShort(const char* key, uint16_t def = 0) { return get(key, Sim::Nvs::Type::U16, def); }
+    uint32_t getUInt(const char* key, uint32_t def = 0) { return get(key, Sim::Nvs::Type::U32, def); }
+    uint32_t getULong(const char* key, uint32_t def = 0) { return getUInt(key, def); }
+    uint64_t getULong64(const char* key, uint64_t def = 0) { return get(key, Sim::Nvs::Type::U64, def); }
+    int32_t getInt(const char* key, int32_t def = 0) { return get(key, Sim::Nvs::Type::I32, def); }
+    float getFloat(const char* key, float def = 0.0f) { return get(key, Sim::Nvs::Type::Float, def); }
+    bool getBool(const char* key, bool def = false) { return getUChar(key, def ? 1 : 0) != 0; }
+
+    String getString(const char* key, const String& def = String()) {
+        Sim::Nvs::Entry e;
+        if (!_open || !Sim::Nvs::get(_ns, key, &e) || e.type != Sim::Nvs::Type::Str) return def;
+        return String(std::string(e.data.begin(), e.data.end()));
+    }
+
+    size_t getBytesLength(const char* key) {
+        Sim::Nvs::Entry e;
+        if (!_open || !Sim::Nvs::get(_ns, key, &e) || e.type != Sim::Nvs::Type::Blob) return 0;
+        return e.data.size();
+    }
+
+    /** Like the ESP32 core: returns 0 (nothing copied) if the blob exceeds maxLen. */
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        Sim::Nvs::Entry e;
+        if (!_open || !Sim::Nvs::get(_ns, key, &e) || e.type != Sim::Nvs::Type::Blob) return 0;
+        if (e.data.size() > maxLen) return 0;
+        memcpy(buf, e.data.data(), e.data.size());
+        return e.data.size();
+    }
+
+private:
+    bool writable() const { return _open && !_readOnly; }
+
+    size_t put(const char* key, Sim::Nvs::Type type, const void* data, size_t len) {
+        if (!writable() || !key || strlen(key) > 15) return 0;
+        Sim::Nvs::put(_ns, key, type, data, len);
+        return len;
+    }
+
+    template <typename T>
+    T get(const char* key, Sim::Nvs::Type type, T def) {
+        Sim::Nvs::Entry e;
+        if (!_open || !Sim::Nvs::get(_ns, key, &e) || e.type != type || e.data.size() != sizeof(T)) return def;
+        T v;
+        memcpy(&v, e.data.data(), sizeof(T));
+        return v;
+    }
+
+    std::string _ns;
+    bool _readOnly = false;
+    bool _open = false;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+// =============================================================================
+// RadioLib shim: SX1262 + LoRaWANNode on top of Sim::Network
+// =============================================================================
+// Same return conventions as RadioLib 7: activateOTAA() returns
+// RADIOLIB_LORAWAN_NEW_SESSION on success; sendReceive() returns > 0 when
+// something arrived in an RX window (downlink and/or ACK), 0 when nothing did,
+// negative on error. Calls block for the RX windows in simulated time.
+// A session buffer handed back with setBufferSession() makes the next
+// activateOTAA() return RADIOLIB_LORAWAN_SESSION_RESTORED without a join.
+// =============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RADIOLIB_ERR_NONE 0
+#define RADIOLIB_ERR_UNKNOWN -1
+#define RADIOLIB_ERR_PACKET_TOO_LONG -4
+#define RADIOLIB_ERR_TX_TIMEOUT -5
+#define RADIOLIB_ERR_RX_TIMEOUT -6
+#define RADIOLIB_ERR_CRC_MISMATCH -7
+#define RADIOLIB_ERR_INVALID_DATA_RATE -104
+#define RADIOLIB_ERR_NETWORK_NOT_JOINED -1101
+#define RADIOLIB_ERR_NO_JOIN_ACCEPT -1116
+#define RADIOLIB_LORAWAN_SESSION_RESTORED -1117
+#define RADIOLIB_LORAWAN_NEW_SESSION -1118
+
+#define RADIOLIB_LORAWAN_CLASS_A 0x00
+
+#define RADIOLIB_LORAWAN_NONCES_BUF_SIZE 16
+#define RADIOLIB_LORAWAN_SESSION_BUF_SIZE 256
+
+struct LoRaWANBand_t {
+    const char* name;
+    uint8_t maxDataRate;
+};
+
+extern const LoRaWANBand_t EU868, US915, AU915, AS923, IN865, KR920, CN500;
+
+struct LoRaWANEvent_t {
+    uint8_t dir;
+    bool confirmed;
+    bool confirming;
+    uint8_t datarate;
+    float freq;
+    int16_t power;
+    uint32_t fCnt;
+    uint8_t fPort;
+    uint8_t multicast;
+};
+
+class PhysicalLayer {
+public:
+    virtual ~PhysicalLayer() = default;
+};
+
+class SX1262 : public PhysicalLayer {
+public:
+    int16_t begin() { return RADIOLIB_ERR_NONE; }
+    float getRSSI();
+    float getSNR();
+};
+
+class LoRaWANNode {
+public:
+    LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand = 0);
+
+    int16_t beginOTAA(uint64_t joinEUI, uint64_t devEUI, uint8_t* nwkKey, uint8_t* appKey);
+    int16_t activateOTAA(uint8_t initialDr = 0xFF, LoRaWANEvent_t* joinEvent = nullptr);
+    void clearSession() { _joined = false; _restored = false; _fCnt = 0; }
+    bool isActivated() const { return _joined; }
+
+    int16_t sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort,
+                        uint8_t* dataDown, size_t* lenDown, bool isConfirmed = false,
+                        LoRaWANEvent_t* eventUp = nullptr, LoRaWANEvent_t* eventDown = nullptr);
+
+    int16_t setDatarate(uint8_t drUp);
+    int16_t setTxPower(int8_t txPower) { _txPower = txPower; return RADIOLIB_ERR_NONE; }
+    void setADR(bool enable) { _adr = enable; }
+    void setDutyCycle(bool, uint32_t = 0) {}
+    void setDwellTime(bool, uint32_t = 0) {}
+    int16_t setClass(uint8_t) { return RADIOLIB_ERR_NONE; }
+
+    uint8_t* getBufferNonces() { return _nonces; }
+    uint8_t* getBufferSession();
+    int16_t setBufferNonces(const uint8_t* buffer);
+    int16_t setBufferSession(const uint8_t* buffer);
+
+    uint8_t getMaxPayloadLen();   // RadioLib: app payload limit for the next uplink
+
+    uint8_t dataRate() const { return _dataRate; }
+
+private:
+    const LoRaWANBand_t* _band;
+    bool _configured = false;
+    bool _joined = false;
+    bool _adr = true;
+    uint8_t _dataRate = 0;
+    int8_t _txPower = 22;
+    bool _restored = false;
+    uint32_t _fCnt = 0;
+    uint8_t _nonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE] = {0};
+    uint8_t _session[RADIOLIB_LORAWAN_SESSION_BUF_SIZE] = {0};
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+// =============================================================================
+// SSD1306 display shim: accepts the drawing API, renders nothing
+// =============================================================================
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "OLEDDisplayFonts.h"
+
+enum OLEDDISPLAY_TEXT_ALIGNMENT { TEXT_ALIGN_LEFT, TEXT_ALIGN_RIGHT, TEXT_ALIGN_CENTER, TEXT_ALIGN_CENTER_BOTH };
+enum OLEDDISPLAY_COLOR { BLACK, WHITE, INVERSE };
+enum OLEDDISPLAY_GEOMETRY { GEOMETRY_128_64, GEOMETRY_128_32 };
+
+class SSD1306Wire {
+public:
+    SSD1306Wire(uint8_t, int, int, OLEDDISPLAY_GEOMETRY = GEOMETRY_128_64, int = I2C_ONE, long = 700000) {}
+
+    bool init() { return true; }
+    void resetDisplay() {}
+    void clear() {}
+    /** Frames pushed to the panel (lets tests see that the UI is refreshing). */
+    void display() { _frames++; }
+    void displayOn() {}
+    void displayOff() {}
+    void flipScreenVertically() {}
+    void setContrast(uint8_t) {}
+
+    void setFont(const uint8_t*) {}
+    void setTextAlignment(OLEDDISPLAY_TEXT_ALIGNMENT) {}
+    void setColor(OLEDDISPLAY_COLOR) {}
+    void drawString(int16_t, int16_t, const String&) {}
+    void drawStringMaxWidth(int16_t, int16_t, uint16_t, const String&) {}
+    uint16_t getStringWidth(const String& text) { return (uint16_t)(text.length() * 6); }
+
+    void setPixel(int16_t, int16_t) {}
+    void drawLine(int16_t, int16_t, int16_t, int16_t) {}
+    void drawHorizontalLine(int16_t, int16_t, int16_t) {}
+    void drawVerticalLine(int16_t, int16_t, int16_t) {}
+    void drawRect(int16_t, int16_t, int16_t, int16_t) {}
+    void fillRect(int16_t, int16_t, int16_t, int16_t) {}
+    void drawCircle(int16_t, int16_t, int16_t) {}
+    void fillCircle(int16_t, int16_t, int16_t) {}
+    void drawXbm(int16_t, int16_t, int16_t, int16_t, const uint8_t*) {}
+    void drawProgressBar(uint16_t, uint16_t, uint16_t, uint16_t, uint8_t) {}
+
+    uint32_t frames() const { return _frames; }
+
+private:
+    uint32_t _frames = 0;
+};
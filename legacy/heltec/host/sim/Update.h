@@ -0,0 +1,46 @@
+#pragma once
+
+// =============================================================================
+// Update shim: OTA writes land in Sim::updateImage()
+// =============================================================================
+// Mirrors the ESP32 UpdateClass contract the receiver relies on: begin() with
+// a size (or UPDATE_SIZE_UNKNOWN), write() refuses bytes past that size,
+// end(true) commits whatever was written, abort() discards.
+// =============================================================================
+
+#include <Arduino.h>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_SPACE 4
+#define UPDATE_ERROR_SIZE 5
+#define UPDATE_ERROR_ABORT 8
+#define UPDATE_ERROR_BAD_ARGUMENT 10
+
+class UpdateClass {
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH);
+    size_t write(uint8_t* data, size_t len);
+    bool end(bool evenIfRemaining = false);
+    void abort();
+
+    bool isRunning() const { return _running; }
+    bool isFinished() const { return _running && _size != UPDATE_SIZE_UNKNOWN && _written == _size; }
+    bool hasError() const { return _error != UPDATE_ERROR_OK; }
+    uint8_t getError() const { return _error; }
+    const char* errorString() const;
+    size_t progress() const { return _written; }
+    size_t size() const { return _size; }
+
+private:
+    bool _running = false;
+    size_t _size = 0;
+    size_t _written = 0;
+    uint8_t _error = UPDATE_ERROR_OK;
+};
+
+extern UpdateClass Update;
@@ -0,0 +1,192 @@
+#pragma once
+
+// =============================================================================
+// PCNT shim (ESP-IDF 5 pulse_cnt driver): units count edges on the simulated
+// pins, so Sim::setPin drives them like it drives interrupts. Limits, watch
+// points and accum_count behave like the driver; the glitch filter is
+// accepted and ignored. 4 units, as on the ESP32-S3.
+// =============================================================================
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct pcnt_unit_t* pcnt_unit_handle_t;
+typedef struct pcnt_chan_t* pcnt_channel_handle_t;
+
+typedef enum {
+    PCNT_CHANNEL_EDGE_ACTION_HOLD,
+    PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+    PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+} pcnt_channel_edge_action_t;
+
+typedef struct {
+    int low_limit;
+    int high_limit;
+    int intr_priority;
+    struct {
+        uint32_t accum_count : 1;
+    } flags;
+} pcnt_unit_config_t;
+
+typedef struct {
+    int edge_gpio_num;
+    int level_gpio_num;
+} pcnt_chan_config_t;
+
+typedef struct {
+    uint32_t max_glitch_ns;
+} pcnt_glitch_filter_config_t;
+
+typedef struct {
+    int watch_point_value;
+} pcnt_watch_event_data_t;
+
+typedef bool (*pcnt_watch_cb_t)(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t* edata, void* user_ctx);
+
+typedef struct {
+    pcnt_watch_cb_t on_reach;
+} pcnt_event_callbacks_t;
+
+struct pcnt_chan_t {
+    pcnt_unit_t* unit = nullptr;
+    int gpio = -1;
+    pcnt_channel_edge_action_t rising = PCNT_CHANNEL_EDGE_ACTION_HOLD;
+    pcnt_channel_edge_action_t falling = PCNT_CHANNEL_EDGE_ACTION_HOLD;
+};
+
+struct pcnt_unit_t {
+    bool used = false;
+    bool enabled = false;
+    bool running = false;
+    pcnt_unit_config_t config = {};
+    int count = 0;          // Hardware counter, reset at a limit
+    int accum = 0;          // Folded limits (accum_count)
+    int watch[4] = {};
+    int watchCount = 0;
+    pcnt_watch_cb_t onReach = nullptr;
+    void* userCtx = nullptr;
+    pcnt_chan_t channel;
+};
+
+inline pcnt_unit_t g_simPcntUnits[4];
+
+inline void simPcntWatch(pcnt_unit_t* unit) {
+    for (int i = 0; i < unit->watchCount; i++) {
+        if (unit->watch[i] != unit->count) continue;
+        pcnt_watch_event_data_t data = {unit->count};
+        if (unit->onReach) unit->onReach(unit, &data, unit->userCtx);
+    }
+    if (unit->count >= unit->config.high_limit || unit->count <= unit->config.low_limit) {
+        if (unit->config.flags.accum_count) unit->accum += unit->count;
+        unit->count = 0;
+    }
+}
+
+inline void simPcntEdge(void* arg) {
+    pcnt_chan_t* chan = static_cast<pcnt_chan_t*>(arg);
+    pcnt_unit_t* unit = chan->unit;
+    if (!unit->running) return;
+    pcnt_channel_edge_action_t action = digitalRead(chan->gpio) ? chan->rising : chan->falling;
+    if (action == PCNT_CHANNEL_EDGE_ACTION_HOLD) return;
+    unit->count += action == PCNT_CHANNEL_EDGE_ACTION_INCREASE ? 1 : -1;
+    simPcntWatch(unit);
+}
+
+inline esp_err_t pcnt_new_unit(const pcnt_unit_config_t* config, pcnt_unit_handle_t* ret) {
+    if (config->low_limit >= 0 || config->high_limit <= 0) return ESP_ERR_INVALID_ARG;
+    for (pcnt_unit_t& unit : g_simPcntUnits) {
+        if (unit.used) continue;
+        unit = pcnt_unit_t{};
+        unit.used = true;
+        unit.config = *config;
+        *ret = &unit;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+inline esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit) {
+    if (unit->enabled || unit->channel.unit) return ESP_ERR_INVALID_STATE;
+    unit->used = false;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t, const pcnt_glitch_filter_config_t*) { return ESP_OK; }
+
+inline esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t* config, pcnt_channel_handle_t* ret) {
+    if (unit->channel.unit) return ESP_ERR_NOT_FOUND;   // One channel per unit here
+    unit->channel = pcnt_chan_t{};
+    unit->channel.unit = unit;
+    unit->channel.gpio = config->edge_gpio_num;
+    attachInterruptArg((uint8_t)config->edge_gpio_num, simPcntEdge, &unit->channel, CHANGE);
+    *ret = &unit->channel;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan) {
+    detachInterrupt((uint8_t)chan->gpio);
+    chan->unit = nullptr;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos,
+                                              pcnt_channel_edge_action_t neg) {
+    chan->rising = pos;
+    chan->falling = neg;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int value) {
+    if (unit->watchCount >= 4 || value < unit->config.low_limit || value > unit->config.high_limit) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    unit->watch[unit->watchCount++] = value;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_register_event_callbacks(pcnt_unit_handle_t unit, const pcnt_event_callbacks_t* cbs,
+                                                    void* userCtx) {
+    if (unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->onReach = cbs->on_reach;
+    unit->userCtx = userCtx;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit) {
+    if (unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->enabled = true;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit) {
+    if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->enabled = false;
+    unit->running = false;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit) {
+    if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->running = true;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit) {
+    if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->running = false;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit) {
+    unit->count = 0;
+    unit->accum = 0;
+    return ESP_OK;
+}
+
+inline esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int* value) {
+    noInterrupts();
+    *value = unit->accum + unit->count;
+    interrupts();
+    return ESP_OK;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// =============================================================================
+// driver/rtc_io shim: RTC GPIO configuration is accepted and ignored. On the
+// ESP32-S3 GPIO 0-21 are RTC GPIOs with the same number.
+// =============================================================================
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+typedef enum {
+    RTC_GPIO_MODE_INPUT_ONLY,
+    RTC_GPIO_MODE_OUTPUT_ONLY,
+    RTC_GPIO_MODE_INPUT_OUTPUT,
+    RTC_GPIO_MODE_DISABLED,
+} rtc_gpio_mode_t;
+
+inline bool rtc_gpio_is_valid_gpio(gpio_num_t gpio) { return gpio >= 0 && gpio <= 21; }
+inline int rtc_io_number_get(gpio_num_t gpio) { return rtc_gpio_is_valid_gpio(gpio) ? (int)gpio : -1; }
+inline esp_err_t rtc_gpio_init(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_deinit(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_set_direction(gpio_num_t, rtc_gpio_mode_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pullup_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pulldown_dis(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_hold_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_hold_dis(gpio_num_t) { return ESP_OK; }
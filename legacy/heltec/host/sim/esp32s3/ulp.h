@@ -0,0 +1,38 @@
+#pragma once
+
+// =============================================================================
+// ULP-FSM shim: programs are accepted but never run, so a counter loaded
+// here stays at zero. RTC_SLOW_MEM is plain memory the firmware can use.
+// =============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef uint32_t ulp_insn_t;
+
+enum { R0, R1, R2, R3 };
+
+#define ULP_SHIM_INSN(...) ((ulp_insn_t)0)
+#define I_MOVI(reg, imm) ULP_SHIM_INSN(reg, imm)
+#define I_MOVR(dst, src) ULP_SHIM_INSN(dst, src)
+#define I_LD(dst, addr, offset) ULP_SHIM_INSN(dst, addr, offset)
+#define I_ST(src, addr, offset) ULP_SHIM_INSN(src, addr, offset)
+#define I_RD_REG(reg, low, high) ULP_SHIM_INSN(reg, low, high)
+#define I_ADDI(dst, src, imm) ULP_SHIM_INSN(dst, src, imm)
+#define I_SUBI(dst, src, imm) ULP_SHIM_INSN(dst, src, imm)
+#define I_SUBR(dst, src1, src2) ULP_SHIM_INSN(dst, src1, src2)
+#define I_WAKE() ULP_SHIM_INSN()
+#define I_HALT() ULP_SHIM_INSN()
+#define M_LABEL(label) ULP_SHIM_INSN(label)
+#define M_BL(label, imm) ULP_SHIM_INSN(label, imm)
+#define M_BGE(label, imm) ULP_SHIM_INSN(label, imm)
+#define M_BX(label) ULP_SHIM_INSN(label)
+
+inline uint32_t g_simRtcSlowMem[2048];
+#define RTC_SLOW_MEM g_simRtcSlowMem
+
+inline esp_err_t ulp_process_macros_and_load(uint32_t, const ulp_insn_t*, size_t*) { return ESP_OK; }
+inline esp_err_t ulp_set_wakeup_period(size_t, uint32_t) { return ESP_OK; }
+inline esp_err_t ulp_run(uint32_t) { return ESP_OK; }
+inline void ulp_timer_stop() {}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "esp_partition.h"
+
+/** The sim "ota_0" partition; its contents are Sim::runningImage(). */
+const esp_partition_t* esp_ota_get_running_partition(void);
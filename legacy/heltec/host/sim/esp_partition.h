@@ -0,0 +1,33 @@
+#pragma once
+
+// =============================================================================
+// esp_partition shim: the running app partition is Sim::runningImage(); data
+// partitions (partitions.csv) are Sim::dataPartition() with NOR semantics
+// =============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size);
+/** Clears bits only, as on flash: bytes must be erased to take new values */
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size);
+/** Offset and size must be 4 KB aligned */
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
@@ -0,0 +1,11 @@
+#pragma once
+
+// =============================================================================
+// esp_rtc_time shim: the RTC timer runs through deep sleep, and so does the
+// sim clock (heltec_deep_sleep() advances it before restarting)
+// =============================================================================
+
+#include <stdint.h>
+#include "sim.h"
+
+inline uint64_t esp_rtc_get_time_us() { return Sim::nowUs(); }
@@ -0,0 +1,27 @@
+#pragma once
+
+// =============================================================================
+// heltec_unofficial shim: board helpers for the Heltec WiFi LoRa 32 V3
+// =============================================================================
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <RadioLib.h>
+
+extern SX1262 radio;
+
+inline void heltec_setup() { Serial.begin(115200); }
+inline void heltec_loop() {}
+inline void heltec_ve(bool on) { digitalWrite(Vext, on ? LOW : HIGH); }
+inline void heltec_led(int) {}
+inline float heltec_vbat() { return Sim::analogMillivolts(1) * 4.9f / 1000.0f; }
+inline int heltec_battery_percent(float vbat = -1) {
+    if (vbat < 0) vbat = heltec_vbat();
+    return vbat >= 4.2f ? 100 : vbat <= 3.04f ? 0 : (int)((vbat - 3.04f) * 100 / (4.2f - 3.04f));
+}
+
+/** Deep sleep ends in a reset: sleep the simulated time, then restart. */
+inline void heltec_deep_sleep(int seconds = 0) {
+    if (seconds > 0) Sim::sleepMs((uint32_t)seconds * 1000);
+    Sim::restart();
+}
@@ -0,0 +1,210 @@
+#include "sim.h"
+#include "sim_nvs.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+
+namespace Sim {
+
+// =============================================================================
+// Clock
+// =============================================================================
+namespace {
+using SteadyClock = std::chrono::steady_clock;
+
+std::atomic<bool> g_manual{false};
+std::atomic<double> g_speed{1.0};
+std::atomic<uint64_t> g_manualUs{0};
+SteadyClock::time_point g_epoch = SteadyClock::now();
+std::atomic<uint64_t> g_scaledBaseUs{0};   // Sim time at g_epoch
+} // namespace
+
+void setClockScaled(double speed) {
+    uint64_t now = nowUs();
+    g_speed = speed > 0 ? speed : 1.0;
+    g_epoch = SteadyClock::now();
+    g_scaledBaseUs = now;
+    g_manual = false;
+}
+
+void setClockManual(uint32_t startMs) {
+    g_manualUs = (uint64_t)startMs * 1000;
+    g_manual = true;
+}
+
+bool clockManual() { return g_manual; }
+double clockSpeed() { return g_manual ? 0.0 : g_speed.load(); }
+
+uint64_t nowUs() {
+    if (g_manual) return g_manualUs;
+    auto real = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - g_epoch).count();
+    return g_scaledBaseUs + (uint64_t)((double)real * g_speed);
+}
+
+uint32_t nowMs() { return (uint32_t)(nowUs() / 1000); }
+
+void advanceMs(uint32_t ms) {
+    if (g_manual) g_manualUs += (uint64_t)ms * 1000;
+}
+
+std::chrono::nanoseconds realDuration(uint32_t ms) {
+    return std::chrono::nanoseconds((int64_t)((double)ms * 1e6 / g_speed));
+}
+
+void sleepMs(uint32_t ms) {
+    if (g_manual) {
+        advanceMs(ms);
+        return;
+    }
+    std::this_thread::sleep_for(realDuration(ms));
+}
+
+// =============================================================================
+// Restart
+// =============================================================================
+namespace {
+std::function<void()> g_restartHook;
+std::atomic<uint32_t> g_restarts{0};
+std::string g_nvsFile;
+} // namespace
+
+void setRestartHook(std::function<void()> hook) { g_restartHook = std::move(hook); }
+uint32_t restartCount() { return g_restarts; }
+
+void restart() {
+    g_restarts++;
+    if (g_restartHook) {
+        g_restartHook();
+        return;
+    }
+    fflush(stdout);
+    if (!g_nvsFile.empty()) saveNvs(g_nvsFile);
+    std::_Exit(EXIT_RESTART);
+}
+
+void setNvsFile(const std::string& path) { g_nvsFile = path; }
+
+// =============================================================================
+// GPIO
+// =============================================================================
+namespace {
+struct PinState {
+    int level = 0;
+    uint16_t analogRaw = 0;
+    uint32_t analogMv = 0;
+    int mode = 0;               // RISING / FALLING / CHANGE, 0 = detached
+    void (*isr)() = nullptr;
+    void (*isrArg)(void*) = nullptr;
+    void* arg = nullptr;
+};
+PinState g_pins[PIN_COUNT];
+std::recursive_mutex g_pinMutex;   // Also the interrupt lock (noInterrupts)
+} // namespace
+
+void setPin(uint8_t pin, int level) {
+    if (pin >= PIN_COUNT) return;
+    std::lock_guard<std::recursive_mutex> lock(g_pinMutex);
+    PinState& p = g_pins[pin];
+    int old = p.level;
+    p.level = level ? HIGH : LOW;
+    bool rising = !old && p.level;
+    bool falling = old && !p.level;
+    bool fire = (p.mode == CHANGE && (rising || falling)) ||
+                (p.mode == RISING && rising) || (p.mode == FALLING && falling);
+    if (!fire) return;
+    if (p.isrArg) p.isrArg(p.arg);
+    else if (p.isr) p.isr();
+}
+
+int pinLevel(uint8_t pin) {
+    if (pin >= PIN_COUNT) return LOW;
+    std::lock_guard<std::recursive_mutex> lock(g_pinMutex);
+    return g_pins[pin].level;
+}
+
+void setAnalog(uint8_t pin, uint16_t raw, uint32_t millivolts) {
+    if (pin >= PIN_COUNT) return;
+    std::lock_guard<std::recursive_mutex> lock(g_pinMutex);
+    g_pins[pin].analogRaw = raw;
+    g_pins[pin].analogMv = millivolts;
+}
+
+uint16_t analogRaw(uint8_t pin) { return pin < PIN_COUNT ? g_pins[pin].analogRaw : 0; }
+uint32_t analogMillivolts(uint8_t pin) { return pin < PIN_COUNT ? g_pins[pin].analogMv : 0; }
+
+// =============================================================================
+// Flash images
+// =============================================================================
+namespace {
+std::vector<uint8_t> g_running;
+} // namespace
+
+std::vector<uint8_t>& runningImage() { return g_running; }
+
+// =============================================================================
+// Heap
+// =============================================================================
+namespace {
+std::atomic<uint32_t> g_freeHeap{200 * 1024};
+std::atomic<uint32_t> g_minFreeHeap{200 * 1024};
+std::atomic<bool> g_serialMuted{false};
+} // namespace
+
+void setFreeHeap(uint32_t bytes) {
+    g_freeHeap = bytes;
+    if (bytes < g_minFreeHeap) g_minFreeHeap = bytes;
+}
+
+} // namespace Sim
+
+// =============================================================================
+// Arduino core functions that need simulator state
+// =============================================================================
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+    if (pin >= Sim::PIN_COUNT) return;
+    std::lock_guard<std::recursive_mutex> lock(Sim::g_pinMutex);
+    Sim::g_pins[pin].isr = isr;
+    Sim::g_pins[pin].isrArg = nullptr;
+    Sim::g_pins[pin].mode = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode) {
+    if (pin >= Sim::PIN_COUNT) return;
+    std::lock_guard<std::recursive_mutex> lock(Sim::g_pinMutex);
+    Sim::g_pins[pin].isr = nullptr;
+    Sim::g_pins[pin].isrArg = isr;
+    Sim::g_pins[pin].arg = arg;
+    Sim::g_pins[pin].mode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin >= Sim::PIN_COUNT) return;
+    std::lock_guard<std::recursive_mutex> lock(Sim::g_pinMutex);
+    Sim::g_pins[pin].mode = 0;
+    Sim::g_pins[pin].isr = nullptr;
+    Sim::g_pins[pin].isrArg = nullptr;
+}
+
+// ISRs run under the pin lock, so masking interrupts is taking it
+void Sim::enterCritical() { Sim::g_pinMutex.lock(); }
+void Sim::exitCritical() { Sim::g_pinMutex.unlock(); }
+void noInterrupts() { Sim::enterCritical(); }
+void interrupts() { Sim::exitCritical(); }
+
+void HardwareSerial::setMuted(bool muted) { Sim::g_serialMuted = muted; }
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+    if (Sim::g_serialMuted) return len;
+    return fwrite(buf, 1, len, stdout);
+}
+
+uint64_t EspClass::getEfuseMac() { return 0x0000A1B2C3D4E5F6ull; }
+uint32_t EspClass::getFreeHeap() { return Sim::g_freeHeap; }
+uint32_t EspClass::getMinFreeHeap() { return Sim::g_minFreeHeap; }
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Sim: host simulation control
+// =============================================================================
+// The Arduino/FreeRTOS/ESP-IDF shims in this directory all read time and
+// hardware state from here.
+//
+// Clock modes:
+//   Scaled - millis() follows the wall clock multiplied by a speed factor;
+//            tasks are real threads and blocking calls sleep (scaled). Used
+//            when the whole firmware runs as a process.
+//   Manual - millis() only moves when advanceMs() is called or a blocking
+//            call times out (the wait is skipped and the clock jumps ahead).
+//            Single-threaded and deterministic; used by the host tests.
+// =============================================================================
+
+namespace Sim {
+
+// -----------------------------------------------------------------------------
+// Clock
+// -----------------------------------------------------------------------------
+void setClockScaled(double speed = 1.0);
+void setClockManual(uint32_t startMs = 0);
+bool clockManual();
+double clockSpeed();
+
+uint32_t nowMs();
+uint64_t nowUs();
+
+/** Manual clock only: move time forward. */
+void advanceMs(uint32_t ms);
+
+/** Block for ms of simulated time (manual clock: advance instead). */
+void sleepMs(uint32_t ms);
+
+/** Wall-clock duration that corresponds to ms of simulated time. */
+std::chrono::nanoseconds realDuration(uint32_t ms);
+
+// -----------------------------------------------------------------------------
+// Restart (ESP.restart)
+// -----------------------------------------------------------------------------
+// Default: flush NVS to the configured file and exit with EXIT_RESTART, so a
+// wrapper script can start the process again. Tests install a hook instead.
+constexpr int EXIT_RESTART = 75;
+void setRestartHook(std::function<void()> hook);
+void restart();
+uint32_t restartCount();
+
+// -----------------------------------------------------------------------------
+// GPIO
+// -----------------------------------------------------------------------------
+constexpr uint8_t PIN_COUNT = 49;
+void setPin(uint8_t pin, int level);       // Fires attached interrupts on edges
+int pinLevel(uint8_t pin);
+void setAnalog(uint8_t pin, uint16_t raw, uint32_t millivolts);
+uint16_t analogRaw(uint8_t pin);
+uint32_t analogMillivolts(uint8_t pin);
+
+/** Interrupt mask: ISRs fired by setPin() are held off while it is taken. */
+void enterCritical();
+void exitCritical();
+
+// -----------------------------------------------------------------------------
+// NVS (Preferences) store
+// -----------------------------------------------------------------------------
+void clearNvs();
+bool loadNvs(const std::string& path);
+bool saveNvs(const std::string& path);
+void setNvsFile(const std::string& path);  // Saved on restart and at exit
+
+// -----------------------------------------------------------------------------
+// Flash: running partition (delta OTA base) and the image written by Update
+// -----------------------------------------------------------------------------
+std::vector<uint8_t>& runningImage();
+const std::vector<uint8_t>& updateImage();
+bool updateCommitted();
+void resetUpdate();
+
+/** Data partition contents by label (erased on first use); nullptr if the
+ *  sim partition table has no such partition. Saved with the NVS file. */
+std::vector<uint8_t>* dataPartition(const std::string& label);
+void clearDataPartitions();
+void saveDataPartitions(const std::string& path);   // One file per partition, path.<label>
+void loadDataPartitions(const std::string& path);
+uint32_t flashEraseCount();
+
+// -----------------------------------------------------------------------------
+// Heap accounting reported through ESP.getFreeHeap()
+// -----------------------------------------------------------------------------
+constexpr uint32_t HEAP_SIZE = 320 * 1024;
+void setFreeHeap(uint32_t bytes);
+
+} // namespace Sim
@@ -0,0 +1,109 @@
+#include "sim_nvs.h"
+#include "sim.h"
+#include <stdio.h>
+#include <map>
+#include <mutex>
+
+namespace Sim {
+namespace Nvs {
+
+namespace {
+std::map<std::string, std::map<std::string, Entry>> g_store;
+std::mutex g_mutex;
+uint32_t g_writes = 0;
+} // namespace
+
+bool get(const std::string& ns, const std::string& key, Entry* out) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto n = g_store.find(ns);
+    if (n == g_store.end()) return false;
+    auto e = n->second.find(key);
+    if (e == n->second.end()) return false;
+    if (out) *out = e->second;
+    return true;
+}
+
+void put(const std::string& ns, const std::string& key, Type type, const void* data, size_t len) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    Entry& e = g_store[ns][key];
+    const uint8_t* p = (const uint8_t*)data;
+    if (e.type == type && e.data.size() == len && std::equal(p, p + len, e.data.begin())) return;
+    e.type = type;
+    e.data.assign(p, p + len);
+    g_writes++;
+}
+
+bool remove(const std::string& ns, const std::string& key) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto n = g_store.find(ns);
+    return n != g_store.end() && n->second.erase(key) > 0;
+}
+
+void clearNamespace(const std::string& ns) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_store.erase(ns);
+}
+
+bool has(const std::string& ns, const std::string& key) { return get(ns, key, nullptr); }
+
+uint32_t writeCount() { return g_writes; }
+
+size_t entryCount() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    size_t n = 0;
+    for (auto& ns : g_store) n += ns.second.size();
+    return n;
+}
+
+} // namespace Nvs
+
+// =============================================================================
+// File persistence: one line per entry, "namespace key type hexdata"; data
+// partitions are saved beside it
+// =============================================================================
+
+void clearNvs() {
+    std::lock_guard<std::mutex> lock(Nvs::g_mutex);
+    Nvs::g_store.clear();
+    clearDataPartitions();
+}
+
+bool saveNvs(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::lock_guard<std::mutex> lock(Nvs::g_mutex);
+    for (auto& ns : Nvs::g_store) {
+        for (auto& kv : ns.second) {
+            fprintf(f, "%s %s %u ", ns.first.c_str(), kv.first.c_str(), (unsigned)kv.second.type);
+            for (uint8_t b : kv.second.data) fprintf(f, "%02x", b);
+            fputc('\n', f);
+        }
+    }
+    fclose(f);
+    saveDataPartitions(path);
+    return true;
+}
+
+bool loadNvs(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    clearNvs();
+    char ns[32], key[32];
+    unsigned type;
+    char hex[8192];
+    while (fscanf(f, "%31s %31s %u %8191s", ns, key, &type, hex) >= 3) {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+            unsigned b;
+            sscanf(hex + i, "%2x", &b);
+            data.push_back((uint8_t)b);
+        }
+        Nvs::put(ns, key, (Nvs::Type)type, data.data(), data.size());
+        hex[0] = 0;
+    }
+    fclose(f);
+    loadDataPartitions(path);
+    return true;
+}
+
+} // namespace Sim
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Sim NVS store: typed key/value entries per namespace (backs Preferences)
+// =============================================================================
+
+namespace Sim {
+namespace Nvs {
+
+enum class Type : uint8_t { U8 = 1, U16, U32, U64, I32, Float, Str, Blob };
+
+struct Entry {
+    Type type;
+    std::vector<uint8_t> data;
+};
+
+bool get(const std::string& ns, const std::string& key, Entry* out);
+void put(const std::string& ns, const std::string& key, Type type, const void* data, size_t len);
+bool remove(const std::string& ns, const std::string& key);
+void clearNamespace(const std::string& ns);
+bool has(const std::string& ns, const std::string& key);
+
+/** Number of put() calls that changed stored data (flash write proxy). */
+uint32_t writeCount();
+size_t entryCount();
+
+} // namespace Nvs
+} // namespace Sim
@@ -0,0 +1,276 @@
+#include "sim_radio.h"
+#include "sim.h"
+#include <RadioLib.h>
+#include <heltec_unofficial.h>
+
+const LoRaWANBand_t EU868 = {"EU868", 7};
+const LoRaWANBand_t US915 = {"US915", 4};
+const LoRaWANBand_t AU915 = {"AU915", 6};
+const LoRaWANBand_t AS923 = {"AS923", 7};
+const LoRaWANBand_t IN865 = {"IN865", 7};
+const LoRaWANBand_t KR920 = {"KR920", 5};
+const LoRaWANBand_t CN500 = {"CN500", 5};
+
+SX1262 radio;
+
+namespace Sim {
+
+// RX1 opens 1 s after the uplink, RX2 1 s later; a join accept comes at 5-6 s
+constexpr uint32_t RX1_DELAY_MS = 1000;
+constexpr uint32_t RX2_END_MS = 2000;
+constexpr uint32_t JOIN_ACCEPT_MS = 5000;
+constexpr uint32_t JOIN_TIMEOUT_MS = 6000;
+
+// =============================================================================
+// Network
+// =============================================================================
+
+Network& Network::instance() {
+    static Network network;
+    return network;
+}
+
+void Network::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _joinFailures = 0;
+    _joinAttempts = 0;
+    _uplinkLoss = 0;
+    _downlinkLoss = 0;
+    _rssi = -80;
+    _snr = 9;
+    _adrTarget = -1;
+    _downlinks.clear();
+    _uplinks.clear();
+    _hook = nullptr;
+}
+
+void Network::seed(uint32_t seed) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _rng.seed(seed);
+}
+
+void Network::failJoins(uint32_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _joinFailures = count;
+}
+
+void Network::setUplinkLoss(uint8_t percent) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _uplinkLoss = percent;
+}
+
+void Network::setDownlinkLoss(uint8_t percent) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _downlinkLoss = percent;
+}
+
+void Network::setLink(int16_t rssi, int8_t snr) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _rssi = rssi;
+    _snr = snr;
+}
+
+void Network::commandDataRate(uint8_t dataRate) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _adrTarget = dataRate;
+}
+
+void Network::queueDownlink(uint8_t port, const std::vector<uint8_t>& payload) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _downlinks.push_back(Downlink{port, payload});
+}
+
+size_t Network::pendingDownlinks() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _downlinks.size();
+}
+
+void Network::onUplink(std::function<void(const Uplink&)> hook) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hook = std::move(hook);
+}
+
+std::vector<Uplink> Network::uplinks() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _uplinks;
+}
+
+size_t Network::uplinkCount() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _uplinks.size();
+}
+
+uint32_t Network::joinAttempts() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _joinAttempts;
+}
+
+bool Network::roll(uint8_t percent) {
+    return percent > 0 && std::uniform_int_distribution<int>(0, 99)(_rng) < percent;
+}
+
+bool Network::join() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _joinAttempts++;
+    if (_joinFailures > 0) {
+        _joinFailures--;
+        return false;
+    }
+    return true;
+}
+
+bool Network::transfer(uint8_t port, const uint8_t* data, size_t len, bool confirmed, bool adr,
+                       uint8_t* dataRate, Downlink* out, bool* acked) {
+    std::function<void(const Uplink&)> hook;
+    Uplink up;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        up = Uplink{nowMs(), port, std::vector<uint8_t>(data, data + len), confirmed, *dataRate, !roll(_uplinkLoss)};
+        _uplinks.push_back(up);
+        hook = _hook;
+    }
+    *acked = false;
+    out->port = 0;
+    out->payload.clear();
+    if (!up.delivered) return false;
+
+    // Network server logic runs before the RX window opens
+    if (hook) hook(up);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (roll(_downlinkLoss)) return false;
+    if (adr && _adrTarget >= 0) {
+        *dataRate = (uint8_t)_adrTarget;
+        _adrTarget = -1;
+    }
+    *acked = confirmed;
+    if (!_downlinks.empty()) {
+        *out = std::move(_downlinks.front());
+        _downlinks.erase(_downlinks.begin());
+        return true;
+    }
+    return confirmed;
+}
+
+} // namespace Sim
+
+// =============================================================================
+// RadioLib shim
+// =============================================================================
+
+float SX1262::getRSSI() { return Sim::Network::instance().rssi(); }
+float SX1262::getSNR() { return Sim::Network::instance().snr(); }
+
+LoRaWANNode::LoRaWANNode(PhysicalLayer*, const LoRaWANBand_t* band, uint8_t)
+    : _band(band) {}
+
+int16_t LoRaWANNode::beginOTAA(uint64_t, uint64_t, uint8_t* nwkKey, uint8_t* appKey) {
+    if (!nwkKey || !appKey) return RADIOLIB_ERR_UNKNOWN;
+    _configured = true;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LoRaWANNode::activateOTAA(uint8_t initialDr, LoRaWANEvent_t*) {
+    if (!_configured) return RADIOLIB_ERR_NETWORK_NOT_JOINED;
+    if (_restored) {
+        _joined = true;
+        return RADIOLIB_LORAWAN_SESSION_RESTORED;
+    }
+    if (!Sim::Network::instance().join()) {
+        Sim::sleepMs(Sim::JOIN_TIMEOUT_MS);
+        return RADIOLIB_ERR_NO_JOIN_ACCEPT;
+    }
+    Sim::sleepMs(Sim::JOIN_ACCEPT_MS);
+    _joined = true;
+    _fCnt = 0;
+    if (initialDr != 0xFF) _dataRate = initialDr;
+    return RADIOLIB_LORAWAN_NEW_SESSION;
+}
+
+// Session buffer: [0] joined, [1] data rate, [2-5] frame counter (LE)
+uint8_t* LoRaWANNode::getBufferSession() {
+    _session[0] = _joined ? 1 : 0;
+    _session[1] = _dataRate;
+    for (int i = 0; i < 4; i++) _session[2 + i] = (uint8_t)(_fCnt >> (8 * i));
+    return _session;
+}
+
+int16_t LoRaWANNode::setBufferNonces(const uint8_t* buffer) {
+    if (!buffer) return RADIOLIB_ERR_UNKNOWN;
+    memcpy(_nonces, buffer, sizeof(_nonces));
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LoRaWANNode::setBufferSession(const uint8_t* buffer) {
+    if (!buffer || buffer[0] != 1) return RADIOLIB_ERR_NETWORK_NOT_JOINED;
+    memcpy(_session, buffer, sizeof(_session));
+    _dataRate = buffer[1];
+    _fCnt = 0;
+    for (int i = 0; i < 4; i++) _fCnt |= (uint32_t)buffer[2 + i] << (8 * i);
+    _restored = true;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LoRaWANNode::setDatarate(uint8_t drUp) {
+    if (drUp > _band->maxDataRate) return RADIOLIB_ERR_INVALID_DATA_RATE;
+    _dataRate = drUp;
+    return RADIOLIB_ERR_NONE;
+}
+
+// Application payload limit by data rate (no FOpts)
+static size_t maxPayloadFor(const LoRaWANBand_t* band, uint8_t dr) {
+    if (band == &US915) {
+        static const uint8_t limits[] = {11, 53, 125, 242, 242};
+        return dr < sizeof(limits) ? limits[dr] : 0;
+    }
+    static const uint8_t limits[] = {51, 51, 51, 115, 222, 222, 222, 222};
+    return dr < sizeof(limits) ? limits[dr] : 0;
+}
+
+uint8_t LoRaWANNode::getMaxPayloadLen() {
+    return (uint8_t)maxPayloadFor(_band, _dataRate);
+}
+
+int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort,
+                                 uint8_t* dataDown, size_t* lenDown, bool isConfirmed,
+                                 LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+    size_t capacity = lenDown ? *lenDown : 0;
+    if (lenDown) *lenDown = 0;
+    if (!_joined) return RADIOLIB_ERR_NETWORK_NOT_JOINED;
+    if (lenUp > maxPayloadFor(_band, _dataRate)) return RADIOLIB_ERR_PACKET_TOO_LONG;
+
+    uint8_t usedDr = _dataRate;
+    if (eventUp) {
+        *eventUp = LoRaWANEvent_t{};
+        eventUp->confirmed = isConfirmed;
+        eventUp->datarate = usedDr;
+        eventUp->power = _txPower;
+        eventUp->fCnt = _fCnt;
+        eventUp->fPort = fPort;
+    }
+    _fCnt++;
+
+    Sim::Downlink down;
+    bool acked = false;
+    bool received = Sim::Network::instance().transfer(fPort, dataUp, lenUp, isConfirmed, _adr,
+                                                      &_dataRate, &down, &acked);
+    if (!received) {
+        Sim::sleepMs(Sim::RX2_END_MS);
+        return RADIOLIB_ERR_NONE;
+    }
+
+    Sim::sleepMs(Sim::RX1_DELAY_MS);
+    if (eventDown) {
+        *eventDown = LoRaWANEvent_t{};
+        eventDown->dir = 1;
+        eventDown->confirming = acked;
+        eventDown->datarate = usedDr;
+        eventDown->fPort = down.port;
+    }
+    if (dataDown && lenDown && !down.payload.empty()) {
+        size_t n = down.payload.size() < capacity ? down.payload.size() : capacity;
+        memcpy(dataDown, down.payload.data(), n);
+        *lenDown = n;
+    }
+    return 1;   // Received in RX1
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// =============================================================================
+// Sim::Network: scriptable LoRaWAN network behind the RadioLib shim
+// =============================================================================
+// Class A semantics: downlinks queued here go out in the RX window of the
+// next uplink that reaches the network (one per uplink). A confirmed uplink
+// that arrives is acknowledged even without a queued downlink.
+//
+// The uplink hook runs before the RX window is filled, so a test can act as
+// the network server and answer an uplink in its own RX window (OTA ACK ->
+// next chunk).
+// =============================================================================
+
+namespace Sim {
+
+struct Uplink {
+    uint32_t atMs;
+    uint8_t port;
+    std::vector<uint8_t> payload;
+    bool confirmed;
+    uint8_t dataRate;
+    bool delivered;     // Reached the network (not lost)
+};
+
+struct Downlink {
+    uint8_t port;
+    std::vector<uint8_t> payload;
+};
+
+class Network {
+public:
+    static Network& instance();
+
+    /** Back to defaults: no loss, DR3, no queued downlinks, empty log. */
+    void reset();
+    void seed(uint32_t seed);
+
+    // --- Link behaviour ---
+    void failJoins(uint32_t count);            // Next count join attempts time out
+    void setUplinkLoss(uint8_t percent);
+    void setDownlinkLoss(uint8_t percent);     // Lost downlinks stay queued
+    void setLink(int16_t rssi, int8_t snr);
+    /** ADR: applied to the node after its next delivered uplink (ADR on). */
+    void commandDataRate(uint8_t dataRate);
+
+    // --- Downlinks ---
+    void queueDownlink(uint8_t port, const std::vector<uint8_t>& payload);
+    size_t pendingDownlinks() const;
+
+    // --- Observation ---
+    void onUplink(std::function<void(const Uplink&)> hook);
+    std::vector<Uplink> uplinks() const;
+    size_t uplinkCount() const;
+    uint32_t joinAttempts() const;
+    int16_t rssi() const { return _rssi; }
+    int8_t snr() const { return _snr; }
+
+    // --- Called by LoRaWANNode ---
+    bool join();
+    /**
+     * Record an uplink and resolve its RX window.
+     * @param dataRate In: DR used for the uplink. Out: DR for the next one (ADR).
+     * @return true if something came back (ACK and/or downlink in out)
+     */
+    bool transfer(uint8_t port, const uint8_t* data, size_t len, bool confirmed, bool adr,
+                  uint8_t* dataRate, Downlink* out, bool* acked);
+
+private:
+    bool roll(uint8_t percent);
+
+    mutable std::mutex _mutex;
+    std::mt19937 _rng{1};
+    uint32_t _joinFailures = 0;
+    uint32_t _joinAttempts = 0;
+    uint8_t _uplinkLoss = 0;
+    uint8_t _downlinkLoss = 0;
+    int16_t _rssi = -80;
+    int8_t _snr = 9;
+    int16_t _adrTarget = -1;
+    std::vector<Downlink> _downlinks;
+    std::vector<Uplink> _uplinks;
+    std::function<void(const Uplink&)> _hook;
+};
+
+} // namespace Sim
@@ -0,0 +1,372 @@
+#include "freertos/FreeRTOS.h"
+#include "sim.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =============================================================================
+// Blocking helper: every FreeRTOS wait goes through here
+// =============================================================================
+namespace {
+
+template <typename Pred>
+bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t wait, Pred ready) {
+    if (ready()) return true;
+    if (wait == 0) return false;
+    if (Sim::clockManual()) {
+        // Single-threaded: nobody can satisfy the wait, so let it time out
+        if (wait != portMAX_DELAY) Sim::advanceMs(wait);
+        return false;
+    }
+    if (wait == portMAX_DELAY) {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, Sim::realDuration(wait), ready);
+}
+
+uint64_t nowTicks() { return Sim::nowUs() / 1000; }
+
+} // namespace
+
+void simEnterCritical(portMUX_TYPE*) { Sim::enterCritical(); }
+void simExitCritical(portMUX_TYPE*) { Sim::exitCritical(); }
+
+// =============================================================================
+// Queues (semaphores are queues with zero-size items)
+// =============================================================================
+struct SimQueue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+namespace {
+
+BaseType_t queueSend(QueueHandle_t q, const void* item, TickType_t wait, bool front) {
+    if (!q) return errQUEUE_FULL;
+    std::unique_lock<std::mutex> lock(q->m);
+    if (!waitUntil(lock, q->cv, wait, [q] { return q->items.size() < q->length; })) return errQUEUE_FULL;
+    const uint8_t* p = (const uint8_t*)item;
+    std::vector<uint8_t> copy(p, p + (p ? q->itemSize : 0));
+    if (front) q->items.push_front(std::move(copy));
+    else q->items.push_back(std::move(copy));
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t queueReceive(QueueHandle_t q, void* item, TickType_t wait, bool remove) {
+    if (!q) return pdFALSE;
+    std::unique_lock<std::mutex> lock(q->m);
+    if (!waitUntil(lock, q->cv, wait, [q] { return !q->items.empty(); })) return pdFALSE;
+    if (item && q->itemSize) memcpy(item, q->items.front().data(), q->itemSize);
+    if (remove) {
+        q->items.pop_front();
+        q->cv.notify_all();
+    }
+    return pdTRUE;
+}
+
+} // namespace
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (length == 0) return nullptr;
+    SimQueue* q = new SimQueue();
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) { delete q; }
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait) { return queueSend(q, item, wait, false); }
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t wait) { return queueSend(q, item, wait, false); }
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t wait) { return queueSend(q, item, wait, true); }
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item) {
+    if (!q) return pdFAIL;
+    {
+        std::lock_guard<std::mutex> lock(q->m);
+        q->items.clear();
+        q->cv.notify_all();
+    }
+    return queueSend(q, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait) { return queueReceive(q, item, wait, true); }
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t wait) { return queueReceive(q, item, wait, false); }
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    if (!q) return pdFAIL;
+    std::lock_guard<std::mutex> lock(q->m);
+    q->items.clear();
+    q->cv.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    if (!q) return 0;
+    std::lock_guard<std::mutex> lock(q->m);
+    return (UBaseType_t)q->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+    if (!q) return 0;
+    std::lock_guard<std::mutex> lock(q->m);
+    return q->length - (UBaseType_t)q->items.size();
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    return queueSend(q, item, 0, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void* item, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    return queueReceive(q, item, 0, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t s = xQueueCreate(1, 0);
+    xSemaphoreGive(s);
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xQueueCreate(1, 0); }
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    SemaphoreHandle_t s = xQueueCreate(maxCount, 0);
+    for (UBaseType_t i = 0; s && i < initialCount && i < maxCount; i++) xSemaphoreGive(s);
+    return s;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s) { vQueueDelete(s); }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) { return queueReceive(s, nullptr, wait, true); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return queueSend(s, nullptr, 0, false); }
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    return xSemaphoreGive(s);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s) { return uxQueueMessagesWaiting(s); }
+
+// =============================================================================
+// Tasks
+// =============================================================================
+struct SimTask {
+    std::string name;
+    uint32_t stackDepth = 0;
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notifyCount = 0;
+    bool deleted = false;
+};
+
+namespace {
+
+struct TaskExit {};   // Thrown by vTaskDelete(NULL), caught by the thread wrapper
+
+thread_local SimTask* t_current = nullptr;
+
+} // namespace
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* param, UBaseType_t, TaskHandle_t* handle) {
+    SimTask* task = new SimTask();
+    task->name = name ? name : "";
+    task->stackDepth = stackDepth;
+    if (handle) *handle = task;
+    std::thread([fn, param, task] {
+        t_current = task;
+        try {
+            fn(param);
+        } catch (const TaskExit&) {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* handle, BaseType_t) {
+    return xTaskCreate(fn, name, stackDepth, param, priority, handle);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (!t_current) {
+        // Main thread (Arduino loop task) or a thread we did not create
+        thread_local SimTask adopted;
+        adopted.name = "loopTask";
+        adopted.stackDepth = 8192;
+        t_current = &adopted;
+    }
+    return t_current;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (!task || task == self) {
+        self->deleted = true;
+        throw TaskExit{};
+    }
+    // A thread cannot be killed from outside; the task keeps running
+    task->deleted = true;
+}
+
+void vTaskDelay(TickType_t ticks) { Sim::sleepMs(ticks); }
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    TickType_t target = *previousWake + increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(target - now) > 0) Sim::sleepMs(target - now);
+    *previousWake = target;
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)nowTicks(); }
+
+// Host stacks are large; report a comfortable margin so stack checks pass
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task->stackDepth / 2;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    if (!task) return;
+    std::lock_guard<std::mutex> lock(task->m);
+    task->notifyCount++;
+    task->cv.notify_all();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait) {
+    SimTask* self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(self->m);
+    if (!waitUntil(lock, self->cv, wait, [self] { return self->notifyCount > 0; })) return 0;
+    uint32_t count = self->notifyCount;
+    self->notifyCount = clearOnExit ? 0 : count - 1;
+    return count;
+}
+
+// =============================================================================
+// Software timers: one service thread fires callbacks in due order
+// =============================================================================
+struct SimTimer {
+    std::string name;
+    TickType_t period;
+    bool autoReload;
+    void* id;
+    TimerCallbackFunction_t callback;
+    bool active = false;
+    bool deleted = false;
+    uint64_t due = 0;
+};
+
+namespace {
+
+std::mutex g_timerMutex;
+std::condition_variable g_timerCv;
+std::vector<SimTimer*> g_timers;
+bool g_timerServiceStarted = false;
+
+void timerService() {
+    std::unique_lock<std::mutex> lock(g_timerMutex);
+    for (;;) {
+        SimTimer* next = nullptr;
+        for (SimTimer* t : g_timers) {
+            if (t->active && !t->deleted && (!next || t->due < next->due)) next = t;
+        }
+        if (!next) {
+            g_timerCv.wait(lock);
+            continue;
+        }
+        uint64_t now = nowTicks();
+        if (next->due > now) {
+            // Manual clock: time only moves when someone advances it; poll
+            if (Sim::clockManual()) g_timerCv.wait_for(lock, std::chrono::milliseconds(1));
+            else g_timerCv.wait_for(lock, Sim::realDuration((uint32_t)(next->due - now)));
+            continue;
+        }
+        if (next->autoReload) {
+            next->due += next->period;
+            if (next->due <= now) next->due = now + next->period;   // Don't replay missed periods
+        } else {
+            next->active = false;
+        }
+        lock.unlock();
+        next->callback(next);
+        lock.lock();
+    }
+}
+
+BaseType_t arm(TimerHandle_t t, TickType_t period) {
+    if (!t) return pdFAIL;
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    if (t->deleted) return pdFAIL;
+    t->period = period;
+    t->due = nowTicks() + period;
+    t->active = true;
+    g_timerCv.notify_all();
+    return pdPASS;
+}
+
+} // namespace
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload,
+                           void* id, TimerCallbackFunction_t callback) {
+    if (period == 0 || !callback) return nullptr;
+    SimTimer* t = new SimTimer();
+    t->name = name ? name : "";
+    t->period = period;
+    t->autoReload = autoReload != 0;
+    t->id = id;
+    t->callback = callback;
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    g_timers.push_back(t);
+    if (!g_timerServiceStarted) {
+        g_timerServiceStarted = true;
+        std::thread(timerService).detach();
+    }
+    return t;
+}
+
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t) { return t ? arm(t, t->period) : pdFAIL; }
+BaseType_t xTimerReset(TimerHandle_t t, TickType_t) { return t ? arm(t, t->period) : pdFAIL; }
+
+// As in FreeRTOS, changing the period also starts a dormant timer
+BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t) {
+    return period ? arm(t, period) : pdFAIL;
+}
+
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t) {
+    if (!t) return pdFAIL;
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    t->active = false;
+    return pdPASS;
+}
+
+// The handle stays allocated: the service thread may be about to fire it
+BaseType_t xTimerDelete(TimerHandle_t t, TickType_t) {
+    if (!t) return pdFAIL;
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    t->active = false;
+    t->deleted = true;
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t t) {
+    if (!t) return pdFALSE;
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    return t->active ? pdTRUE : pdFALSE;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t t) { return t ? t->id : nullptr; }
@@ -0,0 +1,193 @@
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include "sim.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+UpdateClass Update;
+
+namespace Sim {
+
+namespace {
+std::vector<uint8_t> g_update;     // Bytes written since the last begin()
+bool g_committed = false;          // end() succeeded; the image would boot next
+} // namespace
+
+const std::vector<uint8_t>& updateImage() { return g_update; }
+bool updateCommitted() { return g_committed; }
+
+void resetUpdate() {
+    g_update.clear();
+    g_committed = false;
+    Update.abort();
+}
+
+} // namespace Sim
+
+// =============================================================================
+// UpdateClass
+// =============================================================================
+
+bool UpdateClass::begin(size_t size, int command) {
+    if (_running || size == 0 || command != U_FLASH) {
+        _error = UPDATE_ERROR_BAD_ARGUMENT;
+        return false;
+    }
+    Sim::g_update.clear();
+    Sim::g_committed = false;
+    _running = true;
+    _size = size;
+    _written = 0;
+    _error = UPDATE_ERROR_OK;
+    return true;
+}
+
+size_t UpdateClass::write(uint8_t* data, size_t len) {
+    if (!_running || hasError()) return 0;
+    if (_size != UPDATE_SIZE_UNKNOWN && _written + len > _size) {
+        _error = UPDATE_ERROR_SPACE;
+        return 0;
+    }
+    Sim::g_update.insert(Sim::g_update.end(), data, data + len);
+    _written += len;
+    return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+    if (!_running || hasError()) return false;
+    if (!evenIfRemaining && _size != UPDATE_SIZE_UNKNOWN && _written != _size) {
+        _error = UPDATE_ERROR_SIZE;
+        return false;
+    }
+    if (_written == 0) {
+        _error = UPDATE_ERROR_SIZE;
+        return false;
+    }
+    _running = false;
+    Sim::g_committed = true;
+    return true;
+}
+
+void UpdateClass::abort() {
+    if (_running) _error = UPDATE_ERROR_ABORT;
+    _running = false;
+}
+
+const char* UpdateClass::errorString() const {
+    switch (_error) {
+        case UPDATE_ERROR_OK: return "No Error";
+        case UPDATE_ERROR_WRITE: return "Flash Write Failed";
+        case UPDATE_ERROR_SPACE: return "Not Enough Space";
+        case UPDATE_ERROR_SIZE: return "Bad Size Given";
+        case UPDATE_ERROR_ABORT: return "Update Aborted";
+        case UPDATE_ERROR_BAD_ARGUMENT: return "Bad Argument";
+        default: return "UNKNOWN";
+    }
+}
+
+// =============================================================================
+// Partitions: running app (delta OTA base) and data partitions
+// =============================================================================
+
+namespace Sim {
+
+namespace {
+// Data partitions of ../partitions.csv
+esp_partition_t g_dataPartitions[] = {
+    {0x670000, 0x10000, "journal"},
+};
+std::vector<uint8_t> g_dataImages[sizeof(g_dataPartitions) / sizeof(g_dataPartitions[0])];
+uint32_t g_erases = 0;
+
+std::vector<uint8_t>* dataImage(const esp_partition_t* partition) {
+    for (size_t i = 0; i < sizeof(g_dataPartitions) / sizeof(g_dataPartitions[0]); i++) {
+        if (partition != &g_dataPartitions[i]) continue;
+        if (g_dataImages[i].empty()) g_dataImages[i].assign(partition->size, 0xFF);
+        return &g_dataImages[i];
+    }
+    return nullptr;
+}
+} // namespace
+
+std::vector<uint8_t>* dataPartition(const std::string& label) {
+    for (esp_partition_t& p : g_dataPartitions) {
+        if (label == p.label) return dataImage(&p);
+    }
+    return nullptr;
+}
+
+void clearDataPartitions() {
+    for (std::vector<uint8_t>& image : g_dataImages) image.clear();
+}
+
+void saveDataPartitions(const std::string& path) {
+    for (size_t i = 0; i < sizeof(g_dataPartitions) / sizeof(g_dataPartitions[0]); i++) {
+        if (g_dataImages[i].empty()) continue;
+        FILE* f = fopen((path + "." + g_dataPartitions[i].label).c_str(), "wb");
+        if (!f) continue;
+        fwrite(g_dataImages[i].data(), 1, g_dataImages[i].size(), f);
+        fclose(f);
+    }
+}
+
+void loadDataPartitions(const std::string& path) {
+    for (size_t i = 0; i < sizeof(g_dataPartitions) / sizeof(g_dataPartitions[0]); i++) {
+        FILE* f = fopen((path + "." + g_dataPartitions[i].label).c_str(), "rb");
+        if (!f) continue;
+        g_dataImages[i].assign(g_dataPartitions[i].size, 0xFF);
+        fread(g_dataImages[i].data(), 1, g_dataImages[i].size(), f);
+        fclose(f);
+    }
+}
+
+uint32_t flashEraseCount() { return g_erases; }
+
+} // namespace Sim
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t, const char* label) {
+    if (type != ESP_PARTITION_TYPE_DATA || !label) return nullptr;
+    for (esp_partition_t& p : Sim::g_dataPartitions) {
+        if (strcmp(p.label, label) == 0) return &p;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size) {
+    std::vector<uint8_t>* image = Sim::dataImage(partition);
+    if (!image || !src) return ESP_ERR_INVALID_ARG;
+    if (dstOffset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    for (size_t i = 0; i < size; i++) (*image)[dstOffset + i] &= ((const uint8_t*)src)[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::vector<uint8_t>* image = Sim::dataImage(partition);
+    if (!image) return ESP_ERR_INVALID_ARG;
+    if (offset % 4096 || size % 4096 || offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    std::fill(image->begin() + offset, image->begin() + offset + size, 0xFF);
+    Sim::g_erases += size / 4096;
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+    static esp_partition_t running = {0x10000, 0x640000, "ota_0"};
+    return &running;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size) {
+    if (!partition || !dst) return ESP_ERR_INVALID_ARG;
+    if (std::vector<uint8_t>* data = Sim::dataImage(partition)) {
+        if (srcOffset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+        memcpy(dst, data->data() + srcOffset, size);
+        return ESP_OK;
+    }
+    const std::vector<uint8_t>& image = Sim::runningImage();
+    if (srcOffset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    // Flash past the end of the image reads as erased
+    for (size_t i = 0; i < size; i++) {
+        size_t at = srcOffset + i;
+        ((uint8_t*)dst)[i] = at < image.size() ? image[at] : 0xFF;
+    }
+    return ESP_OK;
+}
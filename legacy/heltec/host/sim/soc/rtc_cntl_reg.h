@@ -0,0 +1,6 @@
+#pragma once
+
+// soc/rtc_cntl_reg shim (ESP32-S3 values)
+
+#define RTC_CNTL_LOW_POWER_ST_REG 0x600080D0
+#define RTC_CNTL_MAIN_STATE_IN_IDLE_S 27
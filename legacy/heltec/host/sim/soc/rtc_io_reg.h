@@ -0,0 +1,6 @@
+#pragma once
+
+// soc/rtc_io_reg shim (ESP32-S3 values)
+
+#define RTC_GPIO_IN_REG 0x60008424
+#define RTC_GPIO_IN_NEXT_S 10
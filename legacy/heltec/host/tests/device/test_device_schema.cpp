@@ -0,0 +1,49 @@
+// Compiled once per directory under ../devices/ (see the Makefile), with
+// TEST_DEVICE naming the device and TEST_DEVICE_CONFIG its device_config.h
+#include "test.h"
+#include TEST_DEVICE_CONFIG
+#include "lib/telemetry_keys.h"
+#include <string.h>
+
+using namespace MessageSchema;
+
+#define DEVICE_TEST(device) DEVICE_TEST_(device)
+#define DEVICE_TEST_(device) TEST(schema_perfect_hash_matches_scan_##device)
+
+// Keys every lookup must agree on: the schema's own, other known keys,
+// prefixes/extensions of real keys and over-long keys
+static void checkLookups(const Schema& schema, const char* key) {
+    CHECK_EQ(schema.findFieldIndex(key), schema.scanFields(key));
+    CHECK_EQ(schema.findControlIndex(key), schema.scanControls(key));
+}
+
+DEVICE_TEST(TEST_DEVICE) {
+    const Schema& schema = buildDeviceSchema();
+    CHECK(schema.field_index.valid);
+    CHECK(schema.control_index.valid);
+
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        CHECK_EQ(schema.findFieldIndex(schema.fields[i].key), (int8_t)i);
+        checkLookups(schema, schema.fields[i].key);
+    }
+    for (uint8_t i = 0; i < schema.control_count; i++) {
+        CHECK_EQ(schema.findControlIndex(schema.controls[i].key), (int8_t)i);
+        checkLookups(schema, schema.controls[i].key);
+    }
+
+    const char* others[] = {"", "p", "pdx", "pumpx", "valv", "tsrr", "kwh", "ps", "pe",
+                            TelemetryKeys::ErrorPersistence, "abcdefgh", "abcdefghijkl"};
+    for (const char* key : others) checkLookups(schema, key);
+
+    // Every one- and two-character key
+    char key[3] = {};
+    for (int a = 'a'; a <= 'z'; a++) {
+        key[0] = (char)a;
+        key[1] = '\0';
+        checkLookups(schema, key);
+        for (int b = 'a'; b <= 'z'; b++) {
+            key[1] = (char)b;
+            checkLookups(schema, key);
+        }
+    }
+}
@@ -0,0 +1,11 @@
+// Firmware translation units exercised by the host tests, compiled once
+// (remote_app.cpp includes the same files for the device build)
+#include "lib/ota_receiver.cpp"
+#include "lib/delta_patch.cpp"
+#include "lib/lzss_decoder.cpp"
+#include "lib/tx_scheduler.cpp"
+#include "lib/registration_manager.cpp"
+#include "lib/radio_task.cpp"
+#include "lib/flash_journal.cpp"
+#include "lib/pulse_source.cpp"
+#include "lib/ulp_pulse_counter.cpp"
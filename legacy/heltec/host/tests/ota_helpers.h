@@ -0,0 +1,98 @@
+#pragma once
+
+// Server-side helpers for the OTA tests: heatshrink-format encoder, start and
+// chunk frames as the backend builds them
+
+#include "lib/ota_receiver.h"
+#include "lib/crc.h"
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+namespace OtaTest {
+
+using Bytes = std::vector<uint8_t>;
+
+inline Bytes randomImage(size_t len, uint32_t seed) {
+    std::mt19937 rng(seed);
+    Bytes out(len);
+    // Firmware-like: runs of repeated structure with random noise mixed in
+    for (size_t i = 0; i < len; i++) out[i] = (rng() % 4 == 0) ? (uint8_t)rng() : (uint8_t)(i / 16);
+    return out;
+}
+
+/** Greedy LZSS encoder producing the heatshrink bit stream (MSB first). */
+inline Bytes lzssEncode(const Bytes& in, uint8_t windowBits, uint8_t lookaheadBits) {
+    Bytes out;
+    uint32_t acc = 0;
+    uint8_t bits = 0;
+    auto put = [&](uint32_t value, uint8_t n) {
+        for (int b = n - 1; b >= 0; b--) {
+            acc = (acc << 1) | ((value >> b) & 1);
+            if (++bits == 8) {
+                out.push_back((uint8_t)acc);
+                acc = 0;
+                bits = 0;
+            }
+        }
+    };
+    const size_t window = (size_t)1 << windowBits;
+    const size_t maxLen = (size_t)1 << lookaheadBits;
+    for (size_t i = 0; i < in.size();) {
+        size_t bestLen = 0, bestDist = 0;
+        for (size_t j = i > window ? i - window : 0; j < i; j++) {
+            size_t n = 0;
+            while (n < maxLen && i + n < in.size() && in[j + n] == in[i + n]) n++;
+            if (n > bestLen) {
+                bestLen = n;
+                bestDist = i - j;
+            }
+        }
+        if (bestLen * 9 > 1u + windowBits + lookaheadBits) {
+            put(0, 1);
+            put((uint32_t)(bestDist - 1), windowBits);
+            put((uint32_t)(bestLen - 1), lookaheadBits);
+            i += bestLen;
+        } else {
+            put(1, 1);
+            put(in[i], 8);
+            i++;
+        }
+    }
+    if (bits) out.push_back((uint8_t)(acc << (8 - bits)));
+    return out;
+}
+
+inline uint16_t chunkCount(const Bytes& stream) {
+    return (uint16_t)((stream.size() + OtaReceiver::OTA_PAYLOAD_SIZE - 1) / OtaReceiver::OTA_PAYLOAD_SIZE);
+}
+
+/** fPort 40: size, chunks, CRC32 of the final image, flags, LZSS params. */
+inline Bytes startFrame(const Bytes& stream, uint32_t imageCrc32, uint8_t flags, uint8_t lzssParams = 0) {
+    Bytes f(OtaReceiver::OTA_START_MAX_LEN);
+    uint32_t size = (uint32_t)stream.size();
+    uint16_t chunks = chunkCount(stream);
+    memcpy(&f[0], &size, 4);
+    memcpy(&f[4], &chunks, 2);
+    memcpy(&f[6], &imageCrc32, 4);
+    f[OtaReceiver::OTA_START_FLAGS_OFFSET] = flags;
+    f[OtaReceiver::OTA_START_PARAMS_OFFSET] = lzssParams;
+    return f;
+}
+
+/** fPort 41: index, 218 payload bytes (last chunk padded), CRC16. */
+inline Bytes chunkFrame(const Bytes& stream, uint16_t index) {
+    Bytes f(OtaReceiver::OTA_CHUNK_PAYLOAD_LEN, 0xAA);
+    f[0] = (uint8_t)index;
+    f[1] = (uint8_t)(index >> 8);
+    size_t at = (size_t)index * OtaReceiver::OTA_PAYLOAD_SIZE;
+    size_t n = std::min(OtaReceiver::OTA_PAYLOAD_SIZE, stream.size() - at);
+    memcpy(&f[2], &stream[at], n);
+    uint16_t crc = Crc::crc16Ccitt(&f[2], OtaReceiver::OTA_PAYLOAD_SIZE);
+    f[220] = (uint8_t)crc;
+    f[221] = (uint8_t)(crc >> 8);
+    return f;
+}
+
+} // namespace OtaTest
@@ -0,0 +1,59 @@
+#pragma once
+
+// In-memory NVS stand-in shared by the tests that persist through
+// IPersistenceHal; fail makes every save fail, as does opening read-only.
+// opens counts begin() calls of either kind
+
+#include "lib/hal_persistence.h"
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class MemoryPersistence : public IPersistenceHal {
+public:
+    bool begin(const char*) override {
+        opens++;
+        readOnly = false;
+        return true;
+    }
+    bool beginReadOnly(const char*) override {
+        opens++;
+        readOnly = true;
+        return true;
+    }
+    void end() override {}
+    bool saveU32(const char* key, uint32_t value) override {
+        if (fail || readOnly) return false;
+        _u32[key] = value;
+        return true;
+    }
+    uint32_t loadU32(const char* key, uint32_t defaultValue) override {
+        auto it = _u32.find(key);
+        return it == _u32.end() ? defaultValue : it->second;
+    }
+    bool saveFloat(const char*, float) override { return false; }
+    float loadFloat(const char*, float defaultValue) override { return defaultValue; }
+    bool saveString(const char*, const std::string&) override { return false; }
+    std::string loadString(const char*, const std::string& defaultValue) override { return defaultValue; }
+    bool saveBytes(const char* key, const uint8_t* ptr, size_t len) override {
+        if (fail || readOnly) return false;
+        _bytes[key].assign(ptr, ptr + len);
+        return true;
+    }
+    size_t loadBytes(const char* key, uint8_t* ptr, size_t max_len) override {
+        auto it = _bytes.find(key);
+        if (it == _bytes.end() || it->second.size() > max_len) return 0;
+        memcpy(ptr, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    bool fail = false;
+    bool readOnly = false;
+    int opens = 0;
+
+private:
+    std::map<std::string, uint32_t> _u32;
+    std::map<std::string, std::vector<uint8_t>> _bytes;
+};
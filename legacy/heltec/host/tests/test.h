@@ -0,0 +1,44 @@
+#pragma once
+
+// =============================================================================
+// Minimal test harness for the host build
+// =============================================================================
+//   TEST(name) { CHECK(cond); CHECK_EQ(a, b); }
+// Every test starts from a reset simulator: manual clock at 0, empty NVS,
+// clean network and flash, restart hook that only counts.
+// =============================================================================
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace HostTest {
+
+struct Case {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<Case>& registry();
+void fail(const char* file, int line, const char* expr);
+
+/** Scratch file path under $TMPDIR (or /tmp), unique to this run. */
+std::string tempPath(const char* name);
+
+struct Registrar {
+    Registrar(const char* name, void (*fn)()) { registry().push_back(Case{name, fn}); }
+};
+
+} // namespace HostTest
+
+#define TEST(name)                                                        \
+    static void test_##name();                                            \
+    static HostTest::Registrar registrar_##name(#name, test_##name);      \
+    static void test_##name()
+
+#define CHECK(expr)                                                       \
+    do {                                                                  \
+        if (!(expr)) HostTest::fail(__FILE__, __LINE__, #expr);           \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
@@ -0,0 +1,30 @@
+#include "test.h"
+#include "lib/airtime.h"
+
+TEST(airtime_time_on_air_matches_semtech_calculator) {
+    // SF7/125 kHz, 10 B app payload (23 B PHY): 61.7 ms
+    CHECK_EQ(Airtime::uplinkTimeOnAirUs(LoRaWANRegion::EU868, 5, 10), 61696u);
+    // SF12/125 kHz, LDRO on: 1.48 s
+    CHECK_EQ(Airtime::uplinkTimeOnAirUs(LoRaWANRegion::EU868, 0, 10), 1482752u);
+    // US915 DR0 is SF10/125 kHz
+    CHECK(Airtime::uplinkTimeOnAirUs(LoRaWANRegion::US915, 0, 11) > 300000u);
+}
+
+TEST(airtime_ledger_gates_low_priority_classes) {
+    Airtime::AirtimeLedger ledger = {};
+    ledger.setBudget(1000);
+    const uint8_t all = TxScheduler::ALL_CLASSES;
+    const uint8_t lowPriority = (1u << (uint8_t)TxClass::Telemetry) | (1u << (uint8_t)TxClass::Diagnostics) |
+                                (1u << (uint8_t)TxClass::Backfill);
+
+    for (int i = 0; i < 7; i++) ledger.record(i * 1000, 100000);
+    CHECK_EQ(ledger.admissibleClasses(7000), all);
+    ledger.record(8000, 100000);                           // 800 ms = 80%
+    CHECK_EQ(ledger.admissibleClasses(8000), (uint8_t)(all & ~lowPriority));
+    ledger.record(9000, 250000);                           // Over budget
+    CHECK_EQ(ledger.admissibleClasses(9000),
+             (uint8_t)((1u << (uint8_t)TxClass::OtaAck) | (1u << (uint8_t)TxClass::CmdAck)));
+    // Everything ages out after an hour
+    CHECK_EQ(ledger.admissibleClasses(3600000 + 61000), all);
+    CHECK_EQ(ledger.usedMs(), 0u);
+}
@@ -0,0 +1,293 @@
+#include "test.h"
+#include "persistence_helpers.h"
+#include "lib/reading_store.h"
+#include "devices/remote/device_config.h"
+#include <map>
+#include <string>
+#include <vector>
+
+static constexpr uint8_t PD = 0, TV = 1, BP = 2;
+
+// One report window: pulses, a running total and battery, sampled at i seconds
+static void appendWindow(ReadingStore& store, uint32_t i) {
+    float values[MessageSchema::MAX_FIELDS];
+    for (float& v : values) v = NAN;
+    values[PD] = (float)(i % 7);
+    values[TV] = 1000.0f + 12.34f * i;
+    values[BP] = 90.0f - 0.1f * i;
+    uint16_t present = (1u << PD) | (1u << TV) | (1u << BP);
+    CHECK(store.append(present, values, i * 1000));
+}
+
+// Drains the store through delivered batches; returns the decoded records
+static std::vector<BackfillCodec::Record> drain(ReadingStore& store, uint32_t nowMs) {
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    std::vector<BackfillCodec::Record> out;
+    uint8_t buf[222];
+    size_t len;
+    while ((len = store.buildBatch(buf, sizeof(buf), nowMs)) > 0) {
+        BackfillCodec::Record batch[255];
+        int n = BackfillCodec::decode(schema, buf, len, batch, 255);
+        CHECK(n > 0);
+        if (n <= 0) break;
+        out.insert(out.end(), batch, batch + n);
+        store.onUplinkComplete(buf[1], true);
+    }
+    return out;
+}
+
+TEST(backlog_batch_decodes_oldest_first) {
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    ReadingStore store(schema, nullptr);
+    for (uint32_t i = 0; i < 10; i++) appendWindow(store, i * 60);
+    CHECK_EQ(store.records(), 10u);
+
+    uint8_t buf[222];
+    size_t len = store.buildBatch(buf, sizeof(buf), 600000);
+    CHECK(len > 0);
+    BackfillCodec::Record recs[16];
+    CHECK_EQ(BackfillCodec::decode(schema, buf, len, recs, 16), 10);
+    for (uint32_t i = 0; i < 10; i++) {
+        CHECK_EQ(recs[i].ageSec, 600 - i * 60);
+        CHECK_EQ(recs[i].values.values[PD], (float)((i * 60) % 7));
+        CHECK(fabsf(recs[i].values.values[TV] - (1000.0f + 12.34f * i * 60)) < 0.01f);
+        CHECK(fabsf(recs[i].values.values[BP] - (90.0f - 6.0f * i)) < 0.01f);
+    }
+
+    // Deltas make a batch far smaller than ten standalone records
+    CHECK(len < 10 * (3 + 4 + 4 + 4));
+}
+
+TEST(backlog_float_deltas_are_exact) {
+    // Off the 0.01 grid, sign changes and a jump too large for a delta
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    ReadingStore store(schema, nullptr);
+    const float series[] = {1000.005f, 1012.3456f, 1012.3457f, 3.14159265f, -0.001f, 1.0e-7f,
+                            123456.789f, 1.0e30f, 12.34f, 12.35f, -0.0f};
+    const size_t count = sizeof(series) / sizeof(series[0]);
+    for (size_t i = 0; i < count; i++) {
+        float values[MessageSchema::MAX_FIELDS];
+        for (float& v : values) v = NAN;
+        values[TV] = series[i];
+        CHECK(store.append(1u << TV, values, (uint32_t)i * 1000));
+    }
+    std::vector<BackfillCodec::Record> recs = drain(store, count * 1000);
+    CHECK_EQ(recs.size(), count);
+    for (size_t i = 0; i < recs.size() && i < count; i++) {
+        CHECK(memcmp(&recs[i].values.values[TV], &series[i], sizeof(float)) == 0);
+    }
+}
+
+TEST(backlog_batch_leaves_only_when_delivered) {
+    ReadingStore store(buildDeviceSchema(), nullptr);
+    for (uint32_t i = 0; i < 3; i++) appendWindow(store, i);
+
+    uint8_t buf[222];
+    size_t len = store.buildBatch(buf, sizeof(buf), 10000);
+    CHECK(len > 0);
+    CHECK_EQ(store.buildBatch(buf, sizeof(buf), 10000), 0u);    // One batch in flight at a time
+    CHECK(store.poll(10000, 120000));
+
+    // Sent but not acknowledged: the same records go again
+    store.onUplinkComplete(buf[1], false);
+    CHECK(!store.poll(11000, 120000));
+    CHECK_EQ(store.records(), 3u);
+
+    // No result at all: rolled back after the timeout
+    CHECK(store.buildBatch(buf, sizeof(buf), 12000) > 0);
+    CHECK(store.poll(100000, 120000));
+    CHECK(!store.poll(132000, 120000));
+    CHECK_EQ(store.records(), 3u);
+
+    // A result for an older batch is ignored
+    CHECK(store.buildBatch(buf, sizeof(buf), 140000) > 0);
+    store.onUplinkComplete((uint8_t)(buf[1] - 1), true);
+    CHECK(store.poll(141000, 120000));
+    store.onUplinkComplete(buf[1], true);
+    CHECK(!store.poll(142000, 120000));
+    CHECK_EQ(store.records(), 0u);
+}
+
+TEST(backlog_link_loss_puts_batch_back) {
+    ReadingStore store(buildDeviceSchema(), nullptr);
+    for (uint32_t i = 0; i < 3; i++) appendWindow(store, i);
+    uint8_t buf[222];
+    CHECK(store.buildBatch(buf, sizeof(buf), 10000) > 0);
+
+    // Offline again before the result: the batch is back, and the late result
+    // does not remove it
+    appendWindow(store, 3);
+    store.onUplinkComplete(buf[1], true);
+    CHECK(!store.poll(11000, 120000));
+    CHECK_EQ(store.records(), 4u);
+    CHECK_EQ(drain(store, 20000).size(), 4u);
+}
+
+TEST(backlog_spills_to_flash_in_order) {
+    MemoryPersistence flash;
+    ReadingStore store(buildDeviceSchema(), &flash);
+    const uint32_t windows = 300;   // Several times the RAM FIFO
+    for (uint32_t i = 0; i < windows; i++) appendWindow(store, i);
+    CHECK_EQ(store.records(), windows);
+    CHECK_EQ(store.droppedRecords(), 0u);
+
+    std::vector<BackfillCodec::Record> recs = drain(store, windows * 1000);
+    CHECK_EQ(recs.size(), (size_t)windows);
+    for (uint32_t i = 0; i < recs.size(); i++) {
+        CHECK_EQ(recs[i].ageSec, windows - i);
+        CHECK_EQ(recs[i].values.values[PD], (float)(i % 7));
+    }
+    CHECK_EQ(store.records(), 0u);
+}
+
+TEST(backlog_drops_oldest_when_full) {
+    // No flash: the RAM FIFO keeps the newest records
+    ReadingStore ramOnly(buildDeviceSchema(), nullptr);
+    for (uint32_t i = 0; i < 200; i++) appendWindow(ramOnly, i);
+    uint32_t kept = ramOnly.records();
+    CHECK(kept < 200u);
+    CHECK_EQ(ramOnly.droppedRecords(), 200u - kept);
+    std::vector<BackfillCodec::Record> recs = drain(ramOnly, 200000);
+    CHECK_EQ(recs.size(), (size_t)kept);
+    CHECK_EQ(recs.back().ageSec, 1u);
+
+    // Failing flash behaves the same way
+    MemoryPersistence broken;
+    broken.fail = true;
+    ReadingStore store(buildDeviceSchema(), &broken);
+    for (uint32_t i = 0; i < 200; i++) appendWindow(store, i);
+    CHECK_EQ(store.records() + store.droppedRecords(), 200u);
+
+    // Full flash drops its oldest block; the total stays bounded
+    MemoryPersistence flash;
+    ReadingStore bounded(buildDeviceSchema(), &flash);
+    for (uint32_t i = 0; i < 2000; i++) appendWindow(bounded, i);
+    CHECK(bounded.droppedRecords() > 0u);
+    CHECK_EQ(bounded.records() + bounded.droppedRecords(), 2000u);
+    kept = bounded.records();
+    recs = drain(bounded, 2000000);
+    CHECK_EQ(recs.size(), (size_t)kept);
+    CHECK_EQ(recs.back().ageSec, 1u);
+}
+
+TEST(backlog_survives_deep_sleep) {
+    // Every wake starts a new store; only the saved state (RTC memory) and
+    // flash carry over. Each wake delivers one batch and sleeps with the next
+    // one in flight.
+    static ReadingStore::SavedState rtc;
+    rtc.magic = 0;
+    MemoryPersistence flash;
+    std::vector<BackfillCodec::Record> recs;
+    uint8_t buf[222];
+    uint32_t windows = 0;
+    for (int wake = 0; wake < 3; wake++) {
+        ReadingStore store(buildDeviceSchema(), &flash);
+        CHECK_EQ(store.restore(&rtc), wake > 0);
+        for (int i = 0; i < 100; i++) appendWindow(store, windows++);
+
+        size_t len = store.buildBatch(buf, sizeof(buf), windows * 1000);
+        BackfillCodec::Record batch[255];
+        int n = BackfillCodec::decode(buildDeviceSchema(), buf, len, batch, 255);
+        CHECK(n > 0);
+        if (n > 0) recs.insert(recs.end(), batch, batch + n);
+        store.onUplinkComplete(buf[1], true);
+        CHECK(store.buildBatch(buf, sizeof(buf), windows * 1000) > 0);
+        store.save(&rtc);
+    }
+
+    ReadingStore store(buildDeviceSchema(), &flash);
+    CHECK(store.restore(&rtc));
+    CHECK_EQ(store.records() + recs.size(), (size_t)windows);
+    CHECK(!ReadingStore(buildDeviceSchema(), &flash).restore(&rtc));   // One wake only
+    std::vector<BackfillCodec::Record> rest = drain(store, windows * 1000);
+    recs.insert(recs.end(), rest.begin(), rest.end());
+    CHECK_EQ(recs.size(), (size_t)windows);
+    for (uint32_t i = 0; i < recs.size(); i++) CHECK_EQ(recs[i].values.values[PD], (float)(i % 7));
+    CHECK_EQ(rest.back().ageSec, 1u);
+}
+
+TEST(backlog_splits_records_too_large_for_the_payload) {
+    // A full system report is far over the 11-byte DR0 payload
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    ReadingStore store(schema, nullptr);
+    float full[MessageSchema::MAX_FIELDS];
+    for (uint8_t i = 0; i < schema.field_count; i++) full[i] = 1000.0f * i + 7;
+    full[TV] = 1012.3456f;
+    CHECK(store.append(TelemetryCodec::schemaMask(schema), full, 0));
+    appendWindow(store, 60);
+    CHECK_EQ(store.records(), 2u);
+
+    std::map<uint32_t, TelemetryCodec::FieldValues> merged;   // By age
+    uint8_t buf[11];
+    size_t len;
+    int parts = 0;
+    bool lostOne = false;
+    while ((len = store.buildBatch(buf, sizeof(buf), 120000)) > 0) {
+        BackfillCodec::Record rec[1];
+        CHECK_EQ(BackfillCodec::decode(schema, buf, len, rec, 1), 1);
+        if (parts == 2 && !lostOne) {
+            lostOne = true;                                     // Lost parts are sent again
+            store.onUplinkComplete(buf[1], false);
+            continue;
+        }
+        TelemetryCodec::FieldValues& m = merged[rec[0].ageSec];
+        CHECK_EQ(m.present & rec[0].values.present, 0);         // Disjoint parts
+        for (uint8_t i = 0; i < schema.field_count; i++) {
+            if (rec[0].values.has(i)) m.set(i, rec[0].values.values[i]);
+        }
+        parts++;
+        store.onUplinkComplete(buf[1], true);
+        if (m.present != TelemetryCodec::schemaMask(schema) && rec[0].ageSec == 120) {
+            CHECK_EQ(store.records(), 2u);                      // Still stored until the last part
+        }
+    }
+    CHECK_EQ(store.records(), 0u);
+    CHECK(parts > 4);
+    CHECK_EQ(merged.size(), 2u);
+    CHECK_EQ(merged[120].present, TelemetryCodec::schemaMask(schema));
+    for (uint8_t i = 0; i < schema.field_count; i++) CHECK_EQ(merged[120].values[i], full[i]);
+    CHECK_EQ(merged[60].present, (1u << PD) | (1u << TV) | (1u << BP));
+    CHECK_EQ(merged[60].values[TV], 1000.0f + 12.34f * 60);
+}
+
+TEST(backlog_flash_blocks_survive_reboot) {
+    const uint32_t windows = 300;
+    MemoryPersistence flash;
+    {
+        ReadingStore store(buildDeviceSchema(), &flash);
+        for (uint32_t i = 0; i < windows; i++) appendWindow(store, i);
+    }
+
+    // Rebooted with the clock still running: the RAM FIFO is gone, the
+    // spilled blocks come back oldest first
+    ReadingStore store(buildDeviceSchema(), &flash);
+    CHECK(store.load(windows * 1000));
+    uint32_t flashed = store.records();
+    CHECK(flashed > 0u && flashed < windows);
+    std::vector<BackfillCodec::Record> recs = drain(store, windows * 1000);
+    CHECK_EQ(recs.size(), (size_t)flashed);
+    for (uint32_t i = 0; i < recs.size(); i++) {
+        CHECK_EQ(recs[i].ageSec, windows - i);
+        CHECK_EQ(recs[i].values.values[PD], (float)(i % 7));
+    }
+    ReadingStore drained(buildDeviceSchema(), &flash);
+    CHECK(drained.load(windows * 1000));
+    CHECK_EQ(drained.records(), 0u);                            // Pops were saved too
+
+    // After a power cycle the clock starts over: ages count from the last
+    // time the index was written (the off time is unknown)
+    MemoryPersistence cycled;
+    {
+        ReadingStore before(buildDeviceSchema(), &cycled);
+        for (uint32_t i = 0; i < windows; i++) appendWindow(before, 1000000 + i);
+    }
+    ReadingStore after(buildDeviceSchema(), &cycled);
+    CHECK(after.load(5000));
+    recs = drain(after, 5000);
+    CHECK_EQ(recs.size(), (size_t)flashed);
+    CHECK(recs[0].ageSec <= windows && recs.back().ageSec >= 1u);
+    for (uint32_t i = 0; i < recs.size(); i++) CHECK_EQ(recs[i].ageSec, recs[0].ageSec - i);
+
+    MemoryPersistence empty;
+    CHECK(!ReadingStore(buildDeviceSchema(), &empty).load(0));
+}
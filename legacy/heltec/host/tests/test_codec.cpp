@@ -0,0 +1,99 @@
+#include "test.h"
+#include "lib/telemetry_codec.h"
+#include "devices/remote/device_config.h"
+#include <math.h>
+#include <random>
+
+using namespace TelemetryCodec;
+
+// Runs the compressor against the server-side decompressor over a lossy link;
+// unacked mode learns delivery from the radio, acked mode from the decoder
+static void runCodec(bool acked, uint32_t seed) {
+    MessageSchema::Schema schema = buildDeviceSchema();
+    std::mt19937 rng(seed);
+    TelemetryCompressor enc(schema, acked);
+    TelemetryDecompressor dec(schema);
+    float pd = 0, tv = 1000;
+    uint32_t tsr = 0;
+    size_t bytes = 0, snapshotBytes = 0, frames = 0, keyframes = 0, wrong = 0, malformed = 0;
+
+    for (int i = 0; i < 3000; i++) {
+        pd += rng() % 5;
+        tv += (rng() % 1000) / 100.0f;
+        tsr += 60;
+        FieldValues v;
+        v.set(0, pd);
+        v.set(1, tv);
+        v.set(2, 80 + rng() % 3);
+        v.set(3, 0);
+        v.set(4, tsr);
+        uint8_t buf[MAX_FRAME_SIZE];
+        bool keyframe = false;
+        size_t n = enc.encode(v, buf, sizeof(buf), &keyframe);
+        CHECK(n > 0);
+        bytes += n;
+        uint8_t snap[MAX_FRAME_SIZE];
+        snapshotBytes += encodeSnapshot(schema, v, snap, sizeof(snap));
+        frames++;
+        keyframes += keyframe;
+
+        bool lost = rng() % 5 == 0;
+        if (!acked && !lost) enc.onUplinkComplete(buf[0], buf[1], true, false);
+        if (lost) continue;
+        FieldValues out;
+        DecodeStatus st = dec.decode(buf, n, &out);
+        if (st == DecodeStatus::NeedResync) {
+            enc.requestKeyframe();
+            continue;
+        }
+        if (st != DecodeStatus::Ok) {
+            malformed++;
+            continue;
+        }
+        if (acked) enc.onUplinkComplete(buf[0], buf[1], true, true);
+        for (int k = 0; k < 5; k++) {
+            if (memcmp(&out.values[k], &v.values[k], sizeof(float)) != 0) wrong++;
+        }
+    }
+    CHECK_EQ(malformed, 0u);
+    CHECK_EQ(wrong, 0u);
+    CHECK(keyframes < frames / 4);
+    CHECK(bytes < snapshotBytes * 3 / 4);     // Deltas pay for the keyframes
+}
+
+TEST(codec_roundtrip_with_loss_unacked) { runCodec(false, 1); }
+TEST(codec_roundtrip_with_loss_acked) { runCodec(true, 2); }
+
+TEST(codec_float_deltas_are_exact_off_the_grid) {
+    // Readings that are not multiples of 0.01, sign changes and huge jumps
+    MessageSchema::Schema schema = buildDeviceSchema();
+    TelemetryCompressor enc(schema, true);
+    TelemetryDecompressor dec(schema);
+    const float series[] = {1000.0f, 1000.005f, 1012.3456f, 1012.3457f, 3.14159265f, 2.71828f,
+                            -0.001f, 0.0004f, 1.0e-7f, 2.0e-7f, 123456.789f, 123456.79f,
+                            -98765.4321f, 1.0e9f, 1012.34f, 1012.35f, 1013.0f, -0.0f, 0.0f};
+    size_t deltas = 0;
+    for (float tv : series) {
+        FieldValues v;
+        v.set(0, 7);
+        v.set(1, tv);
+        uint8_t buf[MAX_FRAME_SIZE];
+        bool keyframe = false;
+        size_t n = enc.encode(v, buf, sizeof(buf), &keyframe);
+        CHECK(n > 0);
+        deltas += !keyframe;
+        FieldValues out;
+        CHECK(dec.decode(buf, n, &out) == DecodeStatus::Ok);
+        CHECK(out.has(1));
+        CHECK(memcmp(&out.values[1], &tv, sizeof(float)) == 0);
+        enc.onUplinkComplete(buf[0], buf[1], true, true);
+    }
+    CHECK(deltas > 10);
+
+    // A step on the 0.01 grid still costs a short varint
+    uint32_t word = 0;
+    CHECK(deltaWord(MessageSchema::FieldType::FLOAT, toRaw(MessageSchema::FieldType::FLOAT, 1012.34f),
+                    toRaw(MessageSchema::FieldType::FLOAT, 1012.35f), &word));
+    CHECK_EQ(word & 1, 0u);
+    CHECK(word < (1u << 14));
+}
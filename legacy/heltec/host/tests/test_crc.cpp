@@ -0,0 +1,24 @@
+#include "test.h"
+#include "lib/crc.h"
+#include <random>
+#include <vector>
+
+TEST(crc_check_values) {
+    const uint8_t* check = (const uint8_t*)"123456789";
+    CHECK_EQ(Crc::crc32(check, 9), 0xCBF43926u);
+    CHECK_EQ(Crc::crc16Ccitt(check, 9), 0x29B1);
+}
+
+TEST(crc_table_driven_matches_bitwise_reference) {
+    std::mt19937 rng(2);
+    std::vector<uint8_t> buf(70000);
+    for (auto& b : buf) b = (uint8_t)rng();
+    for (size_t n : {0, 1, 3, 4, 5, 218, 1000, 65537}) {
+        size_t off = rng() % 100;    // Unaligned starts exercise the slicing head
+        CHECK_EQ(Crc::crc32(&buf[off], n), Crc::crc32Reference(0, &buf[off], n));
+        CHECK_EQ(Crc::crc16Ccitt(&buf[off], n), Crc::crc16CcittReference(&buf[off], n));
+    }
+    // Incremental updates compose
+    uint32_t split = Crc::crc32Update(Crc::crc32Update(0, &buf[0], 1001), &buf[1001], 5000);
+    CHECK_EQ(split, Crc::crc32(&buf[0], 6001));
+}
@@ -0,0 +1,116 @@
+#include "test.h"
+#include "ota_helpers.h"
+#include "lib/delta_patch.h"
+
+using OtaTest::Bytes;
+using DeltaPatch::Applier;
+using DeltaPatch::Status;
+
+namespace {
+
+struct Images {
+    Bytes base;
+    Bytes out;
+};
+
+bool readBase(void* ctx, uint32_t offset, uint8_t* dst, size_t len) {
+    Images* img = (Images*)ctx;
+    if (offset + len > img->base.size()) return false;
+    memcpy(dst, &img->base[offset], len);
+    return true;
+}
+
+bool writeOut(void* ctx, const uint8_t* data, size_t len) {
+    Images* img = (Images*)ctx;
+    img->out.insert(img->out.end(), data, data + len);
+    return true;
+}
+
+void u32(Bytes& v, uint32_t x) { for (int i = 0; i < 4; i++) v.push_back((uint8_t)(x >> (8 * i))); }
+void varint(Bytes& v, uint32_t x) {
+    while (x >= 0x80) { v.push_back((uint8_t)(x | 0x80)); x >>= 7; }
+    v.push_back((uint8_t)x);
+}
+
+Bytes header(const Bytes& base, uint32_t newSize) {
+    Bytes p = {DeltaPatch::MAGIC0, DeltaPatch::MAGIC1, DeltaPatch::VERSION, 0};
+    u32(p, (uint32_t)base.size());
+    u32(p, Crc::crc32(base.data(), base.size()));
+    u32(p, newSize);
+    return p;
+}
+
+Status applyAll(Images& img, const Bytes& patch) {
+    Applier a;
+    a.begin(readBase, writeOut, &img);
+    return a.feed(patch.data(), patch.size());
+}
+
+} // namespace
+
+TEST(delta_patch_copy_add_insert_any_split) {
+    Images img;
+    img.base = OtaTest::randomImage(100000, 3);
+    const Bytes& base = img.base;
+    std::mt19937 rng(3);
+    Bytes expected, ops;
+
+    ops.push_back((uint8_t)DeltaPatch::Op::Copy); u32(ops, 0); varint(ops, 40000);
+    expected.insert(expected.end(), base.begin(), base.begin() + 40000);
+    ops.push_back((uint8_t)DeltaPatch::Op::Add); u32(ops, 40000); varint(ops, 20000);
+    for (int i = 0; i < 20000; i++) {
+        uint8_t d = (i % 97 == 0) ? (uint8_t)rng() : 0;
+        ops.push_back(d);
+        expected.push_back((uint8_t)(base[40000 + i] + d));
+    }
+    ops.push_back((uint8_t)DeltaPatch::Op::Insert); varint(ops, 3000);
+    for (int i = 0; i < 3000; i++) {
+        uint8_t b = (uint8_t)rng();
+        ops.push_back(b);
+        expected.push_back(b);
+    }
+    ops.push_back((uint8_t)DeltaPatch::Op::Copy); u32(ops, 70000); varint(ops, 30000);
+    expected.insert(expected.end(), base.begin() + 70000, base.end());
+
+    Bytes patch = header(base, (uint32_t)expected.size());
+    patch.insert(patch.end(), ops.begin(), ops.end());
+    patch.resize(patch.size() + 300, 0);    // Chunk padding after the last op
+
+    for (int trial = 0; trial < 10; trial++) {
+        Applier a;
+        img.out.clear();
+        a.begin(readBase, writeOut, &img);
+        Status s = Status::Ok;
+        for (size_t i = 0; i < patch.size() && (s == Status::Ok || s == Status::Done);) {
+            size_t n = std::min<size_t>(patch.size() - i, 1 + rng() % (trial < 5 ? 7 : 400));
+            s = a.feed(&patch[i], n);
+            i += n;
+        }
+        CHECK(s == Status::Done);
+        CHECK(img.out == expected);
+    }
+}
+
+TEST(delta_patch_rejects_bad_streams) {
+    Images img;
+    img.base = OtaTest::randomImage(5000, 4);
+    Bytes good = header(img.base, 10);
+
+    Bytes wrongBase = good;
+    wrongBase[8] ^= 1;                         // Base CRC32
+    CHECK(applyAll(img, wrongBase) == Status::BaseMismatch);
+
+    Bytes outOfRange = good;
+    outOfRange.push_back((uint8_t)DeltaPatch::Op::Copy);
+    u32(outOfRange, 4999);
+    varint(outOfRange, 10);
+    CHECK(applyAll(img, outOfRange) == Status::OutOfRange);
+
+    Bytes badOp = good;
+    badOp.push_back(9);
+    CHECK(applyAll(img, badOp) == Status::BadOp);
+
+    Bytes badMagic = good;
+    badMagic[0] = 'X';
+    CHECK(applyAll(img, badMagic) == Status::BadHeader);
+}
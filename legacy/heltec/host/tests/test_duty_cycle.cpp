@@ -0,0 +1,149 @@
+#include "test.h"
+#include "lib/duty_cycle.h"
+#include "lib/core_system.h"
+#include "lib/radio_task.h"
+#include "sim_radio.h"
+#include <Arduino.h>
+#include <RadioLib.h>
+#include <heltec_unofficial.h>
+
+static PowerConfig power() {
+    PowerConfig p;
+    p.deepSleepEnabled = true;
+    p.maxAwakeMs = 30000;
+    p.buttonAwakeMs = 20000;
+    return p;
+}
+
+TEST(duty_cycle_sleeps_when_idle) {
+    DutyCycle d;
+    d.begin(PowerConfig{}, 60000, false);
+    CHECK_EQ(d.sleepMs(5000, 0), 0u);               // Disabled: never sleeps
+
+    d.begin(power(), 60000, false);
+    CHECK_EQ(d.sleepMs(5000, 0), 55000u);           // Rest of the interval
+    CHECK_EQ(d.sleepMs(59900, 0), DutyCycle::MIN_SLEEP_MS);
+    CHECK_EQ(d.sleepMs(90000, 0), DutyCycle::MIN_SLEEP_MS);
+    d.setInterval(300000);
+    CHECK_EQ(d.sleepMs(5000, 0), 295000u);
+}
+
+TEST(duty_cycle_holds_and_limits) {
+    DutyCycle d;
+    d.begin(power(), 60000, false);
+    CHECK_EQ(d.sleepMs(5000, DutyCycle::Radio), 0u);
+    CHECK_EQ(d.sleepMs(5000, DutyCycle::Joining | DutyCycle::Report), 0u);
+    CHECK_EQ(d.sleepMs(30000, DutyCycle::Joining), 30000u);    // Out of coverage: give up
+    CHECK_EQ(d.sleepMs(45000, DutyCycle::Ota), 0u);            // Transfers are never cut off
+
+    d.begin(power(), 60000, true);                  // Button wake keeps the display up
+    CHECK_EQ(d.sleepMs(5000, 0), 0u);
+    CHECK_EQ(d.sleepMs(20000, 0), 40000u);
+}
+
+// Deep sleep keeps only RTC memory: a wake builds a new radio state and node
+// and must come back with the session's ADR data rate and the last hour's
+// airtime, without a join
+TEST(duty_cycle_radio_state_survives_sleep) {
+    Sim::Network& net = Sim::Network::instance();
+    net.reset();
+    uint8_t key[16] = {0};
+    LoRaWANConfig config;
+    config.dataRate = 3;
+
+    auto boot = [&](RadioTaskState& state, TxScheduler& tx) {
+        state = RadioTaskState{};
+        tx.begin();
+        state.tx = &tx;
+        state.rxQueue = xQueueCreate(4, sizeof(LoRaWANRxMsg));
+        state.lorawanConfig = &config;
+        state.airtime.setBudget(config.airtimeBudgetMsPerHour);
+        state.node = new LoRaWANNode(&radio, &US915, 2);
+        CHECK_EQ(state.node->beginOTAA(0, 0, key, key), RADIOLIB_ERR_NONE);
+    };
+
+    RadioTaskState awake;
+    TxScheduler tx;
+    boot(awake, tx);
+    CHECK(radioTaskJoin(&awake, 2));        // Not the first attempt: a fresh join
+    CHECK(!awake.sessionRestored);
+    CHECK_EQ(awake.budget.dataRate, 3);
+
+    // ADR moves the node to DR1; the next uplink goes out on it
+    net.commandDataRate(1);
+    for (int i = 0; i < 2; i++) {
+        LoRaWANTxMsg msg = {};
+        msg.port = 2;
+        msg.len = 10;
+        tx.enqueue(TxClass::Telemetry, msg);
+        CHECK(radioTaskServiceTx(&awake, 0));
+        tx.complete();
+    }
+    CHECK_EQ(awake.budget.dataRate, 1);
+    uint32_t airtimeMs = awake.airtime.usedMs();
+    CHECK(airtimeMs > 0u);
+    delete awake.node;
+    vQueueDelete(awake.rxQueue);
+
+    Sim::advanceMs(5 * 60 * 1000);          // Asleep
+    uint32_t joins = net.joinAttempts();
+    RadioTaskState woken;
+    TxScheduler tx2;
+    boot(woken, tx2);
+    CHECK(radioTaskJoin(&woken, 1));
+    CHECK(woken.sessionRestored);
+    CHECK_EQ(net.joinAttempts(), joins);
+    CHECK_EQ(woken.budget.dataRate, 1);     // Not the configured DR3
+    CHECK_EQ(woken.node->dataRate(), 1);
+    CHECK_EQ(woken.airtime.usedMs(), airtimeMs);
+
+    // The window still ends an hour after the uplinks
+    woken.airtime.advance(CoreSystem::clockMs() + 3600 * 1000);
+    CHECK_EQ(woken.airtime.usedMs(), 0u);
+    delete woken.node;
+    vQueueDelete(woken.rxQueue);
+}
+
+TEST(duty_cycle_budget_follows_adr_downgrade) {
+    Sim::Network& net = Sim::Network::instance();
+    net.reset();
+    uint8_t key[16] = {0};
+    LoRaWANConfig config;
+    config.dataRate = 3;
+
+    RadioTaskState state;
+    TxScheduler tx;
+    tx.begin();
+    state.tx = &tx;
+    state.rxQueue = xQueueCreate(4, sizeof(LoRaWANRxMsg));
+    state.lorawanConfig = &config;
+    state.node = new LoRaWANNode(&radio, &US915, 2);
+    CHECK_EQ(state.node->beginOTAA(0, 0, key, key), RADIOLIB_ERR_NONE);
+    CHECK(radioTaskJoin(&state, 2));
+    CHECK_EQ(state.budget.maxPayload(), 222);
+
+    auto send = [&](uint8_t len) {
+        LoRaWANTxMsg msg = {};
+        msg.port = 2;
+        msg.len = len;
+        tx.enqueue(TxClass::Telemetry, msg);
+        CHECK(radioTaskServiceTx(&state, 0));
+        return state.lastTxSent;
+    };
+
+    // The downlink of this uplink moves the node to DR1; the budget has to
+    // shrink before the next frame is built, not one uplink later
+    net.commandDataRate(1);
+    CHECK(send(100));
+    CHECK_EQ(state.node->dataRate(), 1);
+    CHECK_EQ(state.budget.dataRate, 1);
+    CHECK_EQ(state.budget.maxPayload(), 53);
+
+    // A frame sized from the budget goes out on DR1
+    uint32_t sent = state.txCompleteCount;
+    CHECK(send(state.budget.maxPayload()));
+    CHECK_EQ(state.txCompleteCount, sent + 1);
+    CHECK_EQ(state.budget.dataRate, 1);
+    delete state.node;
+    vQueueDelete(state.rxQueue);
+}
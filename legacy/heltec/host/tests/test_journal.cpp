@@ -0,0 +1,247 @@
+#include "test.h"
+#include "persistence_helpers.h"
+#include "lib/flash_journal.h"
+#include "sim.h"
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// NOR flash in RAM with per-sector erase counts; writeBudget cuts power
+// after that many more bytes
+class RamFlash : public IFlashRegion {
+public:
+    explicit RamFlash(size_t sectors) : bytes(sectors * SECTOR_SIZE, 0xFF), erases(sectors, 0) {}
+
+    size_t size() const override { return bytes.size(); }
+    bool read(size_t offset, void* dst, size_t len) override {
+        if (offset + len > bytes.size()) return false;
+        memcpy(dst, bytes.data() + offset, len);
+        return true;
+    }
+    bool write(size_t offset, const void* src, size_t len) override {
+        if (offset + len > bytes.size()) return false;
+        for (size_t i = 0; i < len; i++) {
+            if (writeBudget == 0) return false;
+            if (writeBudget > 0) writeBudget--;
+            bytes[offset + i] &= ((const uint8_t*)src)[i];
+        }
+        return true;
+    }
+    bool eraseSector(size_t offset) override {
+        if (offset % SECTOR_SIZE) return false;
+        memset(bytes.data() + offset, 0xFF, SECTOR_SIZE);
+        erases[offset / SECTOR_SIZE]++;
+        return true;
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> erases;
+    long writeBudget = -1;
+};
+
+static uint32_t getU32(FlashJournal& j, const char* key) {
+    uint32_t v = 0;
+    return j.get(key, FlashJournal::Type::U32, &v, sizeof(v)) == sizeof(v) ? v : 0xFFFFFFFF;
+}
+
+TEST(journal_replays_latest_values) {
+    RamFlash flash(4);
+    {
+        FlashJournal j;
+        CHECK(j.begin(&flash));
+        uint32_t v = 1;
+        CHECK(j.put("app_state/ec_na", FlashJournal::Type::U32, &v, sizeof(v)));
+        v = 7;
+        CHECK(j.put("app_state/ec_na", FlashJournal::Type::U32, &v, sizeof(v)));
+        const uint8_t blob[] = {1, 2, 3, 4, 5};
+        CHECK(j.put("rules/data", FlashJournal::Type::Bytes, blob, sizeof(blob)));
+
+        // Rewriting the current value appends nothing
+        uint32_t written = j.recordsWritten();
+        CHECK(j.put("app_state/ec_na", FlashJournal::Type::U32, &v, sizeof(v)));
+        CHECK_EQ(j.recordsWritten(), written);
+    }
+
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    CHECK_EQ(getU32(j, "app_state/ec_na"), 7u);
+    uint8_t blob[8];
+    CHECK_EQ(j.get("rules/data", FlashJournal::Type::Bytes, blob, sizeof(blob)), 5u);
+    CHECK_EQ(blob[4], 5);
+
+    // Wrong type, unknown key or short buffer read as absent
+    CHECK_EQ(j.get("rules/data", FlashJournal::Type::U32, blob, sizeof(blob)), 0u);
+    CHECK_EQ(j.valueLength("rules/nope", FlashJournal::Type::Bytes), -1);
+    CHECK_EQ(j.get("rules/data", FlashJournal::Type::Bytes, blob, 4), 0u);
+}
+
+TEST(journal_compaction_levels_wear) {
+    RamFlash flash(8);
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    const uint8_t blob[200] = {0x5A};
+    CHECK(j.put("rules/data", FlashJournal::Type::Bytes, blob, sizeof(blob)));
+
+    const uint32_t writes = 20000;
+    for (uint32_t i = 1; i <= writes; i++) {
+        CHECK(j.put("app_state/ec_na", FlashJournal::Type::U32, &i, sizeof(i)));
+    }
+    CHECK_EQ(j.recordsWritten(), writes + 1);
+
+    // Each erase absorbs a sector's worth of 24-byte records, spread over the ring
+    CHECK(j.sectorErases() < writes / 100);
+    uint32_t lo = flash.erases[0], hi = flash.erases[0];
+    for (uint32_t e : flash.erases) {
+        lo = e < lo ? e : lo;
+        hi = e > hi ? e : hi;
+    }
+    CHECK(hi - lo <= 1);
+
+    FlashJournal after;
+    CHECK(after.begin(&flash));
+    CHECK_EQ(getU32(after, "app_state/ec_na"), writes);
+    uint8_t back[200];
+    CHECK_EQ(after.get("rules/data", FlashJournal::Type::Bytes, back, sizeof(back)), sizeof(back));
+    CHECK_EQ(back[0], 0x5A);
+}
+
+TEST(journal_survives_torn_writes) {
+    // Power cut at every byte of one update, the sector open it causes, the
+    // compaction of the oldest sector and the next record
+    for (long cut = 0; cut < 1000; cut++) {
+        RamFlash flash(3);
+        FlashJournal j;
+        CHECK(j.begin(&flash));
+        const uint8_t big[1000] = {0};
+        uint32_t keep = 9, v = 1;
+        CHECK(j.put("a/big", FlashJournal::Type::Bytes, big, sizeof(big)));
+        CHECK(j.put("a/keep", FlashJournal::Type::U32, &keep, sizeof(keep)));
+        CHECK(j.put("a/n", FlashJournal::Type::U32, &v, sizeof(v)));
+        for (int i = 0; i < 7; i++) CHECK(j.put("a/big", FlashJournal::Type::Bytes, big + i + 1, sizeof(big) - i - 1));
+
+        flash.writeBudget = cut;
+        v = 2;
+        j.put("a/n", FlashJournal::Type::U32, &v, sizeof(v));
+        j.put("a/big", FlashJournal::Type::Bytes, big, 900);
+        flash.writeBudget = -1;
+
+        FlashJournal after;
+        CHECK(after.begin(&flash));
+        uint32_t n = getU32(after, "a/n");
+        CHECK(n == 1 || n == 2);
+        CHECK_EQ(getU32(after, "a/keep"), 9u);
+        int32_t len = after.valueLength("a/big", FlashJournal::Type::Bytes);
+        CHECK(len == 993 || len == 900);
+
+        // And the journal keeps working
+        v = 3;
+        CHECK(after.put("a/n", FlashJournal::Type::U32, &v, sizeof(v)));
+        FlashJournal again;
+        CHECK(again.begin(&flash));
+        CHECK_EQ(getU32(again, "a/n"), 3u);
+        CHECK_EQ(getU32(again, "a/keep"), 9u);
+    }
+}
+
+TEST(journal_rejects_what_it_cannot_hold) {
+    RamFlash flash(3);
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    static uint8_t blob[4096] = {0};
+    CHECK(!j.put("a/huge", FlashJournal::Type::Bytes, blob, sizeof(blob)));   // Over a sector
+    CHECK(j.put("a/ok", FlashJournal::Type::Bytes, blob, 2000));
+    CHECK(!j.put("a/more", FlashJournal::Type::Bytes, blob, 2500));           // Over half the ring
+    CHECK(!j.put("a/key_longer_than_thirty_one_chars", FlashJournal::Type::U32, blob, 4));
+
+    RamFlash tiny(2);
+    FlashJournal none;
+    CHECK(!none.begin(&tiny));
+}
+
+TEST(journal_hal_reads_through_to_nvs) {
+    Sim::clearNvs();
+    FlashPersistenceHal nvs;
+    nvs.begin("app_state");
+    nvs.saveU32("ec_na", 42);
+    nvs.saveString("name", "pump");
+    nvs.end();
+
+    RamFlash flash(4);
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    JournalPersistenceHal hal(j, &nvs);
+    CHECK(hal.begin("app_state"));
+    CHECK_EQ(hal.loadU32("ec_na", 0), 42u);        // Written before the journal
+    CHECK(hal.loadString("name") == "pump");
+    CHECK(hal.saveU32("ec_na", 43));
+    CHECK(hal.saveString("name", ""));
+    CHECK_EQ(hal.loadU32("ec_na", 0), 43u);
+    CHECK(hal.loadString("name", "x") == "");
+    CHECK_EQ(hal.loadU32("ec_jf", 5), 5u);
+    hal.end();
+
+    // Writes went to the journal only
+    nvs.begin("app_state");
+    CHECK_EQ(nvs.loadU32("ec_na", 0), 42u);
+    nvs.end();
+    CHECK(!hal.begin("namespace_too_long"));
+}
+
+TEST(journal_hal_opens_nvs_only_for_missing_keys) {
+    MemoryPersistence nvs;
+    nvs.saveU32("old", 7);
+    nvs.opens = 0;
+
+    RamFlash flash(4);
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    JournalPersistenceHal hal(j, &nvs);
+    CHECK(hal.begin("app_state"));
+    CHECK(hal.saveU32("new", 1));
+    CHECK_EQ(hal.loadU32("new", 0), 1u);
+    CHECK_EQ(nvs.opens, 0);                          // Everything came from the journal
+
+    CHECK_EQ(hal.loadU32("old", 0), 7u);
+    CHECK_EQ(hal.loadU32("gone", 3), 3u);
+    CHECK_EQ(nvs.opens, 1);                          // Opened once, read-only
+    CHECK(nvs.readOnly);
+    hal.end();
+
+    CHECK(hal.begin("app_state"));
+    CHECK_EQ(hal.loadU32("new", 0), 1u);
+    CHECK_EQ(nvs.opens, 1);
+    hal.end();
+}
+
+TEST(journal_hal_sessions_keep_their_namespace) {
+    // The loop task and the timer daemon share one HAL: each session's
+    // writes must land under its own namespace
+    Sim::setClockScaled();   // Two real threads, so begin() has to block
+    RamFlash flash(8);
+    FlashJournal j;
+    CHECK(j.begin(&flash));
+    JournalPersistenceHal hal(j, nullptr);
+
+    auto writer = [&hal](const char* ns, const char* key) {
+        for (uint32_t i = 1; i <= 2000; i++) {
+            CHECK(hal.begin(ns));
+            CHECK(hal.saveU32(key, i));
+            std::this_thread::yield();                  // The other task runs mid-session
+            CHECK(hal.saveU32("seq", i));
+            hal.end();
+        }
+    };
+    std::thread timer(writer, "rules", "only_rules");
+    writer("app_state", "only_app");
+    timer.join();
+
+    CHECK_EQ(j.valueLength("rules/only_app", FlashJournal::Type::U32), -1);
+    CHECK_EQ(j.valueLength("app_state/only_rules", FlashJournal::Type::U32), -1);
+    CHECK(hal.begin("rules"));
+    CHECK_EQ(hal.loadU32("only_rules", 0), 2000u);
+    CHECK_EQ(hal.loadU32("seq", 0), 2000u);
+    CHECK(hal.begin("app_state"));                  // Same task: switches namespace
+    CHECK_EQ(hal.loadU32("only_app", 0), 2000u);
+    hal.end();
+    hal.end();                                      // Without a session: ignored
+}
@@ -0,0 +1,51 @@
+#include "test.h"
+#include "ota_helpers.h"
+#include "lib/lzss_decoder.h"
+
+using OtaTest::Bytes;
+
+static bool collect(void* ctx, const uint8_t* data, size_t len) {
+    Bytes* out = (Bytes*)ctx;
+    out->insert(out->end(), data, data + len);
+    return true;
+}
+
+TEST(lzss_roundtrip_any_split) {
+    Bytes raw = OtaTest::randomImage(12000, 5);
+    const uint8_t params[][2] = {{8, 4}, {10, 5}, {4, 3}, {9, 8}};
+    std::mt19937 rng(1);
+    static Lzss::Decoder decoder;
+    for (auto& p : params) {
+        Bytes stream = OtaTest::lzssEncode(raw, p[0], p[1]);
+        for (int trial = 0; trial < 4; trial++) {
+            Bytes out;
+            CHECK(decoder.begin(Lzss::packParams(p[0], p[1]), collect, &out));
+            for (size_t i = 0; i < stream.size();) {
+                size_t n = std::min<size_t>(stream.size() - i, 1 + rng() % (trial ? 300 : 3));
+                CHECK(decoder.feed(&stream[i], n) == Lzss::Status::Ok);
+                i += n;
+            }
+            CHECK(out == raw);
+        }
+    }
+}
+
+TEST(lzss_rejects_unsupported_params) {
+    Lzss::Decoder decoder;
+    Bytes out;
+    CHECK(!decoder.begin(Lzss::MAX_WINDOW_BITS + 1, 4, collect, &out));
+    CHECK(!decoder.begin(8, Lzss::MIN_LOOKAHEAD_BITS - 1, collect, &out));
+    CHECK(decoder.feed((const uint8_t*)"x", 1) == Lzss::Status::BadParams);
+}
+
+TEST(lzss_random_input_is_memory_safe) {
+    std::mt19937 rng(9);
+    static Lzss::Decoder decoder;
+    for (int t = 0; t < 5000; t++) {
+        Bytes in(rng() % 500), out;
+        for (auto& b : in) b = (uint8_t)rng();
+        decoder.begin(Lzss::MIN_WINDOW_BITS + rng() % 7, 3, collect, &out);
+        decoder.feed(in.data(), in.size());
+        CHECK(out.size() <= in.size() * 8 * 8);
+    }
+}
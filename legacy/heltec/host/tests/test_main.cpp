@@ -0,0 +1,64 @@
+#include "test.h"
+#include <Arduino.h>
+#include <Update.h>
+#include "sim_radio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace HostTest {
+
+namespace {
+int g_caseFailures = 0;
+} // namespace
+
+std::vector<Case>& registry() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void fail(const char* file, int line, const char* expr) {
+    g_caseFailures++;
+    fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", file, line, expr);
+}
+
+std::string tempPath(const char* name) {
+    const char* dir = getenv("TMPDIR");
+    if (!dir || !*dir) dir = "/tmp";
+    return std::string(dir) + "/host_tests_" + std::to_string(getpid()) + "_" + name;
+}
+
+} // namespace HostTest
+
+static void resetSim() {
+    Sim::setClockManual(0);
+    Sim::clearNvs();
+    Sim::resetUpdate();
+    Sim::runningImage().clear();
+    Sim::Network::instance().reset();
+    Sim::setRestartHook([] {});
+}
+
+/** host_tests [-v] [name-filter] */
+int main(int argc, char** argv) {
+    bool verbose = false;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) verbose = true;
+        else filter = argv[i];
+    }
+    Serial.setMuted(!verbose);
+
+    int run = 0, failed = 0;
+    for (const HostTest::Case& c : HostTest::registry()) {
+        if (filter && !strstr(c.name, filter)) continue;
+        resetSim();
+        HostTest::g_caseFailures = 0;
+        c.fn();
+        run++;
+        if (HostTest::g_caseFailures) failed++;
+        printf("%s %s\n", HostTest::g_caseFailures ? "FAIL" : "ok  ", c.name);
+    }
+    printf("%d/%d tests passed\n", run - failed, run);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+#include "test.h"
+#include "ota_helpers.h"
+#include "lib/radio_task.h"
+#include "lib/protocol_constants.h"
+#include "lib/delta_patch.h"
+#include "lib/lzss_decoder.h"
+#include "sim_radio.h"
+#include <Arduino.h>
+#include <RadioLib.h>
+#include <Update.h>
+#include <heltec_unofficial.h>
+
+using namespace OtaTest;
+using OtaReceiver::State;
+
+namespace {
+
+// Window status from the device: base and staged bitmap
+struct WindowStatus {
+    uint16_t base = 0;
+    uint16_t staged = 0;
+    bool seen = false;
+};
+
+void readProgress(TxScheduler& tx, WindowStatus* status) {
+    LoRaWANTxMsg msg;
+    TxClass cls;
+    while (tx.dequeue(&msg, &cls, 0)) {
+        if (msg.port != FPORT_OTA_PROGRESS || msg.payload[0] != (uint8_t)OtaReceiver::ProgressStatus::Window) continue;
+        status->base = (uint16_t)(msg.payload[1] | (msg.payload[2] << 8));
+        status->staged = (uint16_t)(msg.payload[3] | (msg.payload[4] << 8));
+        status->seen = true;
+    }
+}
+
+/** Drive a windowed transfer directly, dropping lossPercent of the chunks. */
+uint32_t runWindowed(OtaReceiver::OtaReceiver& ota, TxScheduler& tx, const Bytes& stream,
+                     uint8_t lossPercent, uint32_t seed) {
+    std::mt19937 rng(seed);
+    uint16_t chunks = chunkCount(stream);
+    WindowStatus status;
+    uint32_t sent = 0;
+    while (ota.getState() == State::Receiving && sent < 20u * chunks) {
+        for (uint16_t i = status.base; i < chunks && i < status.base + OtaReceiver::OTA_WINDOW_SIZE; i++) {
+            if (i > status.base && (status.staged >> (i - status.base)) & 1) continue;
+            sent++;
+            if ((uint8_t)(rng() % 100) < lossPercent) continue;
+            Bytes f = chunkFrame(stream, i);
+            ota.handleDownlink(FPORT_OTA_CHUNK, f.data(), (uint8_t)f.size());
+            readProgress(tx, &status);
+            if (ota.getState() != State::Receiving) break;
+        }
+    }
+    return sent;
+}
+
+void start(OtaReceiver::OtaReceiver& ota, const Bytes& frame) {
+    ota.handleDownlink(FPORT_OTA_START, frame.data(), (uint8_t)frame.size());
+}
+
+} // namespace
+
+TEST(ota_windowed_recovers_from_chunk_loss) {
+    TxScheduler tx;
+    tx.begin();
+    OtaReceiver::OtaReceiver ota(&tx);
+    Bytes image = randomImage(200 * OtaReceiver::OTA_PAYLOAD_SIZE - 77, 7);
+
+    start(ota, startFrame(image, Crc::crc32(image.data(), image.size()), OtaReceiver::OTA_FLAG_WINDOWED));
+    CHECK(ota.getState() == State::Receiving);
+    uint32_t sent = runWindowed(ota, tx, image, 30, 11);
+
+    CHECK(ota.getState() == State::Rebooting);
+    CHECK(Sim::updateCommitted());
+    CHECK(Sim::updateImage() == image);
+    CHECK(sent < 3u * chunkCount(image));
+
+    uint32_t restarts = Sim::restartCount();
+    ota.tick(millis() + 1000);
+    CHECK_EQ(Sim::restartCount(), restarts + 1);
+}
+
+TEST(ota_compressed_image_rebuilds_exactly) {
+    TxScheduler tx;
+    tx.begin();
+    OtaReceiver::OtaReceiver ota(&tx);
+    Bytes image = randomImage(30000, 3);
+    Bytes stream = lzssEncode(image, 8, 4);
+    CHECK(stream.size() < image.size());
+
+    start(ota, startFrame(stream, Crc::crc32(image.data(), image.size()),
+                          OtaReceiver::OTA_FLAG_WINDOWED | OtaReceiver::OTA_FLAG_COMPRESSED,
+                          Lzss::packParams(8, 4)));
+    runWindowed(ota, tx, stream, 10, 5);
+
+    CHECK(ota.getState() == State::Rebooting);
+    CHECK(Sim::updateImage() == image);
+}
+
+TEST(ota_crc_mismatch_fails_without_reboot) {
+    TxScheduler tx;
+    tx.begin();
+    OtaReceiver::OtaReceiver ota(&tx);
+    Bytes image = randomImage(20000, 4);
+    Bytes stream = lzssEncode(image, 8, 4);
+    uint32_t wrongCrc = Crc::crc32(image.data(), image.size()) ^ 1;
+
+    start(ota, startFrame(stream, wrongCrc, OtaReceiver::OTA_FLAG_WINDOWED | OtaReceiver::OTA_FLAG_COMPRESSED,
+                          Lzss::packParams(8, 4)));
+    runWindowed(ota, tx, stream, 0, 1);
+
+    CHECK(ota.getState() == State::Failed);
+    CHECK(!Sim::updateCommitted());
+    uint32_t restarts = Sim::restartCount();
+    ota.tick(millis() + 10000);
+    CHECK_EQ(Sim::restartCount(), restarts);
+}
+
+TEST(ota_patch_applies_to_running_partition) {
+    TxScheduler tx;
+    tx.begin();
+    OtaReceiver::OtaReceiver ota(&tx);
+    Bytes base = randomImage(40000, 8);
+    Sim::runningImage() = base;
+
+    // New image: first half unchanged, 500 new bytes, then the old tail
+    Bytes image(base.begin(), base.begin() + 20000);
+    Bytes fresh = randomImage(500, 9);
+    image.insert(image.end(), fresh.begin(), fresh.end());
+    image.insert(image.end(), base.begin() + 25000, base.end());
+
+    Bytes patch = {DeltaPatch::MAGIC0, DeltaPatch::MAGIC1, DeltaPatch::VERSION, 0};
+    auto u32 = [&patch](uint32_t v) { for (int i = 0; i < 4; i++) patch.push_back((uint8_t)(v >> (8 * i))); };
+    auto varint = [&patch](uint32_t v) {
+        while (v >= 0x80) { patch.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+        patch.push_back((uint8_t)v);
+    };
+    u32((uint32_t)base.size());
+    u32(Crc::crc32(base.data(), base.size()));
+    u32((uint32_t)image.size());
+    patch.push_back((uint8_t)DeltaPatch::Op::Copy); u32(0); varint(20000);
+    patch.push_back((uint8_t)DeltaPatch::Op::Insert); varint((uint32_t)fresh.size());
+    patch.insert(patch.end(), fresh.begin(), fresh.end());
+    patch.push_back((uint8_t)DeltaPatch::Op::Copy); u32(25000); varint((uint32_t)(base.size() - 25000));
+
+    start(ota, startFrame(patch, Crc::crc32(image.data(), image.size()),
+                          OtaReceiver::OTA_FLAG_WINDOWED | OtaReceiver::OTA_FLAG_PATCH));
+    runWindowed(ota, tx, patch, 0, 1);
+
+    CHECK(ota.getState() == State::Rebooting);
+    CHECK(Sim::updateImage() == image);
+}
+
+// Full path: OTA progress rides real uplinks through the radio task's TX cycle
+// and chunks come back in Class A RX windows of the simulated network.
+TEST(ota_over_simulated_network) {
+    Sim::Network& net = Sim::Network::instance();
+    net.setUplinkLoss(10);
+    net.setDownlinkLoss(10);
+
+    RadioTaskState state = {};
+    TxScheduler tx;
+    tx.begin();
+    state.tx = &tx;
+    state.rxQueue = xQueueCreate(4, sizeof(LoRaWANRxMsg));
+    state.node = new LoRaWANNode(&radio, &US915, 2);
+    uint8_t key[16] = {0};
+    CHECK_EQ(state.node->beginOTAA(0, 0, key, key), RADIOLIB_ERR_NONE);
+    CHECK_EQ(state.node->activateOTAA(), RADIOLIB_LORAWAN_NEW_SESSION);
+    state.node->setDatarate(3);
+    state.budget.update(LoRaWANRegion::US915, 3);
+    state.joined = true;
+
+    OtaReceiver::OtaReceiver ota(&tx);
+    Bytes image = randomImage(60 * OtaReceiver::OTA_PAYLOAD_SIZE, 21);
+    uint16_t chunks = chunkCount(image);
+    Bytes startMsg = startFrame(image, Crc::crc32(image.data(), image.size()), OtaReceiver::OTA_FLAG_WINDOWED);
+
+    // Network server: one downlink per RX window, next missing chunk first
+    WindowStatus status;
+    uint16_t cursor = 0;
+    bool started = false;
+    net.onUplink([&](const Sim::Uplink& up) {
+        if (up.port == FPORT_OTA_PROGRESS && up.payload[0] == (uint8_t)OtaReceiver::ProgressStatus::Window) {
+            status.base = (uint16_t)(up.payload[1] | (up.payload[2] << 8));
+            status.staged = (uint16_t)(up.payload[3] | (up.payload[4] << 8));
+            if (cursor < status.base) cursor = status.base;
+        }
+        if (net.pendingDownlinks() > 0) return;
+        if (!started) {
+            net.queueDownlink(FPORT_OTA_START, startMsg);
+            return;
+        }
+        // Round-robin over the window, skipping chunks the device has staged
+        for (int tries = 0; tries < OtaReceiver::OTA_WINDOW_SIZE; tries++) {
+            uint16_t i = cursor;
+            cursor = (cursor + 1 >= std::min<int>(chunks, status.base + OtaReceiver::OTA_WINDOW_SIZE)) ? status.base : cursor + 1;
+            if (i >= chunks) continue;
+            if (i > status.base && (status.staged >> (i - status.base)) & 1) continue;
+            net.queueDownlink(FPORT_OTA_CHUNK, chunkFrame(image, i));
+            return;
+        }
+    });
+
+    uint32_t cycles = 0;
+    while (ota.getState() != State::Rebooting && cycles++ < 2000) {
+        // Periodic telemetry keeps RX windows open when OTA has nothing to say
+        if (tx.pendingTotal() == 0) {
+            LoRaWANTxMsg keepalive = {};
+            keepalive.port = 2;
+            keepalive.len = 4;
+            tx.enqueue(TxClass::Telemetry, keepalive);
+        }
+        radioTaskServiceTx(&state, 0);
+        LoRaWANRxMsg rx;
+        while (xQueueReceive(state.rxQueue, &rx, 0) == pdTRUE) {
+            if (rx.port == FPORT_OTA_START) started = true;
+            ota.handleDownlink(rx.port, rx.payload, rx.len);
+        }
+    }
+
+    CHECK(ota.getState() == State::Rebooting);
+    CHECK(Sim::updateImage() == image);
+    CHECK(cycles < 3u * chunks);
+    // Each TX cycle blocks for the RX windows in simulated time
+    CHECK(millis() >= cycles * 1000u);
+    delete state.node;
+}
@@ -0,0 +1,108 @@
+#include "test.h"
+#include "lib/persistent_record.h"
+#include "lib/error_reporter.h"
+#include "sim.h"
+#include "persistence_helpers.h"
+#include <atomic>
+#include <thread>
+
+using ErrorReporter::ErrorCounters;
+
+static void noAck(ErrorCounters& c) { c.increment(ErrorReporter::Category::Comm, ErrorReporter::Comm::NoAck); }
+
+TEST(record_writes_are_coalesced) {
+    Sim::clearNvs();
+    FlashPersistenceHal nvs;
+    PersistentRecord<ErrorCounters> errors("app_state", "errors", 1, 60000);
+    RecordWriter writer;
+    writer.begin(&nvs);
+    CHECK(writer.add(&errors));
+
+    // Clean records are never written
+    writer.tick(0);
+    CHECK_EQ(writer.writes(), 0u);
+
+    // A storm of errors: one write now, then at most one per interval
+    for (uint32_t ms = 0; ms < 150000; ms += 100) {
+        errors.update(noAck);
+        writer.tick(ms);
+    }
+    CHECK_EQ(writer.writes(), 3u);
+    CHECK(errors.dirty());
+
+    // Flush ignores the interval and writes the latest value
+    writer.flushAll(150000);
+    CHECK_EQ(writer.writes(), 4u);
+    CHECK(!errors.dirty());
+
+    PersistentRecord<ErrorCounters> after("app_state", "errors", 1, 60000);
+    CHECK(after.load(nvs));
+    CHECK_EQ(after.get().get(ErrorReporter::Category::Comm, ErrorReporter::Comm::NoAck), 1500u);
+    CHECK_EQ(after.get().total(), 1500u);
+}
+
+TEST(record_rejects_other_versions_and_corruption) {
+    Sim::clearNvs();
+    FlashPersistenceHal nvs;
+    PersistentRecord<ErrorCounters> errors("app_state", "errors", 1, 60000);
+    CHECK(!errors.load(nvs));     // Absent
+    errors.update([](ErrorCounters& c) {
+        c.increment(ErrorReporter::Category::Logic, ErrorReporter::Logic::Persistence);
+        c.lastResetMs = 1234;
+    });
+    CHECK(errors.save(nvs));
+
+    PersistentRecord<ErrorCounters> v2("app_state", "errors", 2, 60000);
+    CHECK(!v2.load(nvs));
+    CHECK_EQ(v2.get().total(), 0u);
+
+    uint8_t blob[PersistentRecord<ErrorCounters>::BLOB_SIZE];
+    nvs.begin("app_state");
+    CHECK_EQ(nvs.loadBytes("errors", blob, sizeof(blob)), sizeof(blob));
+    blob[5] ^= 0x01;
+    nvs.saveBytes("errors", blob, sizeof(blob));
+    nvs.end();
+    PersistentRecord<ErrorCounters> corrupt("app_state", "errors", 1, 60000);
+    CHECK(!corrupt.load(nvs));
+
+    // A daily reset clears the counters and moves the baseline; clear() keeps it
+    ErrorCounters c;
+    noAck(c);
+    c.clear();
+    CHECK_EQ(c.total(), 0u);
+    noAck(c);
+    c.reset(99);
+    CHECK_EQ(c.total(), 0u);
+    CHECK_EQ(c.lastResetMs, 99u);
+    c.increment(ErrorReporter::Category::Comm, 7);     // Unknown sub-code
+    CHECK_EQ(c.total(), 0u);
+}
+
+TEST(record_saves_never_split_an_update) {
+    struct Words {
+        uint32_t w[64];
+    };
+    Sim::setClockScaled();   // Two real threads, so the mutex has to block
+    MemoryPersistence nvs;
+    PersistentRecord<Words> words("app_state", "words", 1, 0);
+    std::atomic<bool> stop{false};
+
+    // Another task sets every word to the same count while this one saves
+    std::thread writer([&] {
+        for (uint32_t i = 1; !stop; i++) {
+            words.update([i](Words& v) {
+                for (uint32_t& w : v.w) w = i;
+            });
+        }
+    });
+    bool consistent = true;
+    for (int save = 0; save < 2000; save++) {
+        CHECK(words.save(nvs));
+        PersistentRecord<Words> copy("app_state", "words", 1, 0);
+        CHECK(copy.load(nvs));
+        for (uint32_t w : copy.get().w) consistent = consistent && w == copy.get().w[0];
+    }
+    stop = true;
+    writer.join();
+    CHECK(consistent);
+}
@@ -0,0 +1,82 @@
+#include "test.h"
+#include "lib/pulse_source.h"
+#include "lib/ulp_pulse_counter.h"
+#include "sim.h"
+#include <esp32s3/ulp.h>
+#include <string.h>
+
+using SensorConfig::PulseBackend;
+
+static void pulses(uint8_t pin, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        Sim::setPin(pin, 0);
+        Sim::setPin(pin, 1);
+    }
+}
+
+TEST(pulse_source_pcnt_counts_each_meter) {
+    Sim::setPin(4, 1);
+    Sim::setPin(5, 1);
+    auto a = PulseSource::open(PulseBackend::Pcnt, 4);
+    auto b = PulseSource::open(PulseBackend::Pcnt, 5);
+    CHECK(strcmp(a->name(), "pcnt") == 0);
+    CHECK(strcmp(b->name(), "pcnt") == 0);
+    CHECK(!a->countsInDeepSleep());
+
+    pulses(4, 10);
+    pulses(5, 3);
+    CHECK_EQ(a->take(), 10u);
+    CHECK_EQ(b->take(), 3u);
+    CHECK_EQ(a->take(), 0u);
+
+    // Past the 16-bit hardware limit the driver's accumulated count carries on
+    pulses(4, PcntPulseSource::HIGH_LIMIT + 1000);
+    CHECK_EQ(a->take(), (uint32_t)PcntPulseSource::HIGH_LIMIT + 1000);
+    pulses(4, 5);
+    CHECK_EQ(a->take(), 5u);
+}
+
+TEST(pulse_source_falls_back_to_isr) {
+    std::unique_ptr<IPulseSource> meters[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        Sim::setPin(10 + i, 1);
+        meters[i] = PulseSource::open(PulseBackend::Pcnt, 10 + i);
+        CHECK(strcmp(meters[i]->name(), "pcnt") == 0);
+    }
+
+    // Out of units: the ISR still counts, per meter
+    Sim::setPin(14, 1);
+    auto isr = PulseSource::open(PulseBackend::Pcnt, 14);
+    CHECK(strcmp(isr->name(), "isr") == 0);
+    pulses(14, 7);
+    pulses(10, 2);
+    CHECK_EQ(isr->take(), 7u);
+    CHECK_EQ(meters[0]->take(), 2u);
+    CHECK(IsrPulseSource::takeEdgeFlag());
+    CHECK(!IsrPulseSource::takeEdgeFlag());
+
+    // A released unit is free again
+    meters[3].reset();
+    CHECK(strcmp(PulseSource::open(PulseBackend::Pcnt, 13)->name(), "pcnt") == 0);
+}
+
+TEST(pulse_source_ulp_channels) {
+    memset(g_simRtcSlowMem, 0, sizeof(g_simRtcSlowMem));
+    {
+        auto a = PulseSource::open(PulseBackend::Ulp, 4);
+        auto b = PulseSource::open(PulseBackend::Ulp, 5);
+        CHECK(strcmp(a->name(), "ulp") == 0);
+        CHECK(strcmp(b->name(), "ulp") == 0);
+        CHECK(b->countsInDeepSleep());
+
+        // Two channels per program; not an RTC GPIO either way
+        CHECK(strcmp(PulseSource::open(PulseBackend::Ulp, 6)->name(), "isr") == 0);
+        CHECK(strcmp(PulseSource::open(PulseBackend::Ulp, 40)->name(), "isr") == 0);
+    }
+
+    // After a wake the program still owns both pins: no new channel needed
+    UlpPulseCounter resumed;
+    CHECK(resumed.begin(5));
+    CHECK(resumed.running());
+    CHECK_EQ(resumed.take(), 0u);
+}
@@ -0,0 +1,117 @@
+#include "test.h"
+#include "lib/registration_manager.h"
+#include "devices/remote/device_config.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Runs one registration sequence through the radio at dr and rebuilds the
+// five parts the way the server does
+static std::vector<std::string> registerAt(uint8_t dr, size_t* frames) {
+    TxScheduler tx;
+    tx.begin();
+    PayloadBudget budget;
+    budget.update(LoRaWANRegion::US915, dr);
+    RegistrationManager reg;
+    reg.setTxScheduler(&tx);
+    reg.setRegistrationText(DEVICE_REGISTRATION);
+    reg.setDeviceInfo("water_monitor", "2.0.0");
+    reg.setPayloadBudget(&budget);
+    reg.onJoin();
+
+    static const char KEYS[] = "hfstc";
+    std::vector<std::string> parts(5);
+    std::string chunks;
+    int nextIndex = 0;
+    *frames = 0;
+    LoRaWANTxMsg m;
+    TxClass cls;
+    for (uint32_t nowMs = 0; nowMs < 1000000; nowMs += 1000) {
+        reg.tick(nowMs);
+        CHECK(tx.pending(TxClass::Registration) <= RegistrationManager::REG_WINDOW);
+        if (!tx.dequeue(&m, &cls, 0)) {
+            if (!reg.sending()) break;
+            continue;
+        }
+        tx.complete();
+        (*frames)++;
+        CHECK(m.len <= budget.maxPayload());
+        CHECK_EQ(m.port, FPORT_REGISTRATION);
+        std::string frame((const char*)m.payload, m.len);
+        if (frame[0] == '~') {
+            const char* key = strchr(KEYS, tolower(frame[1]));
+            CHECK(key != nullptr);
+            if (!key) continue;
+            CHECK_EQ(frame[2] - '0', nextIndex);
+            chunks += frame.substr(3);
+            nextIndex++;
+            if (isupper((unsigned char)frame[1])) {
+                parts[key - KEYS] = chunks;
+                chunks.clear();
+                nextIndex = 0;
+            }
+        } else {
+            static const char* const NAMES[] = {"header", "fields", "sys", "states", "cmds"};
+            size_t bar = frame.find('|');
+            CHECK(frame.compare(0, 4, "reg:") == 0);
+            for (int i = 0; i < 5; i++) {
+                if (frame.compare(4, bar - 4, NAMES[i]) == 0) parts[i] = frame.substr(bar + 1);
+            }
+        }
+    }
+    CHECK(!reg.sending());
+    CHECK_EQ(reg.getState(), RegistrationManager::State::Sent);
+    CHECK_EQ(reg.framesQueued(), (uint32_t)*frames);
+    reg.onRegAck();
+    CHECK_EQ(reg.getState(), RegistrationManager::State::Complete);
+    return parts;
+}
+
+static void checkParts(const std::vector<std::string>& parts) {
+    CHECK_EQ(parts[0], std::string("v=") + "1|sv=" + std::to_string(DEVICE_REGISTRATION.version) +
+                       "|type=water_monitor|fw=2.0.0");
+    CHECK_EQ(parts[1], std::string(DEVICE_REGISTRATION.fields));
+    CHECK_EQ(parts[2], std::string(DEVICE_REGISTRATION.sys));
+    CHECK_EQ(parts[3], std::string(DEVICE_REGISTRATION.states));
+    CHECK(parts[4].compare(0, 5, "cmds=") == 0);
+}
+
+TEST(registration_fits_dr0) {
+    size_t frames = 0;
+    std::vector<std::string> parts = registerAt(0, &frames);
+    checkParts(parts);
+    CHECK(frames > TxScheduler::CONFIG[(uint8_t)TxClass::Registration].depth);   // More than the class holds
+}
+
+TEST(registration_fits_dr1) {
+    size_t frames = 0;
+    std::vector<std::string> parts = registerAt(1, &frames);
+    checkParts(parts);
+    CHECK(frames > 5);
+}
+
+TEST(registration_single_frames_at_high_dr) {
+    size_t frames = 0;
+    std::vector<std::string> parts = registerAt(3, &frames);
+    checkParts(parts);
+    CHECK_EQ(frames, (size_t)5);
+}
+
+TEST(registration_ack_ends_a_sequence_in_progress) {
+    TxScheduler tx;
+    tx.begin();
+    PayloadBudget budget;
+    budget.update(LoRaWANRegion::US915, 0);
+    RegistrationManager reg;
+    reg.setTxScheduler(&tx);
+    reg.setRegistrationText(DEVICE_REGISTRATION);
+    reg.setPayloadBudget(&budget);
+    reg.onJoin();
+    reg.tick(0);
+    CHECK(reg.sending());
+    CHECK(tx.pending(TxClass::Registration) > 0);
+    reg.onRegAck();
+    CHECK(!reg.sending());
+    CHECK_EQ(tx.pending(TxClass::Registration), 0);
+    CHECK_EQ(reg.getState(), RegistrationManager::State::Complete);
+}
@@ -0,0 +1,521 @@
+#include "test.h"
+#include "persistence_helpers.h"
+#include "lib/edge_rules.h"
+#include "devices/remote/device_config.h"
+#include "sim.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace EdgeRules;
+
+static constexpr uint8_t LEVEL = 2;   // bp stands in for a tank level
+static constexpr uint8_t PUMP = 0;
+static constexpr uint8_t OFF = 0, ON = 1;
+
+static EdgeRule makeRule(uint8_t id, RuleOperator op, float threshold, uint8_t state) {
+    EdgeRule rule = {};
+    rule.id = id;
+    rule.enabled = true;
+    rule.op = op;
+    rule.field_idx = LEVEL;
+    rule.threshold = threshold;
+    rule.control_idx = PUMP;
+    rule.action_state = state;
+    rule.release_state = NO_RELEASE;
+    return rule;
+}
+
+static bool add(EdgeRulesEngine& engine, const EdgeRule& rule) {
+    uint8_t buf[EdgeRule::SIZE];
+    return engine.addOrUpdateRule(buf, rule.toBinary(buf, sizeof(buf)));
+}
+
+static uint8_t feed(EdgeRulesEngine& engine, float level, uint32_t now_ms) {
+    float values[MessageSchema::MAX_FIELDS];
+    for (float& v : values) v = NAN;
+    values[LEVEL] = level;
+    engine.evaluate(values, buildDeviceSchema().field_count, now_ms);
+    return engine.getControlState(PUMP).current_state;
+}
+
+TEST(rules_hysteresis_refills_between_bands) {
+    // Pump on below 80, off again only above 90
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule refill = makeRule(1, RuleOperator::LT, 80, ON);
+    refill.hysteresis = 10;
+    refill.release_state = OFF;
+    CHECK(add(engine, refill));
+
+    uint32_t t = 1000;
+    CHECK_EQ(feed(engine, 85, t += 1000), OFF);
+    CHECK_EQ(feed(engine, 79, t += 1000), ON);
+    CHECK_EQ(feed(engine, 82, t += 1000), ON);   // Inside the band: no chatter
+    CHECK_EQ(feed(engine, 89, t += 1000), ON);
+    CHECK_EQ(feed(engine, 91, t += 1000), OFF);  // Cleared the band: released
+    CHECK_EQ(feed(engine, 85, t += 1000), OFF);
+    CHECK_EQ(feed(engine, 79, t += 1000), ON);
+}
+
+TEST(rules_keep_band_state_across_rule_changes) {
+    // Refill engaged mid-band; unrelated rules come and go around it
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule other = makeRule(5, RuleOperator::GT, 1000, ON);
+    other.control_idx = 1;
+    CHECK(add(engine, other));
+    EdgeRule refill = makeRule(2, RuleOperator::LT, 80, ON);
+    refill.hysteresis = 10;
+    refill.release_state = OFF;
+    CHECK(add(engine, refill));
+
+    uint32_t t = 1000;
+    CHECK_EQ(feed(engine, 79, t += 1000), ON);
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    other.id = 9;
+    CHECK(add(engine, other));                  // Added after it
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    CHECK_EQ(feed(engine, 95, t += 1000), OFF); // Release still fires
+
+    CHECK_EQ(feed(engine, 79, t += 1000), ON);
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    CHECK(engine.deleteRule(5));                // Refill moves down a slot
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    CHECK_EQ(feed(engine, 95, t += 1000), OFF);
+
+    // Replacing the rule itself starts it over: no longer engaged, so the
+    // pump keeps its state until the new rule fires and then releases
+    CHECK_EQ(feed(engine, 79, t += 1000), ON);
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    refill.threshold = 82;
+    CHECK(add(engine, refill));
+    CHECK_EQ(feed(engine, 85, t += 1000), ON);
+    CHECK_EQ(feed(engine, 81, t += 1000), ON);
+    CHECK_EQ(feed(engine, 93, t += 1000), OFF);
+}
+
+TEST(rules_dwell_in_seconds_and_samples) {
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule seconds = makeRule(1, RuleOperator::LT, 80, ON);
+    seconds.dwell = 3;
+    seconds.release_state = OFF;
+    CHECK(add(engine, seconds));
+
+    // A dip shorter than the dwell never reaches the pump
+    CHECK_EQ(feed(engine, 70, 1000), OFF);
+    CHECK_EQ(feed(engine, 70, 2000), OFF);
+    CHECK_EQ(feed(engine, 85, 3000), OFF);
+    CHECK_EQ(feed(engine, 70, 4000), OFF);
+    CHECK_EQ(feed(engine, 70, 6000), OFF);
+    CHECK_EQ(feed(engine, 70, 7000), ON);       // Held for 3 s, value unchanged
+    CHECK_EQ(feed(engine, 85, 8000), OFF);
+
+    EdgeRulesEngine counted(buildDeviceSchema(), nullptr);
+    EdgeRule samples = makeRule(1, RuleOperator::GT, 50, ON);
+    samples.dwell = 3;
+    samples.dwell_samples = true;
+    CHECK(add(counted, samples));
+    CHECK_EQ(feed(counted, 60, 1000), OFF);
+    CHECK_EQ(feed(counted, 61, 1001), OFF);
+    CHECK_EQ(feed(counted, 62, 1002), ON);      // Third sample in a row
+}
+
+TEST(rules_rate_of_change) {
+    // Level falling faster than 2 units/s: leak, close everything
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule leak = makeRule(1, RuleOperator::RATE_LT, -2, ON);
+    leak.release_state = OFF;
+    CHECK(add(engine, leak));
+
+    CHECK_EQ(feed(engine, 90, 1000), OFF);      // No previous sample yet
+    CHECK_EQ(feed(engine, 89, 2000), OFF);      // -1/s
+    CHECK_EQ(feed(engine, 89, 2000), OFF);      // Same instant: ignored
+    CHECK_EQ(feed(engine, 83, 4000), ON);       // -3/s
+    CHECK_EQ(feed(engine, 83, 5000), OFF);      // Flat again (value unchanged)
+
+    EdgeRulesEngine rising(buildDeviceSchema(), nullptr);
+    CHECK(add(rising, makeRule(1, RuleOperator::RATE_GT, 5, ON)));
+    CHECK_EQ(feed(rising, 10, 0), OFF);
+    CHECK_EQ(feed(rising, 13, 500), ON);        // +6/s
+}
+
+TEST(rules_original_format_and_persistence) {
+    // 12-byte rule from a server that predates the extension
+    uint8_t v1[EdgeRule::BASE_SIZE] = {7, 0x80 | (uint8_t)((uint8_t)RuleOperator::GT << 4), LEVEL,
+                                       0, 0, 0, 0, PUMP, ON, 0, 0, 1};
+    float threshold = 50;
+    memcpy(v1 + 3, &threshold, sizeof(threshold));
+    EdgeRule parsed;
+    CHECK(parsed.fromBinary(v1, sizeof(v1)));
+    CHECK_EQ(parsed.hysteresis, 0.0f);
+    CHECK_EQ(parsed.dwell, 0);
+    CHECK_EQ(parsed.release_state, NO_RELEASE);
+
+    MemoryPersistence nvs;
+    EdgeRulesEngine engine(buildDeviceSchema(), &nvs);
+    CHECK(engine.addOrUpdateRule(v1, sizeof(v1)));
+    EdgeRule refill = makeRule(8, RuleOperator::LT, 80, ON);
+    refill.hysteresis = 10;
+    refill.dwell = 30;
+    refill.release_state = OFF;
+    CHECK(add(engine, refill));
+    engine.saveToFlash();
+
+    EdgeRulesEngine reloaded(buildDeviceSchema(), &nvs);
+    reloaded.loadFromFlash();
+    CHECK_EQ(reloaded.getRuleCount(), 2);
+    CHECK_EQ(feed(reloaded, 60, 1000), ON);     // The v1 rule still fires
+
+    // A release state the control does not have is rejected
+    EdgeRule bad = makeRule(9, RuleOperator::LT, 10, ON);
+    bad.release_state = 5;
+    CHECK(!add(engine, bad));
+}
+
+// Program bytecode builder
+struct Code {
+    std::vector<uint8_t> bytes;
+    Code& op(RuleOpcode o) { bytes.push_back((uint8_t)o); return *this; }
+    Code& field(uint8_t idx) { op(RuleOpcode::LOAD_FIELD); bytes.push_back(idx); return *this; }
+    Code& num(float v) {
+        op(RuleOpcode::PUSH_F32);
+        uint8_t b[4];
+        memcpy(b, &v, 4);
+        bytes.insert(bytes.end(), b, b + 4);
+        return *this;
+    }
+    Code& window(uint16_t start, uint16_t end) {
+        op(RuleOpcode::TIME_IN);
+        uint8_t b[4] = {(uint8_t)start, (uint8_t)(start >> 8), (uint8_t)end, (uint8_t)(end >> 8)};
+        bytes.insert(bytes.end(), b, b + 4);
+        return *this;
+    }
+};
+
+static bool addProgram(EdgeRulesEngine& engine, const EdgeRule& rule, const Code& code) {
+    uint8_t buf[EdgeRule::SIZE + RuleProgram::MAX_LEN + 1];
+    rule.toBinary(buf, EdgeRule::SIZE);
+    memcpy(buf + EdgeRule::SIZE, code.bytes.data(), code.bytes.size());
+    return engine.addProgramRule(buf, EdgeRule::SIZE + code.bytes.size());
+}
+
+static uint8_t feed2(EdgeRulesEngine& engine, float tank1, float tank2, uint32_t now_ms) {
+    float values[MessageSchema::MAX_FIELDS];
+    for (float& v : values) v = NAN;
+    values[0] = tank1;
+    values[1] = tank2;
+    engine.evaluate(values, buildDeviceSchema().field_count, now_ms);
+    return engine.getControlState(PUMP).current_state;
+}
+
+TEST(rules_program_compound_condition) {
+    // Pump on while tank2 < 80 AND tank1 > 20
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule rule = makeRule(1, RuleOperator::GT, 0.5f, ON);
+    rule.release_state = OFF;
+    Code code;
+    code.field(1).num(80).op(RuleOpcode::CMP_LT)
+        .field(0).num(20).op(RuleOpcode::CMP_GT)
+        .op(RuleOpcode::AND);
+    CHECK(addProgram(engine, rule, code));
+
+    CHECK_EQ(feed2(engine, 50, 90, 1000), OFF);
+    CHECK_EQ(feed2(engine, 50, 70, 2000), ON);
+    CHECK_EQ(feed2(engine, 10, 70, 3000), OFF);   // Source tank too low
+    CHECK_EQ(feed2(engine, NAN, 70, 4000), OFF);  // No data is never true
+    CHECK_EQ(feed2(engine, 50, 70, 5000), ON);
+
+    // Arithmetic feeds the rule's own operator: on while tank1 - tank2 > 10
+    EdgeRulesEngine diff(buildDeviceSchema(), nullptr);
+    Code sub;
+    sub.field(0).field(1).op(RuleOpcode::SUB);
+    CHECK(addProgram(diff, makeRule(2, RuleOperator::GT, 10, ON), sub));
+    CHECK_EQ(feed2(diff, 50, 45, 1000), OFF);
+    CHECK_EQ(feed2(diff, 50, 30, 2000), ON);
+}
+
+static float runProgram(const Code& code, float tank1, float tank2) {
+    RuleProgram program = {};
+    program.len = (uint8_t)code.bytes.size();
+    memcpy(program.code, code.bytes.data(), code.bytes.size());
+    CHECK(RuleProgram::verify(program.code, program.len, 2));
+    const float values[2] = {tank1, tank2};
+    return program.run(values, 2, -1);
+}
+
+TEST(rules_program_missing_data_never_satisfies) {
+    // Every operator passes an absent field on as NaN
+    Code notGt, neq, min2, max2, orOp, div0;
+    notGt.field(0).num(20).op(RuleOpcode::CMP_GT).op(RuleOpcode::NOT);
+    neq.field(0).num(0).op(RuleOpcode::CMP_NEQ);
+    min2.field(0).num(5).op(RuleOpcode::MIN2);
+    max2.field(0).num(5).op(RuleOpcode::MAX2);
+    orOp.field(0).num(1).op(RuleOpcode::OR);
+    div0.field(0).num(0).op(RuleOpcode::DIV);
+    for (const Code* code : {&notGt, &neq, &min2, &max2, &orOp, &div0}) {
+        CHECK(isnan(runProgram(*code, NAN, 50)));
+    }
+    CHECK_EQ(runProgram(notGt, 10, 50), 1.0f);   // Present data still works
+    CHECK_EQ(runProgram(neq, 10, 50), 1.0f);
+    CHECK_EQ(runProgram(min2, 10, 50), 5.0f);
+    CHECK_EQ(runProgram(max2, 10, 50), 10.0f);
+
+    // SELECT: a missing condition or either branch
+    Code select;
+    select.field(0).num(20).op(RuleOpcode::CMP_GT).field(1).num(0).op(RuleOpcode::SELECT);
+    CHECK(isnan(runProgram(select, NAN, 50)));
+    CHECK(isnan(runProgram(select, 30, NAN)));
+    CHECK(isnan(runProgram(select, 10, NAN)));
+    CHECK_EQ(runProgram(select, 30, 50), 50.0f);
+    CHECK_EQ(runProgram(select, 10, 50), 0.0f);
+
+    // A NaN result is false for the rule's operator, NEQ and LT included
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule onWhenLow = makeRule(1, RuleOperator::GT, 0.5f, ON);
+    onWhenLow.release_state = OFF;
+    CHECK(addProgram(engine, onWhenLow, notGt));
+    CHECK_EQ(feed2(engine, NAN, 50, 1000), OFF);
+    CHECK_EQ(feed2(engine, 10, 50, 2000), ON);
+
+    EdgeRulesEngine other(buildDeviceSchema(), nullptr);
+    CHECK(addProgram(other, makeRule(2, RuleOperator::NEQ, 0, ON), min2));
+    CHECK(addProgram(other, makeRule(3, RuleOperator::LT, 100, ON), max2));
+    CHECK_EQ(feed2(other, NAN, 50, 1000), OFF);
+    CHECK_EQ(feed2(other, 10, 50, 2000), ON);
+}
+
+TEST(rules_program_mod_truncates_like_the_vm) {
+    Code mod;
+    mod.field(0).field(1).op(RuleOpcode::MOD);
+    CHECK_EQ(runProgram(mod, 7, 3), 1.0f);
+    CHECK_EQ(runProgram(mod, -7, 3), -1.0f);     // Sign of the dividend
+    CHECK_EQ(runProgram(mod, 7.5f, 2), 1.5f);
+    CHECK_EQ(runProgram(mod, 7, 0), 0.0f);
+
+    // Quotients past int32 range stay defined and in range
+    CHECK_EQ(runProgram(mod, 1e10f, 0.5f), 0.0f);
+    CHECK_EQ(runProgram(mod, -1e10f, 0.5f), 0.0f);
+    float r = runProgram(mod, 1e10f, 3);
+    CHECK(r >= 0.0f && r < 3.0f);
+}
+
+TEST(rules_program_time_window) {
+    // On between 22:00 and 06:00 (off-peak), wrapping midnight
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule rule = makeRule(1, RuleOperator::GT, 0.5f, ON);
+    rule.release_state = OFF;
+    Code code;
+    code.window(22 * 60, 6 * 60);
+    CHECK(addProgram(engine, rule, code));
+
+    CHECK_EQ(feed2(engine, 0, 0, 1000), OFF);       // Not synced: outside
+    engine.setTimeOfDay(21 * 3600 + 59 * 60, 1000);
+    CHECK_EQ(engine.minuteOfDay(1000), 21 * 60 + 59);
+    CHECK_EQ(feed2(engine, 0, 0, 2000), OFF);
+    CHECK_EQ(feed2(engine, 0, 0, 61000), ON);       // 22:00, fields unchanged
+    CHECK_EQ(engine.minuteOfDay(1000 + 8 * 3600 * 1000u), 5 * 60 + 59);
+    CHECK_EQ(feed2(engine, 0, 0, 1000 + 8 * 3600 * 1000u + 60000), OFF);  // 06:00
+}
+
+TEST(rules_program_verify_and_persist) {
+    EdgeRulesEngine engine(buildDeviceSchema(), nullptr);
+    EdgeRule rule = makeRule(1, RuleOperator::GT, 0.5f, ON);
+
+    Code underflow, unfinished, badField, stateful, truncated;
+    underflow.field(0).op(RuleOpcode::ADD);
+    unfinished.field(0).field(1);
+    badField.field(MessageSchema::MAX_FIELDS);
+    stateful.field(0).op((RuleOpcode)0x40);            // Compute VM's ACCUMULATE
+    truncated.bytes = {(uint8_t)RuleOpcode::PUSH_F32, 0, 0};
+    CHECK(!addProgram(engine, rule, underflow));
+    CHECK(!addProgram(engine, rule, unfinished));
+    CHECK(!addProgram(engine, rule, badField));
+    CHECK(!addProgram(engine, rule, stateful));
+    CHECK(!addProgram(engine, rule, truncated));
+
+    Code deep;
+    for (int i = 0; i < RuleProgram::MAX_STACK + 1; i++) deep.num(1);
+    for (int i = 0; i < RuleProgram::MAX_STACK; i++) deep.op(RuleOpcode::ADD);
+    CHECK(!addProgram(engine, rule, deep));             // Nine deep
+
+    // Programs survive a reboot alongside their rules
+    MemoryPersistence nvs;
+    EdgeRulesEngine saved(buildDeviceSchema(), &nvs);
+    Code code;
+    code.field(0).num(20).op(RuleOpcode::CMP_GT);
+    CHECK(addProgram(saved, rule, code));
+    CHECK(add(saved, makeRule(2, RuleOperator::LT, 10, OFF)));
+    saved.saveToFlash();
+
+    EdgeRulesEngine reloaded(buildDeviceSchema(), &nvs);
+    reloaded.loadFromFlash();
+    CHECK_EQ(reloaded.getRuleCount(), 2);
+    CHECK_EQ(feed2(reloaded, 30, 0, 1000), ON);
+
+    // Replacing a program rule with a plain rule frees its program slot
+    for (uint8_t id = 10; id < 10 + EdgeRulesEngine::MAX_PROGRAMS; id++) {
+        EdgeRule r = makeRule(id, RuleOperator::GT, 0.5f, ON);
+        CHECK_EQ(addProgram(reloaded, r, code), id < 10 + EdgeRulesEngine::MAX_PROGRAMS - 1);
+    }
+    CHECK(add(reloaded, makeRule(1, RuleOperator::LT, 10, OFF)));
+    CHECK(addProgram(reloaded, makeRule(99, RuleOperator::GT, 0.5f, ON), code));
+
+    // 0xFE marks a program on fPort 30, so no rule may use that id
+    CHECK(!add(engine, makeRule(PROGRAM_RULE_MARKER, RuleOperator::LT, 10, ON)));
+}
+
+static bool g_pumpFails = false;
+static bool flakyPump(uint8_t) { return !g_pumpFails; }
+
+static EdgeRule randomRule(std::mt19937& rng, uint8_t id, uint8_t controls) {
+    EdgeRule rule = makeRule(id, (RuleOperator)(rng() % 8), (float)(rng() % 10), (uint8_t)(rng() % 2));
+    rule.enabled = rng() % 8 != 0;
+    rule.field_idx = (uint8_t)(rng() % 4);
+    rule.control_idx = (uint8_t)(rng() % controls);
+    rule.priority = (uint8_t)(rng() % 3);                          // Plenty of ties
+    if (rule.isRate()) rule.threshold -= 5;
+    if (rng() % 2 == 0) rule.cooldown_sec = (uint16_t)(1 + rng() % 4);
+    if (rng() % 4 == 0) rule.hysteresis = (float)(1 + rng() % 3);
+    if (rng() % 4 == 0) {
+        rule.dwell = (uint16_t)(1 + rng() % 3);
+        rule.dwell_samples = rng() % 2 == 0;
+    }
+    if (rng() % 2 == 0) rule.release_state = (uint8_t)(rng() % 2);
+    return rule;
+}
+
+static bool sameOutput(EdgeRulesEngine& a, EdgeRulesEngine& b, uint8_t controls) {
+    for (uint8_t c = 0; c < controls; c++) {
+        ControlState sa = a.getControlState(c), sb = b.getControlState(c);
+        if (sa.current_state != sb.current_state || sa.is_manual != sb.is_manual) return false;
+    }
+    uint8_t bufA[STATE_CHANGE_QUEUE_CAP * 11], bufB[STATE_CHANGE_QUEUE_CAP * 11];
+    size_t countA = 0, countB = 0;
+    size_t lenA = a.formatStateChangeBatch(bufA, sizeof(bufA), &countA);
+    size_t lenB = b.formatStateChangeBatch(bufB, sizeof(bufB), &countB);
+    a.clearStateChangeBatch(countA);
+    b.clearStateChangeBatch(countB);
+    return countA == countB && lenA == lenB && memcmp(bufA, bufB, lenA) == 0;
+}
+
+TEST(rules_index_matches_linear_scan) {
+    // Random rule sets, inputs, overrides and rule edits: evaluate() must
+    // emit exactly the state changes of the full scan, call for call.
+    // Short cooldowns make winners drop out so lower-priority rules fall
+    // through; three priority levels make ties common.
+    MessageSchema::Schema schema = buildDeviceSchema();
+    const uint8_t controls = schema.control_count;
+    std::mt19937 rng(11);
+    uint32_t changeSteps = 0, overrides = 0;
+
+    for (int round = 0; round < 300; round++) {
+        EdgeRulesEngine indexed(schema, nullptr), linear(schema, nullptr);
+        indexed.registerControl(PUMP, flakyPump);
+        linear.registerControl(PUMP, flakyPump);
+        uint8_t ruleCount = (uint8_t)(1 + rng() % 10);
+        for (uint8_t id = 1; id <= ruleCount; id++) {
+            EdgeRule rule = randomRule(rng, id, controls);
+            CHECK(add(indexed, rule));
+            CHECK(add(linear, rule));
+        }
+
+        float values[MessageSchema::MAX_FIELDS];
+        for (float& v : values) v = NAN;
+        uint32_t t = 1000;
+        for (int step = 0; step < 80; step++) {
+            t += (uint32_t)(rng() % 3) * 500;                          // Time may stand still
+            for (uint8_t f = 0; f < 4; f++) {
+                if (rng() % 3 == 0) values[f] = rng() % 12 == 0 ? NAN : (float)(rng() % 10);
+            }
+            uint8_t ctrl = (uint8_t)(rng() % controls);
+            switch (rng() % 24) {
+                case 0: {
+                    uint32_t duration = (uint32_t)(rng() % 3) * 2000;  // 0 = until cleared
+                    indexed.setManualOverride(ctrl, duration, t);
+                    linear.setManualOverride(ctrl, duration, t);
+                    overrides++;
+                    break;
+                }
+                case 1:
+                    indexed.clearManualOverride(ctrl);
+                    linear.clearManualOverride(ctrl);
+                    break;
+                case 2: {
+                    uint8_t state = (uint8_t)(rng() % 2);
+                    indexed.setControlState(ctrl, state, TriggerSource::DOWNLINK, 0, t);
+                    linear.setControlState(ctrl, state, TriggerSource::DOWNLINK, 0, t);
+                    break;
+                }
+                case 3: {
+                    EdgeRule rule = randomRule(rng, (uint8_t)(1 + rng() % (ruleCount + 2)), controls);
+                    CHECK_EQ(add(indexed, rule), add(linear, rule));
+                    break;
+                }
+                case 4: {
+                    uint8_t id = (uint8_t)(1 + rng() % (ruleCount + 2));
+                    CHECK_EQ(indexed.deleteRule(id), linear.deleteRule(id));
+                    break;
+                }
+            }
+            g_pumpFails = rng() % 16 == 0;
+
+            indexed.evaluate(values, schema.field_count, t);
+            linear.evaluateLinear(values, schema.field_count, t);
+            if (indexed.hasPendingStateChange()) changeSteps++;
+            if (!sameOutput(indexed, linear, controls)) {
+                CHECK(!"evaluate() diverged from the linear scan");
+                g_pumpFails = false;
+                return;
+            }
+        }
+    }
+    g_pumpFails = false;
+    CHECK(changeSteps > 1000);
+    CHECK(overrides > 100);
+}
+
+TEST(rules_edits_while_another_task_evaluates) {
+    // fPort 30 edits land on the loop task while the sense task evaluates:
+    // deletes shift rules and program rules turn plain and back, so the
+    // index and the program pool change under a running evaluate()
+    Sim::setClockScaled();   // Two real threads, so the mutex has to block
+    MessageSchema::Schema schema = buildDeviceSchema();
+    EdgeRulesEngine engine(schema, nullptr);
+    Code low;
+    low.field(LEVEL).num(50).op(RuleOpcode::CMP_LT);
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> evaluations{0};
+
+    std::thread sense([&] {
+        float values[MessageSchema::MAX_FIELDS];
+        for (float& v : values) v = NAN;
+        for (uint32_t t = 1000; !stop; t += 100) {
+            values[LEVEL] = (float)(t / 100 % 100);
+            engine.evaluate(values, schema.field_count, t);
+            engine.clearStateChangeBatch(STATE_CHANGE_QUEUE_CAP);
+            evaluations++;
+        }
+    });
+    for (int round = 0; round < 2000; round++) {
+        for (uint8_t id = 1; id <= 6; id++) {
+            EdgeRule rule = makeRule(id, RuleOperator::GT, 0.5f, id % 2 ? ON : OFF);
+            rule.priority = id;
+            CHECK(id % 3 ? addProgram(engine, rule, low) : add(engine, rule));
+        }
+        EdgeRule plain = makeRule(1, RuleOperator::LT, 50, ON);   // Program rule turns plain
+        CHECK(add(engine, plain));
+        CHECK(engine.deleteRule(2));                              // Shifts the rules after it
+        CHECK(engine.deleteRule((uint8_t)(3 + round % 4)));
+        if (round % 8 == 0) engine.clearAllRules();
+    }
+    stop = true;
+    sense.join();
+    CHECK(evaluations > 0u);
+
+    // The engine is still coherent: only the plain rule is left in charge
+    engine.clearAllRules();
+    CHECK(add(engine, makeRule(1, RuleOperator::LT, 50, ON)));
+    CHECK(engine.setControlState(PUMP, OFF, TriggerSource::DOWNLINK, 0, 1000000));
+    CHECK_EQ(feed(engine, 60, 1000000), OFF);
+    CHECK_EQ(feed(engine, 10, 1001000), ON);
+}
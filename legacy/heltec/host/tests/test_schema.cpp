@@ -0,0 +1,95 @@
+#include "test.h"
+#include "lib/message_schema.h"
+#include "devices/remote/device_config.h"
+#include <string.h>
+#include <string>
+
+using namespace MessageSchema;
+
+// Registration lists assembled item by item with the snprintf formatters
+static void runtimeLists(const Schema& schema, std::string* fields, std::string* sys, std::string* states) {
+    *fields = "fields=";
+    *sys = "sys=";
+    *states = "states=";
+    char item[REG_ITEM_LEN];
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        int n = schema.fields[i].formatForRegistration(item, sizeof(item));
+        if (n <= 0) continue;
+        std::string* list = schema.fields[i].category == FieldCategory::TELEMETRY ? fields : sys;
+        if (list->back() != '=') *list += ",";
+        *list += item;
+    }
+    for (uint8_t i = 0; i < schema.control_count; i++) {
+        schema.controls[i].formatForRegistration(item, sizeof(item));
+        if (states->back() != '=') *states += ",";
+        *states += item;
+    }
+}
+
+static void checkMatchesRuntime(const Schema& schema, const RegistrationText& text) {
+    std::string fields, sys, states;
+    runtimeLists(schema, &fields, &sys, &states);
+    CHECK(!text.overflow);
+    CHECK_EQ(text.version, schema.version);
+    CHECK_EQ(fields, std::string(text.fields));
+    CHECK_EQ(sys, std::string(text.sys));
+    CHECK_EQ(states, std::string(text.states));
+}
+
+TEST(schema_registration_text_matches_runtime_format) {
+    static_assert(DEVICE_SCHEMA.findFieldIndex("pd") == 0, "key lookup is constexpr");
+    static_assert(DEVICE_SCHEMA.findControlIndex("valve") == 1, "key lookup is constexpr");
+    checkMatchesRuntime(DEVICE_SCHEMA, DEVICE_REGISTRATION);
+
+    // Every formatting branch: escaped %, negative and fractional bounds
+    // (rounded half to even), default and custom system ranges, no unit
+    Schema schema = SchemaBuilder(7)
+        .addField("t", "Temp", "C", FieldType::FLOAT, -40, 85.5f)
+        .addField("h", "Hum", "%", FieldType::FLOAT, 0, 100)
+        .addField("n", "NoUnit", "", FieldType::FLOAT, 0, 0)
+        .addField("u", "UnitOnly", "kPa", FieldType::FLOAT, -10, 0)
+        .addField("c", "Derived", "", FieldType::FLOAT, 0, 1, FieldCategory::COMPUTED)
+        .addSystemField("a", "Sys", "s", FieldType::UINT32, 0, 4294967295, true)
+        .addSystemField("b", "Sys2", "", FieldType::UINT32, 0, 4294967295)
+        .addSystemField("r", "Range", "%", FieldType::FLOAT, 2.5f, 3.5f, true)
+        .addSystemField("z", "Zero", "", FieldType::UINT32, 0, 0)
+        .addControl("m", "Mode", {"a", "b", "c"})
+        .build();
+    checkMatchesRuntime(schema, renderRegistration(schema));
+}
+
+TEST(schema_limits_drop_excess_at_runtime) {
+    SchemaBuilder builder(1);
+    for (uint8_t i = 0; i < MAX_FIELDS + 2; i++) {
+        builder.addField("f", "Field", "", FieldType::FLOAT, 0, 1);
+    }
+    builder.addControl("longkey12", "Ctl", {"a", "b", "c", "d", "e"});
+    Schema schema = builder.build();
+    CHECK_EQ(schema.field_count, MAX_FIELDS);
+    CHECK_EQ(schema.controls[0].state_count, MAX_STATES_PER_CONTROL);
+    CHECK_EQ(strlen(schema.controls[0].key), sizeof(schema.controls[0].key) - 1);
+
+    // Sixteen fields overflow the fields= list; the text says so
+    CHECK(renderRegistration(schema).overflow);
+}
+
+TEST(schema_key_index_full_and_duplicate_keys) {
+    static const char* keys[MAX_FIELDS] = {"pd", "tv", "bp", "ec", "tsr", "tx", "ul", "dl",
+                                           "up", "bc", "ps", "pe", "kwh", "t1", "t2", "rh"};
+    SchemaBuilder full(1);
+    for (const char* key : keys) full.addField(key, "F", "", FieldType::FLOAT, 0, 1);
+    Schema schema = full.build();
+    CHECK(schema.field_index.valid);
+    for (uint8_t i = 0; i < MAX_FIELDS; i++) CHECK_EQ(schema.findFieldIndex(keys[i]), (int8_t)i);
+    CHECK_EQ(schema.findFieldIndex("zz"), -1);
+
+    // Repeated keys cannot be indexed; lookups fall back to the first match
+    Schema dup = SchemaBuilder(1)
+        .addField("a", "A", "", FieldType::FLOAT, 0, 1)
+        .addField("b", "B", "", FieldType::FLOAT, 0, 1)
+        .addField("a", "A2", "", FieldType::FLOAT, 0, 1)
+        .build();
+    CHECK(!dup.field_index.valid);
+    CHECK_EQ(dup.findFieldIndex("a"), 0);
+    CHECK_EQ(dup.findFieldIndex("b"), 1);
+}
@@ -0,0 +1,77 @@
+#include "test.h"
+#include "sensor_interface.hpp"
+#include "devices/remote/device_config.h"
+#include "lib/telemetry_keys.h"
+
+// Writes a fixed value to one field and counts its reads
+class FakeSensor : public ISensor {
+public:
+    FakeSensor(const char* key, uint32_t intervalMs) : _field(key), _intervalMs(intervalMs) {}
+
+    void begin() override {}
+    void read(Readings& readings) override {
+        reads++;
+        readings.set(_field, value);
+    }
+    const char* getName() const override { return "Fake"; }
+    uint8_t getFields(FieldSlot** fields) override { *fields = &_field; return 1; }
+    uint32_t getSampleIntervalMs() const override { return _intervalMs; }
+
+    float value = 0;
+    uint32_t reads = 0;
+
+private:
+    FieldSlot _field;
+    uint32_t _intervalMs;
+};
+
+TEST(sensors_sample_at_their_own_rate) {
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    SensorManager mgr;
+    mgr.setSchema(&schema);
+    auto flow = std::make_shared<FakeSensor>(TelemetryKeys::PulseDelta, 1000);
+    auto battery = std::make_shared<FakeSensor>(TelemetryKeys::BatteryPercent, 5000);
+    CHECK(mgr.addSensor(flow));
+    CHECK(mgr.addSensor(battery));
+    CHECK_EQ(mgr.minSampleIntervalMs(), 1000u);
+
+    Readings sample(schema);
+    for (uint32_t now = 0; now < 10000; now += 1000) {
+        sample.clear(now);
+        CHECK(mgr.sampleDue(sample, now));
+    }
+    CHECK_EQ(flow->reads, 10u);
+    CHECK_EQ(battery->reads, 2u);
+
+    // A field the schema lacks, or one another sensor already writes, is
+    // reported at registration
+    CHECK(!mgr.addSensor(std::make_shared<FakeSensor>("nope", 1000)));
+    CHECK(!mgr.addSensor(std::make_shared<FakeSensor>(TelemetryKeys::PulseDelta, 1000)));
+    CHECK_EQ(mgr.bindErrors(), 2);
+}
+
+TEST(sensors_report_window_sums_delta_fields) {
+    const MessageSchema::Schema& schema = buildDeviceSchema();
+    FieldSlot pd(TelemetryKeys::PulseDelta), tv(TelemetryKeys::TotalVolume);
+    CHECK(pd.bind(schema));
+    CHECK(tv.bind(schema));
+
+    Readings latest(schema), report(schema), sample(schema);
+    for (int i = 1; i <= 3; i++) {
+        sample.clear(0);
+        sample.set(pd, (float)i);
+        sample.set(tv, 100.0f * i);
+        latest.update(sample);
+        report.accumulate(sample);
+    }
+    // pd is a delta (pulses per window); tv a running total
+    CHECK_EQ(report.value(pd.index), 6.0f);
+    CHECK_EQ(report.value(tv.index), 300.0f);
+    CHECK_EQ(latest.value(pd.index), 3.0f);
+    CHECK_EQ(latest.value(tv.index), 300.0f);
+
+    // An absent slot leaves the latest value alone
+    sample.clear(0);
+    latest.update(sample);
+    CHECK(latest.has(pd.index));
+}
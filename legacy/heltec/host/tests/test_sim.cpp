@@ -0,0 +1,127 @@
+#include "test.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <RadioLib.h>
+#include <heltec_unofficial.h>
+#include "sim_nvs.h"
+#include "sim_radio.h"
+
+// The simulated HAL itself: if these drift from the ESP32 behaviour the
+// firmware relies on, the other host tests stop meaning anything.
+
+TEST(sim_preferences_are_typed_and_persist) {
+    Preferences p;
+    CHECK(p.begin("app_state"));
+    p.putUInt("tx", 60000);
+    p.putString("name", "pump");
+    uint8_t blob[3] = {1, 2, 3};
+    p.putBytes("blob", blob, sizeof(blob));
+    CHECK_EQ(p.getUInt("tx", 0), 60000u);
+    CHECK_EQ(p.getFloat("tx", -1.0f), -1.0f);          // Wrong type reads the default
+    CHECK(p.getString("name") == "pump");
+    CHECK_EQ(p.getBytesLength("blob"), 3u);
+    uint8_t small[2];
+    CHECK_EQ(p.getBytes("blob", small, sizeof(small)), 0u);
+    p.end();
+
+    uint32_t writes = Sim::Nvs::writeCount();
+    p.begin("app_state");
+    p.putUInt("tx", 60000);                             // Unchanged: no flash write
+    CHECK_EQ(Sim::Nvs::writeCount(), writes);
+    p.end();
+
+    std::string file = HostTest::tempPath("nvs.txt");   // Any working directory
+    const char* path = file.c_str();
+    CHECK(Sim::saveNvs(path));
+    Sim::clearNvs();
+    CHECK(!p.begin("app_state", true) || !p.isKey("tx"));
+    p.end();
+    CHECK(Sim::loadNvs(path));
+    p.begin("app_state", true);
+    CHECK_EQ(p.getUInt("tx", 0), 60000u);
+    CHECK_EQ(p.putUInt("tx", 1), 0u);                   // Read-only namespace
+    p.end();
+    remove(path);
+}
+
+TEST(sim_rtos_waits_advance_manual_clock) {
+    QueueHandle_t q = xQueueCreate(2, sizeof(uint32_t));
+    uint32_t v = 7, out = 0;
+    CHECK(xQueueSend(q, &v, 0) == pdTRUE);
+    v = 8;
+    CHECK(xQueueSendToFront(q, &v, 0) == pdTRUE);
+    CHECK(xQueueSend(q, &v, 100) != pdTRUE);            // Full: times out
+    CHECK_EQ(millis(), 100u);
+    CHECK(xQueueReceive(q, &out, 0) == pdTRUE && out == 8);
+    CHECK(xQueueReceive(q, &out, 0) == pdTRUE && out == 7);
+    CHECK(xQueueReceive(q, &out, pdMS_TO_TICKS(250)) != pdTRUE);
+    CHECK_EQ(millis(), 350u);
+
+    SemaphoreHandle_t m = xSemaphoreCreateMutex();
+    CHECK(xSemaphoreTake(m, 0) == pdTRUE);
+    CHECK(xSemaphoreTake(m, 0) != pdTRUE);
+    CHECK(xSemaphoreGive(m) == pdTRUE);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK_EQ(xTaskGetTickCount(), 400u);
+    vQueueDelete(q);
+    vSemaphoreDelete(m);
+}
+
+TEST(sim_network_class_a_semantics) {
+    Sim::Network& net = Sim::Network::instance();
+    LoRaWANNode node(&radio, &US915, 2);
+    uint8_t key[16] = {0};
+    node.beginOTAA(0, 0, key, key);
+
+    net.failJoins(2);
+    CHECK_EQ(node.activateOTAA(), RADIOLIB_ERR_NO_JOIN_ACCEPT);
+    CHECK_EQ(node.activateOTAA(), RADIOLIB_ERR_NO_JOIN_ACCEPT);
+    CHECK_EQ(node.activateOTAA(), RADIOLIB_LORAWAN_NEW_SESSION);
+    CHECK_EQ(net.joinAttempts(), 3u);
+    node.setDatarate(3);
+
+    uint8_t up[4] = {1, 2, 3, 4}, down[256];
+    size_t downLen = sizeof(down);
+    LoRaWANEvent_t evUp, evDown;
+    CHECK_EQ(node.sendReceive(up, 4, 2, down, &downLen, false, &evUp, &evDown), RADIOLIB_ERR_NONE);
+    CHECK_EQ(downLen, 0u);
+
+    // Confirmed uplink: ACK alone counts as reception
+    downLen = sizeof(down);
+    CHECK(node.sendReceive(up, 4, 2, down, &downLen, true, &evUp, &evDown) > 0);
+    CHECK(evDown.confirming);
+
+    // Queued downlink rides the next RX window; ADR applies after that uplink
+    net.queueDownlink(10, {0xAB, 0xCD});
+    net.commandDataRate(1);
+    downLen = sizeof(down);
+    CHECK(node.sendReceive(up, 4, 2, down, &downLen, false, &evUp, &evDown) > 0);
+    CHECK_EQ(evDown.fPort, 10);
+    CHECK(downLen == 2 && down[0] == 0xAB);
+    CHECK_EQ(evUp.datarate, 3);
+    CHECK_EQ(node.dataRate(), 1);
+
+    // DR1 carries at most 53 bytes
+    uint8_t big[100] = {0};
+    downLen = sizeof(down);
+    CHECK_EQ(node.sendReceive(big, sizeof(big), 2, down, &downLen), RADIOLIB_ERR_PACKET_TOO_LONG);
+    CHECK_EQ(net.uplinkCount(), 3u);
+}
+
+static volatile int g_edges = 0;
+static void IRAM_ATTR onEdge(void* arg) { g_edges += *(int*)arg; }
+
+TEST(sim_gpio_interrupts_fire_on_edges) {
+    int step = 1;
+    g_edges = 0;
+    attachInterruptArg(7, onEdge, &step, FALLING);
+    for (int i = 0; i < 5; i++) {
+        Sim::setPin(7, HIGH);
+        Sim::setPin(7, LOW);
+    }
+    CHECK_EQ(g_edges, 5);
+    detachInterrupt(7);
+    Sim::setPin(7, HIGH);
+    Sim::setPin(7, LOW);
+    CHECK_EQ(g_edges, 5);
+}
@@ -0,0 +1,60 @@
+#include "test.h"
+#include "lib/tx_scheduler.h"
+#include <Arduino.h>
+
+static LoRaWANTxMsg frame(uint8_t port, uint8_t tag) {
+    LoRaWANTxMsg m = {};
+    m.port = port;
+    m.len = 1;
+    m.payload[0] = tag;
+    return m;
+}
+
+TEST(tx_scheduler_priority_and_policies) {
+    TxScheduler s;
+    CHECK(s.begin());
+    using R = TxScheduler::Result;
+
+    CHECK(s.enqueue(TxClass::Telemetry, frame(2, 0)) == R::Queued);
+    CHECK(s.enqueue(TxClass::Telemetry, frame(2, 1)) == R::Replaced);      // Latest value wins
+    CHECK(s.enqueue(TxClass::StateChange, frame(3, 0)) == R::Queued);
+    CHECK(s.enqueue(TxClass::StateChange, frame(3, 1)) == R::Queued);
+    CHECK(s.enqueue(TxClass::StateChange, frame(3, 2)) == R::Full);        // Producer keeps it
+    CHECK(s.enqueue(TxClass::OtaAck, frame(8, 0)) == R::Queued);
+    CHECK(s.enqueue(TxClass::OtaAck, frame(8, 1)) == R::Queued);
+    CHECK(s.enqueue(TxClass::OtaAck, frame(8, 2)) == R::Replaced);         // Oldest ACK dropped
+    CHECK(s.enqueue(TxClass::Registration, frame(1, 0)) == R::Queued);
+    s.clear(TxClass::Registration);
+
+    const uint8_t expected[][2] = {{8, 1}, {8, 2}, {3, 0}, {3, 1}, {2, 1}};
+    LoRaWANTxMsg m;
+    TxClass cls;
+    for (auto& e : expected) {
+        CHECK(s.dequeue(&m, &cls, 0));
+        CHECK_EQ(m.port, e[0]);
+        CHECK_EQ(m.payload[0], e[1]);
+    }
+    CHECK(!s.dequeue(&m, &cls, 0));
+    CHECK_EQ(s.pendingTotal(), 0);
+    CHECK(!s.idle());                   // Last frame still in flight
+    s.complete();
+    CHECK(s.idle());
+}
+
+TEST(tx_scheduler_mask_defers_classes) {
+    TxScheduler s;
+    s.begin();
+    s.enqueue(TxClass::Telemetry, frame(2, 0));
+    s.enqueue(TxClass::CmdAck, frame(4, 0));
+    const uint8_t acksOnly = (1u << (uint8_t)TxClass::OtaAck) | (1u << (uint8_t)TxClass::CmdAck);
+
+    LoRaWANTxMsg m;
+    TxClass cls;
+    CHECK(s.dequeue(&m, &cls, 0, acksOnly));
+    CHECK(cls == TxClass::CmdAck);
+    // Telemetry stays queued until the mask admits it
+    CHECK(!s.dequeue(&m, &cls, 50, acksOnly));
+    CHECK_EQ(s.pending(TxClass::Telemetry), 1);
+    CHECK(s.dequeue(&m, &cls, 0));
+    CHECK(cls == TxClass::Telemetry);
+}
@@ -27,6 +27,7 @@ public:
         int8_t de_pin = -1;   // -1 = not used
         int8_t re_pin = -1;
         bool enabled = true;
+        uint32_t sampleIntervalMs = 5000;   // One Modbus poll per sample
     };
 
     InverterPumpIntegration(const Config& cfg, IUartHal* uart)
@@ -38,21 +39,17 @@ public:
         LOGI("InverterPump", "begin addr=%u", _cfg.slave_addr);
     }
 
-    void read(std::vector<SensorReading>& readings) override {
-        uint32_t ts = millis();
-        if (!_cfg.enabled) {
-            readings.push_back({InverterPumpKeys::PumpState, std::numeric_limits<float>::quiet_NaN(), ts});
-            readings.push_back({InverterPumpKeys::PumpError, std::numeric_limits<float>::quiet_NaN(), ts});
-            readings.push_back({InverterPumpKeys::EnergyKwh, std::numeric_limits<float>::quiet_NaN(), ts});
-            return;
-        }
+    void read(Readings& readings) override {
+        if (!_cfg.enabled) return;  // Slots stay absent
         // Stub: return last pump state and placeholder values (real impl would read Modbus)
-        readings.push_back({InverterPumpKeys::PumpState, (float)_pumpState, ts});
-        readings.push_back({InverterPumpKeys::PumpError, 0.0f, ts});
-        readings.push_back({InverterPumpKeys::EnergyKwh, 0.0f, ts});
+        readings.set(_fields[0], (float)_pumpState);
+        readings.set(_fields[1], 0.0f);
+        readings.set(_fields[2], 0.0f);
     }
 
     const char* getName() const override { return "InverterPump"; }
+    uint8_t getFields(FieldSlot** fields) override { *fields = _fields; return 3; }
+    uint32_t getSampleIntervalMs() const override { return _cfg.sampleIntervalMs; }
 
     // --- IControlDriver ---
     bool setState(uint8_t state_idx) override {
@@ -70,6 +67,8 @@ private:
     Config _cfg;
     IUartHal* _uart;
     uint8_t _pumpState;
+    FieldSlot _fields[3] = {FieldSlot(InverterPumpKeys::PumpState), FieldSlot(InverterPumpKeys::PumpError),
+                            FieldSlot(InverterPumpKeys::EnergyKwh)};
 };
 
 #endif // INTEGRATIONS_INVERTER_PUMP_H
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "communication_config.h"
+#include "tx_scheduler.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// =============================================================================
+// Airtime: LoRa time-on-air, rolling-hour ledger and uplink admission
+// =============================================================================
+// timeOnAirUs() implements the Semtech SX126x formula (AN1200.13) from SF,
+// bandwidth, coding rate and PHY payload length. The radio task records every
+// uplink in an AirtimeLedger (60 one-minute buckets) and asks it which traffic
+// classes may transmit:
+//
+//   used <  80% of hourly budget -> all classes
+//   used >= 80%                  -> telemetry, diagnostics and backfill deferred
+//   used >= 100%                 -> only OTA and command ACKs
+//
+// Deferred frames stay in the TX scheduler, where telemetry and diagnostics
+// coalesce, so a throttled node sends the latest value once budget frees up.
+// =============================================================================
+
+namespace Airtime {
+
+constexpr uint8_t LORAWAN_OVERHEAD = 13;   // MHDR 1 + FHDR 7 + FPort 1 + MIC 4 (no FOpts)
+constexpr uint8_t PREAMBLE_SYMBOLS = 8;
+constexpr uint8_t SOFT_LIMIT_PERCENT = 80;
+
+struct Modulation {
+    uint8_t sf;          // 7..12
+    uint32_t bwHz;       // 125000, 250000, 500000
+    uint8_t cr;          // Coding rate denominator offset: 1 = 4/5 .. 4 = 4/8
+};
+
+/**
+ * Time on air in microseconds for a LoRa frame (explicit header, CRC on,
+ * low data rate optimisation when symbol time >= 16 ms).
+ */
+inline uint32_t timeOnAirUs(const Modulation& mod, size_t phyPayloadLen,
+                            uint8_t preambleSymbols = PREAMBLE_SYMBOLS) {
+    if (mod.sf < 5 || mod.sf > 12 || mod.bwHz == 0) return 0;
+    uint32_t tSymUs = (uint32_t)(((uint64_t)1000000 << mod.sf) / mod.bwHz);
+    int de = tSymUs >= 16000 ? 1 : 0;
+
+    // payloadSymbNb = 8 + max(ceil((8PL - 4SF + 28 + 16CRC - 20IH) / (4(SF - 2DE))) * (CR + 4), 0)
+    int32_t num = 8 * (int32_t)phyPayloadLen - 4 * mod.sf + 28 + 16;
+    int32_t den = 4 * (mod.sf - 2 * de);
+    int32_t blocks = num > 0 ? (num + den - 1) / den : 0;
+    uint32_t payloadSymbols = 8 + (uint32_t)blocks * (mod.cr + 4);
+
+    // Preamble is (n + 4.25) symbols; keep quarter-symbol precision
+    uint64_t preambleUs = (uint64_t)(preambleSymbols * 4 + 17) * tSymUs / 4;
+    return (uint32_t)(preambleUs + (uint64_t)payloadSymbols * tSymUs);
+}
+
+/** LoRa modulation for a data rate (LoRaWAN Regional Parameters). */
+inline Modulation modulationFor(LoRaWANRegion region, uint8_t dr) {
+    switch (region) {
+        case LoRaWANRegion::US915:
+        case LoRaWANRegion::AU915:
+            if (dr <= 3) return {(uint8_t)(10 - dr), 125000, 1};   // DR0 SF10 .. DR3 SF7
+            if (dr == 4) return {8, 500000, 1};
+            break;
+        default:
+            if (dr <= 5) return {(uint8_t)(12 - dr), 125000, 1};   // DR0 SF12 .. DR5 SF7
+            if (dr == 6) return {7, 250000, 1};
+            break;
+    }
+    return {7, 125000, 1};
+}
+
+/** Time on air for an application payload sent at a data rate. */
+inline uint32_t uplinkTimeOnAirUs(LoRaWANRegion region, uint8_t dr, size_t appPayloadLen) {
+    return timeOnAirUs(modulationFor(region, dr), appPayloadLen + LORAWAN_OVERHEAD);
+}
+
+// -----------------------------------------------------------------------------
+// AirtimeLedger - rolling one-hour airtime in one-minute buckets
+// -----------------------------------------------------------------------------
+// Written by the radio task only; other tasks may read usedMs()/usedPercent().
+// -----------------------------------------------------------------------------
+struct AirtimeLedger {
+    static constexpr uint8_t BUCKETS = 60;
+    static constexpr uint32_t BUCKET_MS = 60000;
+
+    uint32_t bucketMs[BUCKETS];     // Airtime per minute slot
+    uint32_t currentMinute;         // Minute index of the newest bucket
+    volatile uint32_t usedMsCache;  // Sum over the window (refreshed on advance/record)
+    uint32_t budgetMsPerHour;       // 0 = unlimited
+    uint32_t totalMs;               // Since power-on (kept through deep sleep)
+
+    void setBudget(uint32_t msPerHour) { budgetMsPerHour = msPerHour; }
+
+    /** Roll the window forward to nowMs, expiring buckets older than an hour. */
+    void advance(uint32_t nowMs) {
+        uint32_t minute = nowMs / BUCKET_MS;
+        uint32_t steps = minute - currentMinute;
+        if (steps == 0) return;
+        if (steps >= BUCKETS) {
+            for (uint8_t i = 0; i < BUCKETS; i++) bucketMs[i] = 0;
+        } else {
+            for (uint32_t s = 1; s <= steps; s++) bucketMs[(currentMinute + s) % BUCKETS] = 0;
+        }
+        currentMinute = minute;
+        refresh();
+    }
+
+    void record(uint32_t nowMs, uint32_t airtimeUs) {
+        advance(nowMs);
+        uint32_t ms = (airtimeUs + 999) / 1000;
+        bucketMs[currentMinute % BUCKETS] += ms;
+        totalMs += ms;
+        refresh();
+    }
+
+    uint32_t usedMs() const { return usedMsCache; }
+
+    /** Percentage of the hourly budget used (0 when unlimited). */
+    uint8_t usedPercent() const {
+        if (budgetMsPerHour == 0) return 0;
+        uint32_t pct = (uint32_t)((uint64_t)usedMsCache * 100 / budgetMsPerHour);
+        return pct > 255 ? 255 : (uint8_t)pct;
+    }
+
+    /** Bitmask of TxClass values allowed to transmit right now. */
+    uint8_t admissibleClasses(uint32_t nowMs) {
+        advance(nowMs);
+        const uint8_t all = TxScheduler::ALL_CLASSES;
+        if (budgetMsPerHour == 0) return all;
+        uint8_t pct = usedPercent();
+        if (pct >= 100) {
+            return (uint8_t)((1u << (uint8_t)TxClass::OtaAck) | (1u << (uint8_t)TxClass::CmdAck));
+        }
+        if (pct >= SOFT_LIMIT_PERCENT) {
+            return (uint8_t)(all & ~((1u << (uint8_t)TxClass::Telemetry) |
+                                     (1u << (uint8_t)TxClass::Diagnostics) |
+                                     (1u << (uint8_t)TxClass::Backfill)));
+        }
+        return all;
+    }
+
+private:
+    void refresh() {
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < BUCKETS; i++) sum += bucketMs[i];
+        usedMsCache = sum;
+    }
+};
+
+} // namespace Airtime
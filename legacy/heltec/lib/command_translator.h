@@ -59,6 +59,14 @@ inline const char* translate(uint8_t port, const uint8_t* payload, uint8_t len,
             }
             break;
 
+        case FPORT_CMD_TELEMETRY_RESYNC:
+            snprintf(buf, bufSize, "Telemetry resync");
+            break;
+
+        case FPORT_CMD_TIME_SYNC:
+            snprintf(buf, bufSize, "Time sync");
+            break;
+
         case FPORT_DIRECT_CTRL:
             if (len >= 2) {
                 uint8_t ctrlIdx = payload[0];
@@ -77,8 +85,10 @@ inline const char* translate(uint8_t port, const uint8_t* payload, uint8_t len,
         case FPORT_RULE_UPDATE:
             if (len >= 2 && payload[0] == 0xFF && payload[1] == 0x00) {
                 snprintf(buf, bufSize, "Clear all rules");
-            } else if (len >= 2 && (payload[1] & 0x80)) {
+            } else if (len == 2 && (payload[1] & 0x80)) {
                 snprintf(buf, bufSize, "Delete rule %d", payload[0]);
+            } else if (len >= 2 && payload[0] == 0xFE) {
+                snprintf(buf, bufSize, "Program rule %d", payload[1]);
             } else if (len >= 1) {
                 snprintf(buf, bufSize, "Update rule %d", payload[0]);
             } else {
@@ -33,6 +33,7 @@ struct LoRaWANConfig {
     uint8_t txPower = 22;              // Transmit power (dBm)
     uint8_t dataRate = 3;              // Data rate (e.g. 3 = 222-byte max on US915)
     uint8_t minDataRate = 0;           // Clamp: data rate never below this (0 = no clamp)
+    uint32_t airtimeBudgetMsPerHour = 36000;  // Rolling-hour TX airtime cap (1% duty cycle); 0 = unlimited
     
     // Application settings
     uint8_t defaultPort = 1;           // Default application port for telemetry
@@ -10,6 +10,17 @@
 #include "communication_config.h"
 #include "battery_monitor.h" // Include battery monitor for its config struct
 
+// Deep-sleep duty cycle for battery nodes: wake on the TX interval (or a
+// button press, or after wakeAfterPulses flow pulses), sample, uplink and
+// sleep again. Off: the node stays awake.
+struct PowerConfig {
+    bool deepSleepEnabled = false;
+    uint32_t maxAwakeMs = 30000;        // Sleep anyway when join/ACK/registration takes longer
+    uint32_t buttonAwakeMs = 30000;     // Awake with the display on after a button wake
+    uint8_t wakeButtonPin = 0;          // PRG button on Heltec V3 (RTC GPIO); 0xFF = none
+    uint16_t wakeAfterPulses = 0;       // Early wake on flow (0 = timer only)
+};
+
 // Device configuration for remote sensor nodes
 struct DeviceConfig {
     uint8_t deviceId;
@@ -23,6 +34,7 @@ struct DeviceConfig {
     // Centralized hardware and communication configuration
     BatteryMonitor::Config battery;
     CommunicationConfig communication;
+    PowerConfig power;
 };
 
 // Default intervals (used by RemoteConfig::create)
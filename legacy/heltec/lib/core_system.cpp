@@ -2,6 +2,7 @@
 #include "core_logger.h"
 #include "board_config.h"
 #include <Arduino.h>
+#include <esp_sleep.h>
 #define HELTEC_NO_DISPLAY_INSTANCE  // Disable global display creation
 #include <heltec_unofficial.h>
 
@@ -11,8 +12,10 @@ void CoreSystem::init(const DeviceConfig& config) {
     // 1. Initialize Board Hardware using Heltec library
     heltec_setup();
 
-    // 2. Serial is already initialized by heltec_setup()
-    delay(500); // Longer delay to ensure serial is ready
+    // 2. Serial is already initialized by heltec_setup(); a deep-sleep wake
+    // skips the waits, nobody is watching and they cost awake time
+    bool fromSleep = wakeCause() != WakeCause::PowerOn;
+    if (!fromSleep) delay(500); // Longer delay to ensure serial is ready
     Serial.println();
 
     // 3. Initialize Logger
@@ -23,7 +26,7 @@ void CoreSystem::init(const DeviceConfig& config) {
 
     // Ensure Serial is ready before logging (with timeout)
     uint32_t startTime = millis();
-    while (!Serial && (millis() - startTime) < 2000) { // 2 second timeout
+    while (!fromSleep && !Serial && (millis() - startTime) < 2000) { // 2 second timeout
         delay(10);
     }
 
@@ -34,3 +37,30 @@ void CoreSystem::init(const DeviceConfig& config) {
 
     Logger::printf(Logger::Level::Info, "SYS", "Core system initialized.");
 }
+
+CoreSystem::WakeCause CoreSystem::wakeCause() {
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_TIMER: return WakeCause::Timer;
+        case ESP_SLEEP_WAKEUP_EXT0: return WakeCause::Button;
+        case ESP_SLEEP_WAKEUP_ULP: return WakeCause::Pulses;
+        default: return WakeCause::PowerOn;
+    }
+}
+
+const char* CoreSystem::wakeCauseName(WakeCause cause) {
+    switch (cause) {
+        case WakeCause::Timer: return "timer";
+        case WakeCause::Button: return "button";
+        case WakeCause::Pulses: return "pulses";
+        default: return "power-on";
+    }
+}
+
+void CoreSystem::deepSleep(uint32_t sleepMs, uint8_t wakeButtonPin) {
+    if (wakeButtonPin != 0xFF) {
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)wakeButtonPin, 0);
+    }
+    Serial.flush();
+    // Powers down the radio and Vext, arms the timer and sleeps
+    heltec_deep_sleep((int)((sleepMs + 999) / 1000));
+}
@@ -1,10 +1,26 @@
 #pragma once
 
 #include "core_config.h"
+#include <esp_rtc_time.h>
+#include <stdint.h>
 
 // Initializes board hardware (heltec_setup), serial, logger, and external power.
 class CoreSystem {
 public:
+    // Why this boot happened; deep sleep ends in a reset
+    enum class WakeCause : uint8_t { PowerOn, Timer, Button, Pulses };
+
     CoreSystem();
     void init(const DeviceConfig& config);
+
+    static WakeCause wakeCause();
+    static const char* wakeCauseName(WakeCause cause);
+
+    // Milliseconds since power-on, deep sleep included. millis() restarts at
+    // every wake; state kept across sleep (RTC memory) is timed on this clock.
+    static uint32_t clockMs() { return (uint32_t)(esp_rtc_get_time_us() / 1000); }
+
+    // Deep sleep for sleepMs (rounded up to whole seconds), also waking on
+    // wakeButtonPin going low (0xFF = none). Does not return.
+    static void deepSleep(uint32_t sleepMs, uint8_t wakeButtonPin);
 };
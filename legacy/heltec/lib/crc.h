@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ARDUINO_ARCH_ESP32) && __has_include(<esp_rom_crc.h>)
+#include <esp_rom_crc.h>
+#define CRC_USE_ROM_CRC32 1
+#else
+#define CRC_USE_ROM_CRC32 0
+#endif
+
+// =============================================================================
+// CRC: shared checksum engines
+// =============================================================================
+// crc16Ccitt  CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, MSB first). Used
+//             for OTA chunks (must match the server) and persisted blobs.
+// crc32Update CRC-32/IEEE (reflected 0xEDB88320), zlib convention: start with
+//             0 and feed the previous result back in. Used for OTA images.
+//
+// Both are byte-table driven; CRC32 processes four bytes per step (slice-by-4)
+// unless the ESP32 ROM implementation is available. Tables are constexpr and
+// live in flash. The bitwise *Reference versions are the specification the
+// tables are checked against on the host.
+// =============================================================================
+
+namespace Crc {
+
+struct Crc16Table {
+    uint16_t t[256];
+    constexpr Crc16Table() : t{} {
+        for (uint16_t i = 0; i < 256; i++) {
+            uint16_t c = (uint16_t)(i << 8);
+            for (int k = 0; k < 8; k++) c = (uint16_t)((c & 0x8000) ? (c << 1) ^ 0x1021 : c << 1);
+            t[i] = c;
+        }
+    }
+};
+
+struct Crc32Tables {
+    uint32_t t[4][256];
+    constexpr Crc32Tables() : t{} {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int s = 1; s < 4; s++) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+        }
+    }
+};
+
+inline constexpr Crc16Table CRC16_TABLE{};
+#if !CRC_USE_ROM_CRC32
+inline constexpr Crc32Tables CRC32_TABLES{};
+#endif
+
+/** CRC-16/CCITT-FALSE; pass the previous result as crc to continue. */
+inline uint16_t crc16Ccitt(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 8) ^ CRC16_TABLE.t[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+/** CRC-32/IEEE, zlib convention (crc = 0 for a new checksum). */
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+#if CRC_USE_ROM_CRC32
+    return esp_rom_crc32_le(crc, data, len);
+#else
+    const auto& t = CRC32_TABLES.t;
+    crc = ~crc;
+    while (len >= 4) {
+        crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+               ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF] ^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
+        data += 4;
+        len -= 4;
+    }
+    while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    return ~crc;
+#endif
+}
+
+inline uint32_t crc32(const uint8_t* data, size_t len) { return crc32Update(0, data, len); }
+
+// -----------------------------------------------------------------------------
+// Bitwise reference implementations
+// -----------------------------------------------------------------------------
+
+inline uint16_t crc16CcittReference(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int k = 0; k < 8; k++) crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+    }
+    return crc;
+}
+
+inline uint32_t crc32Reference(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+} // namespace Crc
@@ -0,0 +1,163 @@
+#include "delta_patch.h"
+#include <cstring>
+
+namespace DeltaPatch {
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void Applier::begin(ReadFn read, WriteFn write, void* ctx, bool verifyBase) {
+    _read = read;
+    _write = write;
+    _ctx = ctx;
+    _verifyBase = verifyBase;
+    _status = Status::Ok;
+    _stage = Stage::Header;
+    _fieldPos = 0;
+    _offset = 0;
+    _remaining = 0;
+    _oldSize = 0;
+    _oldCrc32 = 0;
+    _newSize = 0;
+    _produced = 0;
+    _outLen = 0;
+}
+
+Status Applier::parseHeader() {
+    if (_header[0] != MAGIC0 || _header[1] != MAGIC1 || _header[2] != VERSION)
+        return fail(Status::BadHeader);
+    _oldSize = readU32(_header + 4);
+    _oldCrc32 = readU32(_header + 8);
+    _newSize = readU32(_header + 12);
+    if (_newSize == 0) return fail(Status::BadHeader);
+
+    if (_verifyBase) {
+        // Reuse the output block as read buffer; nothing is buffered yet
+        uint32_t crc = 0;
+        for (uint32_t pos = 0; pos < _oldSize; ) {
+            size_t n = _oldSize - pos < OUT_BLOCK ? (size_t)(_oldSize - pos) : OUT_BLOCK;
+            if (!_read(_ctx, pos, _out, n)) return fail(Status::ReadFail);
+            crc = Crc::crc32Update(crc, _out, n);
+            pos += n;
+        }
+        if (crc != _oldCrc32) return fail(Status::BaseMismatch);
+    }
+    _stage = Stage::Opcode;
+    return Status::Ok;
+}
+
+// Length field complete: validate the op and switch to its data stage
+Status Applier::startRun() {
+    if (_remaining > _newSize - _produced) return fail(Status::OutOfRange);
+    if (_op != Op::Insert && (_offset > _oldSize || _remaining > _oldSize - _offset))
+        return fail(Status::OutOfRange);
+    if (_remaining == 0) {
+        _stage = Stage::Opcode;
+        return Status::Ok;
+    }
+    _stage = _op == Op::Copy ? Stage::Copy : (_op == Op::Add ? Stage::Add : Stage::Insert);
+    return Status::Ok;
+}
+
+bool Applier::flush() {
+    if (_outLen == 0) return true;
+    bool ok = _write(_ctx, _out, _outLen);
+    _outLen = 0;
+    return ok;
+}
+
+Status Applier::feed(const uint8_t* data, size_t len) {
+    if (_status != Status::Ok) return _status;
+    size_t i = 0;
+
+    // Copy runs need no input, so keep going while one is pending
+    while (i < len || _stage == Stage::Copy) {
+        switch (_stage) {
+            case Stage::Header:
+                _header[_fieldPos++] = data[i++];
+                if (_fieldPos == HEADER_SIZE) {
+                    _fieldPos = 0;
+                    if (parseHeader() != Status::Ok) return _status;
+                }
+                break;
+
+            case Stage::Opcode: {
+                uint8_t op = data[i++];
+                if (op < (uint8_t)Op::Copy || op > (uint8_t)Op::Insert) return fail(Status::BadOp);
+                _op = (Op)op;
+                _offset = 0;
+                _remaining = 0;
+                _fieldPos = 0;
+                _stage = _op == Op::Insert ? Stage::Length : Stage::Offset;
+                break;
+            }
+
+            case Stage::Offset:
+                _offset |= (uint32_t)data[i++] << (8 * _fieldPos);
+                if (++_fieldPos == 4) {
+                    _fieldPos = 0;
+                    _stage = Stage::Length;
+                }
+                break;
+
+            case Stage::Length: {
+                uint8_t b = data[i++];
+                if (_fieldPos >= 5) return fail(Status::BadOp);
+                _remaining |= (uint32_t)(b & 0x7F) << (7 * _fieldPos);
+                _fieldPos++;
+                if (!(b & 0x80) && startRun() != Status::Ok) return _status;
+                break;
+            }
+
+            case Stage::Copy:
+            case Stage::Add:
+            case Stage::Insert: {
+                size_t n = OUT_BLOCK - _outLen;
+                if (n > _remaining) n = _remaining;
+                if (_stage != Stage::Copy && n > len - i) n = len - i;
+                uint8_t* dst = _out + _outLen;
+
+                if (_stage == Stage::Insert) {
+                    memcpy(dst, data + i, n);
+                } else {
+                    if (!_read(_ctx, _offset, dst, n)) return fail(Status::ReadFail);
+                    if (_stage == Stage::Add) {
+                        for (size_t k = 0; k < n; k++) dst[k] = (uint8_t)(dst[k] + data[i + k]);
+                    }
+                    _offset += n;
+                }
+                if (_stage != Stage::Copy) i += n;
+                _outLen += n;
+                _produced += n;
+                _remaining -= n;
+                if (_remaining == 0) _stage = Stage::Opcode;
+                if (_outLen == OUT_BLOCK && !flush()) return fail(Status::WriteFail);
+                break;
+            }
+        }
+
+        if (_produced == _newSize && _stage == Stage::Opcode) {
+            if (!flush()) return fail(Status::WriteFail);
+            _status = Status::Done;
+            return _status;
+        }
+    }
+    return _status;
+}
+
+const char* Applier::statusName(Status s) {
+    switch (s) {
+        case Status::Ok:           return "ok";
+        case Status::Done:         return "done";
+        case Status::BadHeader:    return "bad_header";
+        case Status::BaseMismatch: return "base_mismatch";
+        case Status::BadOp:        return "bad_op";
+        case Status::OutOfRange:   return "out_of_range";
+        case Status::ReadFail:     return "read_fail";
+        case Status::WriteFail:    return "write_fail";
+        default:                   return "?";
+    }
+}
+
+} // namespace DeltaPatch
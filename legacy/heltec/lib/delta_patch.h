@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "crc.h"
+
+// =============================================================================
+// Delta Patch: streaming binary diff applied against the running image
+// =============================================================================
+// Patch OTA (start flag OTA_FLAG_PATCH) ships a diff instead of the full image.
+// The device rebuilds the new image from the running partition plus the patch
+// and streams it into Update. RAM use is fixed (one output block) no matter
+// how large the image is; patch bytes may arrive split across any chunk
+// boundaries.
+//
+// Patch stream:
+//   Header (16 bytes):
+//     [0-1]   magic 'F' 'P'
+//     [2]     version (1)
+//     [3]     reserved (0)
+//     [4-7]   old image size (uint32 LE)
+//     [8-11]  old image CRC32 (uint32 LE) - patch is refused on mismatch
+//     [12-15] new image size (uint32 LE)
+//   Ops, repeated until new image size bytes are produced:
+//     0x01 COPY   [offset u32 LE][len varint]              new = old[offset..]
+//     0x02 ADD    [offset u32 LE][len varint][len bytes]   new = old[offset..] + diff (mod 256)
+//     0x03 INSERT [len varint][len bytes]                  new = literal bytes
+//
+// Bytes after the image is complete (chunk padding) are ignored.
+// CRC32 is Crc::crc32Update (IEEE, zlib convention).
+// =============================================================================
+
+namespace DeltaPatch {
+
+constexpr uint8_t MAGIC0 = 'F';
+constexpr uint8_t MAGIC1 = 'P';
+constexpr uint8_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t OUT_BLOCK = 256;     // Output buffered before each write
+
+enum class Op : uint8_t {
+    Copy   = 0x01,
+    Add    = 0x02,
+    Insert = 0x03
+};
+
+enum class Status : uint8_t {
+    Ok,             // More patch input needed
+    Done,           // New image complete and flushed
+    BadHeader,
+    BaseMismatch,   // Running image is not the one the patch was built against
+    BadOp,
+    OutOfRange,     // Op reads past the old image or writes past the new one
+    ReadFail,
+    WriteFail
+};
+
+/** Read len bytes of the old image at offset. */
+typedef bool (*ReadFn)(void* ctx, uint32_t offset, uint8_t* dst, size_t len);
+/** Append len bytes to the new image. */
+typedef bool (*WriteFn)(void* ctx, const uint8_t* data, size_t len);
+
+class Applier {
+public:
+    /**
+     * Reset for a new patch. If verifyBase, the old image CRC32 from the
+     * header is checked against the running image before any output.
+     */
+    void begin(ReadFn read, WriteFn write, void* ctx, bool verifyBase = true);
+
+    /** Feed the next patch bytes. Sticky once Done or an error is returned. */
+    Status feed(const uint8_t* data, size_t len);
+
+    Status status() const { return _status; }
+    bool done() const { return _status == Status::Done; }
+    uint32_t oldSize() const { return _oldSize; }
+    uint32_t newSize() const { return _newSize; }
+    uint32_t produced() const { return _produced; }
+
+    static const char* statusName(Status s);
+
+private:
+    enum class Stage : uint8_t { Header, Opcode, Offset, Length, Copy, Add, Insert };
+
+    Status parseHeader();
+    Status startRun();
+    bool flush();
+    Status fail(Status s) { _status = s; return s; }
+
+    ReadFn _read = nullptr;
+    WriteFn _write = nullptr;
+    void* _ctx = nullptr;
+    bool _verifyBase = true;
+
+    Status _status = Status::Ok;
+    Stage _stage = Stage::Header;
+    Op _op = Op::Copy;
+    uint8_t _header[HEADER_SIZE];
+    uint8_t _fieldPos = 0;          // Bytes of header/offset/varint consumed
+    uint32_t _offset = 0;           // Old image read position of the current op
+    uint32_t _remaining = 0;        // Bytes left in the current op
+
+    uint32_t _oldSize = 0;
+    uint32_t _oldCrc32 = 0;
+    uint32_t _newSize = 0;
+    uint32_t _produced = 0;         // Bytes of new image emitted (incl. buffered)
+
+    uint8_t _out[OUT_BLOCK];
+    size_t _outLen = 0;
+};
+
+} // namespace DeltaPatch
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "core_config.h"
+#include <stdint.h>
+
+// =============================================================================
+// Duty Cycle: when a deep-sleeping node may go back to sleep, and for how long
+// =============================================================================
+// Deep sleep ends in a reset, so every wake is a boot: millis() restarts at
+// zero and the cycle is measured from there. State that spans wakes (the
+// LoRaWAN session, airtime ledger and offline backlog) is kept in RTC memory
+// and timed on CoreSystem::clockMs(). The app reports what is still in
+// progress as hold bits each loop:
+//
+//   Report        this wake's telemetry not yet queued
+//   Radio         TX scheduler not empty, uplink in flight or downlink unread
+//   Joining       no LoRaWAN session (restored or joined) yet
+//   Registering   server has not acknowledged registration
+//   StateChanges  rule state changes waiting for fPort 3
+//   Ota           transfer in progress (never cut off)
+//
+// With no holds the node sleeps for the rest of the interval. Holds other
+// than Ota give up after maxAwakeMs so a node out of coverage still sleeps;
+// the next wake tries again. A button wake keeps the node up for
+// buttonAwakeMs so the display can be read.
+// =============================================================================
+
+class DutyCycle {
+public:
+    enum Hold : uint8_t {
+        Report = 1 << 0,
+        Radio = 1 << 1,
+        Joining = 1 << 2,
+        Registering = 1 << 3,
+        StateChanges = 1 << 4,
+        Ota = 1 << 5,
+    };
+
+    static constexpr uint32_t MIN_SLEEP_MS = 1000;
+
+    void begin(const PowerConfig& config, uint32_t intervalMs, bool buttonWake) {
+        _config = config;
+        _intervalMs = intervalMs;
+        _buttonWake = buttonWake;
+    }
+
+    void setInterval(uint32_t intervalMs) { _intervalMs = intervalMs; }
+    bool enabled() const { return _config.deepSleepEnabled; }
+
+    /** Time to sleep now (ms since wake, holds); 0 = stay awake. */
+    uint32_t sleepMs(uint32_t awakeMs, uint8_t holds) const {
+        if (!_config.deepSleepEnabled || (holds & Ota)) return 0;
+        if (_buttonWake && awakeMs < _config.buttonAwakeMs) return 0;
+        if (holds != 0 && awakeMs < _config.maxAwakeMs) return 0;
+        uint32_t rest = awakeMs < _intervalMs ? _intervalMs - awakeMs : 0;
+        return rest > MIN_SLEEP_MS ? rest : MIN_SLEEP_MS;
+    }
+
+private:
+    PowerConfig _config;
+    uint32_t _intervalMs = 60000;
+    bool _buttonWake = false;
+};
@@ -4,7 +4,12 @@
 #include "hal_persistence.h"
 #include "core_logger.h"
 #include "control_driver.h"
+#include "crc.h"
+#include "rule_program.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <cstring>
+#include <math.h>
 
 // =============================================================================
 // Edge Rules Engine
@@ -16,8 +21,18 @@
 // Design principles:
 // - Schema-indexed references (compact, validated)
 // - Composable control execution (function pointers)
-// - Binary persistence to NVS
+// - Binary persistence to NVS (blobs guarded by CRC16; legacy blobs without
+//   a stored CRC are still accepted)
 // - State change queue (ring buffer) for uplink; batch within LoRaWAN payload limit
+// - Compiled rule index: rules bucketed by field and pre-sorted by priority per
+//   control, so evaluate() only visits rules whose input field changed
+// - Per-rule runtime state (O(1) each) for hysteresis, dwell, rate of change
+//   and release; rate rules and rules counting a dwell are visited every call
+// - Compound conditions as bytecode programs (rule_program.h) from a fixed
+//   pool; program rules read several fields, so they are visited every call
+// - Thread-safe: evaluation, rule edits, control state, the state change
+//   queue and flash I/O hold one engine mutex, so a downlinked rule edit
+//   never rebuilds the index under a running evaluate()
 // =============================================================================
 
 namespace EdgeRules {
@@ -31,9 +46,14 @@ enum class RuleOperator : uint8_t {
     LTE = 2,  // <=
     GTE = 3,  // >=
     EQ = 4,   // ==
-    NEQ = 5   // !=
+    NEQ = 5,  // !=
+    RATE_GT = 6,  // Rate of change (units per second) >
+    RATE_LT = 7   // Rate of change (units per second) <
 };
 
+static constexpr uint8_t NO_RELEASE = 0xFF;  // Rule leaves the control alone when it clears
+static constexpr uint8_t PROGRAM_RULE_MARKER = 0xFE;  // fPort 30 byte 0: program rule follows
+
 // What triggered a state change
 enum class TriggerSource : uint8_t {
     BOOT = 0,     // Initial state on boot
@@ -45,15 +65,26 @@ enum class TriggerSource : uint8_t {
 // -----------------------------------------------------------------------------
 // EdgeRule - compact rule representation using schema indices
 // -----------------------------------------------------------------------------
-// Binary format for downlink (fPort 30) - 12 bytes:
-// [0]    rule_id
-// [1]    flags: [enabled:1][operator:3][reserved:4]
-// [2]    field_idx
-// [3-6]  threshold (float LE)
-// [7]    control_idx
-// [8]    action_state
-// [9-10] cooldown_sec (uint16 LE)
-// [11]   priority
+// Binary format for downlink (fPort 30) - 20 bytes (12-byte rules from older
+// servers are still accepted; the extension then defaults to off):
+// [0]     rule_id
+// [1]     flags: [enabled:1][operator:3][dwell_in_samples:1][program:1][reserved:2]
+// [2]     field_idx (ignored by program rules)
+// [3-6]   threshold (float LE)
+// [7]     control_idx
+// [8]     action_state
+// [9-10]  cooldown_sec (uint16 LE)
+// [11]    priority
+// [12-15] hysteresis (float LE): once true, the condition holds until the
+//         value crosses threshold -/+ hysteresis (e.g. on below 80, off above 90)
+// [16-17] dwell (uint16 LE): condition must hold this many seconds (or
+//         samples) before it counts; 0 = at once
+// [18]    release_state: state applied when the condition clears and no
+//         other rule holds the control (0xFF = none)
+// [19]    reserved
+//
+// Program rules arrive as [0xFE][20-byte rule][bytecode]; the program's result
+// stands in for the field value (see rule_program.h).
 // -----------------------------------------------------------------------------
 struct EdgeRule {
     uint8_t id;             // Rule ID (0-254, 255 reserved)
@@ -64,12 +95,20 @@ struct EdgeRule {
     uint8_t priority;       // 0 = highest priority
     uint16_t cooldown_sec;  // Minimum time between triggers
     float threshold;        // Value to compare against
+    float hysteresis;       // Release band beyond threshold (0 = none)
+    uint16_t dwell;         // Seconds (or samples) the condition must hold
+    bool dwell_samples;     // dwell counts samples instead of seconds
+    uint8_t release_state;  // State when the condition clears (NO_RELEASE = none)
+    bool program;           // Condition input is a rule program, not field_idx
     uint32_t last_triggered_ms; // Timestamp of last trigger (runtime only)
     bool enabled;           // Is this rule active?
 
-    // Parse rule from binary payload (12 bytes)
+    static constexpr size_t BASE_SIZE = 12;   // Original format, no extension
+    static constexpr size_t SIZE = 20;
+
+    // Parse rule from binary payload (20 bytes, or the 12-byte original)
     bool fromBinary(const uint8_t* data, size_t len) {
-        if (len < 12) return false;
+        if (len < BASE_SIZE) return false;
 
         id = data[0];
         enabled = (data[1] & 0x80) != 0;
@@ -82,15 +121,30 @@ struct EdgeRule {
         priority = data[11];
         last_triggered_ms = 0;
 
+        hysteresis = 0.0f;
+        dwell = 0;
+        dwell_samples = false;
+        release_state = NO_RELEASE;
+        program = false;
+        if (len >= SIZE) {
+            dwell_samples = (data[1] & 0x08) != 0;
+            program = (data[1] & 0x04) != 0;
+            memcpy(&hysteresis, data + 12, sizeof(float));
+            if (!(hysteresis > 0.0f)) hysteresis = 0.0f;  // Negative or NaN: none
+            dwell = data[16] | (data[17] << 8);
+            release_state = data[18];
+        }
+
         return true;
     }
 
-    // Serialize rule to binary (12 bytes)
+    // Serialize rule to binary (20 bytes)
     size_t toBinary(uint8_t* buf, size_t max_len) const {
-        if (max_len < 12) return 0;
+        if (max_len < SIZE) return 0;
 
         buf[0] = id;
-        buf[1] = (enabled ? 0x80 : 0) | ((static_cast<uint8_t>(op) & 0x07) << 4);
+        buf[1] = (enabled ? 0x80 : 0) | ((static_cast<uint8_t>(op) & 0x07) << 4) |
+                 (dwell_samples ? 0x08 : 0) | (program ? 0x04 : 0);
         buf[2] = field_idx;
         memcpy(buf + 3, &threshold, sizeof(float));
         buf[7] = control_idx;
@@ -98,21 +152,46 @@ struct EdgeRule {
         buf[9] = cooldown_sec & 0xFF;
         buf[10] = (cooldown_sec >> 8) & 0xFF;
         buf[11] = priority;
+        memcpy(buf + 12, &hysteresis, sizeof(float));
+        buf[16] = dwell & 0xFF;
+        buf[17] = (dwell >> 8) & 0xFF;
+        buf[18] = release_state;
+        buf[19] = 0;
 
-        return 12;
+        return SIZE;
     }
 
+    bool isRate() const { return op == RuleOperator::RATE_GT || op == RuleOperator::RATE_LT; }
+
     // Human-readable representation for debugging
     String toText() const {
-        char buf[128];
-        const char* op_str[] = {"<", ">", "<=", ">=", "==", "!="};
-        snprintf(buf, sizeof(buf), "rule[%d]: f%d %s %.2f -> c%d:s%d (pri=%d, cd=%ds, en=%d)",
-                 id, field_idx, op_str[static_cast<int>(op)], threshold,
-                 control_idx, action_state, priority, cooldown_sec, enabled);
+        char buf[160];
+        const char* op_str[] = {"<", ">", "<=", ">=", "==", "!=", "rate>", "rate<"};
+        int n = snprintf(buf, sizeof(buf), "rule[%d]: %s%d %s %.2f -> c%d:s%d (pri=%d, cd=%ds, en=%d",
+                         id, program ? "prog" : "f", program ? id : field_idx, op_str[static_cast<int>(op)], threshold,
+                         control_idx, action_state, priority, cooldown_sec, enabled);
+        if (hysteresis > 0.0f && n < (int)sizeof(buf)) n += snprintf(buf + n, sizeof(buf) - n, ", hyst=%.2f", hysteresis);
+        if (dwell > 0 && n < (int)sizeof(buf)) n += snprintf(buf + n, sizeof(buf) - n, ", dwell=%d%s", dwell, dwell_samples ? "x" : "s");
+        if (release_state != NO_RELEASE && n < (int)sizeof(buf)) n += snprintf(buf + n, sizeof(buf) - n, ", release=s%d", release_state);
+        if (n < (int)sizeof(buf)) snprintf(buf + n, sizeof(buf) - n, ")");
         return String(buf);
     }
 };
 
+// -----------------------------------------------------------------------------
+// RuleRuntime - per-rule evaluation state (RAM only). Follows its rule by id
+// when other rules change; reset when the rule itself is replaced.
+// -----------------------------------------------------------------------------
+struct RuleRuntime {
+    float last_value;       // Rate rules: previous sample
+    uint32_t last_ms;       // Rate rules: time of previous sample
+    uint32_t since_ms;      // When the raw condition last became true
+    uint16_t samples;       // Consecutive samples the raw condition held
+    bool has_last;          // last_value/last_ms are valid
+    bool raw;               // Condition including hysteresis, before dwell
+    bool engaged;           // This rule set the control's current state
+};
+
 // -----------------------------------------------------------------------------
 // ControlState - current state of a control
 // -----------------------------------------------------------------------------
@@ -188,13 +267,21 @@ using ControlExecuteFn = bool(*)(uint8_t state_idx);
 // -----------------------------------------------------------------------------
 class EdgeRulesEngine {
 public:
-    static constexpr uint8_t MAX_RULES = 32;
+    static constexpr uint8_t MAX_RULES = 128;
+    static constexpr uint8_t MAX_PROGRAMS = 16;     // Program rules (64 B each)
     static constexpr uint8_t MAX_CONTROLS = 16;
+    static constexpr uint8_t MAX_FIELDS = MessageSchema::MAX_FIELDS;
     static constexpr const char* PERSISTENCE_NAMESPACE = "rules";
     static constexpr const char* PERSISTENCE_KEY_COUNT = "count";
     static constexpr const char* PERSISTENCE_KEY_DATA = "data";
     static constexpr const char* PERSISTENCE_KEY_SC_COUNT = "sc_count";
     static constexpr const char* PERSISTENCE_KEY_SC_DATA = "sc_data";
+    static constexpr const char* PERSISTENCE_KEY_CRC = "data_crc";
+    static constexpr const char* PERSISTENCE_KEY_SC_CRC = "sc_crc";
+    static constexpr const char* PERSISTENCE_KEY_PROG_COUNT = "prog_count";
+    static constexpr const char* PERSISTENCE_KEY_PROG_DATA = "prog_data";
+    static constexpr const char* PERSISTENCE_KEY_PROG_CRC = "prog_crc";
+    static constexpr uint32_t NO_CRC = 0xFFFFFFFF;   // Key absent (written before CRCs)
 
     EdgeRulesEngine(const MessageSchema::Schema& schema, IPersistenceHal* persistence)
         : _schema(schema), _persistence(persistence), _rule_count(0),
@@ -205,15 +292,26 @@ public:
             _executors[i] = nullptr;
             _drivers[i] = nullptr;
         }
+        memset(_programs, 0, sizeof(_programs));
+        rebuildIndex();
+        _mutex = xSemaphoreCreateMutex();
     }
 
+    ~EdgeRulesEngine() {
+        if (_mutex) vSemaphoreDelete(_mutex);
+    }
+
+    EdgeRulesEngine(const EdgeRulesEngine&) = delete;
+    EdgeRulesEngine& operator=(const EdgeRulesEngine&) = delete;
+
     // -------------------------------------------------------------------------
     // Rule Management
     // -------------------------------------------------------------------------
 
-    // Add or update a rule from binary payload
+    // Add or update a rule from binary payload (EdgeRule::SIZE, or BASE_SIZE)
     bool addOrUpdateRule(const uint8_t* payload, size_t len) {
-        if (len < 12) {
+        Lock hold(*this);
+        if (len < EdgeRule::BASE_SIZE) {
             LOGW("Rules", "Invalid rule payload length: %d", len);
             return false;
         }
@@ -223,41 +321,69 @@ public:
             LOGW("Rules", "Failed to parse rule");
             return false;
         }
+        rule.program = false;  // Programs only arrive through addProgramRule
+        if (!validateRule(rule) || !storeRule(rule)) return false;
 
-        // Validate indices against schema
-        if (!_schema.isValidFieldIndex(rule.field_idx)) {
-            LOGW("Rules", "Invalid field index: %d", rule.field_idx);
-            return false;
-        }
-        if (!_schema.isValidControlIndex(rule.control_idx)) {
-            LOGW("Rules", "Invalid control index: %d", rule.control_idx);
+        freeProgram(rule.id);
+        rebuildIndex(rule.id);
+        return true;
+    }
+
+    // Add or update a program rule: a 20-byte rule followed by its bytecode
+    // (the payload after the 0xFE marker)
+    bool addProgramRule(const uint8_t* payload, size_t len) {
+        Lock hold(*this);
+        if (len <= EdgeRule::SIZE) {
+            LOGW("Rules", "Invalid program rule length: %d", len);
             return false;
         }
-        if (!_schema.isValidStateIndex(rule.control_idx, rule.action_state)) {
-            LOGW("Rules", "Invalid state index: %d for control %d",
-                 rule.action_state, rule.control_idx);
+
+        EdgeRule rule;
+        rule.fromBinary(payload, EdgeRule::SIZE);
+        rule.program = true;
+        const uint8_t* code = payload + EdgeRule::SIZE;
+        size_t code_len = len - EdgeRule::SIZE;
+        if (!RuleProgram::verify(code, code_len, _schema.field_count)) {
+            LOGW("Rules", "Rejected program for rule %d (%d bytes)", rule.id, code_len);
             return false;
         }
+        if (!validateRule(rule)) return false;
 
-        // Find existing rule or add new
-        int existing = findRuleById(rule.id);
-        if (existing >= 0) {
-            _rules[existing] = rule;
-            LOGI("Rules", "Updated %s", rule.toText().c_str());
-        } else {
-            if (_rule_count >= MAX_RULES) {
-                LOGW("Rules", "Max rules reached (%d)", MAX_RULES);
-                return false;
-            }
-            _rules[_rule_count++] = rule;
-            LOGI("Rules", "Added %s", rule.toText().c_str());
+        RuleProgram* slot = findProgram(rule.id);
+        if (!slot) slot = findProgram(rule.id, true);
+        if (!slot) {
+            LOGW("Rules", "Max program rules reached (%d)", MAX_PROGRAMS);
+            return false;
         }
+        if (!storeRule(rule)) return false;
+        slot->rule_id = rule.id;
+        slot->len = (uint8_t)code_len;
+        memcpy(slot->code, code, code_len);
 
+        rebuildIndex(rule.id);
         return true;
     }
 
+    // Wall-clock time for time-of-day predicates: local seconds since
+    // midnight as of now_ms. Programs see no time until this is called.
+    void setTimeOfDay(uint32_t seconds_of_day, uint32_t now_ms) {
+        Lock hold(*this);
+        _tod_base_sec = seconds_of_day % 86400;
+        _tod_sync_ms = now_ms;
+        _tod_synced = true;
+        LOGI("Rules", "Time of day %02lu:%02lu", (unsigned long)(_tod_base_sec / 3600),
+             (unsigned long)(_tod_base_sec / 60 % 60));
+    }
+
+    // Local minute of day (0-1439), or -1 before the first time sync
+    int16_t minuteOfDay(uint32_t now_ms) const {
+        if (!_tod_synced) return -1;
+        return (int16_t)((_tod_base_sec + (now_ms - _tod_sync_ms) / 1000) % 86400 / 60);
+    }
+
     // Delete a rule by ID
     bool deleteRule(uint8_t id) {
+        Lock hold(*this);
         int idx = findRuleById(id);
         if (idx < 0) {
             LOGW("Rules", "Rule %d not found for deletion", id);
@@ -269,6 +395,8 @@ public:
             _rules[i] = _rules[i + 1];
         }
         _rule_count--;
+        freeProgram(id);
+        rebuildIndex();
 
         LOGI("Rules", "Deleted rule %d", id);
         return true;
@@ -276,7 +404,10 @@ public:
 
     // Clear all rules
     void clearAllRules() {
+        Lock hold(*this);
         _rule_count = 0;
+        memset(_programs, 0, sizeof(_programs));
+        rebuildIndex();
         LOGI("Rules", "Cleared all rules");
     }
 
@@ -287,81 +418,114 @@ public:
     // Rule Evaluation
     // -------------------------------------------------------------------------
 
-    // Evaluate all rules against current field values
+    // Evaluate rules against current field values; call once per sample.
+    //
+    // Only rules whose input field changed since the previous call are
+    // re-tested; their condition results are cached per rule. Rate rules and
+    // rules counting a dwell depend on time as well, so they are re-tested on
+    // every call, as are program rules. A control is re-resolved only when one of its rule
+    // conditions flipped, or when it was left pending (manual override,
+    // cooldown, external state change, failed driver). Resolution walks the
+    // control's rules in priority order, so the outcome matches a full scan:
+    // highest-priority matching rule wins, ties go to the rule added first.
     void evaluate(const float* field_values, uint8_t field_count, uint32_t now_ms) {
+        Lock hold(*this);
         if (_rule_count == 0) return;
-
-        // Collect triggered rules, grouped by control
-        struct TriggeredRule {
-            uint8_t rule_idx;
-            uint8_t priority;
-        };
-        TriggeredRule triggered[MAX_RULES];
-        uint8_t triggered_count = 0;
-
-        for (uint8_t i = 0; i < _rule_count; i++) {
-            const EdgeRule& rule = _rules[i];
-
-            // Skip disabled rules
-            if (!rule.enabled) continue;
-
-            // Skip if field index out of range
-            if (rule.field_idx >= field_count) continue;
-
-            // Check cooldown
-            if (rule.last_triggered_ms > 0 &&
-                (now_ms - rule.last_triggered_ms) < (rule.cooldown_sec * 1000)) {
-                continue;
-            }
-
-            // Skip if control is in manual mode
-            if (isManualOverride(rule.control_idx, now_ms)) {
-                continue;
+        if (field_count > MAX_FIELDS) field_count = MAX_FIELDS;
+
+        // Timed rules as of the start of this call, so none is visited twice
+        uint32_t timed[RULE_WORDS];
+        for (uint8_t w = 0; w < RULE_WORDS; w++) timed[w] = _rate_bits[w] | _dwell_bits[w] | _program_bits[w];
+        int16_t minute_of_day = minuteOfDay(now_ms);
+
+        uint32_t dirty = collectDirtyFields(field_values, field_count);
+        while (dirty) {
+            uint8_t field_idx = __builtin_ctz(dirty);
+            dirty &= dirty - 1;
+
+            for (uint8_t k = _field_start[field_idx]; k < _field_start[field_idx + 1]; k++) {
+                uint8_t rule_idx = _field_rules[k];
+                if (testBit(timed, rule_idx)) continue;
+                float value = field_idx < field_count ? field_values[field_idx] : NAN;
+                updateCondition(rule_idx, value, now_ms);
             }
+        }
 
-            // Evaluate condition
-            float value = field_values[rule.field_idx];
-            if (evaluateCondition(rule.op, value, rule.threshold)) {
-                triggered[triggered_count++] = {i, rule.priority};
+        for (uint8_t w = 0; w < RULE_WORDS; w++) {
+            uint32_t bits = timed[w];
+            while (bits) {
+                uint8_t rule_idx = (uint8_t)(w * 32 + __builtin_ctz(bits));
+                bits &= bits - 1;
+                float value;
+                if (testBit(_program_bits, rule_idx)) {
+                    value = _programs[_rule_program[rule_idx]].run(field_values, field_count, minute_of_day);
+                } else {
+                    uint8_t field_idx = _rules[rule_idx].field_idx;
+                    value = field_idx < field_count ? field_values[field_idx] : NAN;
+                }
+                updateCondition(rule_idx, value, now_ms);
             }
         }
 
-        if (triggered_count == 0) return;
-
-        // Group by control and pick highest priority for each
-        // (simple approach: iterate and update if higher priority)
-        uint8_t best_rule_for_control[MAX_CONTROLS];
-        uint8_t best_priority_for_control[MAX_CONTROLS];
-        for (uint8_t i = 0; i < MAX_CONTROLS; i++) {
-            best_rule_for_control[i] = 0xFF;  // Invalid
-            best_priority_for_control[i] = 0xFF;
+        uint32_t pending = _pending_controls;
+        _pending_controls = 0;
+        while (pending) {
+            uint8_t ctrl_idx = __builtin_ctz(pending);
+            pending &= pending - 1;
+            resolveControl(ctrl_idx, now_ms);
         }
+    }
 
-        for (uint8_t i = 0; i < triggered_count; i++) {
-            uint8_t rule_idx = triggered[i].rule_idx;
-            uint8_t ctrl_idx = _rules[rule_idx].control_idx;
-            uint8_t priority = triggered[i].priority;
+    // Reference for evaluate(): re-tests every rule and resolves every
+    // control from one pass over the whole rule list, without the index or
+    // the change tracking (what evaluate() did before the index). Same
+    // outcome; the host tests and the bench check evaluate() against it.
+    void evaluateLinear(const float* field_values, uint8_t field_count, uint32_t now_ms) {
+        Lock hold(*this);
+        if (_rule_count == 0) return;
+        if (field_count > MAX_FIELDS) field_count = MAX_FIELDS;
+        int16_t minute_of_day = minuteOfDay(now_ms);
 
-            if (best_rule_for_control[ctrl_idx] == 0xFF ||
-                priority < best_priority_for_control[ctrl_idx]) {
-                best_rule_for_control[ctrl_idx] = rule_idx;
-                best_priority_for_control[ctrl_idx] = priority;
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            if (!indexable(i)) continue;
+            float value;
+            if (_rules[i].program) {
+                value = _programs[_rule_program[i]].run(field_values, field_count, minute_of_day);
+            } else {
+                value = _rules[i].field_idx < field_count ? field_values[_rules[i].field_idx] : NAN;
             }
+            updateCondition(i, value, now_ms);
         }
 
-        // Execute winning rules
-        for (uint8_t ctrl_idx = 0; ctrl_idx < MAX_CONTROLS; ctrl_idx++) {
-            if (best_rule_for_control[ctrl_idx] == 0xFF) continue;
-
-            uint8_t rule_idx = best_rule_for_control[ctrl_idx];
-            EdgeRule& rule = _rules[rule_idx];
-
-            // Only act if state is different
-            if (_control_states[ctrl_idx].current_state != rule.action_state) {
-                executeAction(ctrl_idx, rule.action_state, TriggerSource::RULE, rule.id, now_ms);
-                rule.last_triggered_ms = now_ms;
+        // Best true rule per control (lowest priority value, first on ties),
+        // then whether a true rule ranked above it is cooling down
+        int winner[MAX_CONTROLS], engaged[MAX_CONTROLS];
+        bool cooling[MAX_CONTROLS] = {false};
+        for (uint8_t c = 0; c < MAX_CONTROLS; c++) winner[c] = engaged[c] = -1;
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            if (!indexable(i)) continue;
+            uint8_t c = _rules[i].control_idx;
+            if (engaged[c] < 0 && _runtime[i].engaged) engaged[c] = i;
+            if (!conditionBit(i) || inCooldown(_rules[i], now_ms)) continue;
+            if (winner[c] < 0 || _rules[i].priority < _rules[winner[c]].priority) winner[c] = i;
+        }
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            if (!indexable(i) || !conditionBit(i) || !inCooldown(_rules[i], now_ms)) continue;
+            uint8_t c = _rules[i].control_idx;
+            int w = winner[c];
+            if (w < 0 || _rules[i].priority < _rules[w].priority ||
+                (_rules[i].priority == _rules[w].priority && i < w)) {
+                cooling[c] = true;
             }
         }
+
+        for (uint8_t c = 0; c < MAX_CONTROLS; c++) {
+            if (isManualOverride(c, now_ms)) continue;
+            applyControl(c, winner[c], engaged[c], cooling[c], now_ms);
+        }
+        // A later evaluate() starts from a full pass
+        _index_primed = false;
+        _pending_controls = (uint32_t)((1ull << MAX_CONTROLS) - 1);
     }
 
     // -------------------------------------------------------------------------
@@ -371,55 +535,30 @@ public:
     // Set control state (from any source)
     bool setControlState(uint8_t ctrl_idx, uint8_t state_idx, TriggerSource source,
                          uint8_t rule_id, uint32_t now_ms) {
-        if (ctrl_idx >= MAX_CONTROLS) return false;
-        if (!_schema.isValidControlIndex(ctrl_idx)) return false;
-        if (!_schema.isValidStateIndex(ctrl_idx, state_idx)) return false;
-
-        uint8_t old_state = _control_states[ctrl_idx].current_state;
-        if (old_state == state_idx) return true;  // No change needed
-
-        // Record state change
-        _control_states[ctrl_idx].current_state = state_idx;
-
-        // Queue state change for transmission (drop oldest if full so latest is kept)
-        StateChange change = {
-            ctrl_idx,
-            state_idx,
-            old_state,
-            source,
-            rule_id,
-            now_ms,
-            _sequence_id++
-        };
-        if (_queue_count >= STATE_CHANGE_QUEUE_CAP) {
-            _queue_head = (_queue_head + 1) % STATE_CHANGE_QUEUE_CAP;
-            _queue_count--;
-            LOGW("Rules", "State change queue full, dropped oldest");
-        }
-        size_t write_idx = (_queue_head + _queue_count) % STATE_CHANGE_QUEUE_CAP;
-        _state_change_queue[write_idx] = change;
-        _queue_count++;
-
-        LOGI("Rules", "State change: %s", change.toText().c_str());
-        return true;
+        Lock hold(*this);
+        return changeControlState(ctrl_idx, state_idx, source, rule_id, now_ms);
     }
 
     // Set manual override for a control
     void setManualOverride(uint8_t ctrl_idx, uint32_t duration_ms, uint32_t now_ms) {
+        Lock hold(*this);
         if (ctrl_idx >= MAX_CONTROLS) return;
 
         _control_states[ctrl_idx].is_manual = true;
         _control_states[ctrl_idx].manual_until_ms = (duration_ms > 0) ? now_ms + duration_ms : 0;
+        _pending_controls |= (1u << ctrl_idx);
 
         LOGI("Rules", "Manual override set for control %d, duration=%dms", ctrl_idx, duration_ms);
     }
 
     // Clear manual override for a control
     void clearManualOverride(uint8_t ctrl_idx) {
+        Lock hold(*this);
         if (ctrl_idx >= MAX_CONTROLS) return;
 
         _control_states[ctrl_idx].is_manual = false;
         _control_states[ctrl_idx].manual_until_ms = 0;
+        _pending_controls |= (1u << ctrl_idx);
 
         LOGI("Rules", "Manual override cleared for control %d", ctrl_idx);
     }
@@ -436,6 +575,7 @@ public:
 
     // Get current control state
     ControlState getControlState(uint8_t ctrl_idx) const {
+        Lock hold(*this);
         if (ctrl_idx >= MAX_CONTROLS) return {0, false, 0};
         return _control_states[ctrl_idx];
     }
@@ -474,6 +614,7 @@ public:
 
     // Fill buffer with up to floor(max_len/11) events from queue head. Returns total bytes written; sets *out_count.
     size_t formatStateChangeBatch(uint8_t* buffer, size_t max_len, size_t* out_count) const {
+        Lock hold(*this);
         if (!buffer || !out_count || _queue_count == 0) {
             if (out_count) *out_count = 0;
             return 0;
@@ -494,11 +635,13 @@ public:
     }
 
     String stateChangeToText() const {
+        Lock hold(*this);
         if (_queue_count == 0) return "";
         return _state_change_queue[_queue_head].toText();
     }
 
     void clearStateChangeBatch(size_t count) {
+        Lock hold(*this);
         if (count == 0) return;
         if (count >= _queue_count) {
             _queue_count = 0;
@@ -514,6 +657,7 @@ public:
     // -------------------------------------------------------------------------
 
     void loadFromFlash() {
+        Lock hold(*this);
         if (!_persistence) {
             LOGW("Rules", "No persistence HAL available");
             return;
@@ -528,24 +672,30 @@ public:
         if (_rule_count > MAX_RULES) _rule_count = MAX_RULES;
 
         if (_rule_count > 0) {
-            std::string data = _persistence->loadString(PERSISTENCE_KEY_DATA, "");
-            if (data.length() == _rule_count * 12) {
+            // Records are EdgeRule::SIZE, or BASE_SIZE when saved by older firmware
+            uint8_t blob[MAX_RULES * EdgeRule::SIZE];
+            size_t loaded = _persistence->loadBytes(PERSISTENCE_KEY_DATA, blob, sizeof(blob));
+            size_t record = loaded == (size_t)_rule_count * EdgeRule::SIZE ? EdgeRule::SIZE
+                          : loaded == (size_t)_rule_count * EdgeRule::BASE_SIZE ? EdgeRule::BASE_SIZE : 0;
+            if (record > 0 && blobCrcOk(PERSISTENCE_KEY_CRC, blob, loaded)) {
                 for (uint8_t i = 0; i < _rule_count; i++) {
-                    _rules[i].fromBinary(reinterpret_cast<const uint8_t*>(data.c_str()) + i * 12, 12);
+                    _rules[i].fromBinary(blob + i * record, record);
                 }
                 LOGI("Rules", "Loaded %d rules from flash", _rule_count);
             } else {
-                LOGW("Rules", "Invalid rule data length, clearing");
+                LOGW("Rules", "Invalid rule data (length/CRC), clearing");
                 _rule_count = 0;
             }
         }
+        loadPrograms();
+        rebuildIndex();
 
         // Load state change queue (unsent changes survive reboot)
         uint32_t sc_count = _persistence->loadU32(PERSISTENCE_KEY_SC_COUNT, 0);
         if (sc_count > 0 && sc_count <= STATE_CHANGE_QUEUE_CAP) {
             uint8_t blob[STATE_CHANGE_QUEUE_CAP * 11];
             size_t loaded = _persistence->loadBytes(PERSISTENCE_KEY_SC_DATA, blob, sizeof(blob));
-            if (loaded == sc_count * 11) {
+            if (loaded == sc_count * 11 && blobCrcOk(PERSISTENCE_KEY_SC_CRC, blob, loaded)) {
                 _queue_head = 0;
                 _queue_count = sc_count;
                 for (size_t i = 0; i < sc_count; i++) {
@@ -553,7 +703,7 @@ public:
                 }
                 LOGI("Rules", "Loaded %d pending state changes from flash", (int)sc_count);
             } else {
-                LOGW("Rules", "Invalid state change queue data length, clearing");
+                LOGW("Rules", "Invalid state change queue data (length/CRC), clearing");
             }
         }
 
@@ -561,6 +711,7 @@ public:
     }
 
     void saveToFlash() {
+        Lock hold(*this);
         if (!_persistence) {
             LOGW("Rules", "No persistence HAL available");
             return;
@@ -574,19 +725,22 @@ public:
         _persistence->saveU32(PERSISTENCE_KEY_COUNT, _rule_count);
 
         if (_rule_count > 0) {
-            uint8_t buffer[MAX_RULES * 12];
+            uint8_t buffer[MAX_RULES * EdgeRule::SIZE];
+            size_t len = (size_t)_rule_count * EdgeRule::SIZE;
             for (uint8_t i = 0; i < _rule_count; i++) {
-                _rules[i].toBinary(buffer + i * 12, 12);
+                _rules[i].toBinary(buffer + i * EdgeRule::SIZE, EdgeRule::SIZE);
             }
-            _persistence->saveString(PERSISTENCE_KEY_DATA,
-                std::string(reinterpret_cast<char*>(buffer), _rule_count * 12));
+            _persistence->saveBytes(PERSISTENCE_KEY_DATA, buffer, len);
+            _persistence->saveU32(PERSISTENCE_KEY_CRC, Crc::crc16Ccitt(buffer, len));
         }
+        savePrograms();
 
         _persistence->end();
         LOGI("Rules", "Saved %d rules to flash", _rule_count);
     }
 
     void saveStateChangeQueueToFlash() {
+        Lock hold(*this);
         if (!_persistence) return;
         if (!_persistence->begin(PERSISTENCE_NAMESPACE)) return;
         _persistence->saveU32(PERSISTENCE_KEY_SC_COUNT, (uint32_t)_queue_count);
@@ -598,11 +752,126 @@ public:
                 offset += _state_change_queue[idx].toBinary(blob + offset, sizeof(blob) - offset);
             }
             _persistence->saveBytes(PERSISTENCE_KEY_SC_DATA, blob, _queue_count * 11);
+            _persistence->saveU32(PERSISTENCE_KEY_SC_CRC, Crc::crc16Ccitt(blob, _queue_count * 11));
         }
         _persistence->end();
     }
 
 private:
+    // Schema indices and reserved ids
+    bool validateRule(const EdgeRule& rule) const {
+        if (rule.id == PROGRAM_RULE_MARKER) {
+            LOGW("Rules", "Rule id %d is reserved", rule.id);
+            return false;
+        }
+        if (!rule.program && !_schema.isValidFieldIndex(rule.field_idx)) {
+            LOGW("Rules", "Invalid field index: %d", rule.field_idx);
+            return false;
+        }
+        if (!_schema.isValidControlIndex(rule.control_idx)) {
+            LOGW("Rules", "Invalid control index: %d", rule.control_idx);
+            return false;
+        }
+        if (!_schema.isValidStateIndex(rule.control_idx, rule.action_state)) {
+            LOGW("Rules", "Invalid state index: %d for control %d",
+                 rule.action_state, rule.control_idx);
+            return false;
+        }
+        if (rule.release_state != NO_RELEASE &&
+            !_schema.isValidStateIndex(rule.control_idx, rule.release_state)) {
+            LOGW("Rules", "Invalid release state: %d for control %d",
+                 rule.release_state, rule.control_idx);
+            return false;
+        }
+        return true;
+    }
+
+    // Find existing rule or add new; the caller rebuilds the index
+    bool storeRule(const EdgeRule& rule) {
+        int existing = findRuleById(rule.id);
+        if (existing >= 0) {
+            _rules[existing] = rule;
+            LOGI("Rules", "Updated %s", rule.toText().c_str());
+        } else {
+            if (_rule_count >= MAX_RULES) {
+                LOGW("Rules", "Max rules reached (%d)", MAX_RULES);
+                return false;
+            }
+            _rules[_rule_count++] = rule;
+            LOGI("Rules", "Added %s", rule.toText().c_str());
+        }
+        return true;
+    }
+
+    // Program slot owned by rule id, or a free slot when free is set
+    RuleProgram* findProgram(uint8_t id, bool free = false) {
+        for (uint8_t i = 0; i < MAX_PROGRAMS; i++) {
+            if (free ? _programs[i].len == 0 : (_programs[i].len > 0 && _programs[i].rule_id == id)) {
+                return &_programs[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void freeProgram(uint8_t id) {
+        RuleProgram* slot = findProgram(id);
+        if (slot) slot->len = 0;
+    }
+
+    // Program records: [rule_id][len][code]. Persistence namespace must be open.
+    void savePrograms() {
+        uint8_t blob[MAX_PROGRAMS * (2 + RuleProgram::MAX_LEN)];
+        size_t len = 0;
+        uint8_t count = 0;
+        for (const RuleProgram& program : _programs) {
+            if (program.len == 0) continue;
+            blob[len++] = program.rule_id;
+            blob[len++] = program.len;
+            memcpy(blob + len, program.code, program.len);
+            len += program.len;
+            count++;
+        }
+        _persistence->saveU32(PERSISTENCE_KEY_PROG_COUNT, count);
+        if (count > 0) {
+            _persistence->saveBytes(PERSISTENCE_KEY_PROG_DATA, blob, len);
+            _persistence->saveU32(PERSISTENCE_KEY_PROG_CRC, Crc::crc16Ccitt(blob, len));
+        }
+    }
+
+    // Programs that no longer verify (schema changed) are dropped; their
+    // rules stay out of the index
+    void loadPrograms() {
+        memset(_programs, 0, sizeof(_programs));
+        uint32_t count = _persistence->loadU32(PERSISTENCE_KEY_PROG_COUNT, 0);
+        if (count == 0 || count > MAX_PROGRAMS) return;
+
+        uint8_t blob[MAX_PROGRAMS * (2 + RuleProgram::MAX_LEN)];
+        size_t loaded = _persistence->loadBytes(PERSISTENCE_KEY_PROG_DATA, blob, sizeof(blob));
+        if (loaded == 0 || _persistence->loadU32(PERSISTENCE_KEY_PROG_CRC, NO_CRC) != Crc::crc16Ccitt(blob, loaded)) {
+            LOGW("Rules", "Invalid program data (length/CRC), clearing");
+            return;
+        }
+        size_t off = 0;
+        for (uint8_t i = 0; i < count && off + 2 <= loaded; i++) {
+            uint8_t id = blob[off], len = blob[off + 1];
+            const uint8_t* code = blob + off + 2;
+            off += 2 + len;
+            if (off > loaded || !RuleProgram::verify(code, len, _schema.field_count)) {
+                LOGW("Rules", "Dropped stored program for rule %d", id);
+                continue;
+            }
+            _programs[i].rule_id = id;
+            _programs[i].len = len;
+            memcpy(_programs[i].code, code, len);
+        }
+    }
+
+    // Persistence namespace must be open
+    bool blobCrcOk(const char* crcKey, const uint8_t* blob, size_t len) {
+        uint32_t stored = _persistence->loadU32(crcKey, NO_CRC);
+        return stored == NO_CRC || stored == Crc::crc16Ccitt(blob, len);
+    }
+
     const MessageSchema::Schema& _schema;
     IPersistenceHal* _persistence;
 
@@ -618,6 +887,48 @@ private:
     size_t _queue_count;
     uint16_t _sequence_id;
 
+    // Compiled index (rebuilt whenever the rule set changes)
+    // _field_rules[_field_start[f] .. _field_start[f+1]) : enabled rules reading field f
+    // _control_rules[_control_start[c] .. _control_start[c+1]) : enabled rules driving
+    //   control c, sorted by priority (stable, so insertion order breaks ties)
+    uint8_t _field_start[MAX_FIELDS + 1];
+    uint8_t _field_rules[MAX_RULES];
+    uint8_t _control_start[MAX_CONTROLS + 1];
+    uint8_t _control_rules[MAX_RULES];
+    static constexpr uint8_t RULE_WORDS = (MAX_RULES + 31) / 32;
+    RuleRuntime _runtime[MAX_RULES];
+    uint8_t _runtime_ids[MAX_RULES];                  // Rule id each _runtime slot belongs to
+    uint8_t _runtime_count = 0;
+    uint32_t _condition_bits[RULE_WORDS];             // Cached condition result per rule
+    uint32_t _rate_bits[RULE_WORDS];                  // Enabled rate rules
+    uint32_t _dwell_bits[RULE_WORDS];                 // Raw condition true, dwell not yet met
+    uint32_t _program_bits[RULE_WORDS];               // Enabled program rules
+    static constexpr uint8_t NO_PROGRAM = 0xFF;
+    RuleProgram _programs[MAX_PROGRAMS];              // Program pool, keyed by rule id
+    uint8_t _rule_program[MAX_RULES];                 // Rule -> program slot (NO_PROGRAM)
+    uint32_t _tod_base_sec = 0;                       // Seconds of day at _tod_sync_ms
+    uint32_t _tod_sync_ms = 0;
+    bool _tod_synced = false;
+    uint32_t _last_values[MAX_FIELDS];                // Raw float bits seen last evaluate
+    uint8_t _last_field_count = 0;
+    bool _index_primed = false;                       // False until first evaluate after rebuild
+    uint32_t _pending_controls = 0;                   // Controls to re-resolve next evaluate
+
+    SemaphoreHandle_t _mutex = nullptr;
+
+    // Holds the engine mutex for a scope; public entry points take it once
+    // and only call private members, so it is never taken twice
+    struct Lock {
+        explicit Lock(const EdgeRulesEngine& engine) : _engine(engine) {
+            xSemaphoreTake(_engine._mutex, portMAX_DELAY);
+        }
+        ~Lock() { xSemaphoreGive(_engine._mutex); }
+        const EdgeRulesEngine& _engine;
+    };
+
+    static_assert(MAX_CONTROLS <= 32, "pending control mask is 32 bits");
+    static_assert(MAX_FIELDS <= 32, "dirty field mask is 32 bits");
+
     // Find rule index by ID (-1 if not found)
     int findRuleById(uint8_t id) const {
         for (uint8_t i = 0; i < _rule_count; i++) {
@@ -626,8 +937,303 @@ private:
         return -1;
     }
 
-    // Evaluate a condition
+    bool conditionBit(uint8_t rule_idx) const {
+        return (_condition_bits[rule_idx >> 5] >> (rule_idx & 31)) & 1u;
+    }
+
+    void setConditionBit(uint8_t rule_idx, bool value) {
+        setBit(_condition_bits, rule_idx, value);
+    }
+
+    static bool testBit(const uint32_t* bits, uint8_t rule_idx) {
+        return (bits[rule_idx >> 5] >> (rule_idx & 31)) & 1u;
+    }
+
+    static void setBit(uint32_t* bits, uint8_t rule_idx, bool value) {
+        if (value) bits[rule_idx >> 5] |= (1u << (rule_idx & 31));
+        else bits[rule_idx >> 5] &= ~(1u << (rule_idx & 31));
+    }
+
+    // Rebuild field buckets and per-control priority lists from _rules.
+    // Evaluation state carries over by rule id (reset_id starts over); the
+    // next evaluate re-tests every field and re-resolves every control.
+    void rebuildIndex(int reset_id = -1) {
+        remapRuntime(reset_id);
+
+        uint8_t field_counts[MAX_FIELDS] = {0};
+        uint8_t control_counts[MAX_CONTROLS] = {0};
+
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            RuleProgram* slot = _rules[i].program ? findProgram(_rules[i].id) : nullptr;
+            _rule_program[i] = slot ? (uint8_t)(slot - _programs) : NO_PROGRAM;
+        }
+
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            const EdgeRule& rule = _rules[i];
+            if (!indexable(i)) continue;
+            if (!rule.program) field_counts[rule.field_idx]++;
+            control_counts[rule.control_idx]++;
+        }
+
+        _field_start[0] = 0;
+        for (uint8_t f = 0; f < MAX_FIELDS; f++) {
+            _field_start[f + 1] = _field_start[f] + field_counts[f];
+        }
+        _control_start[0] = 0;
+        for (uint8_t c = 0; c < MAX_CONTROLS; c++) {
+            _control_start[c + 1] = _control_start[c] + control_counts[c];
+        }
+
+        memset(_rate_bits, 0, sizeof(_rate_bits));
+        memset(_program_bits, 0, sizeof(_program_bits));
+        uint8_t field_fill[MAX_FIELDS];
+        uint8_t control_fill[MAX_CONTROLS];
+        memcpy(field_fill, _field_start, sizeof(field_fill));
+        memcpy(control_fill, _control_start, sizeof(control_fill));
+
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            const EdgeRule& rule = _rules[i];
+            if (!indexable(i)) continue;
+            if (rule.program) setBit(_program_bits, i, true);
+            else _field_rules[field_fill[rule.field_idx]++] = i;
+            _control_rules[control_fill[rule.control_idx]++] = i;
+            if (rule.isRate()) setBit(_rate_bits, i, true);
+        }
+
+        // Stable insertion sort by priority within each control bucket
+        for (uint8_t c = 0; c < MAX_CONTROLS; c++) {
+            for (uint8_t k = _control_start[c] + 1; k < _control_start[c + 1]; k++) {
+                uint8_t rule_idx = _control_rules[k];
+                uint8_t pri = _rules[rule_idx].priority;
+                uint8_t j = k;
+                while (j > _control_start[c] && _rules[_control_rules[j - 1]].priority > pri) {
+                    _control_rules[j] = _control_rules[j - 1];
+                    j--;
+                }
+                _control_rules[j] = rule_idx;
+            }
+        }
+
+        _index_primed = false;
+        _pending_controls = (uint32_t)((1ull << MAX_CONTROLS) - 1);
+    }
+
+    // Move runtime state, cached condition and dwell bits to each rule's
+    // current position, matched by id against the previous rebuild. A rule
+    // mid-band (engaged, raw) stays so when an unrelated rule changes, and a
+    // deleted rule's slot is reused without leaking state. In place: swaps
+    // only ever pull state forward from a position not yet visited.
+    void remapRuntime(int reset_id) {
+        uint8_t old_slot[256];          // Rule id -> previous position (0xFF = none)
+        memset(old_slot, 0xFF, sizeof(old_slot));
+        for (uint8_t j = 0; j < _runtime_count; j++) old_slot[_runtime_ids[j]] = j;
+
+        uint8_t origin[MAX_RULES];      // Previous position of the state now at k
+        uint8_t where[MAX_RULES];       // Where previous position j's state is now
+        for (uint8_t k = 0; k < MAX_RULES; k++) origin[k] = where[k] = k;
+
+        uint32_t fresh[RULE_WORDS] = {0};
+        for (uint8_t i = 0; i < _rule_count; i++) {
+            uint8_t j = old_slot[_rules[i].id];
+            if (j == 0xFF || (int)_rules[i].id == reset_id) {
+                setBit(fresh, i, true);
+                continue;
+            }
+            uint8_t cur = where[j];
+            if (cur != i) {
+                RuleRuntime rt = _runtime[i];
+                _runtime[i] = _runtime[cur];
+                _runtime[cur] = rt;
+                bool cond = testBit(_condition_bits, i), dwell = testBit(_dwell_bits, i);
+                setBit(_condition_bits, i, testBit(_condition_bits, cur));
+                setBit(_dwell_bits, i, testBit(_dwell_bits, cur));
+                setBit(_condition_bits, cur, cond);
+                setBit(_dwell_bits, cur, dwell);
+                origin[cur] = origin[i];
+                where[origin[cur]] = cur;
+                origin[i] = j;
+                where[j] = i;
+            }
+        }
+
+        for (uint8_t i = 0; i < MAX_RULES; i++) {
+            if (i < _rule_count && !testBit(fresh, i)) continue;
+            memset(&_runtime[i], 0, sizeof(RuleRuntime));
+            setBit(_condition_bits, i, false);
+            setBit(_dwell_bits, i, false);
+        }
+        for (uint8_t i = 0; i < _rule_count; i++) _runtime_ids[i] = _rules[i].id;
+        _runtime_count = _rule_count;
+    }
+
+    // Enabled, in range, and (program rules) holding a program
+    bool indexable(uint8_t rule_idx) const {
+        const EdgeRule& rule = _rules[rule_idx];
+        if (!rule.enabled || rule.control_idx >= MAX_CONTROLS) return false;
+        return rule.program ? _rule_program[rule_idx] != NO_PROGRAM : rule.field_idx < MAX_FIELDS;
+    }
+
+    // Bitmask of fields whose value differs (bitwise, so NaN compares stable)
+    // from the previous evaluate. Everything is dirty right after a rebuild or
+    // when the caller passes a different field count.
+    uint32_t collectDirtyFields(const float* field_values, uint8_t field_count) {
+        uint32_t dirty = 0;
+        bool full = !_index_primed || field_count != _last_field_count;
+
+        for (uint8_t f = 0; f < field_count; f++) {
+            uint32_t bits;
+            memcpy(&bits, &field_values[f], sizeof(bits));
+            if (full || bits != _last_values[f]) dirty |= (1u << f);
+            _last_values[f] = bits;
+        }
+        if (full) {
+            // Fields beyond field_count evaluate false
+            for (uint8_t f = field_count; f < MAX_FIELDS; f++) dirty |= (1u << f);
+        }
+
+        _index_primed = true;
+        _last_field_count = field_count;
+
+        // Only fields that have rules attached are worth visiting
+        uint32_t with_rules = 0;
+        for (uint8_t f = 0; f < MAX_FIELDS; f++) {
+            if (_field_start[f + 1] != _field_start[f]) with_rules |= (1u << f);
+        }
+        return dirty & with_rules;
+    }
+
+    // Re-test one rule against its field's value: rate, hysteresis, then
+    // dwell. Marks the control pending when the rule's condition flips.
+    void updateCondition(uint8_t rule_idx, float value, uint32_t now_ms) {
+        const EdgeRule& rule = _rules[rule_idx];
+        RuleRuntime& rt = _runtime[rule_idx];
+
+        float input = value;
+        if (rule.isRate()) {
+            if (rt.has_last && now_ms == rt.last_ms) return;  // No time passed: keep state
+            input = rt.has_last && !isnan(value)
+                ? (value - rt.last_value) * 1000.0f / (float)(now_ms - rt.last_ms)
+                : NAN;
+            rt.has_last = !isnan(value);
+            rt.last_value = value;
+            rt.last_ms = now_ms;
+        }
+
+        // Once true, the condition holds until the value clears the band
+        float threshold = rt.raw ? releaseThreshold(rule) : rule.threshold;
+        bool raw = evaluateCondition(rule.op, input, threshold);
+        if (raw && !rt.raw) {
+            rt.since_ms = now_ms;
+            rt.samples = 0;
+        }
+        rt.raw = raw;
+
+        bool hit = raw;
+        if (raw && rule.dwell > 0) {
+            if (rt.samples < 0xFFFF) rt.samples++;
+            hit = rule.dwell_samples ? rt.samples >= rule.dwell
+                                     : (now_ms - rt.since_ms) >= (uint32_t)rule.dwell * 1000u;
+        }
+        setBit(_dwell_bits, rule_idx, raw && !hit);
+
+        if (hit != conditionBit(rule_idx)) {
+            setConditionBit(rule_idx, hit);
+            _pending_controls |= (1u << rule.control_idx);
+        }
+    }
+
+    // Threshold a true condition must cross to clear
+    static float releaseThreshold(const EdgeRule& rule) {
+        switch (rule.op) {
+            case RuleOperator::GT:
+            case RuleOperator::GTE:
+            case RuleOperator::RATE_GT: return rule.threshold - rule.hysteresis;
+            case RuleOperator::LT:
+            case RuleOperator::LTE:
+            case RuleOperator::RATE_LT: return rule.threshold + rule.hysteresis;
+            default: return rule.threshold;
+        }
+    }
+
+    bool inCooldown(const EdgeRule& rule, uint32_t now_ms) const {
+        return rule.last_triggered_ms > 0 &&
+               (now_ms - rule.last_triggered_ms) < (rule.cooldown_sec * 1000);
+    }
+
+    // Pick the winning rule for one control from its priority list: the
+    // first true rule not cooling down. Rules ranked above it that are
+    // cooling down leave the control pending.
+    void resolveControl(uint8_t ctrl_idx, uint32_t now_ms) {
+        if (isManualOverride(ctrl_idx, now_ms)) {
+            _pending_controls |= (1u << ctrl_idx);
+            return;
+        }
+
+        int winner = -1, engaged = -1;
+        bool cooling = false;
+        for (uint8_t k = _control_start[ctrl_idx]; k < _control_start[ctrl_idx + 1]; k++) {
+            uint8_t rule_idx = _control_rules[k];
+            if (engaged < 0 && _runtime[rule_idx].engaged) engaged = rule_idx;
+            if (winner >= 0 || !conditionBit(rule_idx)) continue;
+            if (inCooldown(_rules[rule_idx], now_ms)) cooling = true;
+            else winner = rule_idx;
+        }
+        applyControl(ctrl_idx, winner, engaged, cooling, now_ms);
+    }
+
+    // Apply the winning rule (-1 = none) to a control. With no rule true,
+    // the rule that last held the control (engaged) applies its release
+    // state. Leaves the control pending when the outcome may change with
+    // time alone (a rule in cooldown) or when the action failed.
+    void applyControl(uint8_t ctrl_idx, int winner, int engaged, bool cooling, uint32_t now_ms) {
+        if (cooling) _pending_controls |= (1u << ctrl_idx);
+
+        if (winner >= 0) {
+            EdgeRule& rule = _rules[winner];
+
+            // The winner holds the control until its condition clears
+            if (engaged >= 0) _runtime[engaged].engaged = false;
+            _runtime[winner].engaged = true;
+
+            // Only act if state is different
+            if (_control_states[ctrl_idx].current_state != rule.action_state) {
+                executeAction(ctrl_idx, rule.action_state, TriggerSource::RULE, rule.id, now_ms);
+                rule.last_triggered_ms = now_ms;
+                // The winner drops out while cooling down, so lower-priority
+                // rules get a say on the next evaluate
+                if (rule.cooldown_sec > 0 ||
+                    _control_states[ctrl_idx].current_state != rule.action_state) {
+                    _pending_controls |= (1u << ctrl_idx);
+                }
+            }
+            return;
+        }
+        if (cooling || engaged < 0) return;  // A true rule gets the control once it cools down
+
+        EdgeRule& rule = _rules[engaged];
+        if (rule.release_state == NO_RELEASE) {
+            _runtime[engaged].engaged = false;
+            return;
+        }
+        if (inCooldown(rule, now_ms)) {
+            _pending_controls |= (1u << ctrl_idx);
+            return;
+        }
+        _runtime[engaged].engaged = false;
+        if (_control_states[ctrl_idx].current_state != rule.release_state) {
+            executeAction(ctrl_idx, rule.release_state, TriggerSource::RULE, rule.id, now_ms);
+            rule.last_triggered_ms = now_ms;
+            if (_control_states[ctrl_idx].current_state != rule.release_state) {
+                _runtime[engaged].engaged = true;  // Driver failed: retry
+                _pending_controls |= (1u << ctrl_idx);
+            }
+        }
+    }
+
+    // Evaluate a condition (rate operators compare the rate passed as value).
+    // A missing value (NaN) is false for every operator, NEQ included.
     bool evaluateCondition(RuleOperator op, float value, float threshold) const {
+        if (isnan(value)) return false;
         switch (op) {
             case RuleOperator::LT:  return value < threshold;
             case RuleOperator::GT:  return value > threshold;
@@ -635,6 +1241,8 @@ private:
             case RuleOperator::GTE: return value >= threshold;
             case RuleOperator::EQ:  return value == threshold;
             case RuleOperator::NEQ: return value != threshold;
+            case RuleOperator::RATE_GT: return value > threshold;
+            case RuleOperator::RATE_LT: return value < threshold;
             default: return false;
         }
     }
@@ -657,7 +1265,48 @@ private:
         }
 
         // Update state and queue for transmission
-        setControlState(ctrl_idx, state_idx, source, rule_id, now_ms);
+        changeControlState(ctrl_idx, state_idx, source, rule_id, now_ms);
+    }
+
+    // setControlState() without the lock, for the engine's own actions
+    bool changeControlState(uint8_t ctrl_idx, uint8_t state_idx, TriggerSource source,
+                            uint8_t rule_id, uint32_t now_ms) {
+        if (ctrl_idx >= MAX_CONTROLS) return false;
+        if (!_schema.isValidControlIndex(ctrl_idx)) return false;
+        if (!_schema.isValidStateIndex(ctrl_idx, state_idx)) return false;
+
+        uint8_t old_state = _control_states[ctrl_idx].current_state;
+        if (old_state == state_idx) return true;  // No change needed
+
+        // Record state change
+        _control_states[ctrl_idx].current_state = state_idx;
+
+        // A change from outside the engine may need rules to re-assert
+        if (source != TriggerSource::RULE) {
+            _pending_controls |= (1u << ctrl_idx);
+        }
+
+        // Queue state change for transmission (drop oldest if full so latest is kept)
+        StateChange change = {
+            ctrl_idx,
+            state_idx,
+            old_state,
+            source,
+            rule_id,
+            now_ms,
+            _sequence_id++
+        };
+        if (_queue_count >= STATE_CHANGE_QUEUE_CAP) {
+            _queue_head = (_queue_head + 1) % STATE_CHANGE_QUEUE_CAP;
+            _queue_count--;
+            LOGW("Rules", "State change queue full, dropped oldest");
+        }
+        size_t write_idx = (_queue_head + _queue_count) % STATE_CHANGE_QUEUE_CAP;
+        _state_change_queue[write_idx] = change;
+        _queue_count++;
+
+        LOGI("Rules", "State change: %s", change.toText().c_str());
+        return true;
     }
 };
 
@@ -7,7 +7,7 @@
 // =============================================================================
 // App implements IErrorReporter and injects it into radio_task, OTA, etc.
 // reportError(category, subCode) maps to the correct telemetry counter.
-// All counters reset daily; app persists with keys ec_na, ec_jf, ec_sr, etc.
+// All counters reset daily; app persists them as one ErrorCounters record.
 // =============================================================================
 
 namespace ErrorReporter {
@@ -27,6 +27,43 @@ namespace Ota  { enum : uint8_t { Crc = 0, Write = 1, Timeout = 2 }; }
 namespace Sys  { enum : uint8_t { Memory = 0, QueueFull = 1, Task = 2 }; }
 namespace Logic{ enum : uint8_t { Rule = 0, Config = 1, Persistence = 2 }; }
 
+// One counter per sub-code, [category][subCode]: na,jf,sf, sr,dr,dp, cs,wf,tm,
+// mm,qf,ts, rf,cv,pf (the diagnostics order)
+struct ErrorCounters {
+    static constexpr uint8_t CATEGORIES = 5;
+    static constexpr uint8_t CODES = 3;
+
+    uint32_t count[CATEGORIES][CODES] = {};
+    uint32_t lastResetMs = 0;   // CoreSystem::clockMs() of the last daily reset
+
+    void increment(Category cat, uint8_t subCode) {
+        if ((uint8_t)cat < CATEGORIES && subCode < CODES) count[(uint8_t)cat][subCode]++;
+    }
+
+    uint32_t get(Category cat, uint8_t subCode) const {
+        return (uint8_t)cat < CATEGORIES && subCode < CODES ? count[(uint8_t)cat][subCode] : 0;
+    }
+
+    uint32_t total() const {
+        uint32_t sum = 0;
+        for (const auto& category : count) {
+            for (uint32_t c : category) sum += c;
+        }
+        return sum;
+    }
+
+    void clear() {
+        for (auto& category : count) {
+            for (uint32_t& c : category) c = 0;
+        }
+    }
+
+    void reset(uint32_t nowMs) {
+        clear();
+        lastResetMs = nowMs;
+    }
+};
+
 class IErrorReporter {
 public:
     virtual ~IErrorReporter() = default;
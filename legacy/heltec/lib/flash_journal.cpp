@@ -0,0 +1,478 @@
+#include "flash_journal.h"
+#include "crc.h"
+#include "core_logger.h"
+#include <stdio.h>
+#include <string.h>
+
+static constexpr size_t COPY_CHUNK = 64;
+
+static void putLe32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t getLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// =============================================================================
+// Boot: replay
+// =============================================================================
+
+bool FlashJournal::begin(IFlashRegion* flash) {
+    _flash = flash;
+    size_t sectors = flash ? flash->size() / SECTOR_SIZE : 0;
+    if (sectors < MIN_SECTORS) return false;
+    _sectors = sectors > 255 ? 255 : (uint8_t)sectors;
+    if (!_mutex) _mutex = xSemaphoreCreateMutex();
+    if (!_mutex) return false;
+
+    // Valid sectors form one run around the ring ending at the highest seq
+    uint32_t seqs[255];
+    bool valid[255];
+    bool any = false;
+    for (uint8_t s = 0; s < _sectors; s++) {
+        uint8_t header[SECTOR_HEADER_SIZE];
+        valid[s] = _flash->read((size_t)s * SECTOR_SIZE, header, sizeof(header)) &&
+                   getLe32(header) == SECTOR_MAGIC;
+        seqs[s] = getLe32(header + 4);
+        if (valid[s] && (!any || seqs[s] > _headSeq)) {
+            _head = s;
+            _headSeq = seqs[s];
+            any = true;
+        }
+    }
+    _used = 0;
+    _count = 0;
+    _liveBytes = 0;
+    if (any) {
+        for (uint8_t i = 0; i < _sectors; i++) {
+            uint8_t s = (uint8_t)((_head + _sectors - i) % _sectors);
+            if (!valid[s] || seqs[s] != _headSeq - i) break;
+            _used++;
+        }
+    }
+
+    // A full ring means power was lost while compacting into the head: it
+    // holds only copies of records the oldest sector still has
+    if (_used == _sectors) {
+        if (!_flash->eraseSector((size_t)_head * SECTOR_SIZE)) return false;
+        _erases++;
+        _head = (uint8_t)((_head + _sectors - 1) % _sectors);
+        _headSeq--;
+        _used--;
+    }
+
+    // Anything outside the run (stale or torn by a lost erase) is erased
+    for (uint8_t i = _used; i < _sectors; i++) {
+        uint8_t s = (uint8_t)((_head + 1 + i - _used) % _sectors);
+        uint8_t buf[COPY_CHUNK];
+        bool erased = true;
+        for (size_t off = 0; off < SECTOR_SIZE && erased; off += sizeof(buf)) {
+            if (!_flash->read((size_t)s * SECTOR_SIZE + off, buf, sizeof(buf))) return false;
+            for (uint8_t b : buf) erased = erased && b == 0xFF;
+        }
+        if (!erased) {
+            if (!_flash->eraseSector((size_t)s * SECTOR_SIZE)) return false;
+            _erases++;
+        }
+    }
+
+    if (_used == 0) {
+        _head = _sectors - 1;
+        _headSeq = 0;
+        if (!openNextSector()) return false;
+    } else {
+        for (uint8_t i = 0; i < _used; i++) {
+            uint8_t s = (uint8_t)((oldestSector() + i) % _sectors);
+            replaySector(s, s == _head);
+        }
+    }
+
+    LOGI("Journal", "%u sectors, %u used, %u keys, %u of %u bytes live",
+         (unsigned)_sectors, (unsigned)_used, (unsigned)_count, (unsigned)_liveBytes, (unsigned)capacity());
+    return true;
+}
+
+void FlashJournal::replaySector(uint8_t sector, bool isHead) {
+    size_t base = (size_t)sector * SECTOR_SIZE;
+    size_t offset = SECTOR_HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= SECTOR_SIZE) {
+        uint8_t header[RECORD_HEADER_SIZE];
+        if (!_flash->read(base + offset, header, sizeof(header)) || header[0] == 0xFF) break;
+        uint32_t hash;
+        if (!checkRecord(base + offset, header, &hash)) {
+            LOGW("Journal", "Torn record at 0x%x, sector %u closed", (unsigned)(base + offset), (unsigned)sector);
+            offset = SECTOR_SIZE;
+            break;
+        }
+        indexRecord((uint32_t)(base + offset), header, hash);
+        offset += recordSize(header[1], header[2] | (header[3] << 8));
+    }
+    if (isHead) _headOffset = offset;
+}
+
+// Header fields in range and CRC over header, key and value
+bool FlashJournal::checkRecord(size_t offset, const uint8_t* header, uint32_t* hash) {
+    uint8_t type = header[0];
+    size_t keyLen = header[1];
+    size_t len = header[2] | (header[3] << 8);
+    if (type < (uint8_t)Type::U32 || type > (uint8_t)Type::Bytes) return false;
+    if (keyLen == 0 || keyLen > MAX_KEY_LEN) return false;
+    if (offset % SECTOR_SIZE + recordSize(keyLen, len) > SECTOR_SIZE) return false;
+
+    char key[MAX_KEY_LEN];
+    if (!_flash->read(offset + RECORD_HEADER_SIZE, key, keyLen)) return false;
+    *hash = hashKey(key, keyLen);
+    uint32_t crc = Crc::crc32Update(0, header, 4);
+    crc = Crc::crc32Update(crc, (const uint8_t*)key, keyLen);
+    size_t at = offset + RECORD_HEADER_SIZE + keyLen;
+    uint8_t buf[COPY_CHUNK];
+    for (size_t done = 0; done < len;) {
+        size_t n = len - done < sizeof(buf) ? len - done : sizeof(buf);
+        if (!_flash->read(at + done, buf, n)) return false;
+        crc = Crc::crc32Update(crc, buf, n);
+        done += n;
+    }
+    return crc == getLe32(header + 4);
+}
+
+void FlashJournal::indexRecord(uint32_t offset, const uint8_t* header, uint32_t hash) {
+    size_t keyLen = header[1];
+    char key[MAX_KEY_LEN];
+    if (!_flash->read(offset + RECORD_HEADER_SIZE, key, keyLen)) return;
+    uint16_t len = (uint16_t)(header[2] | (header[3] << 8));
+
+    Entry* e = find(key, keyLen, hash);
+    if (e) {
+        _liveBytes -= recordSize(keyLen, e->len);
+    } else if (_count < MAX_KEYS) {
+        e = &_entries[_count++];
+        e->hash = hash;
+    } else {
+        LOGW("Journal", "Index full, '%.*s' not loaded", (int)keyLen, key);
+        return;
+    }
+    e->offset = offset;
+    e->len = len;
+    e->type = (Type)header[0];
+    _liveBytes += recordSize(keyLen, len);
+}
+
+// =============================================================================
+// Index
+// =============================================================================
+
+uint32_t FlashJournal::hashKey(const char* key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)key[i]) * 16777619u;
+    return h;
+}
+
+FlashJournal::Entry* FlashJournal::find(const char* key, size_t keyLen, uint32_t hash) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_entries[i].hash == hash && keyMatches(_entries[i], key, keyLen)) return &_entries[i];
+    }
+    return nullptr;
+}
+
+bool FlashJournal::keyMatches(const Entry& e, const char* key, size_t keyLen) {
+    uint8_t stored[RECORD_HEADER_SIZE + MAX_KEY_LEN];
+    if (!_flash->read(e.offset, stored, RECORD_HEADER_SIZE + keyLen)) return false;
+    return stored[1] == keyLen && memcmp(stored + RECORD_HEADER_SIZE, key, keyLen) == 0;
+}
+
+size_t FlashJournal::capacity() const {
+    // Half the ring, less the sector kept erased: compaction always frees space
+    return (size_t)(_sectors - 1) * (SECTOR_SIZE - SECTOR_HEADER_SIZE) / 2;
+}
+
+// =============================================================================
+// Reads and writes
+// =============================================================================
+
+int32_t FlashJournal::valueLength(const char* key, Type type) {
+    size_t keyLen = strlen(key);
+    if (!_flash || keyLen == 0 || keyLen > MAX_KEY_LEN) return -1;
+    lock();
+    Entry* e = find(key, keyLen, hashKey(key, keyLen));
+    int32_t len = e && e->type == type ? e->len : -1;
+    unlock();
+    return len;
+}
+
+size_t FlashJournal::get(const char* key, Type type, void* dst, size_t maxLen) {
+    size_t keyLen = strlen(key);
+    if (!_flash || keyLen == 0 || keyLen > MAX_KEY_LEN) return 0;
+    lock();
+    Entry* e = find(key, keyLen, hashKey(key, keyLen));
+    size_t len = 0;
+    if (e && e->type == type && e->len <= maxLen &&
+        _flash->read(e->offset + RECORD_HEADER_SIZE + keyLen, dst, e->len)) {
+        len = e->len;
+    }
+    unlock();
+    return len;
+}
+
+bool FlashJournal::put(const char* key, Type type, const void* data, size_t len) {
+    size_t keyLen = strlen(key);
+    if (!_flash || keyLen == 0 || keyLen > MAX_KEY_LEN) return false;
+    if (recordSize(keyLen, len) > SECTOR_SIZE - SECTOR_HEADER_SIZE) return false;
+
+    lock();
+    uint32_t hash = hashKey(key, keyLen);
+    Entry* e = find(key, keyLen, hash);
+
+    // Unchanged value: nothing to write
+    if (e && e->type == type && e->len == len) {
+        const uint8_t* src = (const uint8_t*)data;
+        size_t at = e->offset + RECORD_HEADER_SIZE + keyLen;
+        uint8_t buf[COPY_CHUNK];
+        bool same = true;
+        for (size_t done = 0; done < len && same;) {
+            size_t n = len - done < sizeof(buf) ? len - done : sizeof(buf);
+            same = _flash->read(at + done, buf, n) && memcmp(buf, src + done, n) == 0;
+            done += n;
+        }
+        if (same) {
+            unlock();
+            return true;
+        }
+    }
+
+    size_t live = _liveBytes - (e ? recordSize(keyLen, e->len) : 0) + recordSize(keyLen, len);
+    if ((!e && _count >= MAX_KEYS) || live > capacity()) {
+        unlock();
+        LOGW("Journal", "No room for '%s' (%u keys, %u bytes live)", key, (unsigned)_count, (unsigned)_liveBytes);
+        return false;
+    }
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = (uint8_t)type;
+    header[1] = (uint8_t)keyLen;
+    header[2] = len & 0xFF;
+    header[3] = (len >> 8) & 0xFF;
+    uint32_t crc = Crc::crc32Update(0, header, 4);
+    crc = Crc::crc32Update(crc, (const uint8_t*)key, keyLen);
+    crc = Crc::crc32Update(crc, (const uint8_t*)data, len);
+    putLe32(header + 4, crc);
+
+    uint32_t offset;
+    bool ok = append(header, key, data, len, &offset);
+    if (ok) {
+        if (!e) {
+            e = &_entries[_count++];
+            e->hash = hash;
+        }
+        e->offset = offset;
+        e->len = (uint16_t)len;
+        e->type = type;
+        _liveBytes = live;
+        _written++;
+    }
+    unlock();
+    return ok;
+}
+
+// Header first: a write cut short leaves a record that fails its CRC,
+// never an erased-looking gap that would be written over
+bool FlashJournal::append(const uint8_t* header, const char* key, const void* data, size_t len, uint32_t* offset) {
+    size_t size = recordSize(header[1], len);
+    for (uint8_t tries = 0; _headOffset + size > SECTOR_SIZE; tries++) {
+        if (tries == _sectors || !openNextSector()) return false;
+    }
+    size_t at = (size_t)_head * SECTOR_SIZE + _headOffset;
+    _headOffset += size;   // Even on failure: the space is no longer erased
+    if (!_flash->write(at, header, RECORD_HEADER_SIZE) ||
+        !_flash->write(at + RECORD_HEADER_SIZE, key, header[1]) ||
+        (len && !_flash->write(at + RECORD_HEADER_SIZE + header[1], data, len))) {
+        LOGW("Journal", "Write failed at 0x%x", (unsigned)at);
+        return false;
+    }
+    *offset = (uint32_t)at;
+    return true;
+}
+
+// =============================================================================
+// Sectors and compaction
+// =============================================================================
+
+// The sector after the head is always erased; opening it may leave none,
+// in which case the oldest is compacted into the new head. The magic is
+// written last, so a sector is never valid with a half-written seq.
+bool FlashJournal::openNextSector() {
+    if (_used == _sectors) return false;
+    uint8_t next = (uint8_t)((_head + 1) % _sectors);
+    uint8_t header[SECTOR_HEADER_SIZE];
+    putLe32(header, SECTOR_MAGIC);
+    putLe32(header + 4, _headSeq + 1);
+    size_t at = (size_t)next * SECTOR_SIZE;
+    if (!_flash->write(at + 4, header + 4, 4) || !_flash->write(at, header, 4)) {
+        LOGW("Journal", "Cannot open sector %u", (unsigned)next);
+        return false;
+    }
+    _head = next;
+    _headSeq++;
+    _headOffset = SECTOR_HEADER_SIZE;
+    _used++;
+    if (_used == _sectors && !compactOldest()) {
+        // Nothing more goes in the head; begin() retries after a reboot
+        _headOffset = SECTOR_SIZE;
+        return false;
+    }
+    return true;
+}
+
+bool FlashJournal::compactOldest() {
+    uint8_t oldest = oldestSector();
+    size_t start = (size_t)oldest * SECTOR_SIZE;
+    for (uint8_t i = 0; i < _count; i++) {
+        Entry& e = _entries[i];
+        if (e.offset >= start && e.offset < start + SECTOR_SIZE && !copyRecord(e)) {
+            LOGW("Journal", "Compaction of sector %u failed", (unsigned)oldest);
+            return false;
+        }
+    }
+    // Retire the sector before erasing it: an erase cut short must not
+    // leave a valid header over damaged records
+    const uint8_t retired[4] = {0, 0, 0, 0};
+    if (!_flash->write(start, retired, sizeof(retired)) || !_flash->eraseSector(start)) {
+        LOGW("Journal", "Erase of sector %u failed", (unsigned)oldest);
+        return false;
+    }
+    _erases++;
+    _used--;
+    return true;
+}
+
+// Current record, byte for byte, to the head (it came from one sector and
+// the head was just opened, so it fits)
+bool FlashJournal::copyRecord(Entry& e) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (!_flash->read(e.offset, header, sizeof(header))) return false;
+    size_t size = RECORD_HEADER_SIZE + header[1] + e.len;
+    if (_headOffset + recordSize(header[1], e.len) > SECTOR_SIZE) return false;
+
+    size_t to = (size_t)_head * SECTOR_SIZE + _headOffset;
+    uint8_t buf[COPY_CHUNK];
+    for (size_t done = 0; done < size;) {
+        size_t n = size - done < sizeof(buf) ? size - done : sizeof(buf);
+        if (!_flash->read(e.offset + done, buf, n) || !_flash->write(to + done, buf, n)) return false;
+        done += n;
+    }
+    _headOffset += recordSize(header[1], e.len);
+    e.offset = (uint32_t)to;
+    return true;
+}
+
+void FlashJournal::lock() const {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+}
+
+void FlashJournal::unlock() const {
+    xSemaphoreGive(_mutex);
+}
+
+// =============================================================================
+// JournalPersistenceHal
+// =============================================================================
+
+bool JournalPersistenceHal::begin(const char* namespace_name) {
+    if (!namespace_name || strlen(namespace_name) >= sizeof(_namespace)) return false;
+    if (_session.held()) closeFallback();
+    else _session.enter();
+    strcpy(_namespace, namespace_name);
+    return true;
+}
+
+void JournalPersistenceHal::end() {
+    if (!_session.held()) return;
+    closeFallback();
+    _session.leave();
+}
+
+void JournalPersistenceHal::closeFallback() {
+    if (_fallbackOpen) _fallback->end();
+    _fallbackTried = false;
+    _fallbackOpen = false;
+}
+
+IPersistenceHal* JournalPersistenceHal::fallback() {
+    if (!_fallbackTried) {
+        _fallbackTried = true;
+        _fallbackOpen = _fallback && _fallback->beginReadOnly(_namespace);
+    }
+    return _fallbackOpen ? _fallback : nullptr;
+}
+
+bool JournalPersistenceHal::fullKey(const char* key, char* out) const {
+    int n = snprintf(out, FlashJournal::MAX_KEY_LEN + 1, "%s/%s", _namespace, key);
+    return n > 0 && n <= FlashJournal::MAX_KEY_LEN;
+}
+
+bool JournalPersistenceHal::saveU32(const char* key, uint32_t value) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    return fullKey(key, k) && _journal.put(k, FlashJournal::Type::U32, &value, sizeof(value));
+}
+
+uint32_t JournalPersistenceHal::loadU32(const char* key, uint32_t defaultValue) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    uint32_t value;
+    if (fullKey(key, k) && _journal.get(k, FlashJournal::Type::U32, &value, sizeof(value)) == sizeof(value)) {
+        return value;
+    }
+    IPersistenceHal* nvs = fallback();
+    return nvs ? nvs->loadU32(key, defaultValue) : defaultValue;
+}
+
+bool JournalPersistenceHal::saveFloat(const char* key, float value) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    return fullKey(key, k) && _journal.put(k, FlashJournal::Type::Float, &value, sizeof(value));
+}
+
+float JournalPersistenceHal::loadFloat(const char* key, float defaultValue) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    float value;
+    if (fullKey(key, k) && _journal.get(k, FlashJournal::Type::Float, &value, sizeof(value)) == sizeof(value)) {
+        return value;
+    }
+    IPersistenceHal* nvs = fallback();
+    return nvs ? nvs->loadFloat(key, defaultValue) : defaultValue;
+}
+
+bool JournalPersistenceHal::saveString(const char* key, const std::string& value) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    return fullKey(key, k) && _journal.put(k, FlashJournal::Type::String, value.data(), value.size());
+}
+
+std::string JournalPersistenceHal::loadString(const char* key, const std::string& defaultValue) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    int32_t len = fullKey(key, k) ? _journal.valueLength(k, FlashJournal::Type::String) : -1;
+    if (len < 0) {
+        IPersistenceHal* nvs = fallback();
+        return nvs ? nvs->loadString(key, defaultValue) : defaultValue;
+    }
+    std::string value((size_t)len, '\0');
+    if (len > 0 && _journal.get(k, FlashJournal::Type::String, &value[0], value.size()) != value.size()) {
+        return defaultValue;
+    }
+    return value;
+}
+
+bool JournalPersistenceHal::saveBytes(const char* key, const uint8_t* ptr, size_t len) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    return fullKey(key, k) && _journal.put(k, FlashJournal::Type::Bytes, ptr, len);
+}
+
+size_t JournalPersistenceHal::loadBytes(const char* key, uint8_t* ptr, size_t max_len) {
+    char k[FlashJournal::MAX_KEY_LEN + 1];
+    int32_t len = fullKey(key, k) ? _journal.valueLength(k, FlashJournal::Type::Bytes) : -1;
+    if (len < 0) {
+        IPersistenceHal* nvs = fallback();
+        return nvs ? nvs->loadBytes(key, ptr, max_len) : 0;
+    }
+    return _journal.get(k, FlashJournal::Type::Bytes, ptr, max_len);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "hal_flash.h"
+#include "hal_persistence.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// =============================================================================
+// Flash Journal: append-only key/value log for hot-write state
+// =============================================================================
+// NVS rewrites an entry on every put; the error counters, the state change
+// queue, the pulse total and the backlog spill are written often enough
+// for that to matter over a decade. The journal appends each write as a
+// record to a dedicated partition and keeps only an index in RAM. The
+// latest record per key wins on replay at boot.
+//
+// The partition is a ring of 4 KB sectors. A sector starts with a header
+// (magic, sequence number); records follow, 4-byte aligned:
+// [0]     type (0xFF = erased, end of sector)
+// [1]     key length
+// [2-3]   value length (uint16 LE)
+// [4-7]   CRC-32 of bytes 0-3, key and value
+// [8..]   key, then value
+//
+// When the head sector fills, the next one is opened. When that leaves no
+// erased sector, the oldest sector is compacted: records still current
+// are appended at the head, then it is erased. Each sector is erased once
+// per pass around the ring. A record torn by power loss fails its CRC;
+// replay stops there and the rest of that sector is not written again.
+// Power lost mid-compaction leaves the oldest sector intact; begin()
+// erases the partial copies and compaction runs again.
+//
+// Thread-safe: calls are serialized by a mutex.
+// =============================================================================
+
+class FlashJournal {
+public:
+    enum class Type : uint8_t { U32 = 1, Float, String, Bytes };
+
+    static constexpr uint8_t MAX_KEYS = 64;
+    static constexpr uint8_t MAX_KEY_LEN = 31;
+    static constexpr size_t SECTOR_SIZE = IFlashRegion::SECTOR_SIZE;
+    static constexpr size_t SECTOR_HEADER_SIZE = 8;
+    static constexpr size_t RECORD_HEADER_SIZE = 8;
+    static constexpr uint8_t MIN_SECTORS = 3;
+    static constexpr uint32_t SECTOR_MAGIC = 0x314C4A46;  // "FJL1"
+
+    /** Replay the region into the index. False when it is too small. */
+    bool begin(IFlashRegion* flash);
+
+    /** Append key = value unless the current value is identical. */
+    bool put(const char* key, Type type, const void* data, size_t len);
+
+    /** Length of key's current value if stored with this type, -1 if absent. */
+    int32_t valueLength(const char* key, Type type);
+
+    /** Copy key's current value into dst; returns its length, 0 if absent,
+     *  of another type or longer than maxLen. */
+    size_t get(const char* key, Type type, void* dst, size_t maxLen);
+
+    /** Bytes of current values, and what the ring can hold at most */
+    size_t liveBytes() const { return _liveBytes; }
+    size_t capacity() const;
+
+    uint32_t sectorErases() const { return _erases; }
+    uint32_t recordsWritten() const { return _written; }
+
+private:
+    struct Entry {
+        uint32_t hash;        // FNV-1a of the key
+        uint32_t offset;      // Record position in the region
+        uint16_t len;         // Value length
+        Type type;
+    };
+
+    IFlashRegion* _flash = nullptr;
+    SemaphoreHandle_t _mutex = nullptr;
+    uint8_t _sectors = 0;
+    uint8_t _head = 0;            // Sector being appended to
+    uint8_t _used = 0;            // Sectors holding records, oldest = _head + 1 - _used
+    uint32_t _headSeq = 0;
+    size_t _headOffset = 0;       // Next record offset within the head sector
+    size_t _liveBytes = 0;
+    uint32_t _erases = 0;
+    uint32_t _written = 0;
+
+    Entry _entries[MAX_KEYS];
+    uint8_t _count = 0;
+
+    static uint32_t hashKey(const char* key, size_t len);
+    static size_t recordSize(size_t keyLen, size_t valueLen) {
+        return (RECORD_HEADER_SIZE + keyLen + valueLen + 3) & ~(size_t)3;
+    }
+
+    void replaySector(uint8_t sector, bool isHead);
+    bool checkRecord(size_t offset, const uint8_t* header, uint32_t* hash);
+    Entry* find(const char* key, size_t keyLen, uint32_t hash);
+    bool keyMatches(const Entry& e, const char* key, size_t keyLen);
+    void indexRecord(uint32_t offset, const uint8_t* header, uint32_t hash);
+
+    bool append(const uint8_t* header, const char* key, const void* data, size_t len, uint32_t* offset);
+    bool copyRecord(Entry& e);
+    bool openNextSector();
+    bool compactOldest();
+    uint8_t oldestSector() const { return (uint8_t)((_head + _sectors + 1 - _used) % _sectors); }
+
+    void lock() const;
+    void unlock() const;
+};
+
+// Persistence HAL on a flash journal. Keys are "namespace/key". Keys not in
+// the journal yet are read from fallback (values NVS held before the
+// journal existed); writes only go to the journal. The fallback is opened
+// read-only, and only once a key is missing from the journal. begin() to
+// end() is one task's session (PersistenceSession), so tasks sharing the
+// HAL never write under each other's namespace.
+class JournalPersistenceHal : public IPersistenceHal {
+public:
+    JournalPersistenceHal(FlashJournal& journal, IPersistenceHal* fallback)
+        : _journal(journal), _fallback(fallback) {}
+
+    bool begin(const char* namespace_name) override;
+    void end() override;
+    bool saveU32(const char* key, uint32_t value) override;
+    uint32_t loadU32(const char* key, uint32_t defaultValue = 0) override;
+    bool saveFloat(const char* key, float value) override;
+    float loadFloat(const char* key, float defaultValue = 0.0f) override;
+    bool saveString(const char* key, const std::string& value) override;
+    std::string loadString(const char* key, const std::string& defaultValue = "") override;
+    bool saveBytes(const char* key, const uint8_t* ptr, size_t len) override;
+    size_t loadBytes(const char* key, uint8_t* ptr, size_t max_len) override;
+
+private:
+    FlashJournal& _journal;
+    IPersistenceHal* _fallback;
+    char _namespace[16] = {0};
+    bool _fallbackTried = false;
+    bool _fallbackOpen = false;
+    PersistenceSession _session;
+
+    // Fallback opened on first use, nullptr when there is none
+    IPersistenceHal* fallback();
+    void closeFallback();
+
+    // "namespace/key" into out (FlashJournal::MAX_KEY_LEN + 1 bytes)
+    bool fullKey(const char* key, char* out) const;
+};
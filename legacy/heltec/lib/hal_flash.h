@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Raw flash region with NOR semantics: write() can only clear bits, and
+// eraseSector() sets a whole sector back to 0xFF
+class IFlashRegion {
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;
+
+    virtual ~IFlashRegion() = default;
+
+    virtual size_t size() const = 0;
+    virtual bool read(size_t offset, void* dst, size_t len) = 0;
+    virtual bool write(size_t offset, const void* src, size_t len) = 0;
+    virtual bool eraseSector(size_t offset) = 0;
+};
+
+#include <esp_partition.h>
+
+// A data partition from the partition table, found by label
+class PartitionFlashRegion : public IFlashRegion {
+public:
+    PartitionFlashRegion() = default;
+
+    bool begin(const char* label) {
+        _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        return _partition != nullptr;
+    }
+
+    size_t size() const override {
+        return _partition ? _partition->size : 0;
+    }
+
+    bool read(size_t offset, void* dst, size_t len) override {
+        return _partition && esp_partition_read(_partition, offset, dst, len) == ESP_OK;
+    }
+
+    bool write(size_t offset, const void* src, size_t len) override {
+        return _partition && esp_partition_write(_partition, offset, src, len) == ESP_OK;
+    }
+
+    bool eraseSector(size_t offset) override {
+        return _partition && esp_partition_erase_range(_partition, offset, SECTOR_SIZE) == ESP_OK;
+    }
+
+private:
+    const esp_partition_t* _partition = nullptr;
+};
@@ -1,14 +1,51 @@
 #pragma once
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <string>
 
+// One HAL instance is shared by the loop task and the timer tasks, and a
+// HAL has one open namespace at a time. begin() therefore claims the HAL
+// for the calling task until its end(); other tasks wait in begin(). A
+// task calling begin() again before end() keeps its claim (the namespace
+// changes), and end() from a task without the claim does nothing.
+class PersistenceSession {
+public:
+    PersistenceSession() : _mutex(xSemaphoreCreateMutex()) {}
+    ~PersistenceSession() {
+        if (_mutex) vSemaphoreDelete(_mutex);
+    }
+
+    PersistenceSession(const PersistenceSession&) = delete;
+    PersistenceSession& operator=(const PersistenceSession&) = delete;
+
+    bool held() const { return _owner == xTaskGetCurrentTaskHandle(); }
+
+    void enter() {
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        _owner = xTaskGetCurrentTaskHandle();
+    }
+
+    void leave() {
+        _owner = nullptr;
+        xSemaphoreGive(_mutex);
+    }
+
+private:
+    SemaphoreHandle_t _mutex;
+    TaskHandle_t volatile _owner = nullptr;
+};
+
 class IPersistenceHal {
 public:
     virtual ~IPersistenceHal() = default;
 
     virtual bool begin(const char* namespace_name) = 0;
+    // For stores that are only read; backends without a read-only mode open normally
+    virtual bool beginReadOnly(const char* namespace_name) { return begin(namespace_name); }
     virtual void end() = 0;
     virtual bool saveU32(const char* key, uint32_t value) = 0;
     virtual uint32_t loadU32(const char* key, uint32_t defaultValue = 0) = 0;
@@ -27,11 +64,17 @@ public:
     FlashPersistenceHal() = default;
 
     bool begin(const char* namespace_name) override {
-        return preferences.begin(namespace_name, false); // false = not read-only
+        return open(namespace_name, false);
+    }
+
+    bool beginReadOnly(const char* namespace_name) override {
+        return open(namespace_name, true);
     }
 
     void end() override {
+        if (!_session.held()) return;
         preferences.end();
+        _session.leave();
     }
 
     bool saveU32(const char* key, uint32_t value) override {
@@ -68,4 +111,13 @@ public:
 
 private:
     Preferences preferences;
+    PersistenceSession _session;
+
+    bool open(const char* namespace_name, bool readOnly) {
+        if (_session.held()) preferences.end();
+        else _session.enter();
+        if (preferences.begin(namespace_name, readOnly)) return true;
+        _session.leave();
+        return false;
+    }
 };
@@ -0,0 +1,112 @@
+#include "lzss_decoder.h"
+#include <cstring>
+
+namespace Lzss {
+
+bool Decoder::begin(uint8_t windowBits, uint8_t lookaheadBits, SinkFn sink, void* ctx) {
+    _sink = sink;
+    _ctx = ctx;
+    _stage = Stage::Tag;
+    _bitBuf = 0;
+    _bitCount = 0;
+    _index = 0;
+    _head = 0;
+    _produced = 0;
+    _outLen = 0;
+    memset(_window, 0, sizeof(_window));
+
+    if (windowBits < MIN_WINDOW_BITS || windowBits > MAX_WINDOW_BITS ||
+        lookaheadBits < MIN_LOOKAHEAD_BITS || lookaheadBits >= windowBits) {
+        _status = Status::BadParams;
+        return false;
+    }
+    _windowBits = windowBits;
+    _lookaheadBits = lookaheadBits;
+    _status = Status::Ok;
+    return true;
+}
+
+// Take n (<= 15) bits MSB first; false if the input ran out (bits are kept)
+bool Decoder::takeBits(uint8_t n, uint16_t* value) {
+    while (_bitCount < n) {
+        if (_inPos >= _inLen) return false;
+        _bitBuf = (_bitBuf << 8) | _in[_inPos++];
+        _bitCount += 8;
+    }
+    _bitCount -= n;
+    *value = (uint16_t)((_bitBuf >> _bitCount) & ((1u << n) - 1));
+    return true;
+}
+
+bool Decoder::flush() {
+    if (_outLen == 0) return true;
+    bool ok = _sink(_ctx, _out, _outLen);
+    _outLen = 0;
+    return ok;
+}
+
+bool Decoder::emit(uint8_t b) {
+    _window[_head] = b;
+    _head = (uint16_t)((_head + 1) & ((1u << _windowBits) - 1));
+    _out[_outLen++] = b;
+    _produced++;
+    if (_outLen < OUT_BLOCK || flush()) return true;
+    _status = Status::SinkFail;
+    return false;
+}
+
+// Decode one token; false when more input is needed or the sink failed
+bool Decoder::step() {
+    uint16_t v;
+    switch (_stage) {
+        case Stage::Tag:
+            if (!takeBits(1, &v)) return false;
+            _stage = v ? Stage::Literal : Stage::Index;
+            return true;
+
+        case Stage::Literal:
+            if (!takeBits(8, &v)) return false;
+            _stage = Stage::Tag;
+            return emit((uint8_t)v);
+
+        case Stage::Index:
+            if (!takeBits(_windowBits, &v)) return false;
+            _index = v;
+            _stage = Stage::Count;
+            return true;
+
+        case Stage::Count: {
+            if (!takeBits(_lookaheadBits, &v)) return false;
+            // Distance may exceed output so far; the zeroed window matches heatshrink
+            const uint16_t mask = (uint16_t)((1u << _windowBits) - 1);
+            _stage = Stage::Tag;
+            for (uint16_t n = 0; n <= v; n++) {
+                if (!emit(_window[(uint16_t)(_head - _index - 1) & mask])) return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+Status Decoder::feed(const uint8_t* data, size_t len) {
+    if (_status != Status::Ok) return _status;
+    _in = data;
+    _inLen = len;
+    _inPos = 0;
+    while (step()) {}
+    _in = nullptr;
+    if (_status == Status::Ok && !flush()) _status = Status::SinkFail;
+    return _status;
+}
+
+const char* Decoder::statusName(Status s) {
+    switch (s) {
+        case Status::Ok:        return "ok";
+        case Status::BadParams: return "bad_params";
+        case Status::SinkFail:  return "sink_fail";
+        default:                return "?";
+    }
+}
+
+} // namespace Lzss
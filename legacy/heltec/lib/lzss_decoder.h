@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// =============================================================================
+// LZSS Decoder: streaming, heatshrink-compatible
+// =============================================================================
+// Decodes the bit stream produced by heatshrink (window 2^W, lookahead 2^L)
+// so images can be compressed with the stock heatshrink encoder on the server.
+// Bits are read MSB first:
+//   1 + 8 bits             literal byte
+//   0 + W bits + L bits    back-reference: distance = index + 1, count = n + 1
+//
+// Working memory is fixed: the decoder embeds a window of 2^MAX_WINDOW_BITS
+// bytes plus a small output block (~1.2 KB total) and is heap-allocated by the
+// OTA receiver only while a compressed transfer runs. Input may be split at
+// any byte; trailing pad bits at the end of the stream are ignored.
+// =============================================================================
+
+namespace Lzss {
+
+constexpr uint8_t MIN_WINDOW_BITS = 4;
+constexpr uint8_t MAX_WINDOW_BITS = 10;   // 1 KB window
+constexpr uint8_t MIN_LOOKAHEAD_BITS = 3;
+constexpr size_t OUT_BLOCK = 128;
+
+enum class Status : uint8_t {
+    Ok,
+    BadParams,      // W/L outside the supported range
+    SinkFail        // Downstream write rejected the output
+};
+
+/** Receives decoded bytes in blocks of up to OUT_BLOCK. */
+typedef bool (*SinkFn)(void* ctx, const uint8_t* data, size_t len);
+
+/** Heatshrink parameters are packed as (W << 4) | L in one byte. */
+inline uint8_t packParams(uint8_t windowBits, uint8_t lookaheadBits) {
+    return (uint8_t)((windowBits << 4) | (lookaheadBits & 0x0F));
+}
+
+class Decoder {
+public:
+    /** Reset for a new stream. Returns false if the parameters are unsupported. */
+    bool begin(uint8_t windowBits, uint8_t lookaheadBits, SinkFn sink, void* ctx);
+    bool begin(uint8_t packedParams, SinkFn sink, void* ctx) {
+        return begin(packedParams >> 4, packedParams & 0x0F, sink, ctx);
+    }
+
+    /** Decode the next input bytes; output is flushed to the sink before returning. */
+    Status feed(const uint8_t* data, size_t len);
+
+    Status status() const { return _status; }
+    uint32_t produced() const { return _produced; }
+
+    static const char* statusName(Status s);
+
+private:
+    enum class Stage : uint8_t { Tag, Literal, Index, Count };
+
+    bool step();
+    bool takeBits(uint8_t n, uint16_t* value);
+    bool emit(uint8_t b);
+    bool flush();
+
+    SinkFn _sink = nullptr;
+    void* _ctx = nullptr;
+    Status _status = Status::BadParams;
+    Stage _stage = Stage::Tag;
+    uint8_t _windowBits = 0;
+    uint8_t _lookaheadBits = 0;
+
+    const uint8_t* _in = nullptr;   // Current feed() input
+    size_t _inLen = 0;
+    size_t _inPos = 0;
+    uint32_t _bitBuf = 0;           // Unconsumed input bits, right-aligned
+    uint8_t _bitCount = 0;
+
+    uint16_t _index = 0;            // Back-reference distance - 1
+    uint16_t _head = 0;             // Window write position
+    uint32_t _produced = 0;
+
+    uint8_t _window[1u << MAX_WINDOW_BITS];
+    uint8_t _out[OUT_BLOCK];
+    size_t _outLen = 0;
+};
+
+} // namespace Lzss
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
+#include <initializer_list>
 
 // =============================================================================
 // Unified Message Schema
@@ -17,6 +18,8 @@
 // - Index-based references for compactness
 // - Format-agnostic (binary or text serialization)
 // - Schema versioning for bidirectional sync
+// - constexpr: a device schema and its registration text are built at compile
+//   time and live in flash (see devices/*/device_config.h)
 // =============================================================================
 
 namespace MessageSchema {
@@ -55,6 +58,81 @@ constexpr char STATE_CLASS_DELTA = 'd';
 constexpr char STATE_CLASS_DURATION = 'u';
 constexpr char STATE_CLASS_DEFAULT = 'm';
 
+// Registration list buffers ("fields=...", "sys=...", "states=...") and the
+// longest single item
+constexpr size_t REG_FIELDS_LEN = 200;
+constexpr size_t REG_SYS_LEN = 300;
+constexpr size_t REG_STATES_LEN = 200;
+constexpr size_t REG_ITEM_LEN = 64;
+
+// Reached when a builder drops or truncates something. Deliberately not
+// constexpr: hitting it while building a constexpr schema is a compile error.
+inline void schemaLimitExceeded() {}
+
+namespace detail {
+
+// Bounded copy with NUL terminator; false when src was truncated
+constexpr bool copyText(char* dst, size_t cap, const char* src) {
+    size_t i = 0;
+    for (; src[i] != '\0' && i + 1 < cap; i++) dst[i] = src[i];
+    dst[i] = '\0';
+    return src[i] == '\0';
+}
+
+constexpr bool keyEquals(const char* a, const char* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return false;
+        if (a[i] == '\0') return true;
+    }
+    return true;
+}
+
+// Appends to a fixed buffer, always NUL-terminated; sets overflow instead of
+// writing past cap
+struct TextWriter {
+    char* buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+
+    constexpr TextWriter(char* b, size_t c) : buf(b), cap(c) { buf[0] = '\0'; }
+
+    constexpr void put(char c) {
+        if (len + 1 >= cap) {
+            overflow = true;
+            return;
+        }
+        buf[len++] = c;
+        buf[len] = '\0';
+    }
+
+    constexpr void put(const char* text) {
+        while (*text) put(*text++);
+    }
+
+    // printf("%.0f"): round half to even
+    constexpr void putWhole(float value) {
+        double v = value < 0 ? -(double)value : (double)value;
+        if (v >= 1e19) {
+            overflow = true;
+            return;
+        }
+        uint64_t whole = (uint64_t)v;
+        double frac = v - (double)whole;
+        if (frac > 0.5 || (frac == 0.5 && (whole & 1))) whole++;
+        if (value < 0) put('-');
+        char digits[20] = {};
+        uint8_t n = 0;
+        do {
+            digits[n++] = (char)('0' + whole % 10);
+            whole /= 10;
+        } while (whole > 0);
+        while (n > 0) put(digits[--n]);
+    }
+};
+
+} // namespace detail
+
 // -----------------------------------------------------------------------------
 // Field Descriptor - defines a telemetry/system field
 // -----------------------------------------------------------------------------
@@ -71,8 +149,8 @@ struct FieldDescriptor {
     char state_class;      // m, i, d, u for display/placement (0 = default m)
 
     // Helper to check if writable
-    bool isWritable() const { return flags & FLAG_WRITABLE; }
-    bool isReadable() const { return flags & FLAG_READABLE; }
+    constexpr bool isWritable() const { return flags & FLAG_WRITABLE; }
+    constexpr bool isReadable() const { return flags & FLAG_READABLE; }
 
     // Get escaped unit string (% becomes %%)
     const char* getEscapedUnit() const {
@@ -83,6 +161,51 @@ struct FieldDescriptor {
         return unit;
     }
 
+    // Registration item as formatForRegistration() writes it; false for
+    // categories that are not registered
+    constexpr bool renderForRegistration(detail::TextWriter& out) const {
+        const char* unitStr = (unit[0] == '%' && unit[1] == '\0') ? "%%" : unit;
+        char sc = (state_class != '\0') ? state_class : STATE_CLASS_DEFAULT;
+        bool hasRange = min_val > 0 || max_val > 0;
+
+        switch (category) {
+            case FieldCategory::TELEMETRY:
+                out.put(key); out.put(':'); out.put(name);
+                if (hasRange) {
+                    out.put(':'); out.put(unitStr);
+                    out.put(':'); out.putWhole(min_val);
+                    out.put(':'); out.putWhole(max_val);
+                } else if (unit[0] != '\0') {
+                    out.put(':'); out.put(unitStr);
+                }
+                break;
+
+            case FieldCategory::SYSTEM: {
+                const char* access = isWritable() ? "w" : "r";
+                bool isDefaultRange = (min_val == 0.0f && max_val == 4294967295.0f);
+                out.put(key); out.put(':'); out.put(name); out.put(':');
+                if (!isDefaultRange && hasRange) {
+                    out.put(unitStr);
+                    out.put(':'); out.putWhole(min_val);
+                    out.put(':'); out.putWhole(max_val);
+                    out.put(':'); out.put(access);
+                } else if (unit[0] != '\0') {
+                    out.put(unitStr); out.put("::"); out.put(access);
+                } else {
+                    out.put("::r");
+                }
+                break;
+            }
+
+            case FieldCategory::COMPUTED:
+            default:
+                return false;
+        }
+        out.put(':');
+        out.put(sc);
+        return true;
+    }
+
     // Format field for registration frame based on category
     // Appends :s (state_class) for dashboard display/placement. Format: ...:s
     // Returns number of bytes written (snprintf-style)
@@ -159,6 +282,15 @@ struct ControlDescriptor {
         return "unknown";
     }
 
+    // Registration item as formatForRegistration() writes it
+    constexpr void renderForRegistration(detail::TextWriter& out) const {
+        out.put(key); out.put(':'); out.put(name); out.put(':');
+        for (uint8_t i = 0; i < state_count; i++) {
+            if (i > 0) out.put(';');
+            out.put(states[i]);
+        }
+    }
+
     // Format control for registration frame
     // Format: key:name:state1;state2;state3
     // Returns number of bytes written (snprintf-style)
@@ -182,6 +314,83 @@ struct ControlDescriptor {
     }
 };
 
+// -----------------------------------------------------------------------------
+// Key Index - minimal perfect hash over a schema's keys
+// -----------------------------------------------------------------------------
+// Hash and displace: a key's bucket (hash with seed 0) stores a displacement d,
+// and hash(key, d + 1) % count is the key's own slot, one per key. Built by
+// SchemaBuilder::build(), so a constexpr schema carries its index in flash.
+
+// Seeded FNV-1a over the key (at most the 8 bytes a descriptor stores)
+constexpr uint32_t keyHash(const char* key, uint32_t seed) {
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (size_t i = 0; i < 8 && key[i] != '\0'; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+template <uint8_t N>
+struct KeyIndex {
+    uint8_t count;
+    uint8_t displacement[N];    // Per bucket
+    uint8_t slot[N];            // Slot -> descriptor index
+    bool valid;                 // False until built, or if keys repeat
+
+    // The only descriptor the key can be (-1: empty); the caller compares it
+    constexpr int8_t candidate(const char* key) const {
+        if (count == 0) return -1;
+        uint8_t d = displacement[keyHash(key, 0) % count];
+        return (int8_t)slot[keyHash(key, d + 1u) % count];
+    }
+
+    // Largest buckets first, each taking the first displacement that puts
+    // all its keys in free slots
+    constexpr bool build(const char* const* keys, uint8_t n) {
+        count = n;
+        valid = false;
+        uint8_t bucketOf[N] = {};
+        uint8_t bucketSize[N] = {};
+        bool used[N] = {};
+        for (uint8_t i = 0; i < n; i++) {
+            bucketOf[i] = (uint8_t)(keyHash(keys[i], 0) % n);
+            bucketSize[bucketOf[i]]++;
+        }
+
+        for (uint8_t size = n; size > 0; size--) {
+            for (uint8_t b = 0; b < n; b++) {
+                if (bucketSize[b] != size) continue;
+                bool placed = false;
+                for (uint16_t d = 0; d < 256 && !placed; d++) {
+                    uint8_t members[N] = {};
+                    uint8_t slots[N] = {};
+                    uint8_t m = 0;
+                    bool fits = true;
+                    for (uint8_t i = 0; i < n && fits; i++) {
+                        if (bucketOf[i] != b) continue;
+                        uint8_t s = (uint8_t)(keyHash(keys[i], d + 1u) % n);
+                        fits = !used[s];
+                        for (uint8_t j = 0; j < m && fits; j++) fits = slots[j] != s;
+                        members[m] = i;
+                        slots[m++] = s;
+                    }
+                    if (!fits) continue;
+                    for (uint8_t j = 0; j < m; j++) {
+                        used[slots[j]] = true;
+                        slot[slots[j]] = members[j];
+                    }
+                    displacement[b] = (uint8_t)d;
+                    placed = true;
+                }
+                if (!placed) return false;
+            }
+        }
+        valid = true;
+        return true;
+    }
+};
+
 // -----------------------------------------------------------------------------
 // Message Schema - the complete contract
 // -----------------------------------------------------------------------------
@@ -191,21 +400,37 @@ struct Schema {
     uint8_t control_count;                  // Number of controls defined
     FieldDescriptor fields[MAX_FIELDS];     // Field definitions
     ControlDescriptor controls[MAX_CONTROLS]; // Control definitions
+    KeyIndex<MAX_FIELDS> field_index;       // Key lookup, filled by SchemaBuilder::build()
+    KeyIndex<MAX_CONTROLS> control_index;
+
+    // Find field index by key (-1 if not found): one hash probe and one key
+    // compare; usable in static_assert
+    constexpr int8_t findFieldIndex(const char* key) const {
+        if (!field_index.valid) return scanFields(key);
+        int8_t i = field_index.candidate(key);
+        return i >= 0 && detail::keyEquals(fields[i].key, key, sizeof(fields[i].key)) ? i : -1;
+    }
 
-    // Find field index by key (-1 if not found)
-    int8_t findFieldIndex(const char* key) const {
+    // Find control index by key (-1 if not found)
+    constexpr int8_t findControlIndex(const char* key) const {
+        if (!control_index.valid) return scanControls(key);
+        int8_t i = control_index.candidate(key);
+        return i >= 0 && detail::keyEquals(controls[i].key, key, sizeof(controls[i].key)) ? i : -1;
+    }
+
+    // Linear lookups, for a schema without a valid index (first match wins)
+    constexpr int8_t scanFields(const char* key) const {
         for (uint8_t i = 0; i < field_count; i++) {
-            if (strncmp(fields[i].key, key, sizeof(fields[i].key)) == 0) {
+            if (detail::keyEquals(fields[i].key, key, sizeof(fields[i].key))) {
                 return i;
             }
         }
         return -1;
     }
 
-    // Find control index by key (-1 if not found)
-    int8_t findControlIndex(const char* key) const {
+    constexpr int8_t scanControls(const char* key) const {
         for (uint8_t i = 0; i < control_count; i++) {
-            if (strncmp(controls[i].key, key, sizeof(controls[i].key)) == 0) {
+            if (detail::keyEquals(controls[i].key, key, sizeof(controls[i].key))) {
                 return i;
             }
         }
@@ -213,17 +438,17 @@ struct Schema {
     }
 
     // Validate field index
-    bool isValidFieldIndex(uint8_t idx) const {
+    constexpr bool isValidFieldIndex(uint8_t idx) const {
         return idx < field_count;
     }
 
     // Validate control index
-    bool isValidControlIndex(uint8_t idx) const {
+    constexpr bool isValidControlIndex(uint8_t idx) const {
         return idx < control_count;
     }
 
     // Validate state index for a control
-    bool isValidStateIndex(uint8_t ctrl_idx, uint8_t state_idx) const {
+    constexpr bool isValidStateIndex(uint8_t ctrl_idx, uint8_t state_idx) const {
         if (ctrl_idx >= control_count) return false;
         return state_idx < controls[ctrl_idx].state_count;
     }
@@ -232,30 +457,35 @@ struct Schema {
 // -----------------------------------------------------------------------------
 // Schema Builder - fluent API for constructing schemas
 // -----------------------------------------------------------------------------
+// constexpr, so a device schema can be a flash-resident constant:
+//   inline constexpr Schema DEVICE_SCHEMA = SchemaBuilder(1).addField(...).build();
+// Exceeding MAX_FIELDS/MAX_CONTROLS/MAX_STATES_PER_CONTROL or a text field's
+// length then fails to compile; at runtime the excess is dropped or truncated.
 class SchemaBuilder {
 public:
-    SchemaBuilder(uint16_t version = 1) {
+    constexpr SchemaBuilder(uint16_t version = 1) : _schema{} {
         _schema.version = version;
         _schema.field_count = 0;
         _schema.control_count = 0;
     }
 
     // Add a telemetry field (state_class: m, i, d, u for display/placement)
-    SchemaBuilder& addField(const char* key, const char* name, const char* unit,
-                            FieldType type, float min_val, float max_val,
-                            FieldCategory category = FieldCategory::TELEMETRY,
-                            uint8_t flags = FLAG_READABLE,
-                            char state_class = STATE_CLASS_DEFAULT) {
-        if (_schema.field_count >= MAX_FIELDS) return *this;
+    constexpr SchemaBuilder& addField(const char* key, const char* name, const char* unit,
+                                      FieldType type, float min_val, float max_val,
+                                      FieldCategory category = FieldCategory::TELEMETRY,
+                                      uint8_t flags = FLAG_READABLE,
+                                      char state_class = STATE_CLASS_DEFAULT) {
+        if (_schema.field_count >= MAX_FIELDS) {
+            schemaLimitExceeded();
+            return *this;
+        }
 
         auto& f = _schema.fields[_schema.field_count];
         f.index = _schema.field_count;
-        strncpy(f.key, key, sizeof(f.key) - 1);
-        f.key[sizeof(f.key) - 1] = '\0';
-        strncpy(f.name, name, sizeof(f.name) - 1);
-        f.name[sizeof(f.name) - 1] = '\0';
-        strncpy(f.unit, unit, sizeof(f.unit) - 1);
-        f.unit[sizeof(f.unit) - 1] = '\0';
+        bool fits = detail::copyText(f.key, sizeof(f.key), key);
+        fits &= detail::copyText(f.name, sizeof(f.name), name);
+        fits &= detail::copyText(f.unit, sizeof(f.unit), unit);
+        if (!fits) schemaLimitExceeded();
         f.type = type;
         f.category = category;
         f.min_val = min_val;
@@ -268,47 +498,122 @@ public:
     }
 
     // Add a system field (convenience method)
-    SchemaBuilder& addSystemField(const char* key, const char* name, const char* unit,
-                                   FieldType type, float min_val, float max_val,
-                                   bool writable = false,
-                                   char state_class = STATE_CLASS_DEFAULT) {
+    constexpr SchemaBuilder& addSystemField(const char* key, const char* name, const char* unit,
+                                            FieldType type, float min_val, float max_val,
+                                            bool writable = false,
+                                            char state_class = STATE_CLASS_DEFAULT) {
         uint8_t flags = FLAG_READABLE | (writable ? FLAG_WRITABLE : 0);
         return addField(key, name, unit, type, min_val, max_val, FieldCategory::SYSTEM, flags, state_class);
     }
 
     // Add a control with states
-    SchemaBuilder& addControl(const char* key, const char* name,
-                               std::initializer_list<const char*> state_names) {
-        if (_schema.control_count >= MAX_CONTROLS) return *this;
+    constexpr SchemaBuilder& addControl(const char* key, const char* name,
+                                        std::initializer_list<const char*> state_names) {
+        if (_schema.control_count >= MAX_CONTROLS) {
+            schemaLimitExceeded();
+            return *this;
+        }
 
         auto& c = _schema.controls[_schema.control_count];
         c.index = _schema.control_count;
-        strncpy(c.key, key, sizeof(c.key) - 1);
-        c.key[sizeof(c.key) - 1] = '\0';
-        strncpy(c.name, name, sizeof(c.name) - 1);
-        c.name[sizeof(c.name) - 1] = '\0';
+        bool fits = detail::copyText(c.key, sizeof(c.key), key);
+        fits &= detail::copyText(c.name, sizeof(c.name), name);
 
         c.state_count = 0;
         for (const char* state : state_names) {
-            if (c.state_count >= MAX_STATES_PER_CONTROL) break;
-            strncpy(c.states[c.state_count], state, 15);
-            c.states[c.state_count][15] = '\0';
+            if (c.state_count >= MAX_STATES_PER_CONTROL) {
+                fits = false;
+                break;
+            }
+            fits &= detail::copyText(c.states[c.state_count], sizeof(c.states[0]), state);
             c.state_count++;
         }
+        if (!fits) schemaLimitExceeded();
 
         _schema.control_count++;
         return *this;
     }
 
-    // Build and return the schema
-    Schema build() const {
-        return _schema;
+    // Build and return the schema with its key index
+    constexpr Schema build() const {
+        Schema schema = _schema;
+        const char* keys[MAX_FIELDS > MAX_CONTROLS ? MAX_FIELDS : MAX_CONTROLS] = {};
+        for (uint8_t i = 0; i < schema.field_count; i++) keys[i] = schema.fields[i].key;
+        schema.field_index.build(keys, schema.field_count);
+        for (uint8_t i = 0; i < schema.control_count; i++) keys[i] = schema.controls[i].key;
+        schema.control_index.build(keys, schema.control_count);
+        return schema;
     }
 
 private:
     Schema _schema;
 };
 
+// -----------------------------------------------------------------------------
+// Registration Text - the schema's registration lists, rendered once
+// -----------------------------------------------------------------------------
+// Byte-for-byte what formatForRegistration() produces, joined with commas.
+// Rendered at compile time for a constexpr schema, so RegistrationManager
+// sends flash-resident text instead of formatting on every attempt.
+struct RegistrationText {
+    uint16_t version;
+    char fields[REG_FIELDS_LEN];    // "fields=pd:...,tv:..."
+    char sys[REG_SYS_LEN];          // "sys=bp:...,ec:..."
+    char states[REG_STATES_LEN];    // "states=pump:...;..."
+    bool overflow;                  // An item or list did not fit; check with static_assert
+};
+
+namespace detail {
+
+// Appends one rendered item to a list, comma-separated
+constexpr void appendItem(TextWriter& list, bool& first, const char* item) {
+    if (!first) list.put(',');
+    first = false;
+    list.put(item);
+}
+
+} // namespace detail
+
+constexpr RegistrationText renderRegistration(const Schema& schema) {
+    RegistrationText text{};
+    text.version = schema.version;
+    detail::TextWriter fields(text.fields, sizeof(text.fields));
+    detail::TextWriter sys(text.sys, sizeof(text.sys));
+    detail::TextWriter states(text.states, sizeof(text.states));
+    fields.put("fields=");
+    sys.put("sys=");
+    states.put("states=");
+    bool fieldsFirst = true, sysFirst = true, statesFirst = true;
+    bool itemOverflow = false;
+
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        const FieldDescriptor& field = schema.fields[i];
+        char item[REG_ITEM_LEN] = {};
+        detail::TextWriter out(item, sizeof(item));
+        if (!field.renderForRegistration(out)) continue;
+        if (out.overflow) {
+            itemOverflow = true;
+            continue;
+        }
+        if (field.category == FieldCategory::TELEMETRY) {
+            detail::appendItem(fields, fieldsFirst, item);
+        } else {
+            detail::appendItem(sys, sysFirst, item);
+        }
+    }
+
+    for (uint8_t i = 0; i < schema.control_count; i++) {
+        char item[REG_ITEM_LEN] = {};
+        detail::TextWriter out(item, sizeof(item));
+        schema.controls[i].renderForRegistration(out);
+        itemOverflow |= out.overflow;
+        detail::appendItem(states, statesFirst, item);
+    }
+
+    text.overflow = itemOverflow || fields.overflow || sys.overflow || states.overflow;
+    return text;
+}
+
 } // namespace MessageSchema
 
 #endif // MESSAGE_SCHEMA_H
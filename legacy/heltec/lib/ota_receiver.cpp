@@ -3,25 +3,19 @@
 #include "protocol_constants.h"
 #include "core_logger.h"
 #include "lorawan_messages.h"
+#include "crc.h"
 #include <Arduino.h>
 #include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
 #include <cstring>
+#include <new>
 
 namespace OtaReceiver {
 
 // CRC-16-CCITT (poly 0x1021, init 0xFFFF) over payload only — must match Node-RED
 uint16_t OtaReceiver::crc16Payload(const uint8_t* data, size_t len) {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (int k = 0; k < 8; k++) {
-            if (crc & 0x8000)
-                crc = (crc << 1) ^ 0x1021;
-            else
-                crc = crc << 1;
-        }
-    }
-    return crc;
+    return Crc::crc16Ccitt(data, len);
 }
 
 bool OtaReceiver::verifyChunkCrc16(const uint8_t* payload, size_t payloadLen, uint16_t expectedCrc16) {
@@ -29,7 +23,7 @@ bool OtaReceiver::verifyChunkCrc16(const uint8_t* payload, size_t payloadLen, ui
 }
 
 void OtaReceiver::sendProgress(ProgressStatus status, uint16_t chunkIndex) {
-    if (!txQueue_) return;
+    if (!tx_) return;
     
     LoRaWANTxMsg msg;
     msg.port = FPORT_OTA_PROGRESS;
@@ -39,10 +33,177 @@ void OtaReceiver::sendProgress(ProgressStatus status, uint16_t chunkIndex) {
     msg.payload[1] = (uint8_t)(chunkIndex & 0xFF);
     msg.payload[2] = (uint8_t)(chunkIndex >> 8);
     
-    xQueueSend(txQueue_, &msg, 0);  // Fire and forget
+    tx_->enqueue(TxClass::OtaAck, msg);  // Fire and forget; newest ACK wins if full
     LOGI("OTA", "Progress: status=%d index=%u", (int)status, (unsigned)chunkIndex);
 }
 
+void OtaReceiver::sendWindow() {
+    if (!tx_) return;
+
+    LoRaWANTxMsg msg;
+    msg.port = FPORT_OTA_PROGRESS;
+    msg.len = 5;
+    msg.confirmed = false;
+    msg.payload[0] = static_cast<uint8_t>(ProgressStatus::Window);
+    msg.payload[1] = (uint8_t)(nextExpectedIndex_ & 0xFF);
+    msg.payload[2] = (uint8_t)(nextExpectedIndex_ >> 8);
+    msg.payload[3] = (uint8_t)(stagedMask_ & 0xFF);
+    msg.payload[4] = (uint8_t)(stagedMask_ >> 8);
+
+    tx_->enqueue(TxClass::OtaAck, msg);  // Cumulative: a newer window status supersedes older ones
+    LOGD("OTA", "Window: base=%u staged=0x%04x", (unsigned)nextExpectedIndex_, (unsigned)stagedMask_);
+}
+
+void OtaReceiver::releaseBuffers() {
+    delete[] staging_;
+    staging_ = nullptr;
+    stagedMask_ = 0;
+    delete patch_;
+    patch_ = nullptr;
+    delete lzss_;
+    lzss_ = nullptr;
+}
+
+// Abort the update, report and tell the server
+void OtaReceiver::fail(uint16_t index, uint8_t otaError) {
+    if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, otaError);
+    Update.abort();
+    releaseBuffers();
+    state_ = State::Failed;
+    sendProgress(ProgressStatus::Failed, index);
+}
+
+bool OtaReceiver::patchRead(void* ctx, uint32_t offset, uint8_t* dst, size_t len) {
+    auto* self = static_cast<OtaReceiver*>(ctx);
+    auto* part = static_cast<const esp_partition_t*>(self->basePartition_);
+    return part && esp_partition_read(part, offset, dst, len) == ESP_OK;
+}
+
+bool OtaReceiver::patchWrite(void* ctx, const uint8_t* data, size_t len) {
+    return static_cast<OtaReceiver*>(ctx)->writeImage(data, len);
+}
+
+bool OtaReceiver::decodedSink(void* ctx, const uint8_t* data, size_t len) {
+    return static_cast<OtaReceiver*>(ctx)->consume(data, len);
+}
+
+// Image stage input: patch stream in patch mode, raw image otherwise
+bool OtaReceiver::consume(const uint8_t* data, size_t len) {
+    if (!patch_) return writeImage(data, len);
+    DeltaPatch::Status st = patch_->feed(data, len);
+    return st == DeltaPatch::Status::Ok || st == DeltaPatch::Status::Done;
+}
+
+// Append image bytes to the inactive slot
+bool OtaReceiver::writeImage(const uint8_t* data, size_t len) {
+    // ZERO COPY: Cast away const (Update.write doesn't accept const but won't modify)
+    size_t written = Update.write(const_cast<uint8_t*>(data), len);
+    if (written != len) {
+        LOGW("OTA", "Update.write failed: wrote %d of %u, error=%u, hasError=%d, heap=%lu",
+             (int)written, (unsigned)len, Update.getError(), Update.hasError(),
+             (unsigned long)ESP.getFreeHeap());
+        return false;
+    }
+    if (verifyImage_) imageCrc32_ = Crc::crc32Update(imageCrc32_, data, len);
+    return true;
+}
+
+// Write one chunk (image or patch bytes). On failure aborts the update and reports.
+bool OtaReceiver::writeChunk(uint16_t index, const uint8_t* chunkPayload) {
+    // Diagnostic logging every 100 chunks to track memory
+    if (index % 100 == 0 || index == 2064) {
+        LOGI("OTA", "Chunk %u: heap=%lu min_heap=%lu",
+             (unsigned)index,
+             (unsigned long)ESP.getFreeHeap(),
+             (unsigned long)ESP.getMinFreeHeap());
+    }
+
+    // Last chunk is padded; only totalSize_ bytes are image (or stream) data
+    size_t len = OTA_PAYLOAD_SIZE;
+    uint32_t start = (uint32_t)index * OTA_PAYLOAD_SIZE;
+    if (start >= totalSize_) len = 0;
+    else if (totalSize_ - start < OTA_PAYLOAD_SIZE) len = (size_t)(totalSize_ - start);
+    bool ok = lzss_ ? lzss_->feed(chunkPayload, len) == Lzss::Status::Ok : consume(chunkPayload, len);
+    if (!ok) {
+        DeltaPatch::Status st = patch_ ? patch_->status() : DeltaPatch::Status::Ok;
+        if (st != DeltaPatch::Status::Ok && st != DeltaPatch::Status::WriteFail &&
+            st != DeltaPatch::Status::ReadFail) {
+            LOGW("OTA", "Patch failed at chunk %u: %s", (unsigned)index, DeltaPatch::Applier::statusName(st));
+            fail(index, ErrorReporter::Ota::Crc);
+        } else {
+            LOGW("OTA", "Write failed at chunk %u", (unsigned)index);
+            fail(index, ErrorReporter::Ota::Write);
+        }
+        return false;
+    }
+    nextExpectedIndex_++;
+    return true;
+}
+
+// All chunks written: finalize the image and schedule the reboot
+void OtaReceiver::finish(uint16_t index) {
+    if (patch_ && !patch_->done()) {
+        LOGW("OTA", "Patch incomplete: %lu of %lu bytes", (unsigned long)patch_->produced(),
+             (unsigned long)patch_->newSize());
+        fail(index, ErrorReporter::Ota::Crc);
+        return;
+    }
+    if (verifyImage_ && imageCrc32_ != expectedCrc32_) {
+        LOGW("OTA", "Image CRC32 mismatch: got %08lx expected %08lx",
+             (unsigned long)imageCrc32_, (unsigned long)expectedCrc32_);
+        fail(index, ErrorReporter::Ota::Crc);
+        return;
+    }
+    releaseBuffers();
+    bool ok = Update.end(true);
+    if (!ok) {
+        LOGW("OTA", "Update.end failed");
+        if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Write);
+        state_ = State::Failed;
+        sendProgress(ProgressStatus::Failed, index);
+        return;
+    }
+    state_ = State::Verifying;
+    sendProgress(ProgressStatus::Done, index);
+    rebootAtMs_ = millis() + REBOOT_DELAY_MS;
+    state_ = State::Rebooting;
+    LOGI("OTA", "All chunks received, rebooting in %lu ms", (unsigned long)REBOOT_DELAY_MS);
+}
+
+// Windowed mode: stage chunks inside the window, write the contiguous prefix
+bool OtaReceiver::handleChunkWindowed(uint16_t index, const uint8_t* chunkPayload) {
+    if (index < nextExpectedIndex_ || index - nextExpectedIndex_ >= OTA_WINDOW_SIZE) {
+        // Duplicate or ahead of the window: the status tells the server where we are
+        sendWindow();
+        return true;
+    }
+
+    uint16_t offset = index - nextExpectedIndex_;
+    if (offset > 0) {
+        uint16_t slot = index % OTA_WINDOW_SIZE;
+        memcpy(staging_ + (size_t)slot * OTA_PAYLOAD_SIZE, chunkPayload, OTA_PAYLOAD_SIZE);
+        stagedMask_ |= (uint16_t)(1u << offset);
+        sendWindow();
+        return true;
+    }
+
+    // In order: write it, then drain staged successors
+    if (!writeChunk(index, chunkPayload)) return true;
+    stagedMask_ >>= 1;
+    while ((stagedMask_ & 1) && nextExpectedIndex_ < totalChunks_) {
+        uint16_t next = nextExpectedIndex_;
+        if (!writeChunk(next, staging_ + (size_t)(next % OTA_WINDOW_SIZE) * OTA_PAYLOAD_SIZE)) return true;
+        stagedMask_ >>= 1;
+    }
+
+    if (nextExpectedIndex_ >= totalChunks_) {
+        finish(nextExpectedIndex_ - 1);
+    } else {
+        sendWindow();
+    }
+    return true;
+}
+
 bool OtaReceiver::handleDownlink(uint8_t port, const uint8_t* payload, uint8_t length) {
     if (port == FPORT_OTA_START) {
         LOGI("OTA", "RX fPort 40 Start len=%d", length);
@@ -64,20 +225,75 @@ bool OtaReceiver::handleDownlink(uint8_t port, const uint8_t* payload, uint8_t l
             expectedCrc32_ = (uint32_t)payload[6] | ((uint32_t)payload[7] << 8) |
                              ((uint32_t)payload[8] << 16) | ((uint32_t)payload[9] << 24);
         }
-        if (totalChunks_ == 0 || totalSize_ == 0) {
+        uint8_t flags = length > OTA_START_FLAGS_OFFSET ? payload[OTA_START_FLAGS_OFFSET] : 0;
+        if (totalChunks_ == 0 || totalSize_ == 0 || totalSize_ > (uint32_t)totalChunks_ * OTA_PAYLOAD_SIZE) {
             LOGW("OTA", "Start ignored: invalid size=%lu chunks=%u", (unsigned long)totalSize_, (unsigned)totalChunks_);
             return true;
         }
-        if (!Update.begin(totalSize_, U_FLASH)) {
+        bool patch = (flags & OTA_FLAG_PATCH) != 0;
+        bool compressed = (flags & OTA_FLAG_COMPRESSED) != 0;
+        if ((patch || compressed) && !hasExpectedCrc32_) {
+            LOGW("OTA", "Start ignored: patch/compressed mode requires image CRC32");
+            return true;
+        }
+        if (compressed && length <= OTA_START_PARAMS_OFFSET) {
+            LOGW("OTA", "Start ignored: compression parameters missing");
+            return true;
+        }
+        // Patch/compressed: image size is only known once the stream is decoded
+        if (!Update.begin(patch || compressed ? UPDATE_SIZE_UNKNOWN : totalSize_, U_FLASH)) {
             LOGW("OTA", "Update.begin failed");
             if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Write);
             sendProgress(ProgressStatus::Failed, 0);
             return true;
         }
         nextExpectedIndex_ = 0;
+        imageCrc32_ = 0;
+        verifyImage_ = hasExpectedCrc32_;
+        releaseBuffers();
+        if (patch) {
+            basePartition_ = esp_ota_get_running_partition();
+            patch_ = new (std::nothrow) DeltaPatch::Applier();
+            if (!patch_ || !basePartition_) {
+                LOGW("OTA", "Patch mode unavailable");
+                if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::Memory);
+                Update.abort();
+                releaseBuffers();
+                sendProgress(ProgressStatus::Failed, 0);
+                return true;
+            }
+            patch_->begin(patchRead, patchWrite, this);
+        }
+        if (compressed) {
+            uint8_t params = payload[OTA_START_PARAMS_OFFSET];
+            lzss_ = new (std::nothrow) Lzss::Decoder();
+            if (!lzss_ || !lzss_->begin(params, decodedSink, this)) {
+                LOGW("OTA", "Compression unavailable (params=0x%02x)", (unsigned)params);
+                if (!lzss_ && errorReporter_)
+                    errorReporter_->reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::Memory);
+                Update.abort();
+                releaseBuffers();
+                sendProgress(ProgressStatus::Failed, 0);
+                return true;
+            }
+        }
+        windowed_ = (flags & OTA_FLAG_WINDOWED) != 0;
+        if (windowed_) {
+            staging_ = new (std::nothrow) uint8_t[OTA_WINDOW_SIZE * OTA_PAYLOAD_SIZE];
+            if (!staging_) {
+                LOGW("OTA", "No memory for window staging, using stop-and-wait");
+                if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::Memory);
+                windowed_ = false;
+            }
+        }
         state_ = State::Receiving;
-        sendProgress(ProgressStatus::Ready, 0);
-        LOGI("OTA", "Start: size=%lu chunks=%u", (unsigned long)totalSize_, (unsigned)totalChunks_);
+        if (windowed_) {
+            sendWindow();
+        } else {
+            sendProgress(ProgressStatus::Ready, 0);
+        }
+        LOGI("OTA", "Start: size=%lu chunks=%u mode=%s%s%s", (unsigned long)totalSize_, (unsigned)totalChunks_,
+             windowed_ ? "windowed" : "stop-and-wait", patch ? "+patch" : "", compressed ? "+lzss" : "");
         return true;
     }
 
@@ -103,9 +319,16 @@ bool OtaReceiver::handleDownlink(uint8_t port, const uint8_t* payload, uint8_t l
         if (!verifyChunkCrc16(chunkPayload, OTA_PAYLOAD_SIZE, recvCrc)) {
             LOGW("OTA", "Chunk %u CRC mismatch", (unsigned)index);
             if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Crc);
-            sendProgress(ProgressStatus::Failed, index);
+            if (windowed_) {
+                sendWindow();  // Corrupt chunk stays missing in the bitmap
+            } else {
+                sendProgress(ProgressStatus::Failed, index);
+            }
             return true;
         }
+        if (windowed_) {
+            return handleChunkWindowed(index, chunkPayload);
+        }
         if (index < nextExpectedIndex_) {
             sendProgress(ProgressStatus::ChunkOk, index);
             return true;
@@ -116,46 +339,11 @@ bool OtaReceiver::handleDownlink(uint8_t port, const uint8_t* payload, uint8_t l
             return true;
         }
 
-        // Diagnostic logging every 100 chunks to track memory
-        if (index % 100 == 0 || index == 2064) {
-            LOGI("OTA", "Chunk %u: heap=%lu min_heap=%lu",
-                 (unsigned)index,
-                 (unsigned long)ESP.getFreeHeap(),
-                 (unsigned long)ESP.getMinFreeHeap());
-        }
-
-        // ZERO COPY: Cast away const (Update.write doesn't accept const but won't modify)
-        size_t written = Update.write(const_cast<uint8_t*>(chunkPayload), OTA_PAYLOAD_SIZE);
-        if (written != OTA_PAYLOAD_SIZE) {
-            uint8_t err = Update.getError();
-            LOGW("OTA", "Update.write failed at chunk %u: wrote %d, error=%u, hasError=%d, heap=%lu",
-                 (unsigned)index, (int)written, err, Update.hasError(),
-                 (unsigned long)ESP.getFreeHeap());
-            if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Write);
-            Update.abort();
-            state_ = State::Failed;
-            sendProgress(ProgressStatus::Failed, index);
-            return true;
-        }
-        nextExpectedIndex_++;
+        if (!writeChunk(index, chunkPayload)) return true;
         sendProgress(ProgressStatus::ChunkOk, index);
 
         if (nextExpectedIndex_ >= totalChunks_) {
-            bool ok = Update.end(true);
-            if (!ok) {
-                LOGW("OTA", "Update.end failed");
-                if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Write);
-                state_ = State::Failed;
-                sendProgress(ProgressStatus::Failed, index);
-                return true;
-            }
-            if (hasExpectedCrc32_)
-                (void)expectedCrc32_;
-            state_ = State::Verifying;
-            sendProgress(ProgressStatus::Done, index);
-            rebootAtMs_ = millis() + REBOOT_DELAY_MS;
-            state_ = State::Rebooting;
-            LOGI("OTA", "All chunks received, rebooting in %lu ms", (unsigned long)REBOOT_DELAY_MS);
+            finish(index);
         }
         return true;
     }
@@ -167,6 +355,7 @@ bool OtaReceiver::handleDownlink(uint8_t port, const uint8_t* payload, uint8_t l
         }
         if (state_ == State::Receiving || state_ == State::Verifying)
             Update.abort();
+        releaseBuffers();
         if (errorReporter_) errorReporter_->reportError(ErrorReporter::Category::Ota, ErrorReporter::Ota::Timeout);
         state_ = State::Cancelled;
         sendProgress(ProgressStatus::Cancelled, nextExpectedIndex_);
@@ -2,16 +2,43 @@
 
 #include <stdint.h>
 #include <stddef.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
+#include "tx_scheduler.h"
+#include "delta_patch.h"
+#include "lzss_decoder.h"
 
 namespace ErrorReporter { class IErrorReporter; }
 
 // =============================================================================
-// OTA over LoRaWAN — sequential chunk receiver
+// OTA over LoRaWAN — chunk receiver (stop-and-wait or windowed)
 // =============================================================================
 // fPort 40 = start, 41 = chunk, 42 = cancel; uplink progress on fPort 8.
-// One chunk per ACK: device ACKs every chunk; server sends next.
+//
+// Stop-and-wait (default): device ACKs every chunk; server sends next.
+//
+// When the start frame carries a CRC32 it is computed incrementally over the
+// image as it is written (first total size bytes) and checked before
+// Update.end commits; a mismatch fails the transfer without rebooting.
+//
+// Windowed (start flag OTA_FLAG_WINDOWED): the device accepts any chunk in
+// [base, base + OTA_WINDOW_SIZE), stages out-of-order chunks in RAM and writes
+// flash in order. Every chunk is answered with a Window status carrying the
+// base and a bitmap of staged chunks, so the server can keep the network
+// server downlink queue full and only resend what the bitmap shows missing.
+//
+// Patch (start flag OTA_FLAG_PATCH): chunks carry a DeltaPatch stream (see
+// delta_patch.h) of total size bytes instead of the image. The new image is
+// rebuilt from the running partition and must match the start frame CRC32,
+// which is required in this mode. Combines with windowed mode.
+//
+// Compressed (start flag OTA_FLAG_COMPRESSED): chunk bytes are a heatshrink
+// stream (see lzss_decoder.h) decoded before the image (or patch) stage.
+// Start byte 11 carries the parameters as (W << 4) | L; CRC32 is required
+// and covers the decoded image. Combines with windowed and patch modes.
+//
+// Window status (fPort 8, 5 bytes):
+// [0]   ProgressStatus::Window
+// [1-2] base: next chunk to be written (uint16 LE)
+// [3-4] bitmap (uint16 LE): bit i = chunk base + i staged
 // =============================================================================
 
 namespace OtaReceiver {
@@ -22,7 +49,8 @@ enum class ProgressStatus : uint8_t {
     ChunkOk   = 1,
     Done      = 2,
     Failed    = 3,
-    Cancelled = 4
+    Cancelled = 4,
+    Window    = 5   // Windowed mode: base + staged bitmap
 };
 
 // State machine
@@ -41,19 +69,32 @@ constexpr size_t OTA_INDEX_SIZE     = 2;    // little-endian
 constexpr size_t OTA_CRC16_SIZE     = 2;
 constexpr size_t OTA_CHUNK_PAYLOAD_LEN = OTA_INDEX_SIZE + OTA_PAYLOAD_SIZE + OTA_CRC16_SIZE;  // 222
 
-// fPort 40: minimum = 4 (size) + 2 (chunks) = 6; optional +4 = CRC32
+// fPort 40: minimum = 4 (size) + 2 (chunks) = 6; optional +4 = CRC32; optional +1 = flags;
+// +1 = compression parameters when OTA_FLAG_COMPRESSED
 constexpr size_t OTA_START_MIN_LEN = 6;
-constexpr size_t OTA_START_MAX_LEN = 10;
+constexpr size_t OTA_START_FLAGS_OFFSET = 10;
+constexpr size_t OTA_START_PARAMS_OFFSET = 11;
+constexpr size_t OTA_START_MAX_LEN = 12;
+
+// Start flags (byte 10)
+constexpr uint8_t OTA_FLAG_WINDOWED = 0x01;
+constexpr uint8_t OTA_FLAG_PATCH    = 0x02;
+constexpr uint8_t OTA_FLAG_COMPRESSED = 0x04;
+
+// Windowed mode: chunks staged ahead of the flash write position
+constexpr uint16_t OTA_WINDOW_SIZE = 16;
+static_assert(OTA_WINDOW_SIZE <= 16, "staged bitmap is 16 bits");
 
 class OtaReceiver {
 public:
     OtaReceiver() = default;
+    ~OtaReceiver() { releaseBuffers(); }
     
-    /** Constructor with TX queue (direct queue access, no callback) */
-    explicit OtaReceiver(QueueHandle_t txQueue) : txQueue_(txQueue) {}
+    /** Constructor with TX scheduler (progress goes out as TxClass::OtaAck) */
+    explicit OtaReceiver(TxScheduler* tx) : tx_(tx) {}
 
-    /** Set TX queue (alternative to constructor) */
-    void setTxQueue(QueueHandle_t txQueue) { txQueue_ = txQueue; }
+    /** Set TX scheduler (alternative to constructor) */
+    void setTxScheduler(TxScheduler* tx) { tx_ = tx; }
 
     /** Optional: report OTA errors (cs=CRC, wf=write fail, tm=timeout/cancel) for telemetry counters */
     void setErrorReporter(ErrorReporter::IErrorReporter* reporter) { errorReporter_ = reporter; }
@@ -79,17 +120,36 @@ public:
 
 private:
     void sendProgress(ProgressStatus status, uint16_t chunkIndex);
+    void sendWindow();
+    bool handleChunkWindowed(uint16_t index, const uint8_t* chunkPayload);
+    bool writeChunk(uint16_t index, const uint8_t* chunkPayload);
+    bool consume(const uint8_t* data, size_t len);
+    bool writeImage(const uint8_t* data, size_t len);
+    void fail(uint16_t index, uint8_t otaError);
+    void finish(uint16_t index);
+    void releaseBuffers();
+    static bool patchRead(void* ctx, uint32_t offset, uint8_t* dst, size_t len);
+    static bool patchWrite(void* ctx, const uint8_t* data, size_t len);
+    static bool decodedSink(void* ctx, const uint8_t* data, size_t len);
     bool verifyChunkCrc16(const uint8_t* payload, size_t payloadLen, uint16_t expectedCrc16);
     static uint16_t crc16Payload(const uint8_t* data, size_t len);
 
-    QueueHandle_t txQueue_ = nullptr;
+    TxScheduler* tx_ = nullptr;
     ErrorReporter::IErrorReporter* errorReporter_ = nullptr;
     State state_ = State::Idle;
     uint32_t totalSize_ = 0;
     uint16_t totalChunks_ = 0;
     uint32_t expectedCrc32_ = 0;       // 0 = not provided
     bool hasExpectedCrc32_ = false;
-    uint16_t nextExpectedIndex_ = 0;
+    uint16_t nextExpectedIndex_ = 0;   // Windowed mode: window base
+    bool windowed_ = false;
+    uint16_t stagedMask_ = 0;          // Bit i = chunk nextExpectedIndex_ + i staged
+    uint8_t* staging_ = nullptr;       // OTA_WINDOW_SIZE * OTA_PAYLOAD_SIZE, windowed mode only
+    DeltaPatch::Applier* patch_ = nullptr;  // Patch mode only
+    Lzss::Decoder* lzss_ = nullptr;         // Compressed mode only
+    const void* basePartition_ = nullptr;   // Running partition (patch source)
+    uint32_t imageCrc32_ = 0;          // CRC32 of image bytes written so far
+    bool verifyImage_ = false;         // Check imageCrc32_ before Update.end
     uint32_t rebootAtMs_ = 0;
     static constexpr uint32_t REBOOT_DELAY_MS = 500;
 };
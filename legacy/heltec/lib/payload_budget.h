@@ -0,0 +1,54 @@
+#pragma once
+
+#include "communication_config.h"
+#include "lorawan_payload_limits.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// =============================================================================
+// Payload Budget: live max application payload for the negotiated data rate
+// =============================================================================
+// The radio task updates the budget after join and after every uplink (ADR may
+// move the link down to DR0/DR1). Producers read maxPayload() when building a
+// frame and split, prioritise or truncate to fit instead of assuming DR3.
+//
+// Plain struct with volatile fields so it can live in RadioTaskState (written
+// by the radio task, read by any task).
+// =============================================================================
+
+struct PayloadBudget {
+    static constexpr uint8_t ABSOLUTE_MAX = 222;  // Largest payload on any DR (LoRaWANTxMsg buffer)
+
+    volatile uint8_t dataRate;
+    volatile uint8_t limit;     // 0 = unknown (not joined yet)
+
+    /** Radio task: record the data rate in use. */
+    void update(LoRaWANRegion region, uint8_t dr) {
+        uint8_t max = getMaxPayloadSize(region, dr);
+        dataRate = dr;
+        limit = (max == 0 || max > ABSOLUTE_MAX) ? ABSOLUTE_MAX : max;
+    }
+
+    /** Max application payload for the current data rate (ABSOLUTE_MAX until known). */
+    uint8_t maxPayload() const {
+        uint8_t l = limit;
+        return l ? l : ABSOLUTE_MAX;
+    }
+};
+
+namespace PayloadFit {
+
+/**
+ * Largest prefix of a comma-separated list that fits in maxLen, cut at an item
+ * boundary. Returns the prefix length (0 if not even the first item fits).
+ */
+inline size_t fitItems(const char* items, size_t len, size_t maxLen) {
+    if (len <= maxLen) return len;
+    size_t cut = 0;
+    for (size_t i = 0; i <= maxLen && i < len; i++) {
+        if (items[i] == ',') cut = i;
+    }
+    return cut;
+}
+
+} // namespace PayloadFit
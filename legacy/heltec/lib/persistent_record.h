@@ -0,0 +1,178 @@
+#pragma once
+
+#include "hal_persistence.h"
+#include "crc.h"
+#include "core_logger.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// =============================================================================
+// Persistent Records: typed state with dirty tracking and coalesced writes
+// =============================================================================
+// A record is one struct stored as one blob, so it is replaced whole or not
+// at all:
+// [0]     version
+// [1..n]  struct bytes
+// [n+1..] CRC-16 of the above (LE)
+//
+// update() changes the RAM copy and marks it dirty. RecordWriter writes a
+// dirty record at most once per the record's interval, so a burst of
+// changes (a no-ACK storm) costs one write. flushAll() ignores the interval:
+// before a restart, before sleep, or when the supply is about to brown out.
+//
+// update() may be called from any task: it and the snapshot in save() both
+// hold the record's mutex, so a write never stores half an update. Writes
+// happen on the task that calls RecordWriter::tick() / flushAll(); get()
+// takes no lock and is for the task that owns the value.
+// =============================================================================
+
+class IPersistentRecord {
+public:
+    virtual ~IPersistentRecord() = default;
+    virtual bool dirty() const = 0;
+    virtual uint32_t minIntervalMs() const = 0;
+    virtual bool save(IPersistenceHal& hal) = 0;
+};
+
+template <typename T>
+class PersistentRecord : public IPersistentRecord {
+    static_assert(std::is_trivially_copyable<T>::value, "records are stored as raw bytes");
+
+public:
+    static constexpr size_t BLOB_SIZE = 1 + sizeof(T) + 2;
+
+    PersistentRecord(const char* ns, const char* key, uint8_t version, uint32_t minIntervalMs)
+        : _ns(ns), _key(key), _version(version), _minIntervalMs(minIntervalMs),
+          _mutex(xSemaphoreCreateMutex()) {}
+
+    ~PersistentRecord() override {
+        if (_mutex) vSemaphoreDelete(_mutex);
+    }
+
+    PersistentRecord(const PersistentRecord&) = delete;
+    PersistentRecord& operator=(const PersistentRecord&) = delete;
+
+    const T& get() const { return _value; }
+
+    // Apply fn to the value and mark it dirty, both under the lock, so a
+    // concurrent save() sees either none of the change or all of it
+    template <typename Fn>
+    void update(Fn fn) {
+        lock();
+        fn(_value);
+        _dirty = true;
+        unlock();
+    }
+
+    void markDirty() { _dirty = true; }
+
+    // False when the record is absent, of another version or corrupt; the
+    // value is left as it was
+    bool load(IPersistenceHal& hal) {
+        uint8_t blob[BLOB_SIZE];
+        if (!hal.begin(_ns)) return false;
+        size_t len = hal.loadBytes(_key, blob, sizeof(blob));
+        hal.end();
+        if (len != sizeof(blob) || blob[0] != _version) return false;
+        uint16_t crc = (uint16_t)(blob[BLOB_SIZE - 2] | (blob[BLOB_SIZE - 1] << 8));
+        if (Crc::crc16Ccitt(blob, BLOB_SIZE - 2) != crc) {
+            LOGW("Persist", "%s/%s: CRC mismatch, using defaults", _ns, _key);
+            return false;
+        }
+        lock();
+        memcpy(&_value, blob + 1, sizeof(T));
+        unlock();
+        return true;
+    }
+
+    bool dirty() const override { return _dirty; }
+    uint32_t minIntervalMs() const override { return _minIntervalMs; }
+
+    bool save(IPersistenceHal& hal) override {
+        uint8_t blob[BLOB_SIZE];
+        blob[0] = _version;
+        lock();
+        _dirty = false;
+        memcpy(blob + 1, &_value, sizeof(T));
+        unlock();
+        uint16_t crc = Crc::crc16Ccitt(blob, BLOB_SIZE - 2);
+        blob[BLOB_SIZE - 2] = crc & 0xFF;
+        blob[BLOB_SIZE - 1] = crc >> 8;
+        bool ok = hal.begin(_ns);
+        ok = ok && hal.saveBytes(_key, blob, sizeof(blob));
+        hal.end();
+        if (!ok) {
+            _dirty = true;
+            LOGW("Persist", "%s/%s: write failed", _ns, _key);
+        }
+        return ok;
+    }
+
+private:
+    const char* _ns;
+    const char* _key;
+    uint8_t _version;
+    uint32_t _minIntervalMs;
+    T _value{};
+    volatile bool _dirty = false;
+    SemaphoreHandle_t _mutex;
+
+    void lock() const { xSemaphoreTake(_mutex, portMAX_DELAY); }
+    void unlock() const { xSemaphoreGive(_mutex); }
+};
+
+// Writes dirty records, each at most once per its interval
+class RecordWriter {
+public:
+    static constexpr uint8_t MAX_RECORDS = 8;
+
+    void begin(IPersistenceHal* hal) { _hal = hal; }
+
+    bool add(IPersistentRecord* record) {
+        if (!record || _count >= MAX_RECORDS) return false;
+        _slots[_count++] = {record, 0, false};
+        return true;
+    }
+
+    void tick(uint32_t nowMs) {
+        if (!_hal) return;
+        for (uint8_t i = 0; i < _count; i++) {
+            Slot& s = _slots[i];
+            if (!s.record->dirty()) continue;
+            if (s.written && nowMs - s.lastWriteMs < s.record->minIntervalMs()) continue;
+            write(s, nowMs);
+        }
+    }
+
+    // Every dirty record now, regardless of interval
+    void flushAll(uint32_t nowMs) {
+        if (!_hal) return;
+        for (uint8_t i = 0; i < _count; i++) {
+            if (_slots[i].record->dirty()) write(_slots[i], nowMs);
+        }
+    }
+
+    uint32_t writes() const { return _writes; }
+
+private:
+    struct Slot {
+        IPersistentRecord* record;
+        uint32_t lastWriteMs;
+        bool written;
+    };
+
+    IPersistenceHal* _hal = nullptr;
+    Slot _slots[MAX_RECORDS];
+    uint8_t _count = 0;
+    uint32_t _writes = 0;
+
+    void write(Slot& s, uint32_t nowMs) {
+        // A failed write also waits out the interval before retrying
+        s.lastWriteMs = nowMs;
+        s.written = true;
+        if (s.record->save(*_hal)) _writes++;
+    }
+};
@@ -4,7 +4,7 @@
 // Message Protocol fPorts (Phase 4: Device-centric framework)
 // =============================================================================
 // fPort 1: Registration - Sent on boot/join, contains device metadata and field definitions
-// fPort 2: Telemetry - Periodic sensor readings in JSON format
+// fPort 2: Telemetry - Periodic sensor readings, schema-indexed binary (keyframe/delta)
 // fPort 3: State Change - Sent when control state changes (future: RS485 actuators)
 // fPort 4: Command ACK - Acknowledgment of received downlink commands
 // fPort 10-12: Utility commands (reset, interval, reboot)
@@ -16,6 +16,7 @@
 #define FPORT_COMMAND_ACK   4   // Acknowledgment of downlink commands
 #define FPORT_DIAGNOSTICS   6   // Device status/diagnostics response
 #define FPORT_RECONNECTION  7   // Reconnection event: 4 bytes duration_sec (uint32 LE) since disconnect
+#define FPORT_BACKFILL      9   // Readings stored while offline, batched (see reading_store.h)
 
 // Downlink ports (server → device)
 #define FPORT_REG_ACK       5   // Registration acknowledgment from server
@@ -26,14 +27,16 @@
 #define FPORT_CMD_FORCE_REG 14  // Force re-registration (clear NVS)
 #define FPORT_CMD_STATUS    15  // Request device status uplink
 #define FPORT_CMD_DISPLAY_TIMEOUT 16  // Set display auto-off timeout (2 bytes: seconds big-endian)
+#define FPORT_CMD_TELEMETRY_RESYNC 17 // Server lost delta baseline: next telemetry frame is a keyframe
+#define FPORT_CMD_TIME_SYNC 18  // Wall clock for rule programs (unix time 4B LE, optional UTC offset minutes 2B LE signed)
 
 // Edge Rules Engine ports
 #define FPORT_DIRECT_CTRL   20  // Direct control command (7 bytes: ctrl_idx, state_idx, flags, timeout)
-#define FPORT_RULE_UPDATE   30  // Rule management (12 bytes per rule, or special commands)
+#define FPORT_RULE_UPDATE   30  // Rule management (20- or 12-byte rule, 0xFE + rule + program, or special commands)
 
 // OTA over LoRaWAN (custom chunked protocol)
 #define FPORT_OTA_PROGRESS  8   // Uplink: OTA progress (status 1B, chunk index 2B LE)
-#define FPORT_OTA_START     40  // Downlink: OTA start (total size 4B LE, total chunks 2B LE, optional CRC32 4B)
+#define FPORT_OTA_START     40  // Downlink: OTA start (total size 4B LE, total chunks 2B LE, optional CRC32 4B, flags 1B, lzss params 1B)
 #define FPORT_OTA_CHUNK     41  // Downlink: OTA chunk (index 2B LE, payload 218 B, CRC16 2B) = 222 B max
 #define FPORT_OTA_CANCEL    42  // Downlink: OTA cancel
 
@@ -0,0 +1,140 @@
+#include "pulse_source.h"
+#include "ulp_pulse_counter.h"
+#include "core_logger.h"
+
+// =============================================================================
+// ISR
+// =============================================================================
+
+volatile bool IsrPulseSource::_edgeSeen = false;
+
+IsrPulseSource::~IsrPulseSource() {
+    if (_gpio != 0xFF) detachInterrupt(digitalPinToInterrupt(_gpio));
+}
+
+bool IsrPulseSource::begin(uint8_t gpio) {
+    _gpio = gpio;
+    pinMode(gpio, INPUT_PULLUP);
+    attachInterruptArg(digitalPinToInterrupt(gpio), onEdge, this, FALLING);
+    return true;
+}
+
+void IRAM_ATTR IsrPulseSource::onEdge(void* arg) {
+    static_cast<IsrPulseSource*>(arg)->_count++;
+    _edgeSeen = true;
+}
+
+uint32_t IsrPulseSource::take() {
+    noInterrupts();
+    uint32_t pulses = _count;
+    _count = 0;
+    interrupts();
+    return pulses;
+}
+
+bool IsrPulseSource::takeEdgeFlag() {
+    if (!_edgeSeen) return false;
+    _edgeSeen = false;
+    return true;
+}
+
+// =============================================================================
+// PCNT
+// =============================================================================
+
+namespace {
+
+// Registering a callback installs the unit's interrupt, which is what folds
+// each HIGH_LIMIT wrap into the accumulated count
+bool IRAM_ATTR onPcntLimit(pcnt_unit_handle_t, const pcnt_watch_event_data_t*, void*) {
+    return false;
+}
+
+} // namespace
+
+PcntPulseSource::~PcntPulseSource() {
+    release();
+}
+
+bool PcntPulseSource::begin(uint8_t gpio) {
+    pcnt_unit_config_t unitConfig = {};
+    unitConfig.low_limit = -1;
+    unitConfig.high_limit = HIGH_LIMIT;
+    unitConfig.flags.accum_count = 1;
+    if (pcnt_new_unit(&unitConfig, &_unit) != ESP_OK) {
+        _unit = nullptr;
+        LOGW("PCNT", "No free counter unit for GPIO %u", (unsigned)gpio);
+        return false;
+    }
+
+    pcnt_glitch_filter_config_t filter = {};
+    filter.max_glitch_ns = GLITCH_FILTER_NS;
+    pcnt_chan_config_t channelConfig = {};
+    channelConfig.edge_gpio_num = gpio;     // Driver enables the pull-up
+    channelConfig.level_gpio_num = -1;
+    pcnt_event_callbacks_t callbacks = {};
+    callbacks.on_reach = onPcntLimit;
+
+    bool ok = pcnt_unit_set_glitch_filter(_unit, &filter) == ESP_OK &&
+              pcnt_new_channel(_unit, &channelConfig, &_channel) == ESP_OK &&
+              pcnt_channel_set_edge_action(_channel, PCNT_CHANNEL_EDGE_ACTION_HOLD,
+                                           PCNT_CHANNEL_EDGE_ACTION_INCREASE) == ESP_OK &&
+              pcnt_unit_add_watch_point(_unit, HIGH_LIMIT) == ESP_OK &&
+              pcnt_unit_register_event_callbacks(_unit, &callbacks, nullptr) == ESP_OK &&
+              pcnt_unit_enable(_unit) == ESP_OK &&
+              pcnt_unit_clear_count(_unit) == ESP_OK &&
+              pcnt_unit_start(_unit) == ESP_OK;
+    if (!ok) {
+        LOGW("PCNT", "Failed to set up counter on GPIO %u", (unsigned)gpio);
+        release();
+        return false;
+    }
+    _taken = 0;
+    LOGI("PCNT", "Counting GPIO %u (glitch filter %lu ns)", (unsigned)gpio, (unsigned long)GLITCH_FILTER_NS);
+    return true;
+}
+
+uint32_t PcntPulseSource::take() {
+    if (!_unit) return 0;
+    // The count is never cleared, so edges arriving during the read are
+    // simply part of the next delta
+    int count = 0;
+    if (pcnt_unit_get_count(_unit, &count) != ESP_OK) return 0;
+    uint32_t total = (uint32_t)count;
+    uint32_t pulses = total - _taken;
+    _taken = total;
+    return pulses;
+}
+
+void PcntPulseSource::release() {
+    if (!_unit) return;
+    pcnt_unit_stop(_unit);
+    pcnt_unit_disable(_unit);
+    if (_channel) pcnt_del_channel(_channel);
+    pcnt_del_unit(_unit);
+    _channel = nullptr;
+    _unit = nullptr;
+}
+
+// =============================================================================
+// Factory
+// =============================================================================
+
+namespace PulseSource {
+
+std::unique_ptr<IPulseSource> open(SensorConfig::PulseBackend backend, uint8_t gpio) {
+    std::unique_ptr<IPulseSource> source;
+    switch (backend) {
+        case SensorConfig::PulseBackend::Pcnt: source.reset(new PcntPulseSource()); break;
+        case SensorConfig::PulseBackend::Ulp: source.reset(new UlpPulseCounter()); break;
+        case SensorConfig::PulseBackend::Isr: break;
+    }
+    if (source && source->begin(gpio)) return source;
+    if (source) LOGW("Pulses", "%s counter unavailable on GPIO %u, using ISR", source->name(), (unsigned)gpio);
+
+    source.reset(new IsrPulseSource());
+    source->begin(gpio);
+    return source;
+}
+
+} // namespace PulseSource
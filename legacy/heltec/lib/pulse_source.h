@@ -0,0 +1,90 @@
+#pragma once
+
+#include "sensor_config_types.h"
+#include <Arduino.h>
+#include <driver/pulse_cnt.h>
+#include <memory>
+#include <stdint.h>
+
+// =============================================================================
+// Pulse Sources: where a flow meter's pulses are counted
+// =============================================================================
+// A sensor reads its meter through IPulseSource::take(), so the counting
+// backend is a config choice (SensorConfig::PulseBackend):
+//
+//   Isr   one interrupt per falling edge. Works on any pin and always
+//         starts, so it is the fallback for the others.
+//   Pcnt  a hardware counter unit counts falling edges with a glitch filter.
+//         The CPU is interrupted once per HIGH_LIMIT pulses, when the driver
+//         folds the 16-bit hardware count into a 32-bit total. The ESP32-S3
+//         has 4 units, one per meter. Counting stops in deep sleep.
+//   Ulp   UlpPulseCounter: the ULP coprocessor samples RTC GPIOs and keeps
+//         counting through deep sleep (up to 2 meters).
+//
+// Each source counts for one pin, so two meters at a pump site are two
+// sources. take() returns the pulses since the previous take(); a source
+// never loses an edge between the read and the reset.
+// =============================================================================
+
+class IPulseSource {
+public:
+    virtual ~IPulseSource() = default;
+
+    /** Start counting falling edges on gpio; false if this backend cannot. */
+    virtual bool begin(uint8_t gpio) = 0;
+
+    /** Pulses since the last take(). */
+    virtual uint32_t take() = 0;
+
+    /** Right before deep sleep; wakeAfterPulses only applies where the count continues. */
+    virtual void prepareForSleep(uint16_t wakeAfterPulses) {}
+
+    virtual bool countsInDeepSleep() const { return false; }
+    virtual const char* name() const = 0;
+};
+
+class IsrPulseSource : public IPulseSource {
+public:
+    ~IsrPulseSource() override;
+
+    bool begin(uint8_t gpio) override;
+    uint32_t take() override;
+    const char* name() const override { return "isr"; }
+
+    /** True if any ISR source saw an edge since the last call (debug aid). */
+    static bool takeEdgeFlag();
+
+private:
+    static void IRAM_ATTR onEdge(void* arg);
+    static volatile bool _edgeSeen;
+
+    uint8_t _gpio = 0xFF;
+    volatile uint32_t _count = 0;
+};
+
+class PcntPulseSource : public IPulseSource {
+public:
+    static constexpr int HIGH_LIMIT = 32767;            // Hardware counter is 16-bit signed
+    static constexpr uint32_t GLITCH_FILTER_NS = 10000; // YF-S201 pulses are > 1 ms apart
+
+    ~PcntPulseSource() override;
+
+    bool begin(uint8_t gpio) override;
+    uint32_t take() override;
+    const char* name() const override { return "pcnt"; }
+
+private:
+    pcnt_unit_handle_t _unit = nullptr;
+    pcnt_channel_handle_t _channel = nullptr;
+    uint32_t _taken = 0;    // Total count at the last take()
+
+    void release();
+};
+
+namespace PulseSource {
+    /**
+     * Create and start a source for backend on gpio. A backend that fails to
+     * start (no free unit, not an RTC GPIO) falls back to Isr with a warning.
+     */
+    std::unique_ptr<IPulseSource> open(SensorConfig::PulseBackend backend, uint8_t gpio);
+}
@@ -2,6 +2,7 @@
 #include "error_reporter.h"
 #include "core_logger.h"
 #include "communication_config.h"
+#include "core_system.h"
 #include <RadioLib.h>
 #include <heltec_unofficial.h>
 #include <Arduino.h>
@@ -11,11 +12,80 @@
 // =============================================================================
 static const LoRaWANBand_t* REGION = &US915;
 static const uint8_t SUBBAND = 2;
+static const LoRaWANRegion BUDGET_REGION = LoRaWANRegion::US915;  // Must match REGION
 
 // =============================================================================
 // Global State (Singleton)
 // =============================================================================
 static RadioTaskState g_radioState = {0};
+static TxScheduler g_txScheduler;
+
+// LoRaWAN session across deep sleep (RTC slow memory survives it; a power
+// cycle or reset clears the magic and the node joins again). The data rate
+// of the last uplink goes with it, since the budget is not in the session.
+static constexpr uint32_t RTC_SESSION_MAGIC = 0x4C57534E;  // "LWSN"
+RTC_DATA_ATTR static uint32_t g_rtcSessionMagic;
+RTC_DATA_ATTR static uint8_t g_rtcNonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE];
+RTC_DATA_ATTR static uint8_t g_rtcSession[RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+RTC_DATA_ATTR static uint8_t g_rtcDataRate;
+
+static void saveRtcSession(LoRaWANNode* node, uint8_t dataRate) {
+    memcpy(g_rtcNonces, node->getBufferNonces(), sizeof(g_rtcNonces));
+    memcpy(g_rtcSession, node->getBufferSession(), sizeof(g_rtcSession));
+    g_rtcDataRate = dataRate;
+    g_rtcSessionMagic = RTC_SESSION_MAGIC;
+}
+
+// Hand the saved session back to RadioLib; activateOTAA() then returns
+// RADIOLIB_LORAWAN_SESSION_RESTORED without a join
+static bool restoreRtcSession(LoRaWANNode* node) {
+    if (g_rtcSessionMagic != RTC_SESSION_MAGIC) return false;
+    g_rtcSessionMagic = 0;  // One try: a session that fails to restore is not reused
+    return node->setBufferNonces(g_rtcNonces) == RADIOLIB_ERR_NONE &&
+           node->setBufferSession(g_rtcSession) == RADIOLIB_ERR_NONE;
+}
+
+// Airtime of the last hour, so a node that wakes every few minutes still
+// sees its whole window (the ledger is timed on CoreSystem::clockMs())
+static constexpr uint32_t RTC_AIRTIME_MAGIC = 0x41495254;  // "AIRT"
+struct RtcAirtime {
+    uint32_t magic;
+    uint32_t bucketMs[Airtime::AirtimeLedger::BUCKETS];
+    uint32_t currentMinute;
+    uint32_t totalMs;
+};
+RTC_DATA_ATTR static RtcAirtime g_rtcAirtime;
+
+static void saveRtcAirtime(const Airtime::AirtimeLedger& ledger) {
+    memcpy(g_rtcAirtime.bucketMs, ledger.bucketMs, sizeof(g_rtcAirtime.bucketMs));
+    g_rtcAirtime.currentMinute = ledger.currentMinute;
+    g_rtcAirtime.totalMs = ledger.totalMs;
+    g_rtcAirtime.magic = RTC_AIRTIME_MAGIC;
+}
+
+static bool restoreRtcAirtime(Airtime::AirtimeLedger* ledger) {
+    if (g_rtcAirtime.magic != RTC_AIRTIME_MAGIC) return false;
+    g_rtcAirtime.magic = 0;
+    memcpy(ledger->bucketMs, g_rtcAirtime.bucketMs, sizeof(ledger->bucketMs));
+    ledger->currentMinute = g_rtcAirtime.currentMinute;
+    ledger->totalMs = g_rtcAirtime.totalMs;
+    ledger->advance(CoreSystem::clockMs());
+    return true;
+}
+
+// =============================================================================
+// Helper: data rate of the next uplink
+// =============================================================================
+// A LinkADRReq in a downlink only applies from the following uplink, so the
+// budget has to follow the node's MAC state rather than the DR just used.
+// RadioLib exposes that state as the max payload length; map it back to the
+// lowest data rate of the region that carries it.
+static uint8_t nextUplinkDataRate(LoRaWANNode* node, uint8_t fallback) {
+    uint8_t len = node->getMaxPayloadLen();
+    if (len > PayloadBudget::ABSOLUTE_MAX) len = PayloadBudget::ABSOLUTE_MAX;
+    uint8_t dr = len ? getMinDataRateForPayload(BUDGET_REGION, len) : 255;
+    return dr == 255 ? fallback : dr;
+}
 
 // =============================================================================
 // Helper: RadioLib error string
@@ -47,15 +117,17 @@ bool radioTaskStart(
     ErrorReporter::IErrorReporter* errorReporter
 ) {
     g_radioState.errorReporter = errorReporter;
+    g_radioState.airtime.setBudget(lorawanConfig ? lorawanConfig->airtimeBudgetMsPerHour : 0);
 
-    // Create queues
-    g_radioState.txQueue = xQueueCreate(8, sizeof(LoRaWANTxMsg));
+    // Create TX scheduler and RX queue
+    g_radioState.tx = g_txScheduler.begin() ? &g_txScheduler : nullptr;
     g_radioState.rxQueue = xQueueCreate(4, sizeof(LoRaWANRxMsg));
-    if (!g_radioState.txQueue || !g_radioState.rxQueue) {
+    if (!g_radioState.tx || !g_radioState.rxQueue) {
         LOGE("Radio", "Failed to create queues");
         return false;
     }
-    LOGI("Radio", "Queues created (TX: 8 slots, RX: 4 slots)");
+    LOGI("Radio", "Queues created (TX: %u slots in %u classes, RX: 4 slots)",
+         (unsigned)TxScheduler::TOTAL_SLOTS, (unsigned)TxScheduler::CLASS_COUNT);
     
     // Initialize radio hardware
     int16_t state = radio.begin();
@@ -111,6 +183,80 @@ bool radioTaskStart(
     return true;
 }
 
+// =============================================================================
+// Join: restore the session kept through deep sleep, else OTAA
+// =============================================================================
+bool radioTaskJoin(RadioTaskState* state, uint16_t attempt) {
+    LoRaWANNode* node = state->node;
+    if (attempt == 1 && restoreRtcAirtime(&state->airtime)) {
+        LOGI("Radio", "Airtime ledger restored (%lu ms in last hour)", (unsigned long)state->airtime.usedMs());
+    }
+
+    uint32_t joinStartMs = millis();
+    int16_t joinState = RADIOLIB_ERR_UNKNOWN;
+    bool restoring = attempt == 1 && restoreRtcSession(node);
+    if (restoring) {
+        LOGI("Radio", "Restoring LoRaWAN session from RTC memory");
+        joinState = node->activateOTAA();
+        if (joinState != RADIOLIB_LORAWAN_SESSION_RESTORED) {
+            LOGW("Radio", "Saved session rejected: %s (%d); joining",
+                 getRadioLibErrorString(joinState), joinState);
+            restoring = false;
+        }
+    }
+    if (!restoring) {
+        LOGI("Radio", "OTAA join attempt %u...", (unsigned)attempt);
+        node->clearSession();
+        joinState = node->activateOTAA();
+    }
+    uint32_t joinDurationMs = millis() - joinStartMs;
+
+    if (joinState != RADIOLIB_LORAWAN_NEW_SESSION && joinState != RADIOLIB_LORAWAN_SESSION_RESTORED) {
+        LOGW("Radio", "Join failed after %lu ms: %s (%d)",
+             joinDurationMs, getRadioLibErrorString(joinState), joinState);
+        return false;
+    }
+    state->sessionRestored = joinState == RADIOLIB_LORAWAN_SESSION_RESTORED;
+
+    // Class A (default): device listens on RX1+RX2 windows after each uplink.
+    // sendReceive() handles both windows internally — no separate poll needed.
+
+    // Apply data rate, TX power, ADR from config (or defaults)
+    uint8_t dr = 3;  // default: DR3 for 222-byte max payload
+    uint8_t txPwr = 22;  // default dBm
+    bool adr = true;
+    const LoRaWANConfig* cfg = state->lorawanConfig;
+    if (cfg) {
+        dr = cfg->dataRate;
+        if (cfg->minDataRate > 0 && dr < cfg->minDataRate) {
+            dr = cfg->minDataRate;
+        }
+        txPwr = cfg->txPower;
+        adr = cfg->adrEnabled;
+    }
+    if (state->sessionRestored) {
+        // A restored session keeps the data rate and TX power ADR moved it
+        // to; the config only seeds a new session
+        dr = g_rtcDataRate;
+    } else {
+        node->setDatarate(dr);
+        node->setTxPower(txPwr);
+    }
+    node->setADR(adr);
+    state->budget.update(BUDGET_REGION, dr);
+    saveRtcSession(node, dr);
+    state->joined = true;
+
+    // Get initial RSSI/SNR from join
+    state->lastRssi = radio.getRSSI();
+    state->lastSnr = radio.getSNR();
+
+    LOGI("Radio", "%s in %lu ms (attempt %u, DR%u, ADR=%s)",
+         state->sessionRestored ? "Session restored" : "Joined network",
+         joinDurationMs, (unsigned)attempt, dr, adr ? "on" : "off");
+    return true;
+}
+
 // =============================================================================
 // Task Entry Point
 // =============================================================================
@@ -128,52 +274,8 @@ void radioTaskRun(void* param) {
     // Join with retry until success (blocking, OK — we're in dedicated task)
     // =========================================================================
     const uint32_t joinRetryDelayMs = 10000;  // Delay between join attempts
-    uint16_t joinAttempt = 0;
-    
-    for (;;) {
-        joinAttempt++;
-        LOGI("Radio", "OTAA join attempt %u...", (unsigned)joinAttempt);
-        node->clearSession();
-        
-        uint32_t joinStartMs = millis();
-        int16_t joinState = node->activateOTAA();
-        uint32_t joinDurationMs = millis() - joinStartMs;
-        
-        if (joinState == RADIOLIB_LORAWAN_NEW_SESSION || joinState == RADIOLIB_LORAWAN_SESSION_RESTORED) {
-            state->joined = true;
-            
-            // Class A (default): device listens on RX1+RX2 windows after each uplink.
-            // sendReceive() handles both windows internally — no separate poll needed.
-
-            // Apply data rate, TX power, ADR from config (or defaults)
-            uint8_t dr = 3;  // default: DR3 for 222-byte max payload
-            uint8_t txPwr = 22;  // default dBm
-            bool adr = true;
-            const LoRaWANConfig* cfg = state->lorawanConfig;
-            if (cfg) {
-                dr = cfg->dataRate;
-                if (cfg->minDataRate > 0 && dr < cfg->minDataRate) {
-                    dr = cfg->minDataRate;
-                }
-                txPwr = cfg->txPower;
-                adr = cfg->adrEnabled;
-            }
-            node->setDatarate(dr);
-            node->setTxPower(txPwr);
-            node->setADR(adr);
-            
-            // Get initial RSSI/SNR from join
-            state->lastRssi = radio.getRSSI();
-            state->lastSnr = radio.getSNR();
-            
-            LOGI("Radio", "Joined network in %lu ms (attempt %u, DR%u, %u dBm, ADR=%s)",
-                 joinDurationMs, (unsigned)joinAttempt, dr, txPwr, adr ? "on" : "off");
-            break;
-        }
-        
-        LOGW("Radio", "Join failed after %lu ms: %s (%d); retrying in %lu s",
-             joinDurationMs, getRadioLibErrorString(joinState), joinState,
-             (unsigned long)(joinRetryDelayMs / 1000));
+    for (uint16_t joinAttempt = 1; !radioTaskJoin(state, joinAttempt); joinAttempt++) {
+        LOGW("Radio", "Retrying join in %lu s", (unsigned long)(joinRetryDelayMs / 1000));
         if (state->errorReporter) {
             state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::JoinFail);
         }
@@ -186,102 +288,155 @@ void radioTaskRun(void* param) {
     LOGI("Radio", "Entering main loop");
     
     for (;;) {
-        // ---------------------------------------------------------------------
-        // Check for TX requests. sendReceive() handles RX1+RX2 windows internally
-        // and returns any downlink received during those windows.
-        // ---------------------------------------------------------------------
-        LoRaWANTxMsg txMsg;
-        if (xQueueReceive(state->txQueue, &txMsg, pdMS_TO_TICKS(1)) == pdTRUE) {
-            if (!state->joined) {
-                LOGW("Radio", "TX dropped (not joined): port=%d len=%d", txMsg.port, txMsg.len);
-                continue;
-            }
-            
-            // Validate payload size
-            if (txMsg.len > 222) {
-                LOGW("Radio", "TX dropped (too large): port=%d len=%d", txMsg.port, txMsg.len);
-                continue;
-            }
-            
-            LOGD("Radio", "TX: port=%d len=%d confirmed=%d", txMsg.port, txMsg.len, txMsg.confirmed);
-            
-            // Prepare downlink buffer (stack local, thread-safe)
-            uint8_t rxBuf[256];
-            size_t rxLen = sizeof(rxBuf);
-            LoRaWANEvent_t event;
-            
-            // Track timing for performance analysis
-            uint32_t sendStart = millis();
-            
-            // Send uplink (BLOCKING 1-2s for RX windows — OK here)
-            int16_t result = node->sendReceive(
-                txMsg.payload, txMsg.len, txMsg.port,
-                rxBuf, &rxLen,
-                txMsg.confirmed,
-                nullptr,  // No FOptsMask
-                &event
-            );
-            
-            uint32_t sendDuration = millis() - sendStart;
+        // Producers signal the scheduler, so the wait ends as soon as a frame is queued
+        radioTaskServiceTx(state, pdMS_TO_TICKS(100));
+    }
+}
+
+// =============================================================================
+// One TX cycle: send the highest-priority queued frame. sendReceive() handles
+// RX1+RX2 windows internally and returns any downlink received during those
+// windows.
+// =============================================================================
+bool radioTaskServiceTx(RadioTaskState* state, TickType_t waitTicks) {
+    // Airtime admission: near the hourly budget, low-priority classes wait
+    // (and coalesce) in the scheduler
+    static uint8_t lastAllowed = TxScheduler::ALL_CLASSES;
+    uint8_t allowed = state->airtime.admissibleClasses(CoreSystem::clockMs());
+    if (allowed != lastAllowed) {
+        LOGW("Radio", "Airtime %u ms/h (%u%% of budget): %s",
+             (unsigned)state->airtime.usedMs(), (unsigned)state->airtime.usedPercent(),
+             allowed == TxScheduler::ALL_CLASSES ? "all classes admitted" : "deferring low-priority uplinks");
+        lastAllowed = allowed;
+    }
+
+    LoRaWANTxMsg txMsg;
+    TxClass txClass;
+    if (!state->tx->dequeue(&txMsg, &txClass, waitTicks, allowed)) return false;
+
+    if (!state->joined) {
+        LOGW("Radio", "TX dropped (not joined): port=%d len=%d", txMsg.port, txMsg.len);
+        state->tx->complete();
+        return true;
+    }
+    
+    // Validate payload size against the current data rate (producers size
+    // frames from the budget; this catches frames queued before a DR drop)
+    uint8_t maxPayload = state->budget.maxPayload();
+    if (txMsg.len > maxPayload) {
+        LOGW("Radio", "TX dropped (too large for DR%u): port=%d len=%d max=%u",
+             (unsigned)state->budget.dataRate, txMsg.port, txMsg.len, (unsigned)maxPayload);
+        if (state->errorReporter) {
+            state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::SendFail);
+        }
+        state->tx->complete();
+        return true;
+    }
+    
+    LOGD("Radio", "TX: class=%s port=%d len=%d confirmed=%d",
+         TxScheduler::className(txClass), txMsg.port, txMsg.len, txMsg.confirmed);
+    
+    // Prepare downlink buffer (stack local, thread-safe)
+    uint8_t rxBuf[256];
+    size_t rxLen = sizeof(rxBuf);
+    LoRaWANEvent_t eventUp;
+    LoRaWANEvent_t event;
+    
+    // Track timing for performance analysis
+    uint32_t sendStart = millis();
+    
+    // Send uplink (BLOCKING 1-2s for RX windows — OK here)
+    int16_t result = state->node->sendReceive(
+        txMsg.payload, txMsg.len, txMsg.port,
+        rxBuf, &rxLen,
+        txMsg.confirmed,
+        &eventUp,
+        &event
+    );
+    
+    uint32_t sendDuration = millis() - sendStart;
+    
+    // Log timing for OTA progress ACKs to diagnose chunk 2064 issue
+    if (txMsg.port == 8) {  // FPORT_OTA_PROGRESS
+        uint16_t chunkIndex = txMsg.payload[1] | (txMsg.payload[2] << 8);
+        if (chunkIndex % 100 == 0 || chunkIndex >= 2060) {
+            LOGI("Radio", "OTA ACK chunk %u: send took %lu ms, result=%d, heap=%lu, stack=%u",
+                 (unsigned)chunkIndex, sendDuration, result,
+                 (unsigned long)ESP.getFreeHeap(),
+                 (unsigned)uxTaskGetStackHighWaterMark(NULL));
+        }
+    }
+    
+    // Track the data rate the network now has us on (ADR) and the airtime spent
+    if (result >= 0) {
+        uint8_t nextDr = nextUplinkDataRate(state->node, eventUp.datarate);
+        state->budget.update(BUDGET_REGION, nextDr);
+        saveRtcSession(state->node, nextDr);   // Frame counters moved on
+        uint32_t toaUs = Airtime::uplinkTimeOnAirUs(BUDGET_REGION, eventUp.datarate, txMsg.len);
+        state->airtime.record(CoreSystem::clockMs(), toaUs);
+        saveRtcAirtime(state->airtime);
+        LOGD("Radio", "Airtime %lu us at DR%u; %lu ms in last hour",
+             (unsigned long)toaUs, (unsigned)eventUp.datarate, (unsigned long)state->airtime.usedMs());
+    }
+
+    // Handle result
+    if (result > 0) {
+        // Positive: downlink received in RX window
+        state->uplinkCount++;
+        
+        LOGD("Radio", "TX success, downlink received: port=%d len=%zu", event.fPort, rxLen);
+        
+        // Send downlink to app if payload present
+        if (rxLen > 0 && rxLen <= 222) {
+            LoRaWANRxMsg rxMsg;
+            rxMsg.port = event.fPort;
+            rxMsg.len = rxLen;
+            rxMsg.rssi = radio.getRSSI();
+            rxMsg.snr = radio.getSNR();
+            memcpy(rxMsg.payload, rxBuf, rxLen);
             
-            // Log timing for OTA progress ACKs to diagnose chunk 2064 issue
-            if (txMsg.port == 8) {  // FPORT_OTA_PROGRESS
-                uint16_t chunkIndex = txMsg.payload[1] | (txMsg.payload[2] << 8);
-                if (chunkIndex % 100 == 0 || chunkIndex >= 2060) {
-                    LOGI("Radio", "OTA ACK chunk %u: send took %lu ms, result=%d, heap=%lu, stack=%u",
-                         (unsigned)chunkIndex, sendDuration, result,
-                         (unsigned long)ESP.getFreeHeap(),
-                         (unsigned)uxTaskGetStackHighWaterMark(NULL));
-                }
-            }
+            state->lastRssi = rxMsg.rssi;
+            state->lastSnr = rxMsg.snr;
+            state->downlinkCount++;
             
-            // Handle result
-            if (result > 0) {
-                // Positive: downlink received in RX window
-                state->uplinkCount++;
-                
-                LOGD("Radio", "TX success, downlink received: port=%d len=%zu", event.fPort, rxLen);
-                
-                // Send downlink to app if payload present
-                if (rxLen > 0 && rxLen <= 222) {
-                    LoRaWANRxMsg rxMsg;
-                    rxMsg.port = event.fPort;
-                    rxMsg.len = rxLen;
-                    rxMsg.rssi = radio.getRSSI();
-                    rxMsg.snr = radio.getSNR();
-                    memcpy(rxMsg.payload, rxBuf, rxLen);
-                    
-                    state->lastRssi = rxMsg.rssi;
-                    state->lastSnr = rxMsg.snr;
-                    state->downlinkCount++;
-                    
-                    if (xQueueSend(state->rxQueue, &rxMsg, 0) != pdTRUE) {
-                        LOGW("Radio", "RX queue full, dropping downlink");
-                        if (state->errorReporter) {
-                            state->errorReporter->reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::QueueFull);
-                        }
-                    }
-                }
-            } else if (result == RADIOLIB_ERR_NONE) {
-                // Zero: TX success but no downlink (or no ACK for confirmed)
-                if (txMsg.confirmed) {
-                    LOGW("Radio", "Confirmed TX sent but no ACK received");
-                    if (state->errorReporter) {
-                        state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::NoAck);
-                    }
-                } else {
-                    state->uplinkCount++;
-                    LOGD("Radio", "TX success, no downlink");
-                }
-            } else {
-                // Negative: error
-                LOGW("Radio", "TX failed: %s (%d)", getRadioLibErrorString(result), result);
+            if (xQueueSend(state->rxQueue, &rxMsg, 0) != pdTRUE) {
+                LOGW("Radio", "RX queue full, dropping downlink");
                 if (state->errorReporter) {
-                    state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::SendFail);
+                    state->errorReporter->reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::QueueFull);
                 }
             }
         }
-        
-        // Loop: wait for next TX request (1ms timeout keeps OTA ACK responsive)
+    } else if (result == RADIOLIB_ERR_NONE) {
+        // Zero: TX success but no downlink (or no ACK for confirmed)
+        if (txMsg.confirmed) {
+            LOGW("Radio", "Confirmed TX sent but no ACK received");
+            if (state->errorReporter) {
+                state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::NoAck);
+            }
+        } else {
+            state->uplinkCount++;
+            LOGD("Radio", "TX success, no downlink");
+        }
+    } else {
+        // Negative: error
+        LOGW("Radio", "TX failed: %s (%d)", getRadioLibErrorString(result), result);
+        if (state->errorReporter) {
+            state->errorReporter->reportError(ErrorReporter::Category::Comm, ErrorReporter::Comm::SendFail);
+        }
     }
+
+    // Publish completion for producers that track delivery (telemetry deltas)
+    state->lastTxPort = txMsg.port;
+    state->lastTxType = txMsg.len > 0 ? txMsg.payload[0] : 0;
+    state->lastTxSeq = txMsg.len > 1 ? txMsg.payload[1] : 0;
+    state->lastTxSent = result >= 0;
+    state->lastTxAcked = txMsg.confirmed && result > 0;
+    state->txCompleteCount++;
+    state->tx->complete();
+
+    return true;
+}
+
+bool radioTaskIdle(const RadioTaskState* state) {
+    return state->tx->idle() && uxQueueMessagesWaiting(state->rxQueue) == 0;
 }
@@ -2,6 +2,9 @@
 
 #include "lorawan_messages.h"
 #include "communication_config.h"
+#include "payload_budget.h"
+#include "tx_scheduler.h"
+#include "airtime.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <stdint.h>
@@ -13,20 +16,23 @@ namespace ErrorReporter { class IErrorReporter; }
 // =============================================================================
 // Radio Task: Dedicated FreeRTOS task for LoRaWAN communication
 // =============================================================================
-// Owns RadioLib instance, services TX/RX queues, handles join/send/receive.
+// Owns RadioLib instance, services TX scheduler and RX queue, handles join/send/receive.
 // Singleton pattern: one radio task per device.
 //
 // Architecture:
 // - Runs in dedicated 8KB stack task (prevents timer daemon starvation)
 // - Blocking operations (join, sendReceive) are safe here
-// - App communicates via FreeRTOS queues (zero callback overhead)
+// - App submits uplinks to the TX scheduler by class (OTA/cmd ACKs first);
+//   downlinks arrive on a FreeRTOS queue (zero callback overhead)
 // - Status polling via atomic volatile flags
 // - Optional IErrorReporter for join-fail, no-ack, send-fail, queue-full
+// - LoRaWAN session (keys, frame counters, nonces) kept in RTC memory after
+//   every join and uplink, so a deep-sleep wake resumes without a join
 // =============================================================================
 
 // Global radio task state (singleton)
 struct RadioTaskState {
-    QueueHandle_t txQueue;
+    TxScheduler* tx;
     QueueHandle_t rxQueue;
     LoRaWANNode* node;
     const LoRaWANConfig* lorawanConfig;  // Applied after join (optional)
@@ -34,10 +40,26 @@ struct RadioTaskState {
 
     // Status flags (atomic access from any task via volatile)
     volatile bool joined;
+    volatile bool sessionRestored;      // Joined from the RTC session (no join traffic)
     volatile uint32_t uplinkCount;
     volatile uint32_t downlinkCount;
     volatile int16_t lastRssi;
     volatile int8_t lastSnr;
+
+    // Max payload for the data rate in use (updated after join and each uplink)
+    PayloadBudget budget;
+
+    // Uplink time-on-air over the last hour; gates low-priority classes
+    Airtime::AirtimeLedger airtime;
+
+    // Completion of the last uplink. Fields are written before txCompleteCount
+    // is incremented; the app polls the counter and then reads the fields.
+    volatile uint8_t lastTxPort;
+    volatile uint8_t lastTxType;        // payload[0] (frame type for telemetry)
+    volatile uint8_t lastTxSeq;         // payload[1] (frame sequence for telemetry)
+    volatile bool lastTxSent;           // Uplink went out (no RadioLib error)
+    volatile bool lastTxAcked;          // Confirmed uplink acknowledged by the network
+    volatile uint32_t txCompleteCount;
 };
 
 /**
@@ -63,13 +85,33 @@ bool radioTaskStart(
     ErrorReporter::IErrorReporter* errorReporter = nullptr
 );
 
+/**
+ * One join attempt (the radio task retries until it succeeds). The first
+ * attempt after a deep-sleep wake restores the session and airtime ledger
+ * kept in RTC memory; the session keeps its ADR data rate and TX power. A
+ * new session gets the configured ones.
+ *
+ * @return true once the node has a session
+ */
+bool radioTaskJoin(RadioTaskState* state, uint16_t attempt);
+
 /**
  * Radio task entry point (internal, called by xTaskCreate).
  * 
- * Performs initial OTAA join, then enters main loop:
- * 1. Check TX queue (blocking 50ms)
- * 2. Send uplink if message available (blocks 1-2s for RX windows)
- * 3. Poll for Class C downlinks (non-blocking)
- * 4. Repeat
+ * Performs initial OTAA join, then calls radioTaskServiceTx() forever.
  */
 void radioTaskRun(void* param);
+
+/**
+ * One TX cycle: wait up to waitTicks for a frame, send the highest-priority
+ * one (blocks 1-2s for RX windows) and forward any downlink to rxQueue.
+ *
+ * @return true if a frame was taken from the scheduler (sent or dropped)
+ */
+bool radioTaskServiceTx(RadioTaskState* state, TickType_t waitTicks);
+
+/**
+ * True when nothing is queued, in flight or waiting in rxQueue; the app may
+ * power down.
+ */
+bool radioTaskIdle(const RadioTaskState* state);
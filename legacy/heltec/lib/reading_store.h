@@ -0,0 +1,566 @@
+#pragma once
+
+#include "message_schema.h"
+#include "telemetry_codec.h"
+#include "hal_persistence.h"
+#include "persistent_record.h"
+#include "core_logger.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// =============================================================================
+// Reading Store: store-and-forward backlog for telemetry intervals
+// =============================================================================
+// While the node is not joined or not registered, each closed report window
+// is appended here as one timestamped, schema-indexed record instead of being
+// lost. After reconnect the backlog is sent oldest first in batched backfill
+// uplinks (fPort 9, lowest TX class, only while the airtime budget has room).
+//
+// Records live in a RAM FIFO; when it fills, the oldest records spill to
+// flash in fixed blocks (one NVS blob each). When flash is full too, the
+// oldest block is dropped. Sample times are on CoreSystem::clockMs(), which
+// runs through deep sleep: save() copies the RAM part (FIFO and flash ring
+// index) to RTC memory before sleeping and restore() takes it back on wake.
+// The ring index is also written to NVS with every spill and pop, so load()
+// takes the flash blocks back after a reboot (the RAM FIFO is lost). If the
+// clock restarted, their ages leave out the time the node was off.
+//
+// A record too large for the payload (DR0) goes out in parts: as many of
+// its fields as fit, one batch each, with the same age. It leaves the store
+// once every field is delivered.
+//
+// Delivery is at-least-once: a batch leaves the store only once its uplink
+// completes (ACKed when confirmed). A lost completion or a new outage puts
+// the batch back, so the server must tolerate a repeated batch.
+//
+// append(), buildBatch() and poll() must be called from a single task.
+// onUplinkComplete() may be called from any task; it only posts the result.
+//
+// Record (RAM and flash):
+// [0]     record length
+// [1-4]   sample time (millis, uint32 LE)
+// [5-6]   presence mask (uint16 LE)
+// [7..]   values by FieldType (TelemetryCodec::encodeRaw)
+//
+// Backfill frame (fPort 9), records oldest first:
+// [0]     record count
+// [1]     batch seq
+// first:  age varint (seconds before the frame was built), presence mask
+//         (uint16 LE), values by FieldType
+// next:   gap varint (seconds after the previous record), presence mask
+//         (uint16 LE), then per present field: a delta varint when the
+//         previous record had the field (TelemetryCodec delta encoding, so
+//         FLOAT values are exact), else the value by FieldType. A FLOAT
+//         change too large for a delta ends the batch; the next batch starts
+//         from that record.
+// A part of a split record is a batch of one record holding some of its
+// fields; the parts of one record have the same age and disjoint masks.
+// =============================================================================
+
+class ReadingStore {
+public:
+    static constexpr size_t RAM_BYTES = 1024;
+    static constexpr size_t BLOCK_BYTES = 256;
+    static constexpr uint8_t FLASH_BLOCKS = 16;
+    static constexpr size_t RECORD_HEADER_SIZE = 7;
+    static constexpr size_t MAX_RECORD_SIZE =
+        RECORD_HEADER_SIZE + MessageSchema::MAX_FIELDS * TelemetryCodec::MAX_VALUE_SIZE;
+    static constexpr size_t FRAME_HEADER_SIZE = 2;
+    static constexpr const char* PERSISTENCE_NAMESPACE = "backlog";
+
+    static_assert(MAX_RECORD_SIZE <= BLOCK_BYTES, "a record must fit a flash block");
+    static_assert(MAX_RECORD_SIZE <= 0xFF, "record length is one byte");
+
+    // Flash ring index (NVS key "ring", and part of SavedState)
+    struct RingIndex {
+        uint8_t blockHead;
+        uint8_t blockCount;
+        uint16_t headOffset;        // Bytes of the head block already delivered
+        uint16_t headSent;          // Fields of the head record delivered in parts
+        uint32_t clockMs;           // Newest sample time when written
+        uint8_t blockRecords[FLASH_BLOCKS];
+        uint16_t blockLen[FLASH_BLOCKS];
+        uint32_t blockShift[FLASH_BLOCKS];  // Added to sample times (clock restarts)
+    };
+
+    // Everything the store keeps in RAM, for RTC memory across deep sleep
+    struct SavedState {
+        uint32_t magic;
+        uint16_t ramLen;
+        uint16_t ramRecords;
+        RingIndex ring;
+        uint32_t dropped;
+        uint8_t seq;
+        uint8_t ram[RAM_BYTES];
+    };
+
+    ReadingStore(const MessageSchema::Schema& schema, IPersistenceHal* spill)
+        : _schema(schema), _spill(spill), _index(PERSISTENCE_NAMESPACE, "ring", 1, 0) {}
+
+    // Take back the flash blocks listed in NVS after a reboot. nowMs is the
+    // current clock; if it is behind the stored index the clock restarted
+    // and the blocks' sample times are moved to end at nowMs. False when
+    // there is no index (or no flash).
+    bool load(uint32_t nowMs) {
+        if (!_spill || !_index.load(*_spill)) return false;
+        RingIndex ring = _index.get();
+        if (ring.blockCount > FLASH_BLOCKS || ring.blockHead >= FLASH_BLOCKS) return false;
+        if ((int32_t)(nowMs - ring.clockMs) < 0) {
+            for (uint32_t& shift : ring.blockShift) shift += nowMs - ring.clockMs;
+            ring.clockMs = nowMs;
+        }
+        applyRing(ring);
+        return true;
+    }
+
+    // Copy the store into out. A batch still in flight goes back into the
+    // backlog (its result is applied first if it has arrived).
+    void save(SavedState* out) {
+        consumeSignals();
+        _inFlight = false;
+        out->ramLen = (uint16_t)_ramLen;
+        out->ramRecords = _ramRecords;
+        out->ring = ringIndex();
+        out->dropped = _dropped;
+        out->seq = _seq;
+        memcpy(out->ram, _ram, _ramLen);
+        out->magic = SAVED_MAGIC;
+    }
+
+    // Take back a saved store, once (the copy is invalidated). False when
+    // in holds no saved store.
+    bool restore(SavedState* in) {
+        if (in->magic != SAVED_MAGIC || in->ramLen > RAM_BYTES || in->ring.blockCount > FLASH_BLOCKS ||
+            in->ring.blockHead >= FLASH_BLOCKS) {
+            return false;
+        }
+        in->magic = 0;
+        _ramLen = in->ramLen;
+        _ramRecords = in->ramRecords;
+        memcpy(_ram, in->ram, _ramLen);
+        applyRing(in->ring);
+        _dropped = in->dropped;
+        _seq = in->seq;
+        return true;
+    }
+
+    // Store one report window. Puts back any batch in flight (the link is
+    // down again), spilling or dropping the oldest records to make room.
+    bool append(uint16_t present, const float* values, uint32_t sampleMs) {
+        consumeSignals();
+        _inFlight = false;
+        _clockMs = sampleMs;
+
+        uint8_t record[MAX_RECORD_SIZE];
+        size_t len = encodeRecord(present, values, sampleMs, record);
+        if (len == 0) return false;
+
+        while (_ramLen + len > RAM_BYTES) {
+            if (!spillOldest()) dropRamRecord();
+        }
+        memcpy(_ram + _ramLen, record, len);
+        _ramLen += len;
+        _ramRecords++;
+        return true;
+    }
+
+    // Encode the oldest records that fit in cap into one backfill frame and
+    // mark them in flight; an oldest record that does not fit goes in parts.
+    // Returns 0 when the store is empty, a batch is already in flight, or
+    // not even one field of the oldest record fits.
+    size_t buildBatch(uint8_t* buf, size_t cap, uint32_t nowMs) {
+        consumeSignals();
+        if (_inFlight || records() == 0 || cap < FRAME_HEADER_SIZE) return 0;
+
+        const uint8_t* src;
+        size_t srcLen;
+        uint32_t shift = 0;
+        if (_blockCount > 0) {
+            if (!stageHeadBlock()) return buildBatch(buf, cap, nowMs);
+            src = _stage + _stageOff;
+            srcLen = _stageLen - _stageOff;
+            shift = _blockShift[_blockHead];
+        } else {
+            src = _ram;
+            srcLen = _ramLen;
+        }
+
+        TelemetryCodec::RawFrame prev;
+        uint32_t prevAge = 0;
+        size_t offset = FRAME_HEADER_SIZE;
+        size_t used = 0;
+        uint8_t count = 0;
+        while (used < srcLen && count < 0xFF) {
+            TelemetryCodec::RawFrame cur;
+            uint32_t sampleMs;
+            if (!decodeRecord(src + used, srcLen - used, &cur, &sampleMs)) break;
+            if (count == 0) cur.present &= (uint16_t)~_headSent;
+            uint32_t age = (nowMs - (sampleMs + shift)) / 1000;
+            uint32_t stamp = count == 0 ? age : (prevAge > age ? prevAge - age : 0);
+            size_t n = encodeFrameRecord(stamp, count > 0 ? &prev : nullptr, &cur, buf + offset, cap - offset);
+            if (n == 0) break;
+            offset += n;
+            used += src[used];
+            prev = cur;
+            prevAge = age;
+            count++;
+        }
+        if (count == 0) return buildPart(src, srcLen, shift, buf, cap, nowMs);
+
+        buf[0] = count;
+        buf[1] = ++_seq;
+        _inFlight = true;
+        _inFlightRecords = count;
+        _inFlightBytes = used;
+        _inFlightFields = 0;
+        _inFlightMs = nowMs;
+        return offset;
+    }
+
+    // Radio finished an fPort 9 uplink (batch seq is payload[1])
+    void onUplinkComplete(uint8_t seq, bool delivered) {
+        _result = (uint16_t)(0x100 | (delivered ? 0x200 : 0) | seq);
+    }
+
+    // Apply a posted delivery result; a batch with no result after timeoutMs
+    // (frame dropped before air) goes back. True while a batch is in flight.
+    bool poll(uint32_t nowMs, uint32_t timeoutMs) {
+        consumeSignals();
+        if (_inFlight && nowMs - _inFlightMs >= timeoutMs) {
+            LOGW("Backlog", "No result for batch %u, resending", (unsigned)_seq);
+            _inFlight = false;
+        }
+        return _inFlight;
+    }
+
+    uint32_t records() const {
+        uint32_t n = _ramRecords;
+        for (uint8_t i = 0; i < _blockCount; i++) n += _blockRecords[(_blockHead + i) % FLASH_BLOCKS];
+        return n;
+    }
+    uint32_t droppedRecords() const { return _dropped; }
+
+private:
+    static constexpr uint32_t SAVED_MAGIC = 0x424B4C32;   // "BKL2"
+
+    const MessageSchema::Schema& _schema;
+    IPersistenceHal* _spill;
+    PersistentRecord<RingIndex> _index;
+
+    uint8_t _ram[RAM_BYTES];
+    size_t _ramLen = 0;
+    uint16_t _ramRecords = 0;
+
+    // Flash blocks form a ring of NVS keys b0..b15; the head block is staged
+    // in RAM while it is being sent, from _stageOff (bytes already delivered)
+    uint8_t _blockHead = 0;
+    uint8_t _blockCount = 0;
+    uint8_t _blockRecords[FLASH_BLOCKS] = {0};
+    uint16_t _blockLen[FLASH_BLOCKS] = {0};
+    uint32_t _blockShift[FLASH_BLOCKS] = {0};
+    uint16_t _headSent = 0;         // Fields of the oldest record delivered in parts
+    uint32_t _clockMs = 0;          // Newest sample time
+    uint8_t _stage[BLOCK_BYTES];
+    size_t _stageLen = 0;
+    size_t _stageOff = 0;
+    bool _staged = false;
+
+    bool _inFlight = false;
+    volatile uint16_t _result = 0;   // 0x100 | seq, 0x200 = delivered
+    uint8_t _seq = 0;
+    uint8_t _inFlightRecords = 0;
+    size_t _inFlightBytes = 0;
+    uint16_t _inFlightFields = 0;   // Part of the oldest record (no whole record)
+    uint32_t _inFlightMs = 0;
+    uint32_t _dropped = 0;
+
+    void consumeSignals() {
+        uint16_t result = _result;
+        if (!result) return;
+        _result = 0;
+        if (!_inFlight || (uint8_t)result != _seq) return;  // Stale or superseded batch
+        _inFlight = false;
+        if (!(result & 0x200)) return;                       // Not delivered: send again
+
+        _headSent |= _inFlightFields;
+        if (_inFlightRecords == 0) return;                   // One more part of the oldest record
+        _headSent = 0;
+        if (_blockCount > 0) {
+            _stageOff += _inFlightBytes;
+            _blockRecords[_blockHead] -= _inFlightRecords;
+            if (_stageOff >= _stageLen) popBlock();
+        } else {
+            memmove(_ram, _ram + _inFlightBytes, _ramLen - _inFlightBytes);
+            _ramLen -= _inFlightBytes;
+            _ramRecords -= _inFlightRecords;
+        }
+    }
+
+    size_t encodeRecord(uint16_t present, const float* values, uint32_t sampleMs, uint8_t* out) const {
+        uint16_t mask = 0;
+        uint32_t raw[MessageSchema::MAX_FIELDS];
+        for (uint8_t i = 0; i < _schema.field_count; i++) {
+            if (!(present & (1u << i)) || isnan(values[i])) continue;
+            raw[i] = TelemetryCodec::toRaw(_schema.fields[i].type, values[i]);
+            mask |= (uint16_t)(1u << i);
+        }
+        if (mask == 0) return 0;
+
+        out[1] = sampleMs & 0xFF;
+        out[2] = (sampleMs >> 8) & 0xFF;
+        out[3] = (sampleMs >> 16) & 0xFF;
+        out[4] = (sampleMs >> 24) & 0xFF;
+        out[5] = mask & 0xFF;
+        out[6] = (mask >> 8) & 0xFF;
+        size_t n = TelemetryCodec::encodeFields(_schema, mask, raw, out + RECORD_HEADER_SIZE,
+                                                MAX_RECORD_SIZE - RECORD_HEADER_SIZE);
+        if (n == 0) return 0;
+        out[0] = (uint8_t)(RECORD_HEADER_SIZE + n);
+        return out[0];
+    }
+
+    bool decodeRecord(const uint8_t* in, size_t len, TelemetryCodec::RawFrame* out, uint32_t* sampleMs) const {
+        if (len < RECORD_HEADER_SIZE || in[0] < RECORD_HEADER_SIZE || in[0] > len) return false;
+        *sampleMs = (uint32_t)in[1] | ((uint32_t)in[2] << 8) | ((uint32_t)in[3] << 16) | ((uint32_t)in[4] << 24);
+        out->present = (uint16_t)(in[5] | (in[6] << 8));
+        return TelemetryCodec::decodeFields(_schema, out->present, in + RECORD_HEADER_SIZE,
+                                            in[0] - RECORD_HEADER_SIZE, out->raw) > 0;
+    }
+
+    // One backfill record against prev (nullptr for the first). Returns 0
+    // if it does not fit, or if a value cannot travel as a delta.
+    size_t encodeFrameRecord(uint32_t stamp, const TelemetryCodec::RawFrame* prev,
+                             const TelemetryCodec::RawFrame* cur, uint8_t* buf, size_t cap) const {
+        size_t offset = TelemetryCodec::writeVarint(buf, cap, stamp);
+        if (offset == 0 || offset + 2 > cap) return 0;
+        buf[offset++] = cur->present & 0xFF;
+        buf[offset++] = (cur->present >> 8) & 0xFF;
+
+        for (uint8_t i = 0; i < _schema.field_count; i++) {
+            if (!(cur->present & (1u << i))) continue;
+            MessageSchema::FieldType type = _schema.fields[i].type;
+            size_t n;
+            if (prev && (prev->present & (1u << i))) {
+                uint32_t word;
+                if (!TelemetryCodec::deltaWord(type, prev->raw[i], cur->raw[i], &word)) return 0;
+                n = TelemetryCodec::writeVarint(buf + offset, cap - offset, word);
+            } else {
+                n = TelemetryCodec::encodeRaw(type, cur->raw[i], buf + offset, cap - offset);
+            }
+            if (n == 0) return 0;
+            offset += n;
+        }
+        return offset;
+    }
+
+    // The oldest record alone does not fit cap: send the fields still to go
+    // that fit, in field order, as a batch of one. The last part takes the
+    // record out of the store.
+    size_t buildPart(const uint8_t* src, size_t srcLen, uint32_t shift, uint8_t* buf, size_t cap, uint32_t nowMs) {
+        TelemetryCodec::RawFrame part;
+        uint32_t sampleMs;
+        if (!decodeRecord(src, srcLen, &part, &sampleMs)) return 0;
+        uint16_t all = part.present;
+        uint16_t left = (uint16_t)(all & ~_headSent);
+        uint32_t age = (nowMs - (sampleMs + shift)) / 1000;
+
+        part.present = 0;
+        for (uint8_t i = 0; i < _schema.field_count; i++) {
+            uint16_t bit = (uint16_t)(1u << i);
+            if (!(left & bit)) continue;
+            part.present |= bit;
+            if (encodeFrameRecord(age, nullptr, &part, buf + FRAME_HEADER_SIZE, cap - FRAME_HEADER_SIZE) == 0) {
+                part.present &= (uint16_t)~bit;
+            }
+        }
+        if (part.present == 0) return 0;
+        size_t n = encodeFrameRecord(age, nullptr, &part, buf + FRAME_HEADER_SIZE, cap - FRAME_HEADER_SIZE);
+
+        bool last = (part.present | _headSent) == all;
+        buf[0] = 1;
+        buf[1] = ++_seq;
+        _inFlight = true;
+        _inFlightRecords = last ? 1 : 0;
+        _inFlightBytes = last ? src[0] : 0;
+        _inFlightFields = last ? 0 : part.present;
+        _inFlightMs = nowMs;
+        return FRAME_HEADER_SIZE + n;
+    }
+
+    RingIndex ringIndex() const {
+        RingIndex ring = {};
+        ring.blockHead = _blockHead;
+        ring.blockCount = _blockCount;
+        ring.headOffset = (uint16_t)_stageOff;
+        ring.headSent = _headSent;
+        ring.clockMs = _clockMs;
+        memcpy(ring.blockRecords, _blockRecords, sizeof(ring.blockRecords));
+        memcpy(ring.blockLen, _blockLen, sizeof(ring.blockLen));
+        memcpy(ring.blockShift, _blockShift, sizeof(ring.blockShift));
+        return ring;
+    }
+
+    // The batch in flight, if any, goes back
+    void applyRing(const RingIndex& ring) {
+        _blockHead = ring.blockHead;
+        _blockCount = ring.blockCount;
+        _stageOff = ring.headOffset;
+        _headSent = ring.headSent;
+        _clockMs = ring.clockMs;
+        memcpy(_blockRecords, ring.blockRecords, sizeof(_blockRecords));
+        memcpy(_blockLen, ring.blockLen, sizeof(_blockLen));
+        memcpy(_blockShift, ring.blockShift, sizeof(_blockShift));
+        _staged = false;
+        _inFlight = false;
+        _result = 0;
+    }
+
+    // Write the ring index to NVS (after every spill and pop)
+    void saveRing() {
+        if (!_spill) return;
+        RingIndex ring = ringIndex();
+        _index.update([&](RingIndex& stored) { stored = ring; });
+        _index.save(*_spill);
+    }
+
+    static void blockKey(uint8_t block, char* key, size_t size) {
+        snprintf(key, size, "b%u", (unsigned)block);
+    }
+
+    // Move the oldest whole RAM records (up to a block) to flash. False when
+    // there is no flash to spill to.
+    bool spillOldest() {
+        if (!_spill || _ramRecords == 0) return false;
+
+        size_t len = 0;
+        uint8_t count = 0;
+        while (len < _ramLen && len + _ram[len] <= BLOCK_BYTES) {
+            len += _ram[len];
+            count++;
+        }
+
+        if (_blockCount == FLASH_BLOCKS) {
+            LOGW("Backlog", "Flash backlog full, dropping %u oldest records",
+                 (unsigned)_blockRecords[_blockHead]);
+            _dropped += _blockRecords[_blockHead];
+            popBlock();
+        }
+        uint8_t block = (_blockHead + _blockCount) % FLASH_BLOCKS;
+        char key[8];
+        blockKey(block, key, sizeof(key));
+        bool saved = _spill->begin(PERSISTENCE_NAMESPACE);
+        saved = saved && _spill->saveBytes(key, _ram, len);
+        _spill->end();
+        if (!saved) {
+            LOGW("Backlog", "Spill to flash failed");
+            return false;
+        }
+
+        _blockRecords[block] = count;
+        _blockLen[block] = (uint16_t)len;
+        _blockShift[block] = 0;
+        _blockCount++;
+        memmove(_ram, _ram + len, _ramLen - len);
+        _ramLen -= len;
+        _ramRecords -= count;
+        saveRing();
+        return true;
+    }
+
+    void dropRamRecord() {
+        size_t len = _ram[0];
+        memmove(_ram, _ram + len, _ramLen - len);
+        _ramLen -= len;
+        _ramRecords--;
+        _dropped++;
+        if (_blockCount == 0) _headSent = 0;
+    }
+
+    // Load the head flash block into _stage. A block that cannot be read is
+    // dropped (returns false).
+    bool stageHeadBlock() {
+        if (_staged) return true;
+        char key[8];
+        blockKey(_blockHead, key, sizeof(key));
+        size_t loaded = 0;
+        if (_spill && _spill->begin(PERSISTENCE_NAMESPACE)) {
+            loaded = _spill->loadBytes(key, _stage, sizeof(_stage));
+            _spill->end();
+        }
+        if (loaded != _blockLen[_blockHead]) {
+            LOGW("Backlog", "Flash block %u unreadable, dropping %u records",
+                 (unsigned)_blockHead, (unsigned)_blockRecords[_blockHead]);
+            _dropped += _blockRecords[_blockHead];
+            popBlock();
+            return false;
+        }
+        _stageLen = loaded;
+        _staged = true;
+        return true;
+    }
+
+    void popBlock() {
+        _blockRecords[_blockHead] = 0;
+        _stageOff = 0;
+        _headSent = 0;
+        _blockHead = (_blockHead + 1) % FLASH_BLOCKS;
+        _blockCount--;
+        _staged = false;
+        saveRing();
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Reference decoder for backfill frames (host tests; spec for the server)
+// -----------------------------------------------------------------------------
+namespace BackfillCodec {
+
+struct Record {
+    uint32_t ageSec;   // Seconds before the frame was built
+    TelemetryCodec::FieldValues values;
+};
+
+// Decodes up to maxRecords records. Returns the count, -1 on malformed input.
+inline int decode(const MessageSchema::Schema& schema, const uint8_t* buf, size_t len,
+                  Record* out, size_t maxRecords) {
+    if (len < ReadingStore::FRAME_HEADER_SIZE) return -1;
+    uint8_t count = buf[0];
+    if (count > maxRecords) return -1;
+
+    TelemetryCodec::RawFrame prev;
+    size_t offset = ReadingStore::FRAME_HEADER_SIZE;
+    uint32_t age = 0;
+    for (uint8_t r = 0; r < count; r++) {
+        uint32_t stamp = 0;
+        size_t n = TelemetryCodec::readVarint(buf + offset, len - offset, &stamp);
+        if (n == 0 || offset + n + 2 > len) return -1;
+        offset += n;
+        age = r == 0 ? stamp : age - stamp;
+
+        TelemetryCodec::RawFrame cur;
+        cur.present = (uint16_t)(buf[offset] | (buf[offset + 1] << 8));
+        offset += 2;
+        if (cur.present & ~TelemetryCodec::schemaMask(schema)) return -1;
+        for (uint8_t i = 0; i < schema.field_count; i++) {
+            if (!(cur.present & (1u << i))) continue;
+            MessageSchema::FieldType type = schema.fields[i].type;
+            if (r > 0 && (prev.present & (1u << i))) {
+                uint32_t zz = 0;
+                n = TelemetryCodec::readVarint(buf + offset, len - offset, &zz);
+                if (n) cur.raw[i] = TelemetryCodec::applyDelta(type, prev.raw[i], zz);
+            } else {
+                n = TelemetryCodec::decodeRaw(type, buf + offset, len - offset, &cur.raw[i]);
+            }
+            if (n == 0) return -1;
+            offset += n;
+        }
+        out[r].ageSec = age;
+        cur.toValues(schema, &out[r].values);
+        prev = cur;
+    }
+    return offset == len ? count : -1;
+}
+
+} // namespace BackfillCodec
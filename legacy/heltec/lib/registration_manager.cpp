@@ -11,12 +11,15 @@ void RegistrationManager::setDeviceInfo(const char* deviceType, const char* fwVe
 
 void RegistrationManager::onJoin() {
     // Always re-register after join — firmware or server may have changed.
-    // Cheap (5 frames) and provides consistency.
+    // Cheap (5 parts) and provides consistency.
     _state = State::Pending;
 }
 
 void RegistrationManager::onRegAck() {
     if (_state != State::Sent) return;
+    // An ACK for an earlier sequence ends a resend in progress
+    if (sending()) _tx->clear(TxClass::Registration);
+    _part = PART_COUNT;
     _state = State::Complete;
     _lastSendMs = 0;
     if (_persistence) {
@@ -52,8 +55,11 @@ void RegistrationManager::tick(uint32_t nowMs) {
         send();
         return;
     }
-    if (_state == State::Sent && _lastSendMs != 0 && (nowMs - _lastSendMs) >= REG_RETRY_INTERVAL_MS) {
-        _lastSendMs = nowMs;
+    if (sending()) {
+        pump(nowMs);
+        return;
+    }
+    if (_state == State::Sent && (nowMs - _lastSendMs) >= REG_RETRY_INTERVAL_MS) {
         _state = State::Pending;
         LOGI("Reg", "Retrying registration (awaiting ACK)");
         send();
@@ -61,95 +67,104 @@ void RegistrationManager::tick(uint32_t nowMs) {
 }
 
 void RegistrationManager::send() {
-    if (_state != State::Pending || !_txQueue) return;
-
-    // Flush any pending messages so registration frames have queue space.
-    // Registration is rare and takes priority over a queued telemetry/ack frame.
-    UBaseType_t pending = uxQueueMessagesWaiting(_txQueue);
-    if (pending > 3) {
-        LoRaWANTxMsg discard;
-        while (uxQueueMessagesWaiting(_txQueue) > 0) {
-            xQueueReceive(_txQueue, &discard, 0);
-        }
-        LOGI("Reg", "Flushed %d queued msgs to make room for registration", (int)pending);
-    }
+    if (_state != State::Pending || !_tx || !_text) return;
+
+    // Replace frames left over from a previous attempt; other classes are untouched
+    _tx->clear(TxClass::Registration);
 
     _state = State::Sent;
-    _lastSendMs = millis();
+    snprintf(_header, sizeof(_header), "v=1|sv=%d|type=%s|fw=%s", _text->version, _deviceType, _fwVersion);
+    _part = 0;
+    _offset = 0;
+    _chunk = 0;
+    _chunked = false;
+    pump(millis());
+}
 
-    sendFrame("header", "v=1|sv=%d|type=%s|fw=%s", _schema.version, _deviceType, _fwVersion);
+namespace {
+const char* const PART_KEYS[RegistrationManager::PART_COUNT] = {"header", "fields", "sys", "states", "cmds"};
+const char PART_CODES[RegistrationManager::PART_COUNT] = {'h', 'f', 's', 't', 'c'};
+const char CMDS_TEXT[] = "cmds=reset:10,interval:11,reboot:12,clearerr:13,forcereg:14,status:15,resync:17,ctrl:20,rule:30";
+}
 
-    auto appendItem = [](char* buf, int& pos, size_t bufSize, bool& isFirst, const char* item) -> bool {
-        if (!isFirst) {
-            int n = snprintf(buf + pos, bufSize - pos, ",");
-            if (n < 0 || n >= (int)(bufSize - pos)) return false;
-            pos += n;
-        }
-        isFirst = false;
-        int n = snprintf(buf + pos, bufSize - pos, "%s", item);
-        if (n < 0 || n >= (int)(bufSize - pos)) return false;
-        pos += n;
-        return true;
-    };
-
-    char fieldsBuf[200] = {0};
-    char sysBuf[300] = {0};
-    char statesBuf[200] = {0};
-    int fieldsPos = snprintf(fieldsBuf, sizeof(fieldsBuf), "fields=");
-    int sysPos = snprintf(sysBuf, sizeof(sysBuf), "sys=");
-    int statesPos = snprintf(statesBuf, sizeof(statesBuf), "states=");
-    bool fieldsFirst = true, sysFirst = true, statesFirst = true;
-    char itemBuf[64];
-
-    for (uint8_t i = 0; i < _schema.field_count; i++) {
-        const auto& field = _schema.fields[i];
-        int written = field.formatForRegistration(itemBuf, sizeof(itemBuf));
-        if (written <= 0 || written >= (int)sizeof(itemBuf)) continue;
-        itemBuf[sizeof(itemBuf) - 1] = '\0';
-        switch (field.category) {
-            case MessageSchema::FieldCategory::TELEMETRY:
-                appendItem(fieldsBuf, fieldsPos, sizeof(fieldsBuf), fieldsFirst, itemBuf);
-                break;
-            case MessageSchema::FieldCategory::SYSTEM:
-                appendItem(sysBuf, sysPos, sizeof(sysBuf), sysFirst, itemBuf);
-                break;
-            default:
-                break;
-        }
+const char* RegistrationManager::partText(uint8_t part) const {
+    switch (part) {
+        case 0: return _header;
+        case 1: return _text->fields;
+        case 2: return _text->sys;
+        case 3: return _text->states;
+        default: return CMDS_TEXT;
     }
+}
 
-    for (uint8_t i = 0; i < _schema.control_count; i++) {
-        int written = _schema.controls[i].formatForRegistration(itemBuf, sizeof(itemBuf));
-        if (written > 0) appendItem(statesBuf, statesPos, sizeof(statesBuf), statesFirst, itemBuf);
+// Top the queue up to REG_WINDOW frames; the rest waits for the next tick,
+// so a long low-DR sequence never overflows the Registration ring
+void RegistrationManager::pump(uint32_t nowMs) {
+    while (sending() && _tx->pending(TxClass::Registration) < REG_WINDOW) {
+        if (!enqueueNext()) return;
+    }
+    if (!sending()) {
+        _lastSendMs = nowMs;
+        LOGI("Reg", "Registration sequence queued (%lu frames so far)", (unsigned long)_framesQueued);
     }
-
-    sendFrame("fields", "%s", fieldsBuf);
-    sendFrame("sys", "%s", sysBuf);
-    sendFrame("states", "%s", statesBuf);
-    sendFrame("cmds", "cmds=reset:10,interval:11,reboot:12,clearerr:13,forcereg:14,status:15,ctrl:20,rule:30");
 }
 
-void RegistrationManager::sendFrame(const char* key, const char* format, ...) {
-    static char buffer[256];
-    int prefixLen = snprintf(buffer, sizeof(buffer), "reg:%s|", key);
-    if (prefixLen < 0 || prefixLen >= (int)sizeof(buffer)) return;
+bool RegistrationManager::enqueueNext() {
+    const char* text = partText(_part);
+    size_t len = strlen(text);
+    size_t maxLen = _budget ? _budget->maxPayload() : PayloadBudget::ABSOLUTE_MAX;
+    uint8_t frame[PayloadBudget::ABSOLUTE_MAX];
+
+    if (!_chunked) {
+        int prefixLen = snprintf((char*)frame, sizeof(frame), "reg:%s|", PART_KEYS[_part]);
+        if (prefixLen + len <= maxLen) {
+            memcpy(frame + prefixLen, text, len);
+            if (!enqueueFrame((const char*)frame, prefixLen + len)) return false;
+            nextPart();
+            return true;
+        }
+        _chunked = true;
+    }
 
-    va_list args;
-    va_start(args, format);
-    int dataLen = vsnprintf(buffer + prefixLen, sizeof(buffer) - prefixLen, format, args);
-    va_end(args);
-    if (dataLen < 0) return;
+    if (_chunk >= MAX_CHUNKS) {
+        LOGW("Reg", "'%s' needs more than %d chunks at max %d, rest dropped", PART_KEYS[_part], MAX_CHUNKS, (int)maxLen);
+        nextPart();
+        return true;
+    }
+    size_t n = len - _offset;
+    if (n > maxLen - CHUNK_PREFIX_LEN) n = maxLen - CHUNK_PREFIX_LEN;
+    bool last = _offset + n == len;
+    frame[0] = '~';
+    frame[1] = last ? (char)(PART_CODES[_part] - 'a' + 'A') : PART_CODES[_part];
+    frame[2] = (char)('0' + _chunk);
+    memcpy(frame + CHUNK_PREFIX_LEN, text + _offset, n);
+    if (!enqueueFrame((const char*)frame, CHUNK_PREFIX_LEN + n)) return false;
+    _offset += n;
+    _chunk++;
+    if (last) {
+        LOGI("Reg", "'%s' sent as %d chunks (max %d)", PART_KEYS[_part], _chunk, (int)maxLen);
+        nextPart();
+    }
+    return true;
+}
 
-    int totalLen = prefixLen + dataLen;
-    if (totalLen > 222) return;
+void RegistrationManager::nextPart() {
+    _part++;
+    _offset = 0;
+    _chunk = 0;
+    _chunked = false;
+}
 
+bool RegistrationManager::enqueueFrame(const char* data, size_t len) {
     LoRaWANTxMsg msg;
     msg.port = FPORT_REGISTRATION;
-    msg.len = totalLen;
+    msg.len = len;
     msg.confirmed = false;
-    memcpy(msg.payload, buffer, totalLen);
-    
-    if (xQueueSend(_txQueue, &msg, 0) != pdPASS) {
-        LOGW("Reg", "sendFrame '%s' dropped (queue full)", key);
+    memcpy(msg.payload, data, len);
+
+    if (_tx->enqueue(TxClass::Registration, msg) == TxScheduler::Result::Full) {
+        return false;   // Retried on the next tick
     }
+    _framesQueued++;
+    return true;
 }
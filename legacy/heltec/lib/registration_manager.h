@@ -4,8 +4,8 @@
 #include "protocol_constants.h"
 #include "hal_persistence.h"
 #include "lorawan_messages.h"
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
+#include "payload_budget.h"
+#include "tx_scheduler.h"
 #include <stdint.h>
 #include <cstdarg>
 #include <cstdio>
@@ -16,9 +16,20 @@
  *
  * States: NotStarted -> Pending -> Sent -> Complete
  * onJoin(): NotStarted -> Pending (triggers send)
- * send(): builds 5 frames, enqueues via TX queue (no delay)
+ * send(): starts the 5-part sequence (header, fields, sys, states, cmds) from
+ *         the pre-rendered RegistrationText, Pending -> Sent
+ * tick(): keeps at most REG_WINDOW frames queued as TxClass::Registration,
+ *         advancing the cursor as the radio sends them; retries 30 s after
+ *         the last frame of an unanswered sequence
  * onRegAck(): persist, Sent -> Complete
- * tick(): retry when Sent and elapsed > 30s
+ *
+ * A part that fits the current payload budget goes out as one frame,
+ * "reg:<key>|<text>". A larger one is cut into byte chunks behind a 3-byte
+ * prefix, so it fits even DR0 (11 bytes):
+ *   '~'  <code>  <index>  <bytes...>
+ * code is the part (h f s t c; upper case on the last chunk), index is '0'
+ * plus the chunk number. The server joins the chunks in index order and
+ * parses the result as the text of "reg:<key>|".
  */
 class RegistrationManager {
 public:
@@ -29,12 +40,19 @@ public:
         Complete
     };
 
+    static constexpr uint8_t PART_COUNT = 5;
+    static constexpr uint8_t REG_WINDOW = 2;            // Frames queued at a time
+    static constexpr uint8_t CHUNK_PREFIX_LEN = 3;
+    static constexpr uint8_t MAX_CHUNKS = 'z' - '0' + 1;
+
     RegistrationManager() = default;
 
-    void setTxQueue(QueueHandle_t queue) { _txQueue = queue; }
-    void setSchema(const MessageSchema::Schema& schema) { _schema = schema; }
+    void setTxScheduler(TxScheduler* tx) { _tx = tx; }
+    /** Registration lists to send; must outlive the manager (normally DEVICE_REGISTRATION in flash). */
+    void setRegistrationText(const MessageSchema::RegistrationText& text) { _text = &text; }
     void setDeviceInfo(const char* deviceType, const char* fwVersion);
     void setPersistence(IPersistenceHal* hal) { _persistence = hal; }
+    void setPayloadBudget(const PayloadBudget* budget) { _budget = budget; }
 
     /** Called when device joins — NotStarted -> Pending. */
     void onJoin();
@@ -48,25 +66,44 @@ public:
     /** Restore state from persistence (call at boot). */
     void restoreFromPersistence();
 
-    /** Retry logic: Sent + 30s elapsed -> Pending, send again. */
+    /** Feed the next frames of a sequence; retry when Sent and 30 s passed since its last frame. */
     void tick(uint32_t nowMs);
 
     State getState() const { return _state; }
 
-    /** Send all 5 registration frames via TX queue. Call when Pending. */
+    /** Start the registration sequence (first frames are queued at once). Call when Pending. */
     void send();
 
+    /** A sequence is in progress (frames left to queue). */
+    bool sending() const { return _state == State::Sent && _part < PART_COUNT; }
+
+    /** Frames queued since start, for accounting. */
+    uint32_t framesQueued() const { return _framesQueued; }
+
 private:
     static constexpr uint32_t REG_RETRY_INTERVAL_MS = 30000;
 
-    QueueHandle_t _txQueue = nullptr;
-    MessageSchema::Schema     _schema;
+    TxScheduler* _tx = nullptr;
+    const MessageSchema::RegistrationText* _text = nullptr;
     IPersistenceHal* _persistence = nullptr;
+    const PayloadBudget* _budget = nullptr;
     char _deviceType[32] = "water_monitor";
     char _fwVersion[16] = "2.0.0";
+    char _header[80] = {};
 
     State _state = State::NotStarted;
-    uint32_t _lastSendMs = 0;
+    uint32_t _lastSendMs = 0;       // Last frame of the sequence queued
+
+    // Sequence cursor
+    uint8_t _part = PART_COUNT;
+    uint16_t _offset = 0;           // Bytes of the part already queued
+    uint8_t _chunk = 0;
+    bool _chunked = false;
+    uint32_t _framesQueued = 0;
 
-    void sendFrame(const char* key, const char* format, ...);
+    const char* partText(uint8_t part) const;
+    void pump(uint32_t nowMs);
+    bool enqueueNext();
+    bool enqueueFrame(const char* data, size_t len);
+    void nextPart();
 };
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+// =============================================================================
+// Rule programs: compound rule conditions as stack bytecode
+// =============================================================================
+// A program replaces a rule's single field as the value the rule's operator
+// compares, so "tank2 < 80 AND tank1 > 20" is one rule whose program yields
+// 1 or 0 (operator GT, threshold 0.5). The server compiles the expression.
+//
+// Opcodes shared with the compute VM keep its numbering. Values are floats;
+// a missing field loads as NaN and every operation with a NaN operand yields
+// NaN (NOT, NEQ, MIN2 and SELECT included). The rule compares a NaN result
+// as false, so absent data never satisfies a condition.
+//
+// Bounds: no jumps, so a program runs at most MAX_LEN instructions; verify()
+// checks operands and stack depth once on receipt, so run() needs no checks.
+// =============================================================================
+
+namespace EdgeRules {
+
+enum class RuleOpcode : uint8_t {
+    LOAD_FIELD = 0x01,  // push values[next byte]
+    PUSH_F32 = 0x02,    // push float (4 bytes LE follow)
+    ADD = 0x10,
+    SUB = 0x11,
+    MUL = 0x12,
+    DIV = 0x13,         // x / 0 = 0
+    MOD = 0x14,         // truncated; x % 0 = 0
+    CMP_GT = 0x20,      // a > b -> 1 or 0
+    CMP_LT = 0x21,
+    CMP_GTE = 0x22,
+    CMP_LTE = 0x23,
+    SELECT = 0x24,      // cond, a, b -> cond ? a : b
+    CMP_EQ = 0x25,
+    CMP_NEQ = 0x26,
+    MIN2 = 0x30,
+    MAX2 = 0x31,
+    ABS = 0x32,
+    NEG = 0x33,
+    CLAMP = 0x42,       // min, max (2 floats LE follow)
+    AND = 0x50,
+    OR = 0x51,
+    NOT = 0x52,
+    TIME_OF_DAY = 0x60, // push local minute of day (0-1439), NaN until time is synced
+    TIME_IN = 0x61,     // start, end minute (2 x uint16 LE follow): 1 inside
+                        // [start, end), wrapping past midnight; 0 until synced
+};
+
+struct RuleProgram {
+    static constexpr uint8_t MAX_LEN = 64;   // Same limit as compute expressions
+    static constexpr uint8_t MAX_STACK = 8;
+
+    uint8_t rule_id;
+    uint8_t len;         // 0 = slot free
+    uint8_t code[MAX_LEN];
+
+    // Checks every opcode, operand and field index, and that the stack never
+    // under- or overflows and ends holding exactly the result
+    static bool verify(const uint8_t* code, size_t len, uint8_t field_count) {
+        if (len == 0 || len > MAX_LEN) return false;
+        int depth = 0;
+        size_t pc = 0;
+        while (pc < len) {
+            uint8_t pops = 0, pushes = 1, operands = 0;
+            switch (static_cast<RuleOpcode>(code[pc])) {
+                case RuleOpcode::LOAD_FIELD:
+                    operands = 1;
+                    if (pc + 1 < len && code[pc + 1] >= field_count) return false;
+                    break;
+                case RuleOpcode::PUSH_F32: operands = 4; break;
+                case RuleOpcode::TIME_OF_DAY: break;
+                case RuleOpcode::TIME_IN: operands = 4; break;
+                case RuleOpcode::ABS:
+                case RuleOpcode::NEG:
+                case RuleOpcode::NOT: pops = 1; break;
+                case RuleOpcode::CLAMP: pops = 1; operands = 8; break;
+                case RuleOpcode::SELECT: pops = 3; break;
+                case RuleOpcode::ADD:
+                case RuleOpcode::SUB:
+                case RuleOpcode::MUL:
+                case RuleOpcode::DIV:
+                case RuleOpcode::MOD:
+                case RuleOpcode::CMP_GT:
+                case RuleOpcode::CMP_LT:
+                case RuleOpcode::CMP_GTE:
+                case RuleOpcode::CMP_LTE:
+                case RuleOpcode::CMP_EQ:
+                case RuleOpcode::CMP_NEQ:
+                case RuleOpcode::MIN2:
+                case RuleOpcode::MAX2:
+                case RuleOpcode::AND:
+                case RuleOpcode::OR: pops = 2; break;
+                default: return false;
+            }
+            if (pc + 1 + operands > len || depth < pops) return false;
+            depth += pushes - pops;
+            if (depth > MAX_STACK) return false;
+            pc += 1 + operands;
+        }
+        return depth == 1;
+    }
+
+    // Runs a verified program. Fields at or past field_count load as NaN;
+    // minute_of_day < 0 means the clock is not synced.
+    float run(const float* values, uint8_t field_count, int16_t minute_of_day) const {
+        float stack[MAX_STACK];
+        uint8_t sp = 0;
+        uint8_t pc = 0;
+        while (pc < len) {
+            RuleOpcode op = static_cast<RuleOpcode>(code[pc++]);
+            switch (op) {
+                case RuleOpcode::LOAD_FIELD: {
+                    uint8_t idx = code[pc++];
+                    stack[sp++] = idx < field_count ? values[idx] : NAN;
+                    break;
+                }
+                case RuleOpcode::PUSH_F32:
+                    memcpy(&stack[sp++], code + pc, sizeof(float));
+                    pc += 4;
+                    break;
+                case RuleOpcode::TIME_OF_DAY:
+                    stack[sp++] = minute_of_day < 0 ? NAN : (float)minute_of_day;
+                    break;
+                case RuleOpcode::TIME_IN: {
+                    uint16_t start = code[pc] | (code[pc + 1] << 8);
+                    uint16_t end = code[pc + 2] | (code[pc + 3] << 8);
+                    pc += 4;
+                    bool in = minute_of_day >= 0 &&
+                              (start <= end ? minute_of_day >= start && minute_of_day < end
+                                            : minute_of_day >= start || minute_of_day < end);
+                    stack[sp++] = in ? 1.0f : 0.0f;
+                    break;
+                }
+                case RuleOpcode::ABS: stack[sp - 1] = fabsf(stack[sp - 1]); break;
+                case RuleOpcode::NEG: stack[sp - 1] = -stack[sp - 1]; break;
+                case RuleOpcode::NOT:
+                    if (!isnan(stack[sp - 1])) stack[sp - 1] = stack[sp - 1] != 0.0f ? 0.0f : 1.0f;
+                    break;
+                case RuleOpcode::CLAMP: {
+                    float lo, hi;
+                    memcpy(&lo, code + pc, sizeof(float));
+                    memcpy(&hi, code + pc + 4, sizeof(float));
+                    pc += 8;
+                    float& v = stack[sp - 1];
+                    if (v < lo) v = lo;
+                    if (v > hi) v = hi;
+                    break;
+                }
+                case RuleOpcode::SELECT: {
+                    sp -= 2;
+                    float& cond = stack[sp - 1];
+                    if (isnan(cond) || isnan(stack[sp]) || isnan(stack[sp + 1])) cond = NAN;
+                    else cond = cond != 0.0f ? stack[sp] : stack[sp + 1];
+                    break;
+                }
+                default: {
+                    float b = stack[--sp];
+                    float& a = stack[sp - 1];
+                    a = binary(op, a, b);
+                    break;
+                }
+            }
+        }
+        return stack[0];
+    }
+
+private:
+    static float binary(RuleOpcode op, float a, float b) {
+        if (isnan(a) || isnan(b)) return NAN;
+        switch (op) {
+            case RuleOpcode::ADD: return a + b;
+            case RuleOpcode::SUB: return a - b;
+            case RuleOpcode::MUL: return a * b;
+            case RuleOpcode::DIV: return b != 0.0f ? a / b : 0.0f;
+            case RuleOpcode::MOD: return b != 0.0f ? a - truncf(a / b) * b : 0.0f;
+            case RuleOpcode::CMP_GT: return a > b ? 1.0f : 0.0f;
+            case RuleOpcode::CMP_LT: return a < b ? 1.0f : 0.0f;
+            case RuleOpcode::CMP_GTE: return a >= b ? 1.0f : 0.0f;
+            case RuleOpcode::CMP_LTE: return a <= b ? 1.0f : 0.0f;
+            case RuleOpcode::CMP_EQ: return a == b ? 1.0f : 0.0f;
+            case RuleOpcode::CMP_NEQ: return a != b ? 1.0f : 0.0f;
+            case RuleOpcode::MIN2: return a < b ? a : b;
+            case RuleOpcode::MAX2: return a > b ? a : b;
+            case RuleOpcode::AND: return a != 0.0f && b != 0.0f ? 1.0f : 0.0f;
+            case RuleOpcode::OR: return a != 0.0f || b != 0.0f ? 1.0f : 0.0f;
+            default: return NAN;
+        }
+    }
+};
+
+} // namespace EdgeRules
@@ -9,14 +9,25 @@
 
 namespace SensorConfig {
 
+// Where flow pulses are counted (lib/pulse_source.h); a backend that cannot
+// start on the pin falls back to Isr
+enum class PulseBackend : uint8_t {
+    Isr,    // GPIO interrupt per pulse
+    Pcnt,   // Hardware counter, filtered; stops in deep sleep
+    Ulp,    // ULP coprocessor (RTC GPIO only); counts through deep sleep
+};
+
 struct YFS201WaterFlow {
     uint8_t pin = 7;
     bool enabled = true;
     const char* persistence_namespace = "water_meter";
+    uint32_t sampleIntervalMs = 1000;   // Rule reaction time for flow
+    PulseBackend counter = PulseBackend::Pcnt;
 };
 
 struct BatteryMonitor {
     bool enabled = true;
+    uint32_t sampleIntervalMs = 5000;
 };
 
 } // namespace SensorConfig
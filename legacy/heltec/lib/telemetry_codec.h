@@ -0,0 +1,621 @@
+#pragma once
+
+#include "message_schema.h"
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// =============================================================================
+// Telemetry Codec
+// =============================================================================
+// Schema-indexed binary encoding for telemetry uplinks (fPort 2). Replaces the
+// "key:value" text format: keys are implied by the schema field index, values
+// are packed by FieldType.
+//
+// Value encoding by FieldType:
+//   FLOAT  -> float32 LE (4 bytes)
+//   UINT32 -> unsigned LEB128 varint (1-5 bytes)
+//   INT32  -> zigzag LEB128 varint (1-5 bytes)
+//   ENUM   -> uint8
+//
+// Frames ([0] is the frame type):
+//
+// Snapshot (stateless, e.g. post-join report):
+// [0]     FRAME_SNAPSHOT
+// [1-2]   presence mask (uint16 LE): bit N set = schema field N follows
+// [3..]   values in field index order
+//
+// Keyframe (starts a delta chain):
+// [0]     FRAME_KEYFRAME
+// [1]     seq
+// [2-3]   presence mask (uint16 LE)
+// [4..]   values in field index order
+//
+// Delta (only fields that changed against an earlier frame base_seq):
+// [0]     FRAME_DELTA
+// [1]     seq
+// [2]     base_seq
+// [3-4]   changed mask (uint16 LE); presence is inherited from base_seq
+// [5..]   varint delta per changed field, in field index order:
+//           UINT32/INT32/ENUM -> zigzag(value - base), 32-bit wrapping
+//           FLOAT             -> low bit 0: zigzag(q) << 1, q steps on the
+//                                0.01 grid: value = (float)k / 100.0f with
+//                                k = lroundf(base * 100.0f) + q (float32,
+//                                |k| < 2^24). Used only when it gives the
+//                                exact float back, e.g. 12.34 -> 12.35.
+//                                low bit 1: zigzag(d) << 1 | 1, d the
+//                                difference of the IEEE754 bit patterns
+//                                (|d| < 2^30, else a keyframe is sent)
+//           FLOAT values arrive bit-exact either way.
+//
+// Typical water monitor report (pd, tv, bp, ec, tsr): snapshot ~15 bytes,
+// delta ~8 bytes, which fits the 11-byte US915 DR0 limit.
+// =============================================================================
+
+namespace TelemetryCodec {
+
+constexpr uint8_t FRAME_SNAPSHOT = 0x00;
+constexpr uint8_t FRAME_KEYFRAME = 0x01;
+constexpr uint8_t FRAME_DELTA = 0x02;
+
+constexpr size_t SNAPSHOT_HEADER_SIZE = 3;
+constexpr size_t KEYFRAME_HEADER_SIZE = 4;
+constexpr size_t DELTA_HEADER_SIZE = 5;
+constexpr size_t MAX_VALUE_SIZE = 5;    // Longest varint
+constexpr size_t MAX_FRAME_SIZE = DELTA_HEADER_SIZE + MessageSchema::MAX_FIELDS * MAX_VALUE_SIZE;
+
+constexpr float FLOAT_DELTA_SCALE = 100.0f;  // FLOAT grid steps are centi-units
+constexpr int32_t FLOAT_GRID_LIMIT = 1 << 24;  // Grid points a float32 holds exactly
+constexpr uint8_t HISTORY = 16;              // Decoder keeps this many frames; deltas never span more
+
+static_assert(MessageSchema::MAX_FIELDS <= 16, "presence mask is 16 bits");
+
+// -----------------------------------------------------------------------------
+// FieldValues - one value slot per schema field plus a presence mask
+// -----------------------------------------------------------------------------
+struct FieldValues {
+    uint16_t present = 0;
+    float values[MessageSchema::MAX_FIELDS] = {0};
+
+    void clear() { present = 0; }
+
+    // NaN readings are treated as absent
+    void set(uint8_t idx, float value) {
+        if (idx >= MessageSchema::MAX_FIELDS || std::isnan(value)) return;
+        values[idx] = value;
+        present |= (uint16_t)(1u << idx);
+    }
+
+    bool has(uint8_t idx) const {
+        return idx < MessageSchema::MAX_FIELDS && (present & (1u << idx));
+    }
+
+    uint8_t count() const { return (uint8_t)__builtin_popcount(present); }
+};
+
+// -----------------------------------------------------------------------------
+// Primitives
+// -----------------------------------------------------------------------------
+
+// Write unsigned LEB128. Returns bytes written, 0 if it does not fit.
+inline size_t writeVarint(uint8_t* buf, size_t cap, uint32_t value) {
+    size_t n = 0;
+    do {
+        if (n >= cap) return 0;
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        buf[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    return n;
+}
+
+// Read unsigned LEB128. Returns bytes consumed, 0 on truncated/overlong input.
+inline size_t readVarint(const uint8_t* buf, size_t len, uint32_t* out) {
+    uint32_t value = 0;
+    for (size_t n = 0; n < len && n < MAX_VALUE_SIZE; n++) {
+        value |= (uint32_t)(buf[n] & 0x7F) << (7 * n);
+        if (!(buf[n] & 0x80)) {
+            *out = value;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+inline uint32_t zigzagEncode(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t zigzagDecode(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+// Saturating float -> integer conversions (round to nearest)
+inline uint32_t toUint32(float v) {
+    if (!(v > 0.0f)) return 0;
+    if (v >= 4294967295.0f) return 0xFFFFFFFFu;
+    return (uint32_t)(v + 0.5f);
+}
+
+inline int32_t toInt32(float v) {
+    if (v >= 2147483647.0f) return INT32_MAX;
+    if (v <= -2147483648.0f) return INT32_MIN;
+    return (int32_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+// Wire representation of a value as 32 raw bits: the integer for integer
+// types, the IEEE754 bit pattern for FLOAT. Deltas and baselines work on this.
+inline uint32_t toRaw(MessageSchema::FieldType type, float value) {
+    switch (type) {
+        case MessageSchema::FieldType::FLOAT: {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        case MessageSchema::FieldType::UINT32: return toUint32(value);
+        case MessageSchema::FieldType::INT32:  return (uint32_t)toInt32(value);
+        case MessageSchema::FieldType::ENUM: {
+            uint32_t v = toUint32(value);
+            return v > 0xFF ? 0xFF : v;
+        }
+    }
+    return 0;
+}
+
+inline float fromRaw(MessageSchema::FieldType type, uint32_t raw) {
+    switch (type) {
+        case MessageSchema::FieldType::FLOAT: {
+            float value;
+            memcpy(&value, &raw, sizeof(value));
+            return value;
+        }
+        case MessageSchema::FieldType::UINT32: return (float)raw;
+        case MessageSchema::FieldType::INT32:  return (float)(int32_t)raw;
+        case MessageSchema::FieldType::ENUM:   return (float)raw;
+    }
+    return 0.0f;
+}
+
+// Encode one raw value by field type. Returns bytes written, 0 if it does not fit.
+inline size_t encodeRaw(MessageSchema::FieldType type, uint32_t raw, uint8_t* buf, size_t cap) {
+    switch (type) {
+        case MessageSchema::FieldType::FLOAT:
+            if (cap < 4) return 0;
+            buf[0] = raw & 0xFF;
+            buf[1] = (raw >> 8) & 0xFF;
+            buf[2] = (raw >> 16) & 0xFF;
+            buf[3] = (raw >> 24) & 0xFF;
+            return 4;
+        case MessageSchema::FieldType::UINT32:
+            return writeVarint(buf, cap, raw);
+        case MessageSchema::FieldType::INT32:
+            return writeVarint(buf, cap, zigzagEncode((int32_t)raw));
+        case MessageSchema::FieldType::ENUM:
+            if (cap < 1) return 0;
+            buf[0] = (uint8_t)raw;
+            return 1;
+    }
+    return 0;
+}
+
+// Decode one raw value by field type. Returns bytes consumed, 0 on malformed input.
+inline size_t decodeRaw(MessageSchema::FieldType type, const uint8_t* buf, size_t len, uint32_t* raw) {
+    size_t n = 0;
+    switch (type) {
+        case MessageSchema::FieldType::FLOAT:
+            if (len < 4) return 0;
+            *raw = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+                   ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+            return 4;
+        case MessageSchema::FieldType::UINT32:
+            return readVarint(buf, len, raw);
+        case MessageSchema::FieldType::INT32: {
+            uint32_t zz = 0;
+            n = readVarint(buf, len, &zz);
+            if (n) *raw = (uint32_t)zigzagDecode(zz);
+            return n;
+        }
+        case MessageSchema::FieldType::ENUM:
+            if (len < 1) return 0;
+            *raw = buf[0];
+            return 1;
+    }
+    return 0;
+}
+
+inline size_t encodeValue(MessageSchema::FieldType type, float value, uint8_t* buf, size_t cap) {
+    return encodeRaw(type, toRaw(type, value), buf, cap);
+}
+
+inline size_t decodeValue(MessageSchema::FieldType type, const uint8_t* buf, size_t len, float* out) {
+    uint32_t raw = 0;
+    size_t n = decodeRaw(type, buf, len, &raw);
+    if (n) *out = fromRaw(type, raw);
+    return n;
+}
+
+inline uint16_t schemaMask(const MessageSchema::Schema& schema) {
+    return (uint16_t)((1u << schema.field_count) - 1);
+}
+
+// -----------------------------------------------------------------------------
+// RawFrame - field values in wire representation (baseline for deltas)
+// -----------------------------------------------------------------------------
+struct RawFrame {
+    uint8_t seq = 0;
+    uint16_t present = 0;
+    uint32_t raw[MessageSchema::MAX_FIELDS] = {0};
+
+    void toValues(const MessageSchema::Schema& schema, FieldValues* out) const {
+        out->clear();
+        for (uint8_t i = 0; i < schema.field_count; i++) {
+            if (present & (1u << i)) out->set(i, fromRaw(schema.fields[i].type, raw[i]));
+        }
+    }
+};
+
+// Apply a delta varint to one raw value (see frame layout above)
+inline uint32_t applyDelta(MessageSchema::FieldType type, uint32_t base, uint32_t word) {
+    if (type != MessageSchema::FieldType::FLOAT) return base + (uint32_t)zigzagDecode(word);
+    if (word == 0) return base;
+    int32_t delta = zigzagDecode(word >> 1);
+    if (word & 1) return base + (uint32_t)delta;
+    float from = fromRaw(type, base) * FLOAT_DELTA_SCALE;
+    if (!(fabsf(from) < FLOAT_GRID_LIMIT)) return base;  // Off the grid: never encoded
+    int32_t k = (int32_t)lroundf(from) + delta;
+    return toRaw(type, (float)k / FLOAT_DELTA_SCALE);
+}
+
+// Delta varint taking base to cur exactly (0 = unchanged). FLOAT prefers a
+// grid step, which stays short for values like 12.34. False when the change
+// is too large for a delta and the value has to be sent whole.
+inline bool deltaWord(MessageSchema::FieldType type, uint32_t base, uint32_t cur, uint32_t* word) {
+    if (type != MessageSchema::FieldType::FLOAT) {
+        *word = zigzagEncode((int32_t)(cur - base));
+        return true;
+    }
+    if (cur == base) {
+        *word = 0;
+        return true;
+    }
+    float from = fromRaw(type, base) * FLOAT_DELTA_SCALE, to = fromRaw(type, cur) * FLOAT_DELTA_SCALE;
+    if (fabsf(from) < FLOAT_GRID_LIMIT && fabsf(to) < FLOAT_GRID_LIMIT) {  // False for NaN/Inf
+        uint32_t step = zigzagEncode((int32_t)(lroundf(to) - lroundf(from))) << 1;
+        if (step != 0 && applyDelta(type, base, step) == cur) {
+            *word = step;
+            return true;
+        }
+    }
+    int32_t bits = (int32_t)(cur - base);
+    if (bits < -(1 << 30) || bits >= (1 << 30)) return false;
+    *word = (zigzagEncode(bits) << 1) | 1;
+    return true;
+}
+
+// Values in field order for the fields in mask. Returns bytes written, 0 if it does not fit.
+inline size_t encodeFields(const MessageSchema::Schema& schema, uint16_t mask, const uint32_t* raw,
+                           uint8_t* buf, size_t cap) {
+    size_t offset = 0;
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        if (!(mask & (1u << i))) continue;
+        size_t n = encodeRaw(schema.fields[i].type, raw[i], buf + offset, cap - offset);
+        if (n == 0) return 0;
+        offset += n;
+    }
+    return offset;
+}
+
+inline size_t decodeFields(const MessageSchema::Schema& schema, uint16_t mask, const uint8_t* buf,
+                           size_t len, uint32_t* raw) {
+    size_t offset = 0;
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        if (!(mask & (1u << i))) continue;
+        size_t n = decodeRaw(schema.fields[i].type, buf + offset, len - offset, &raw[i]);
+        if (n == 0) return 0;
+        offset += n;
+    }
+    return offset;
+}
+
+// Drop the lowest-priority present field so a frame fits a smaller payload
+// budget: SYSTEM/COMPUTED before TELEMETRY, highest schema index first.
+// Returns false when there is nothing left to drop.
+inline bool dropLowestPriority(const MessageSchema::Schema& schema, FieldValues* values) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = schema.field_count - 1; i >= 0; i--) {
+            if (!values->has((uint8_t)i)) continue;
+            bool isTelemetry = schema.fields[i].category == MessageSchema::FieldCategory::TELEMETRY;
+            if (pass == 0 && isTelemetry) continue;
+            values->present &= (uint16_t)~(1u << i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// Snapshot frames
+// -----------------------------------------------------------------------------
+
+// Encode every present field that exists in the schema.
+// Returns frame length, 0 if the frame does not fit in cap.
+inline size_t encodeSnapshot(const MessageSchema::Schema& schema, const FieldValues& in,
+                             uint8_t* buf, size_t cap) {
+    if (cap < SNAPSHOT_HEADER_SIZE) return 0;
+
+    uint16_t mask = in.present & schemaMask(schema);
+    uint32_t raw[MessageSchema::MAX_FIELDS];
+    for (uint8_t i = 0; i < schema.field_count; i++) {
+        if (mask & (1u << i)) raw[i] = toRaw(schema.fields[i].type, in.values[i]);
+    }
+
+    buf[0] = FRAME_SNAPSHOT;
+    buf[1] = mask & 0xFF;
+    buf[2] = (mask >> 8) & 0xFF;
+    size_t n = encodeFields(schema, mask, raw, buf + SNAPSHOT_HEADER_SIZE, cap - SNAPSHOT_HEADER_SIZE);
+    if (n == 0 && mask != 0) return 0;
+    return SNAPSHOT_HEADER_SIZE + n;
+}
+
+// -----------------------------------------------------------------------------
+// TelemetryCompressor - stateful keyframe/delta encoder
+// -----------------------------------------------------------------------------
+// Deltas are taken against the most recent frame known to have reached the
+// server: with confirmed uplinks that is the last frame the network ACKed;
+// without ACKs it is the last keyframe that actually went on air (a queued
+// frame may be coalesced away before sending). A keyframe is sent when
+// there is no baseline, when the set of present fields changes, every
+// keyframeInterval frames, when the baseline is too old for the decoder's
+// history, or on request (server resync downlink, rejoin).
+//
+// encode() must be called from a single task. onUplinkComplete() and
+// requestKeyframe() may be called from any task; they only post a flag that
+// encode() consumes.
+// -----------------------------------------------------------------------------
+class TelemetryCompressor {
+public:
+    static constexpr uint8_t DEFAULT_KEYFRAME_INTERVAL = 20;
+
+    TelemetryCompressor(const MessageSchema::Schema& schema, bool ackRequired,
+                        uint8_t keyframeInterval = DEFAULT_KEYFRAME_INTERVAL)
+        : _schema(schema), _ackRequired(ackRequired),
+          _keyframeInterval(keyframeInterval ? keyframeInterval : 1) {}
+
+    // Encode the next frame. Returns length, 0 if it does not fit in cap.
+    size_t encode(const FieldValues& in, uint8_t* buf, size_t cap, bool* isKeyframe = nullptr) {
+        consumeSignals();
+
+        RawFrame cur;
+        cur.seq = _nextSeq;
+        cur.present = in.present & schemaMask(_schema);
+        for (uint8_t i = 0; i < _schema.field_count; i++) {
+            if (cur.present & (1u << i)) cur.raw[i] = toRaw(_schema.fields[i].type, in.values[i]);
+        }
+
+        size_t len = 0;
+        bool keyframe = needKeyframe(cur);
+        if (!keyframe) {
+            len = encodeDelta(&cur, buf, cap);
+            keyframe = (len == 0);
+        }
+        if (keyframe) {
+            len = encodeKeyframe(cur, buf, cap);
+            if (len == 0) return 0;
+            _framesSinceKeyframe = 0;
+            _keyframeRequested = false;
+        } else {
+            _framesSinceKeyframe++;
+        }
+
+        // Remember what the decoder will reconstruct, so delivery can promote it
+        _sent[_sentHead] = cur;
+        _sentHead = (_sentHead + 1) % SENT_SLOTS;
+        if (_sentCount < SENT_SLOTS) _sentCount++;
+
+        _nextSeq++;
+        if (isKeyframe) *isKeyframe = keyframe;
+        return len;
+    }
+
+    // Radio finished an fPort 2 uplink (frame type and seq are payload[0..1])
+    void onUplinkComplete(uint8_t frameType, uint8_t seq, bool sent, bool acked) {
+        bool delivered = _ackRequired ? acked : (sent && frameType == FRAME_KEYFRAME);
+        if (delivered && frameType != FRAME_SNAPSHOT) _ackedSeq = (uint16_t)(0x100 | seq);
+    }
+
+    // Next frame is a keyframe (server lost sync, or session restarted)
+    void requestKeyframe() { _resyncPending = true; }
+
+    uint8_t nextSeq() const { return _nextSeq; }
+
+private:
+    static constexpr uint8_t SENT_SLOTS = 4;
+
+    const MessageSchema::Schema& _schema;
+    bool _ackRequired;
+    uint8_t _keyframeInterval;
+
+    uint8_t _nextSeq = 0;
+    uint8_t _framesSinceKeyframe = 0;
+    bool _keyframeRequested = true;
+    bool _hasBaseline = false;
+    RawFrame _baseline;
+
+    RawFrame _sent[SENT_SLOTS];
+    uint8_t _sentHead = 0;
+    uint8_t _sentCount = 0;
+
+    volatile uint16_t _ackedSeq = 0;      // 0x100 | seq when a delivery is pending
+    volatile bool _resyncPending = false;
+
+    void consumeSignals() {
+        if (_resyncPending) {
+            _resyncPending = false;
+            _keyframeRequested = true;
+            _hasBaseline = false;
+            _sentCount = 0;
+        }
+        uint16_t acked = _ackedSeq;
+        if (acked) {
+            _ackedSeq = 0;
+            for (uint8_t k = 0; k < _sentCount; k++) {
+                const RawFrame& f = _sent[(_sentHead + SENT_SLOTS - 1 - k) % SENT_SLOTS];
+                if (f.seq == (uint8_t)acked) {
+                    _baseline = f;
+                    _hasBaseline = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    bool needKeyframe(const RawFrame& cur) const {
+        if (_keyframeRequested || !_hasBaseline) return true;
+        if (cur.present != _baseline.present) return true;
+        if (_framesSinceKeyframe + 1 >= _keyframeInterval) return true;
+        return (uint8_t)(cur.seq - _baseline.seq) >= HISTORY;
+    }
+
+    size_t encodeKeyframe(const RawFrame& cur, uint8_t* buf, size_t cap) const {
+        if (cap < KEYFRAME_HEADER_SIZE) return 0;
+        buf[0] = FRAME_KEYFRAME;
+        buf[1] = cur.seq;
+        buf[2] = cur.present & 0xFF;
+        buf[3] = (cur.present >> 8) & 0xFF;
+        size_t n = encodeFields(_schema, cur.present, cur.raw, buf + KEYFRAME_HEADER_SIZE,
+                                cap - KEYFRAME_HEADER_SIZE);
+        if (n == 0 && cur.present != 0) return 0;
+        return KEYFRAME_HEADER_SIZE + n;
+    }
+
+    // Encode cur as a delta against the baseline. Returns 0 if a keyframe is
+    // needed instead.
+    size_t encodeDelta(const RawFrame* cur, uint8_t* buf, size_t cap) const {
+        if (cap < DELTA_HEADER_SIZE) return 0;
+
+        uint16_t changed = 0;
+        size_t offset = DELTA_HEADER_SIZE;
+        for (uint8_t i = 0; i < _schema.field_count; i++) {
+            if (!(cur->present & (1u << i))) continue;
+            uint32_t word;
+            if (!deltaWord(_schema.fields[i].type, _baseline.raw[i], cur->raw[i], &word)) return 0;
+            if (word == 0) continue;
+
+            size_t n = writeVarint(buf + offset, cap - offset, word);
+            if (n == 0) return 0;
+            offset += n;
+            changed |= (uint16_t)(1u << i);
+        }
+
+        buf[0] = FRAME_DELTA;
+        buf[1] = cur->seq;
+        buf[2] = _baseline.seq;
+        buf[3] = changed & 0xFF;
+        buf[4] = (changed >> 8) & 0xFF;
+        return offset;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Reference decoder
+// -----------------------------------------------------------------------------
+// Mirrors the encoders above; used by host tests and as the spec for
+// server-side decoders. Keeps the last HISTORY reconstructed frames so deltas
+// can reference any of them.
+// -----------------------------------------------------------------------------
+enum class DecodeStatus : uint8_t {
+    Ok = 0,
+    NeedResync = 1,   // Delta references a frame we do not have: request a keyframe
+    Malformed = 2
+};
+
+inline bool decodeSnapshot(const MessageSchema::Schema& schema, const uint8_t* buf, size_t len,
+                           FieldValues* out) {
+    if (len < SNAPSHOT_HEADER_SIZE || buf[0] != FRAME_SNAPSHOT) return false;
+
+    uint16_t mask = (uint16_t)(buf[1] | (buf[2] << 8));
+    if (mask & ~schemaMask(schema)) return false;
+
+    RawFrame frame;
+    frame.present = mask;
+    size_t n = decodeFields(schema, mask, buf + SNAPSHOT_HEADER_SIZE, len - SNAPSHOT_HEADER_SIZE, frame.raw);
+    if (n == 0 && mask != 0) return false;
+    if (SNAPSHOT_HEADER_SIZE + n != len) return false;
+    frame.toValues(schema, out);
+    return true;
+}
+
+class TelemetryDecompressor {
+public:
+    explicit TelemetryDecompressor(const MessageSchema::Schema& schema) : _schema(schema) {}
+
+    DecodeStatus decode(const uint8_t* buf, size_t len, FieldValues* out) {
+        if (len < 1) return DecodeStatus::Malformed;
+
+        switch (buf[0]) {
+            case FRAME_SNAPSHOT:
+                return decodeSnapshot(_schema, buf, len, out) ? DecodeStatus::Ok : DecodeStatus::Malformed;
+
+            case FRAME_KEYFRAME: {
+                if (len < KEYFRAME_HEADER_SIZE) return DecodeStatus::Malformed;
+                RawFrame frame;
+                frame.seq = buf[1];
+                frame.present = (uint16_t)(buf[2] | (buf[3] << 8));
+                if (frame.present & ~schemaMask(_schema)) return DecodeStatus::Malformed;
+                size_t n = decodeFields(_schema, frame.present, buf + KEYFRAME_HEADER_SIZE,
+                                        len - KEYFRAME_HEADER_SIZE, frame.raw);
+                if (n == 0 && frame.present != 0) return DecodeStatus::Malformed;
+                if (KEYFRAME_HEADER_SIZE + n != len) return DecodeStatus::Malformed;
+                remember(frame);
+                frame.toValues(_schema, out);
+                return DecodeStatus::Ok;
+            }
+
+            case FRAME_DELTA: {
+                if (len < DELTA_HEADER_SIZE) return DecodeStatus::Malformed;
+                const RawFrame* base = find(buf[2]);
+                if (!base) return DecodeStatus::NeedResync;
+
+                RawFrame frame = *base;
+                frame.seq = buf[1];
+                uint16_t changed = (uint16_t)(buf[3] | (buf[4] << 8));
+                if (changed & ~frame.present) return DecodeStatus::Malformed;
+
+                size_t offset = DELTA_HEADER_SIZE;
+                for (uint8_t i = 0; i < _schema.field_count; i++) {
+                    if (!(changed & (1u << i))) continue;
+                    uint32_t zz = 0;
+                    size_t n = readVarint(buf + offset, len - offset, &zz);
+                    if (n == 0) return DecodeStatus::Malformed;
+                    offset += n;
+                    frame.raw[i] = applyDelta(_schema.fields[i].type, frame.raw[i], zz);
+                }
+                if (offset != len) return DecodeStatus::Malformed;
+                remember(frame);
+                frame.toValues(_schema, out);
+                return DecodeStatus::Ok;
+            }
+        }
+        return DecodeStatus::Malformed;
+    }
+
+    // Forget all history (after requesting a resync)
+    void reset() { _count = 0; }
+
+private:
+    const MessageSchema::Schema& _schema;
+    RawFrame _history[HISTORY];
+    uint8_t _head = 0;
+    uint8_t _count = 0;
+
+    const RawFrame* find(uint8_t seq) const {
+        for (uint8_t k = 0; k < _count; k++) {
+            const RawFrame& f = _history[(_head + HISTORY - 1 - k) % HISTORY];
+            if (f.seq == seq) return &f;
+        }
+        return nullptr;
+    }
+
+    void remember(const RawFrame& frame) {
+        _history[_head] = frame;
+        _head = (_head + 1) % HISTORY;
+        if (_count < HISTORY) _count++;
+    }
+};
+
+} // namespace TelemetryCodec
@@ -0,0 +1,144 @@
+#include "tx_scheduler.h"
+#include <cstring>
+
+static constexpr uint8_t sumDepths(uint8_t c = 0) {
+    return c >= TxScheduler::CLASS_COUNT ? 0 : TxScheduler::CONFIG[c].depth + sumDepths(c + 1);
+}
+static_assert(sumDepths() == TxScheduler::TOTAL_SLOTS, "TOTAL_SLOTS must match CONFIG depths");
+
+bool TxScheduler::begin() {
+    uint8_t base = 0;
+    for (uint8_t c = 0; c < CLASS_COUNT; c++) {
+        _rings[c].base = base;
+        _rings[c].head = 0;
+        _rings[c].count = 0;
+        base += CONFIG[c].depth;
+    }
+    if (!_mutex) _mutex = xSemaphoreCreateMutex();
+    if (!_signal) _signal = xSemaphoreCreateBinary();
+    return _mutex && _signal;
+}
+
+void TxScheduler::lock() const {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+}
+
+void TxScheduler::unlock() const {
+    xSemaphoreGive(_mutex);
+}
+
+TxScheduler::Result TxScheduler::enqueue(TxClass cls, const LoRaWANTxMsg& msg) {
+    uint8_t c = (uint8_t)cls;
+    if (c >= CLASS_COUNT) return Result::Full;
+    const ClassConfig& cfg = CONFIG[c];
+    Result result = Result::Queued;
+
+    lock();
+    Ring& ring = _rings[c];
+    if (ring.count >= cfg.depth) {
+        if (cfg.policy == Policy::Reject) {
+            unlock();
+            return Result::Full;
+        }
+        if (cfg.policy == Policy::Replace) {
+            // Overwrite the newest queued frame in place
+            uint8_t newest = (ring.head + ring.count - 1) % cfg.depth;
+            _slots[ring.base + newest] = msg;
+            unlock();
+            return Result::Replaced;
+        }
+        // DropOldest
+        ring.head = (ring.head + 1) % cfg.depth;
+        ring.count--;
+        _dropped++;
+        result = Result::Replaced;
+    }
+    uint8_t tail = (ring.head + ring.count) % cfg.depth;
+    _slots[ring.base + tail] = msg;
+    ring.count++;
+    unlock();
+
+    xSemaphoreGive(_signal);
+    return result;
+}
+
+bool TxScheduler::popLocked(LoRaWANTxMsg* out, TxClass* cls, uint8_t allowedMask) {
+    for (uint8_t c = 0; c < CLASS_COUNT; c++) {
+        Ring& ring = _rings[c];
+        if (ring.count == 0 || !(allowedMask & (1u << c))) continue;
+        *out = _slots[ring.base + ring.head];
+        ring.head = (ring.head + 1) % CONFIG[c].depth;
+        ring.count--;
+        if (cls) *cls = (TxClass)c;
+        _inFlight = true;
+        return true;
+    }
+    return false;
+}
+
+bool TxScheduler::dequeue(LoRaWANTxMsg* out, TxClass* cls, TickType_t waitTicks, uint8_t allowedMask) {
+    lock();
+    bool found = popLocked(out, cls, allowedMask);
+    unlock();
+    if (found) return true;
+
+    // Empty: wait for a producer signal (may be stale; re-check once)
+    if (xSemaphoreTake(_signal, waitTicks) != pdTRUE) return false;
+    lock();
+    found = popLocked(out, cls, allowedMask);
+    unlock();
+    return found;
+}
+
+void TxScheduler::clear(TxClass cls) {
+    uint8_t c = (uint8_t)cls;
+    if (c >= CLASS_COUNT) return;
+    lock();
+    _rings[c].head = 0;
+    _rings[c].count = 0;
+    unlock();
+}
+
+void TxScheduler::complete() {
+    lock();
+    _inFlight = false;
+    unlock();
+}
+
+bool TxScheduler::idle() const {
+    lock();
+    bool idle = !_inFlight;
+    for (uint8_t c = 0; c < CLASS_COUNT; c++) idle = idle && _rings[c].count == 0;
+    unlock();
+    return idle;
+}
+
+uint8_t TxScheduler::pending(TxClass cls) const {
+    uint8_t c = (uint8_t)cls;
+    if (c >= CLASS_COUNT) return 0;
+    lock();
+    uint8_t n = _rings[c].count;
+    unlock();
+    return n;
+}
+
+uint8_t TxScheduler::pendingTotal() const {
+    uint8_t n = 0;
+    lock();
+    for (uint8_t c = 0; c < CLASS_COUNT; c++) n += _rings[c].count;
+    unlock();
+    return n;
+}
+
+const char* TxScheduler::className(TxClass cls) {
+    switch (cls) {
+        case TxClass::OtaAck:       return "ota_ack";
+        case TxClass::CmdAck:       return "cmd_ack";
+        case TxClass::StateChange:  return "state";
+        case TxClass::Registration: return "reg";
+        case TxClass::Telemetry:    return "telemetry";
+        case TxClass::Diagnostics:  return "diag";
+        case TxClass::Backfill:     return "backfill";
+        default:                    return "?";
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "lorawan_messages.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// =============================================================================
+// TX Scheduler: prioritised uplink classes for the radio task
+// =============================================================================
+// Replaces the single FIFO txQueue. Each traffic class has its own bounded
+// slot ring; the radio task always sends from the highest-priority non-empty
+// class, so OTA and command ACKs never wait behind bulk data.
+//
+// Per-class policy when a frame is enqueued:
+//   Replace    - at most one frame; a newer frame replaces the queued one
+//                (telemetry, diagnostics: only the latest value matters)
+//   DropOldest - full ring drops its oldest frame (OTA progress: the newest
+//                ACK supersedes older ones)
+//   Reject     - full ring rejects the new frame; producer keeps it and
+//                retries (state changes stay in the rules engine queue,
+//                backfill records in the reading store)
+//
+// Thread-safe: producers on any task, one consumer (radio task). Host tests
+// drive it through the FreeRTOS stubs.
+// =============================================================================
+
+enum class TxClass : uint8_t {
+    OtaAck = 0,      // fPort 8: highest priority
+    CmdAck,          // fPort 4
+    StateChange,     // fPort 3
+    Registration,    // fPort 1
+    Telemetry,       // fPort 2
+    Diagnostics,     // fPort 6/7
+    Backfill,        // fPort 9: stored readings after an outage, lowest priority
+    Count
+};
+
+class TxScheduler {
+public:
+    enum class Policy : uint8_t { Replace, DropOldest, Reject };
+
+    enum class Result : uint8_t {
+        Queued,
+        Replaced,     // Coalesced with (or displaced) an older queued frame
+        Full          // Rejected; nothing changed
+    };
+
+    static constexpr uint8_t CLASS_COUNT = (uint8_t)TxClass::Count;
+
+    struct ClassConfig {
+        uint8_t depth;
+        Policy policy;
+    };
+
+    // Slot budget per class (order = priority)
+    static constexpr ClassConfig CONFIG[CLASS_COUNT] = {
+        {2, Policy::DropOldest},   // OtaAck
+        {4, Policy::Reject},       // CmdAck
+        {2, Policy::Reject},       // StateChange
+        {8, Policy::Reject},       // Registration
+        {1, Policy::Replace},      // Telemetry
+        {1, Policy::Replace},      // Diagnostics
+        {1, Policy::Reject},       // Backfill
+    };
+    static constexpr uint8_t TOTAL_SLOTS = 2 + 4 + 2 + 8 + 1 + 1 + 1;
+
+    /** Create mutex and wake signal. Call once before use. */
+    bool begin();
+
+    /** Enqueue a frame in its class; applies the class policy. */
+    Result enqueue(TxClass cls, const LoRaWANTxMsg& msg);
+
+    static constexpr uint8_t ALL_CLASSES = (uint8_t)((1u << CLASS_COUNT) - 1);
+
+    /**
+     * Pop the highest-priority frame among the classes in allowedMask (bit N =
+     * TxClass N). Frames of other classes stay queued. Blocks up to waitTicks
+     * for a frame. Returns false on timeout.
+     */
+    bool dequeue(LoRaWANTxMsg* out, TxClass* cls, TickType_t waitTicks,
+                 uint8_t allowedMask = ALL_CLASSES);
+
+    /** The frame from the last dequeue() has been sent (or dropped). */
+    void complete();
+
+    /** No frame queued and none dequeued without complete(). */
+    bool idle() const;
+
+    /** Drop all queued frames of one class (e.g. stale registration frames before a resend). */
+    void clear(TxClass cls);
+
+    uint8_t pending(TxClass cls) const;
+    uint8_t pendingTotal() const;
+    uint32_t droppedCount() const { return _dropped; }
+
+    static const char* className(TxClass cls);
+
+private:
+    struct Ring {
+        uint8_t base;    // First slot in _slots
+        uint8_t head;    // Oldest frame (offset from base)
+        uint8_t count;
+    };
+
+    LoRaWANTxMsg _slots[TOTAL_SLOTS];
+    Ring _rings[CLASS_COUNT] = {};
+    SemaphoreHandle_t _mutex = nullptr;
+    SemaphoreHandle_t _signal = nullptr;
+    volatile uint32_t _dropped = 0;
+    bool _inFlight = false;
+
+    bool popLocked(LoRaWANTxMsg* out, TxClass* cls, uint8_t allowedMask);
+    void lock() const;
+    void unlock() const;
+};
@@ -0,0 +1,163 @@
+#include "ulp_pulse_counter.h"
+#include "core_logger.h"
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
+#include <soc/rtc_cntl_reg.h>
+#include <soc/rtc_io_reg.h>
+#include <string.h>
+#if CONFIG_IDF_TARGET_ESP32
+#include <esp32/ulp.h>
+#define ULP_WAKE_READY_BIT RTC_CNTL_RDY_FOR_WAKEUP_S
+#else
+#include <esp32s3/ulp.h>
+#define ULP_WAKE_READY_BIT RTC_CNTL_MAIN_STATE_IN_IDLE_S
+#endif
+
+namespace {
+
+// RTC slow memory word offsets; the program follows the data
+enum : uint32_t {
+    SLOT_WAKE_LEFT = 0,    // ULP: pulses left before waking the SoC
+    SLOT_MAGIC = 1,        // CPU: program loaded
+    SLOT_CHANNELS = 4,
+    CH_GPIO = 0,           // CPU: GPIO + 1, 0 = free
+    CH_EDGES = 1,          // ULP: falling edges, wraps at 16 bits
+    CH_LEVEL = 2,          // ULP: pin level at the previous sample
+    CH_TAKEN = 3,          // CPU: edge count at the last take()
+    CH_WORDS = 4,
+    PROGRAM_ADDR = 16,
+};
+
+constexpr uint32_t PROGRAM_MAGIC = 0x554C5002;   // "ULP" + layout version
+constexpr size_t CHANNEL_INSNS = 20;
+
+inline uint32_t channelBase(uint8_t channel) { return SLOT_CHANNELS + channel * CH_WORDS; }
+inline uint16_t slot(uint32_t index) { return (uint16_t)(RTC_SLOW_MEM[index] & 0xFFFF); }
+
+} // namespace
+
+bool UlpPulseCounter::begin(uint8_t gpio) {
+    gpio_num_t pin = (gpio_num_t)gpio;
+    if (!rtc_gpio_is_valid_gpio(pin)) {
+        LOGW("ULP", "GPIO %u is not an RTC GPIO", (unsigned)gpio);
+        return false;
+    }
+
+    // Pin stays configured (and pulled up) through deep sleep
+    rtc_gpio_hold_dis(pin);
+    rtc_gpio_init(pin);
+    rtc_gpio_set_direction(pin, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pulldown_dis(pin);
+    rtc_gpio_pullup_en(pin);
+    rtc_gpio_hold_en(pin);
+
+    bool loaded = RTC_SLOW_MEM[SLOT_MAGIC] == PROGRAM_MAGIC;
+    if (!loaded) {
+        memset((void*)&RTC_SLOW_MEM[0], 0, PROGRAM_ADDR * sizeof(RTC_SLOW_MEM[0]));
+    }
+
+    // Woken from deep sleep or restarted: the program is still counting this pin
+    int8_t freeChannel = -1;
+    for (uint8_t c = 0; c < MAX_CHANNELS; c++) {
+        uint32_t base = channelBase(c);
+        if (loaded && RTC_SLOW_MEM[base + CH_GPIO] == (uint32_t)gpio + 1) {
+            _channel = c;
+            LOGI("ULP", "Pulse counter resumed on GPIO %u (%u pulses pending)", (unsigned)gpio,
+                 (unsigned)(uint16_t)(slot(base + CH_EDGES) - slot(base + CH_TAKEN)));
+            return true;
+        }
+        if (freeChannel < 0 && RTC_SLOW_MEM[base + CH_GPIO] == 0) freeChannel = c;
+    }
+    if (freeChannel < 0) {
+        LOGW("ULP", "All %u ULP channels in use", (unsigned)MAX_CHANNELS);
+        return false;
+    }
+
+    uint32_t base = channelBase(freeChannel);
+    RTC_SLOW_MEM[base + CH_EDGES] = 0;
+    RTC_SLOW_MEM[base + CH_LEVEL] = 1;              // Idle high (pulled up)
+    RTC_SLOW_MEM[base + CH_TAKEN] = 0;
+    RTC_SLOW_MEM[base + CH_GPIO] = (uint32_t)gpio + 1;
+    if (!loadProgram()) {
+        RTC_SLOW_MEM[base + CH_GPIO] = 0;
+        LOGE("ULP", "Failed to start pulse counter program");
+        return false;
+    }
+    _channel = freeChannel;
+    LOGI("ULP", "Pulse counter started on GPIO %u (channel %d, %lu us sample period)",
+         (unsigned)gpio, (int)freeChannel, (unsigned long)_samplePeriodUs);
+    return true;
+}
+
+// One block per used channel, then HALT. Labels are the channel number + 1.
+bool UlpPulseCounter::loadProgram() {
+    ulp_insn_t program[MAX_CHANNELS * CHANNEL_INSNS + 1];
+    size_t count = 0;
+    for (uint8_t c = 0; c < MAX_CHANNELS; c++) {
+        uint32_t base = channelBase(c);
+        uint32_t gpioPlusOne = RTC_SLOW_MEM[base + CH_GPIO];
+        if (gpioPlusOne == 0) continue;
+        uint32_t inBit = RTC_GPIO_IN_NEXT_S + rtc_io_number_get((gpio_num_t)(gpioPlusOne - 1));
+        uint32_t next = c + 1;
+        const ulp_insn_t block[] = {
+            I_MOVI(R3, base),                           // R3 = channel slots
+            I_RD_REG(RTC_GPIO_IN_REG, inBit, inBit),    // R0 = pin level
+            I_LD(R1, R3, CH_LEVEL),
+            I_ST(R0, R3, CH_LEVEL),
+            I_SUBR(R0, R1, R0),                         // previous - level: 1 on a falling edge
+            M_BL(next, 1),
+            M_BGE(next, 2),
+            I_LD(R0, R3, CH_EDGES),
+            I_ADDI(R0, R0, 1),
+            I_ST(R0, R3, CH_EDGES),
+            I_MOVI(R3, 0),
+            I_LD(R0, R3, SLOT_WAKE_LEFT),               // 0 = disarmed
+            M_BL(next, 1),
+            I_SUBI(R0, R0, 1),
+            I_ST(R0, R3, SLOT_WAKE_LEFT),
+            M_BGE(next, 1),
+            I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, ULP_WAKE_READY_BIT, ULP_WAKE_READY_BIT),
+            M_BL(next, 1),                              // SoC is awake already
+            I_WAKE(),
+            M_LABEL(next),
+        };
+        static_assert(sizeof(block) / sizeof(block[0]) == CHANNEL_INSNS, "CHANNEL_INSNS out of date");
+        memcpy(&program[count], block, sizeof(block));
+        count += CHANNEL_INSNS;
+    }
+    const ulp_insn_t halt[] = { I_HALT() };
+    memcpy(&program[count], halt, sizeof(halt));
+    count++;
+
+    // A program already running finishes its pass before the code changes
+    if (RTC_SLOW_MEM[SLOT_MAGIC] == PROGRAM_MAGIC) {
+        ulp_timer_stop();
+        delay(1);
+    }
+    if (ulp_process_macros_and_load(PROGRAM_ADDR, program, &count) != ESP_OK ||
+        ulp_set_wakeup_period(0, _samplePeriodUs) != ESP_OK ||
+        ulp_run(PROGRAM_ADDR) != ESP_OK) {
+        return false;
+    }
+    RTC_SLOW_MEM[SLOT_MAGIC] = PROGRAM_MAGIC;
+    return true;
+}
+
+uint32_t UlpPulseCounter::take() {
+    if (_channel < 0) return 0;
+    // Only the ULP writes the edge count, so no edge is lost between the
+    // read and the bookkeeping; the 16-bit difference absorbs the wrap
+    uint32_t base = channelBase(_channel);
+    uint16_t edges = slot(base + CH_EDGES);
+    uint16_t delta = (uint16_t)(edges - slot(base + CH_TAKEN));
+    RTC_SLOW_MEM[base + CH_TAKEN] = edges;
+    return delta;
+}
+
+void UlpPulseCounter::armWake(uint16_t pulses) {
+    if (_channel < 0) return;
+    RTC_SLOW_MEM[SLOT_WAKE_LEFT] = (pulses == 0 || pulses > WAKE_GUARD_PULSES) ? WAKE_GUARD_PULSES : pulses;
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);   // RTC IO pull-up
+    esp_sleep_enable_ulp_wakeup();
+}
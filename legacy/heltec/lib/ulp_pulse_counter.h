@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pulse_source.h"
+#include <stdint.h>
+
+// =============================================================================
+// ULP Pulse Counter: counts falling edges on RTC GPIOs in any power state
+// =============================================================================
+// A small ULP-FSM program samples each counted pin every samplePeriodUs and
+// counts falling edges into RTC slow memory. The ULP runs independently of
+// the main CPU, so counting carries on through deep sleep and across the
+// reset that ends it; the app takes the counts after each wake.
+//
+// One program serves up to MAX_CHANNELS pins (one instance per pin). It is
+// reloaded when a pin is added; the counts in RTC memory are kept.
+//
+// RTC slow memory (16-bit data words, program after them):
+// [0] pulses left before waking the SoC, any channel (0 = disarmed)
+// [1] program magic (main CPU, 32 bits)
+// [4 + 4c] channel c: GPIO + 1 (0 = free), falling edges (ULP, wraps at
+//          16 bits), previous pin level, edge count at the last take()
+//
+// The counters are 16 bits wide. Before sleeping the app arms a wake after
+// wakeAfterPulses (capped at WAKE_GUARD_PULSES), so the CPU wakes to drain
+// the counters long before they can wrap.
+// =============================================================================
+
+class UlpPulseCounter : public IPulseSource {
+public:
+    static constexpr uint8_t MAX_CHANNELS = 2;
+    static constexpr uint16_t WAKE_GUARD_PULSES = 30000;
+    static constexpr uint32_t DEFAULT_SAMPLE_PERIOD_US = 1000;  // Up to ~500 Hz input
+
+    explicit UlpPulseCounter(uint32_t samplePeriodUs = DEFAULT_SAMPLE_PERIOD_US)
+        : _samplePeriodUs(samplePeriodUs) {}
+
+    /**
+     * Start counting on gpio (must be an RTC GPIO). After a deep-sleep wake
+     * the running program and its count are kept; otherwise the pin gets a
+     * free channel with the count at zero.
+     */
+    bool begin(uint8_t gpio) override;
+
+    /** Edges counted since the last take(); resets the count. */
+    uint32_t take() override;
+
+    /**
+     * Arm the ULP to wake the SoC after pulses more edges on any channel
+     * (0 = only the overflow guard) and enable ULP wakeup.
+     */
+    void armWake(uint16_t pulses);
+
+    void prepareForSleep(uint16_t wakeAfterPulses) override { armWake(wakeAfterPulses); }
+    bool countsInDeepSleep() const override { return true; }
+    const char* name() const override { return "ulp"; }
+
+    bool running() const { return _channel >= 0; }
+
+private:
+    uint32_t _samplePeriodUs;
+    int8_t _channel = -1;
+
+    bool loadProgram();
+};
@@ -8,11 +8,16 @@
 #include "lib/hal_display.h"
 #include "lib/hal_battery.h"
 #include "lib/hal_persistence.h"
+#include "lib/flash_journal.h"
+#include "lib/persistent_record.h"
+#include "lib/duty_cycle.h"
 #include "lib/svc_ui.h"
 #include "lib/message_schema.h"
 #include "lib/command_translator.h"
 #include "lib/protocol_constants.h"
 #include "lib/telemetry_keys.h"
+#include "lib/telemetry_codec.h"
+#include "lib/reading_store.h"
 #include "lib/error_reporter.h"
 
 // Sensors and edge rules (before device_setup.h which uses them)
@@ -37,6 +42,8 @@
 #include "lib/ui_text_element.h"
 #include "lib/ui_icon_element.h"
 
+// Offline backlog across deep sleep (RTC slow memory; see runDutyCycle)
+RTC_DATA_ATTR static ReadingStore::SavedState g_rtcBacklog;
 
 class RemoteApplicationImpl : public ErrorReporter::IErrorReporter {
 public:
@@ -60,6 +67,12 @@ private:
     std::unique_ptr<IBatteryHal> batteryHal;
     std::unique_ptr<IPersistenceHal> persistenceHal;
 
+    // Flash journal behind persistenceHal when the partition table has one
+    static constexpr const char* JOURNAL_PARTITION = "journal";
+    PartitionFlashRegion _journalFlash;
+    FlashJournal _journal;
+    std::unique_ptr<IPersistenceHal> _nvsHal;
+
     // Communication (radio task)
     RadioTaskState* _radioState = nullptr;
     RegistrationManager registrationManager;
@@ -71,10 +84,31 @@ private:
     SensorManager sensorManager;
     std::shared_ptr<YFS201WaterFlowSensor> waterFlowSensor;
 
-    // Edge Rules Engine
-    MessageSchema::Schema _schema;
+    // Edge Rules Engine; the schema is a compile-time constant in flash
+    const MessageSchema::Schema& _schema = buildDeviceSchema();
     std::unique_ptr<EdgeRules::EdgeRulesEngine> _rulesEngine;
 
+    // Telemetry keyframe/delta encoder (baseline advances when the radio reports delivery)
+    TelemetryCodec::TelemetryCompressor _telemetryCompressor{
+        _schema, config.communication.lorawan.useConfirmedUplinks};
+
+    // Sense task output: latest value per field (rule input) and the report
+    // window telemetry sends next (delta fields summed since the last send)
+    Readings _latest{_schema};
+    Readings _report{_schema};
+    uint32_t _txCompleteSeen = 0;
+
+    // Report windows closed while offline, sent as backfill after reconnect
+    std::unique_ptr<ReadingStore> _backlog;
+    static constexpr uint32_t BACKFILL_INTERVAL_MS = 15000;
+    static constexpr uint32_t BACKFILL_TIMEOUT_MS = 120000;      // No TX result: resend the batch
+    static constexpr uint8_t BACKFILL_AIRTIME_PERCENT = 50;      // Live traffic keeps the rest
+
+    // Deep-sleep duty cycle (config.power): run() samples and reports once
+    // per wake in place of the sense/lorawan_tx tasks, then sleeps
+    DutyCycle _dutyCycle;
+    bool _cycleReported = false;
+
     // OTA over LoRaWAN (fPort 40/41/42 downlink, fPort 8 uplink progress)
     OtaReceiver::OtaReceiver _ota;
 
@@ -85,18 +119,15 @@ private:
     std::shared_ptr<BatteryIconElement> batteryElement;
     std::shared_ptr<TextElement> statusTextElement;
 
-    // Error counters (2-char keys: na,jf,sf, sr,dr,dp, cs,wf,tm, mm,qf,ts, rf,cv,pf). Daily reset.
-    uint32_t _noAckCount = 0;
-    uint32_t _joinFailCount = 0;
-    uint32_t _sendFailCount = 0;
-    uint32_t _errSr = 0, _errDr = 0, _errDp = 0;
-    uint32_t _errCs = 0, _errWf = 0, _errTm = 0;
-    uint32_t _errMm = 0, _errQf = 0, _errTs = 0;
-    uint32_t _errRf = 0, _errCv = 0, _errPf = 0;
-    uint32_t _lastResetMs = 0;
+    // Error counters, one record in "app_state". A no-ACK storm costs one
+    // write per interval; restarts and a sagging battery flush at once.
+    static constexpr uint32_t ERROR_WRITE_INTERVAL_MS = 60000;
+    static constexpr uint32_t LOW_SUPPLY_FLUSH_MV = 3350;      // Just above BatteryMonitor's empty
+    PersistentRecord<ErrorReporter::ErrorCounters> _errors{"app_state", "errors", 1, ERROR_WRITE_INTERVAL_MS};
+    RecordWriter _records;
+    volatile bool _lowSupply = false;
     uint32_t _lastTxMs = 0;
 
-    bool _persistErrorCount = false;
     char _notifyCmd[24] = {0};
     bool _lastTxWasNoAck = false;
     bool _wasConnected = false;
@@ -113,12 +144,22 @@ private:
     // Post-join sequence: 0=none, 1=send diagnostics, 2=send telemetry, 3=done
     uint8_t _postJoinStep = 0;
 
+    // Schema slots the app writes itself (test data, post-join report, system
+    // readings); bound in setupSensors() once the schema is built
+    FieldSlot _pdField{TelemetryKeys::PulseDelta};
+    FieldSlot _tvField{TelemetryKeys::TotalVolume};
+    FieldSlot _bpField{TelemetryKeys::BatteryPercent};
+    FieldSlot _ecField{TelemetryKeys::ErrorCount};
+    FieldSlot _tsrField{TelemetryKeys::TimeSinceReset};
+
     // Test mode state (schema-aligned: pd=pulse delta, tv=total volume L)
     float _testPulseDelta = 5.0f;
     float _testVolume = 1000.0f;
 
     // Message protocol methods
-    void sendTelemetryJson(const std::vector<SensorReading>& readings);
+    void sendTelemetry(const Readings& readings, bool snapshot = false);  // Packed binary telemetry (fPort 2)
+    void pollTxFeedback();
+    void sendBackfill(uint32_t nowMs);  // Stored readings, batched (fPort 9)
     void sendCommandAck(uint8_t cmdPort, bool success);  // Send command ACK (fPort 4)
     void sendDiagnostics();  // Send device diagnostics/status (fPort 6)
 
@@ -127,7 +168,11 @@ private:
 
     void setupUi();
     void setupSensors();
-    void generateTestData(std::vector<SensorReading>& readings, uint32_t nowMs);
+    void generateTestData(Readings& readings, uint32_t nowMs);
+    void addSystemReadings(Readings& readings);
+    void sampleSensors(uint32_t nowMs);
+    void transmitReport(uint32_t nowMs);
+    void runDutyCycle(uint32_t nowMs);
 };
 
 RemoteApplicationImpl::RemoteApplicationImpl() :
@@ -136,34 +181,7 @@ RemoteApplicationImpl::RemoteApplicationImpl() :
 }
 
 void RemoteApplicationImpl::reportError(ErrorReporter::Category cat, uint8_t subCode) {
-    switch (cat) {
-        case ErrorReporter::Category::Comm:
-            if (subCode == ErrorReporter::Comm::NoAck) _noAckCount++;
-            else if (subCode == ErrorReporter::Comm::JoinFail) _joinFailCount++;
-            else if (subCode == ErrorReporter::Comm::SendFail) _sendFailCount++;
-            break;
-        case ErrorReporter::Category::Hw:
-            if (subCode == ErrorReporter::Hw::SensorRead) _errSr++;
-            else if (subCode == ErrorReporter::Hw::Driver) _errDr++;
-            else if (subCode == ErrorReporter::Hw::Display) _errDp++;
-            break;
-        case ErrorReporter::Category::Ota:
-            if (subCode == ErrorReporter::Ota::Crc) _errCs++;
-            else if (subCode == ErrorReporter::Ota::Write) _errWf++;
-            else if (subCode == ErrorReporter::Ota::Timeout) _errTm++;
-            break;
-        case ErrorReporter::Category::Sys:
-            if (subCode == ErrorReporter::Sys::Memory) _errMm++;
-            else if (subCode == ErrorReporter::Sys::QueueFull) _errQf++;
-            else if (subCode == ErrorReporter::Sys::Task) _errTs++;
-            break;
-        case ErrorReporter::Category::Logic:
-            if (subCode == ErrorReporter::Logic::Rule) _errRf++;
-            else if (subCode == ErrorReporter::Logic::Config) _errCv++;
-            else if (subCode == ErrorReporter::Logic::Persistence) _errPf++;
-            break;
-    }
-    _persistErrorCount = true;
+    _errors.update([&](ErrorReporter::ErrorCounters& c) { c.increment(cat, subCode); });
     if (cat == ErrorReporter::Category::Comm && (subCode == ErrorReporter::Comm::NoAck || subCode == ErrorReporter::Comm::SendFail)) {
         _notifyTxFailPending = true;
     }
@@ -173,9 +191,19 @@ void RemoteApplicationImpl::initialize() {
     // ---
     // Critical: HALs must be created FIRST
     // ---
-    persistenceHal = std::make_unique<FlashPersistenceHal>();
+    // Persistent state is appended to the flash journal when the partition
+    // table has one (serial flash with partitions.csv); NVS still answers for
+    // keys written before the journal existed. Older layouts stay on NVS.
+    _nvsHal = std::make_unique<FlashPersistenceHal>();
+    bool journal = _journalFlash.begin(JOURNAL_PARTITION) && _journal.begin(&_journalFlash);
+    if (journal) {
+        persistenceHal = std::make_unique<JournalPersistenceHal>(_journal, _nvsHal.get());
+    } else {
+        persistenceHal = std::move(_nvsHal);
+    }
 
     coreSystem.init(config);
+    if (!journal) LOGW("Remote", "No '%s' partition, persistence on NVS", JOURNAL_PARTITION);
 
     // Initialize display immediately after hardware setup to minimize delay
     LOGI("Remote", "Creating display HAL");
@@ -193,24 +221,25 @@ void RemoteApplicationImpl::initialize() {
         LOGD("System", "Debug mode is ON. Log level set to DEBUG.");
     }
 
-    // Load persistent state (error counters: ec_na, ec_jf, ec_sf, ec_sr, ...)
+    // Load persistent state. Error counters stored as separate ec_* keys by
+    // older firmware are read once and rewritten as one record.
+    bool haveErrors = _errors.load(*persistenceHal);
     persistenceHal->begin("app_state");
-    _noAckCount = persistenceHal->loadU32("ec_na", 0);
-    _joinFailCount = persistenceHal->loadU32("ec_jf", 0);
-    _sendFailCount = persistenceHal->loadU32("ec_sf", 0);
-    _errSr = persistenceHal->loadU32("ec_sr", 0);
-    _errDr = persistenceHal->loadU32("ec_dr", 0);
-    _errDp = persistenceHal->loadU32("ec_dp", 0);
-    _errCs = persistenceHal->loadU32("ec_cs", 0);
-    _errWf = persistenceHal->loadU32("ec_wf", 0);
-    _errTm = persistenceHal->loadU32("ec_tm", 0);
-    _errMm = persistenceHal->loadU32("ec_mm", 0);
-    _errQf = persistenceHal->loadU32("ec_qf", 0);
-    _errTs = persistenceHal->loadU32("ec_ts", 0);
-    _errRf = persistenceHal->loadU32("ec_rf", 0);
-    _errCv = persistenceHal->loadU32("ec_cv", 0);
-    _errPf = persistenceHal->loadU32("ec_pf", 0);
-    _lastResetMs = persistenceHal->loadU32("lastResetMs", 0);
+    if (!haveErrors) {
+        using ErrorReporter::ErrorCounters;
+        static const char* const legacyKeys[ErrorCounters::CATEGORIES][ErrorCounters::CODES] = {
+            {"ec_na", "ec_jf", "ec_sf"}, {"ec_sr", "ec_dr", "ec_dp"}, {"ec_cs", "ec_wf", "ec_tm"},
+            {"ec_mm", "ec_qf", "ec_ts"}, {"ec_rf", "ec_cv", "ec_pf"},
+        };
+        _errors.update([&](ErrorCounters& c) {
+            for (uint8_t cat = 0; cat < ErrorCounters::CATEGORIES; cat++) {
+                for (uint8_t sub = 0; sub < ErrorCounters::CODES; sub++) {
+                    c.count[cat][sub] = persistenceHal->loadU32(legacyKeys[cat][sub], 0);
+                }
+            }
+            c.lastResetMs = persistenceHal->loadU32("lastResetMs", 0);
+        });
+    }
     // TX interval: persisted across reboots; default 60s if absent (10s–3600s valid)
     constexpr uint32_t TX_INTERVAL_DEFAULT_MS = 60000;
     constexpr uint32_t TX_INTERVAL_MIN_MS = 10000;
@@ -225,6 +254,28 @@ void RemoteApplicationImpl::initialize() {
     }
     persistenceHal->end();
 
+    _records.begin(persistenceHal.get());
+    _records.add(&_errors);
+
+    // lastResetMs is on CoreSystem::clockMs(), which deep sleep keeps but a
+    // power cycle restarts: start the 24 h window again instead of wrapping
+    uint32_t clockMs = CoreSystem::clockMs();
+    if (_errors.get().lastResetMs > clockMs) {
+        _errors.update([&](ErrorReporter::ErrorCounters& c) { c.lastResetMs = clockMs; });
+    }
+
+    // Deep sleep: one cycle per TX interval; the flow meter counts on the
+    // ULP so pulses are not lost while asleep
+    CoreSystem::WakeCause wake = CoreSystem::wakeCause();
+    _dutyCycle.begin(config.power, config.communication.lorawan.txIntervalMs,
+                     wake == CoreSystem::WakeCause::Button);
+    if (_dutyCycle.enabled()) {
+        sensorConfig.waterFlow.counter = SensorConfig::PulseBackend::Ulp;
+        LOGI("Remote", "Deep-sleep duty cycle on (wake: %s)", CoreSystem::wakeCauseName(wake));
+        // Only a button wake means someone is looking at the screen
+        if (wake != CoreSystem::WakeCause::Button) displayHal->displayOff();
+    }
+
     // Registration state will be restored after RegistrationManager is wired
 
     LOGI("Remote", "Initializing battery HAL");
@@ -250,25 +301,27 @@ void RemoteApplicationImpl::initialize() {
     }
     LOGI("Remote", "Radio task started");
 
-    // OTA receiver: send via radio task TX queue; report OTA errors (cs/wf/tm) to this
-    _ota.setTxQueue(_radioState->txQueue);
+    // OTA receiver: send via radio task TX scheduler; report OTA errors (cs/wf/tm) to this
+    _ota.setTxScheduler(_radioState->tx);
     _ota.setErrorReporter(this);
 
     setupUi();
     LOGI("Remote", "UI setup complete");
 
+    // Message schema (fields and controls) is built at compile time; sensors bind to it
+    LOGI("Remote", "Schema: %d fields, %d controls, version %d",
+         _schema.field_count, _schema.control_count, _schema.version);
+
     setupSensors();
     LOGI("Remote", "Sensors setup complete");
+    if (_dutyCycle.enabled() && waterFlowSensor && !waterFlowSensor->countsInDeepSleep()) {
+        LOGW("Remote", "Flow meter cannot count in deep sleep; pulses while asleep are lost");
+    }
 
-    // Build message schema (defines fields and controls)
-    _schema = buildDeviceSchema();
-
-    LOGI("Remote", "Schema built: %d fields, %d controls, version %d",
-         _schema.field_count, _schema.control_count, _schema.version);
-
-    // RegistrationManager: send via radio task TX queue
-    registrationManager.setTxQueue(_radioState->txQueue);
-    registrationManager.setSchema(_schema);
+    // RegistrationManager: send via radio task TX scheduler
+    registrationManager.setTxScheduler(_radioState->tx);
+    registrationManager.setPayloadBudget(&_radioState->budget);
+    registrationManager.setRegistrationText(DEVICE_REGISTRATION);
     registrationManager.setDeviceInfo(DEVICE_TYPE, FIRMWARE_VERSION);
     registrationManager.setPersistence(persistenceHal.get());
     registrationManager.restoreFromPersistence();
@@ -280,6 +333,13 @@ void RemoteApplicationImpl::initialize() {
     _rulesEngine = std::make_unique<EdgeRules::EdgeRulesEngine>(_schema, persistenceHal.get());
     _rulesEngine->loadFromFlash();
 
+    _backlog = std::make_unique<ReadingStore>(_schema, persistenceHal.get());
+    if (wake != CoreSystem::WakeCause::PowerOn && _backlog->restore(&g_rtcBacklog)) {
+        LOGI("Remote", "Backlog restored from RTC memory (%lu records)", (unsigned long)_backlog->records());
+    } else if (_backlog->load(CoreSystem::clockMs())) {
+        LOGI("Remote", "Backlog restored from flash (%lu records)", (unsigned long)_backlog->records());
+    }
+
     // Register control drivers (device-specific: lib drivers and/or integrations)
     registerDeviceControls(*_rulesEngine);
 
@@ -296,10 +356,13 @@ void RemoteApplicationImpl::initialize() {
     // Battery monitoring task
     scheduler.registerTask("battery", [this](CommonAppState& state){
         batteryHal->update(state.nowMs);
+        // Flushed from run(); 0 mV means no battery ADC
+        uint32_t mv = batteryHal->getVoltageMilliVolts();
+        _lowSupply = mv != 0 && mv < LOW_SUPPLY_FLUSH_MV;
     }, 1000);
     
-    // Persistence task for water flow sensor
-    if (sensorConfig.enableSensorSystem && sensorConfig.waterFlow.enabled) {
+    // Persistence task for water flow sensor (deep sleep saves before sleeping)
+    if (sensorConfig.enableSensorSystem && sensorConfig.waterFlow.enabled && !_dutyCycle.enabled()) {
         scheduler.registerTask("persistence", [this](CommonAppState& state){
             if (waterFlowSensor) {
                 waterFlowSensor->saveTotalVolume();
@@ -323,6 +386,7 @@ void RemoteApplicationImpl::initialize() {
             if (isJoined && !_wasConnected) {
                 _notifyConnected = true;
                 _joinAttempts = 0;
+                _telemetryCompressor.requestKeyframe();  // New session: server may have lost our baseline
             }
             if (!isJoined && _wasConnected) {
                 _notifyDisconnected = true;
@@ -378,70 +442,27 @@ void RemoteApplicationImpl::initialize() {
         }, 10);
     }
     
+    // Sense task: samples each sensor at its own rate and feeds the rules
+    // engine straight away, joined or not. Telemetry only consumes the samples.
+    uint32_t senseIntervalMs = sensorManager.minSampleIntervalMs();
+    if (sensorConfig.enableSensorSystem && !config.testModeEnabled && senseIntervalMs > 0 &&
+        !_dutyCycle.enabled()) {
+        scheduler.registerTask("sense", [this](CommonAppState& state){
+            sampleSensors(state.nowMs);
+        }, senseIntervalMs);
+    }
+
     // Sensor telemetry transmission task
-    if (sensorConfig.enableSensorSystem) {
+    if (sensorConfig.enableSensorSystem && !_dutyCycle.enabled()) {
         scheduler.registerTask("lorawan_tx", [this](CommonAppState& state){
-            if (!_radioState || !_radioState->joined) return;
-
-            if (registrationManager.getState() != RegistrationManager::State::Complete) {
-                LOGD("Remote", "Telemetry skipped - awaiting registration ACK from server");
-                return;
-            }
-
-            // Caller collects fresh data from services
-            std::vector<SensorReading> readings;
-
-            if (config.testModeEnabled) {
-                // Generate random test data
-                generateTestData(readings, state.nowMs);
-            } else {
-                // Use real sensor data: all sensors (lib + integrations) via SensorManager
-                readings = sensorManager.readAll();
-
-                // Append system state - all error counters and total (daily reset)
-                uint32_t errTotal = _noAckCount + _joinFailCount + _sendFailCount
-                    + _errSr + _errDr + _errDp + _errCs + _errWf + _errTm
-                    + _errMm + _errQf + _errTs + _errRf + _errCv + _errPf;
-                readings.push_back({ TelemetryKeys::ErrorNoAck, (float)_noAckCount, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorJoinFail, (float)_joinFailCount, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorSendFail, (float)_sendFailCount, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorSensorRead, (float)_errSr, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorDriver, (float)_errDr, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorDisplay, (float)_errDp, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorOtaCrc, (float)_errCs, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorOtaWrite, (float)_errWf, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorOtaTimeout, (float)_errTm, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorMemory, (float)_errMm, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorQueueFull, (float)_errQf, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorTask, (float)_errTs, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorRule, (float)_errRf, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorConfig, (float)_errCv, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorPersistence, (float)_errPf, state.nowMs });
-                readings.push_back({ TelemetryKeys::ErrorCount, (float)errTotal, state.nowMs });
-                uint32_t timeSinceResetSec = (state.nowMs - _lastResetMs) / 1000;
-                readings.push_back({
-                    TelemetryKeys::TimeSinceReset,
-                    (float)timeSinceResetSec,
-                    state.nowMs
-                });
-            }
-
-            // Send telemetry as JSON on fPort 2 (Phase 4 protocol)
-            if (!readings.empty()) {
-                sendTelemetryJson(readings);
-
-                // Evaluate edge rules after telemetry (skip when OTA active or test mode)
-                if (_rulesEngine && !readings.empty() && !config.testModeEnabled && !_ota.isActive()) {
-                    float fieldValues[16];
-                    uint8_t fieldCount = 0;
-                    for (const auto& reading : readings) {
-                        if (fieldCount >= 16) break;
-                        fieldValues[fieldCount++] = reading.value;
-                    }
-                    _rulesEngine->evaluate(fieldValues, fieldCount, state.nowMs);
-                }
-            }
+            transmitReport(state.nowMs);
         }, config.communication.lorawan.txIntervalMs);
+
+        scheduler.registerTask("backfill", [this](CommonAppState& state){
+            if (!_radioState || !_radioState->joined ||
+                registrationManager.getState() != RegistrationManager::State::Complete) return;
+            sendBackfill(CoreSystem::clockMs());
+        }, BACKFILL_INTERVAL_MS);
     }
 
     // State change transmission task - sends batched pending state changes on fPort 3
@@ -449,7 +470,7 @@ void RemoteApplicationImpl::initialize() {
         if (!_radioState || !_radioState->joined || registrationManager.getState() != RegistrationManager::State::Complete) return;
         if (!_rulesEngine || !_rulesEngine->hasPendingStateChange()) return;
 
-        const uint8_t maxPayload = 222;  // DR3 max
+        const uint8_t maxPayload = _radioState->budget.maxPayload();
         if (maxPayload < 11) return;  // Cannot send even one 11-byte event
 
         size_t max_events = maxPayload / 11;
@@ -462,21 +483,20 @@ void RemoteApplicationImpl::initialize() {
             LOGI("Remote", "Sending state change batch (%d bytes, %d events): %s",
                  (int)len, (int)num_events, _rulesEngine->stateChangeToText().c_str());
 
-            // Send via TX queue
-            if (_radioState && _radioState->txQueue) {
+            // Send via TX scheduler
+            if (_radioState && _radioState->tx) {
                 LoRaWANTxMsg msg;
                 msg.port = FPORT_STATE_CHANGE;
                 msg.len = len;
                 msg.confirmed = true;
                 memcpy(msg.payload, buffer, len);
                 
-                if (xQueueSend(_radioState->txQueue, &msg, 0) == pdTRUE) {
+                if (_radioState->tx->enqueue(TxClass::StateChange, msg) != TxScheduler::Result::Full) {
                     _rulesEngine->clearStateChangeBatch(num_events);
                     _rulesEngine->saveStateChangeQueueToFlash();
                     LOGI("Remote", "State change batch sent on fPort %d", FPORT_STATE_CHANGE);
                 } else {
-                    _errQf++;
-                    _persistErrorCount = true;
+                    reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::QueueFull);
                     LOGW("Remote", "Failed to send state change batch (queue full)");
                 }
             }
@@ -544,65 +564,47 @@ void RemoteApplicationImpl::setupUi() {
 }
 
 void RemoteApplicationImpl::setupSensors() {
-    if (!sensorConfig.enableSensorSystem) {
-        return;
+    // A field the schema does not define would never be reported; catch it
+    // here rather than evaluating rules against an empty slot
+    uint8_t unbound = 0;
+    for (FieldSlot* field : {&_pdField, &_tvField, &_bpField, &_ecField, &_tsrField}) {
+        if (!field->bind(_schema)) {
+            LOGE("Remote", "Field '%s' is not in the schema", field->key);
+            unbound++;
+        }
+    }
+
+    if (sensorConfig.enableSensorSystem) {
+        // Device-specific sensor setup (lib sensors + optional integrations)
+        sensorManager.setSchema(&_schema);
+        setupDeviceSensors(sensorManager, sensorConfig, batteryHal.get(), persistenceHal.get(), &waterFlowSensor);
+        unbound += sensorManager.bindErrors();
     }
 
-    // Device-specific sensor setup (lib sensors + optional integrations)
-    setupDeviceSensors(sensorManager, sensorConfig, batteryHal.get(), persistenceHal.get(), &waterFlowSensor);
+    if (unbound > 0) {
+        LOGE("Remote", "%u sensor field(s) do not match the schema", unbound);
+        reportError(ErrorReporter::Category::Logic, ErrorReporter::Logic::Config);
+    }
 }
 
 void RemoteApplicationImpl::run() {
     // No longer need deferred join - radio task handles join automatically
 
     // Automatic daily reset: clear all error counters and tsr baseline every 24h
+    // (on the clock that runs through deep sleep, like lastResetMs)
     uint32_t nowMs = millis();
+    uint32_t clockMs = CoreSystem::clockMs();
     const uint32_t dayMs = 24U * 3600U * 1000U;
-    if (_lastResetMs != 0 && (nowMs - _lastResetMs) >= dayMs) {
-        _noAckCount = _joinFailCount = _sendFailCount = 0;
-        _errSr = _errDr = _errDp = _errCs = _errWf = _errTm = 0;
-        _errMm = _errQf = _errTs = _errRf = _errCv = _errPf = 0;
-        _lastResetMs = nowMs;
-        persistenceHal->begin("app_state");
-        persistenceHal->saveU32("ec_na", _noAckCount);
-        persistenceHal->saveU32("ec_jf", _joinFailCount);
-        persistenceHal->saveU32("ec_sf", _sendFailCount);
-        persistenceHal->saveU32("ec_sr", _errSr);
-        persistenceHal->saveU32("ec_dr", _errDr);
-        persistenceHal->saveU32("ec_dp", _errDp);
-        persistenceHal->saveU32("ec_cs", _errCs);
-        persistenceHal->saveU32("ec_wf", _errWf);
-        persistenceHal->saveU32("ec_tm", _errTm);
-        persistenceHal->saveU32("ec_mm", _errMm);
-        persistenceHal->saveU32("ec_qf", _errQf);
-        persistenceHal->saveU32("ec_ts", _errTs);
-        persistenceHal->saveU32("ec_rf", _errRf);
-        persistenceHal->saveU32("ec_cv", _errCv);
-        persistenceHal->saveU32("ec_pf", _errPf);
-        persistenceHal->saveU32("lastResetMs", _lastResetMs);
-        persistenceHal->end();
+    uint32_t lastResetMs = _errors.get().lastResetMs;
+    if (lastResetMs != 0 && (clockMs - lastResetMs) >= dayMs) {
+        _errors.update([&](ErrorReporter::ErrorCounters& c) { c.reset(clockMs); });
     }
 
     drainNotifications();
-    if (_persistErrorCount) {
-        _persistErrorCount = false;
-        persistenceHal->begin("app_state");
-        persistenceHal->saveU32("ec_na", _noAckCount);
-        persistenceHal->saveU32("ec_jf", _joinFailCount);
-        persistenceHal->saveU32("ec_sf", _sendFailCount);
-        persistenceHal->saveU32("ec_sr", _errSr);
-        persistenceHal->saveU32("ec_dr", _errDr);
-        persistenceHal->saveU32("ec_dp", _errDp);
-        persistenceHal->saveU32("ec_cs", _errCs);
-        persistenceHal->saveU32("ec_wf", _errWf);
-        persistenceHal->saveU32("ec_tm", _errTm);
-        persistenceHal->saveU32("ec_mm", _errMm);
-        persistenceHal->saveU32("ec_qf", _errQf);
-        persistenceHal->saveU32("ec_ts", _errTs);
-        persistenceHal->saveU32("ec_rf", _errRf);
-        persistenceHal->saveU32("ec_cv", _errCv);
-        persistenceHal->saveU32("ec_pf", _errPf);
-        persistenceHal->end();
+    if (_lowSupply || _ota.getState() == OtaReceiver::State::Rebooting) {
+        _records.flushAll(nowMs);
+    } else {
+        _records.tick(nowMs);
     }
     if (_notifyCmd[0] != '\0') {
         uiService->showNotification("Cmd:", _notifyCmd, 2000, false);
@@ -611,6 +613,8 @@ void RemoteApplicationImpl::run() {
 
     // OTA: tick rebooting state (ESP.restart after delay)
     _ota.tick(millis());
+
+    pollTxFeedback();
     
     // Process RX queue (non-blocking with short timeout)
     if (_radioState && _radioState->rxQueue) {
@@ -627,168 +631,254 @@ void RemoteApplicationImpl::run() {
         _postJoinStep = 2;
     } else if (_postJoinStep == 2 && _radioState && _radioState->joined) {
         uint32_t nowMs = millis();
-        uint32_t timeSinceResetSec = (nowMs - _lastResetMs) / 1000;
-        uint32_t errTotal = _noAckCount + _joinFailCount + _sendFailCount
-            + _errSr + _errDr + _errDp + _errCs + _errWf + _errTm
-            + _errMm + _errQf + _errTs + _errRf + _errCv + _errPf;
         int batteryPercent = batteryHal ? batteryHal->getBatteryPercent() : -1;
         if (batteryPercent < 0) batteryPercent = 0;
-        std::vector<SensorReading> readings;
-        readings.push_back({ TelemetryKeys::PulseDelta, 0.0f, nowMs });
-        readings.push_back({ TelemetryKeys::TotalVolume, 0.0f, nowMs });
-        readings.push_back({ TelemetryKeys::BatteryPercent, (float)batteryPercent, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorNoAck, (float)_noAckCount, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorJoinFail, (float)_joinFailCount, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorSendFail, (float)_sendFailCount, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorSensorRead, (float)_errSr, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorDriver, (float)_errDr, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorDisplay, (float)_errDp, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorOtaCrc, (float)_errCs, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorOtaWrite, (float)_errWf, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorOtaTimeout, (float)_errTm, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorMemory, (float)_errMm, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorQueueFull, (float)_errQf, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorTask, (float)_errTs, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorRule, (float)_errRf, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorConfig, (float)_errCv, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorPersistence, (float)_errPf, nowMs });
-        readings.push_back({ TelemetryKeys::ErrorCount, (float)errTotal, nowMs });
-        readings.push_back({ TelemetryKeys::TimeSinceReset, (float)timeSinceResetSec, nowMs });
+        Readings readings(_schema);
+        readings.clear(nowMs);
+        readings.set(_pdField, 0.0f);
+        readings.set(_tvField, 0.0f);
+        readings.set(_bpField, (float)batteryPercent);
+        addSystemReadings(readings);
         LOGI("Remote", "Post-join: sending minimal telemetry (fPort 2)");
-        sendTelemetryJson(readings);
+        sendTelemetry(readings, true);
         _postJoinStep = 3;
     }
 
+    if (_dutyCycle.enabled()) runDutyCycle(millis());
+
     delay(1);
 }
 
-void RemoteApplicationImpl::generateTestData(std::vector<SensorReading>& readings, uint32_t nowMs) {
+void RemoteApplicationImpl::sampleSensors(uint32_t nowMs) {
+    Readings sample(_schema);
+    sample.clear(nowMs);
+    if (!sensorManager.sampleDue(sample, nowMs)) return;
+    addSystemReadings(sample);
+    _latest.update(sample);
+    _report.accumulate(sample);
+
+    // Only rules whose input field changed are re-tested (skip while OTA active).
+    // Slots are in schema order, so rule field indices line up.
+    if (_rulesEngine && !_ota.isActive()) {
+        _rulesEngine->evaluate(_latest.values(), _latest.fieldCount(), nowMs);
+    }
+}
+
+void RemoteApplicationImpl::transmitReport(uint32_t nowMs) {
+    if (!_radioState || !_radioState->joined ||
+        registrationManager.getState() != RegistrationManager::State::Complete) {
+        // Offline: close the window into the backlog for backfill
+        if (!_report.empty()) {
+            addSystemReadings(_report);
+            _backlog->append(_report.present(), _report.values(), CoreSystem::clockMs());
+            LOGD("Remote", "Telemetry stored for backfill (%lu records)",
+                 (unsigned long)_backlog->records());
+        }
+        _report.clear(nowMs);
+        return;
+    }
+
+    if (config.testModeEnabled) {
+        // Generate random test data
+        _report.clear(nowMs);
+        generateTestData(_report, nowMs);
+    } else {
+        // Samples since the last send; system state as of now
+        addSystemReadings(_report);
+    }
+
+    // Send packed binary telemetry on fPort 2
+    if (!_report.empty()) {
+        sendTelemetry(_report);
+    }
+    _report.clear(nowMs);
+}
+
+// One wake = one report: sample once the session is up, queue the report
+// and any backlog, then sleep as soon as nothing is in progress (see
+// DutyCycle for the holds). A wake that gives up on the link stores its
+// reading for backfill instead.
+void RemoteApplicationImpl::runDutyCycle(uint32_t nowMs) {
+    bool online = _radioState && _radioState->joined;
+    bool registered = registrationManager.getState() == RegistrationManager::State::Complete;
+
+    if (!_cycleReported && online && registered && sensorConfig.enableSensorSystem) {
+        if (!config.testModeEnabled) sampleSensors(nowMs);
+        transmitReport(nowMs);
+        _cycleReported = true;
+    }
+    if (online && registered && sensorConfig.enableSensorSystem) sendBackfill(CoreSystem::clockMs());
+
+    uint8_t holds = 0;
+    if (!_cycleReported && sensorConfig.enableSensorSystem) holds |= DutyCycle::Report;
+    if (!online) holds |= DutyCycle::Joining;
+    if (!registered) holds |= DutyCycle::Registering;
+    if (_radioState && !radioTaskIdle(_radioState)) holds |= DutyCycle::Radio;
+    if (_rulesEngine && _rulesEngine->hasPendingStateChange()) holds |= DutyCycle::StateChanges;
+    if (_ota.isActive()) holds |= DutyCycle::Ota;
+
+    uint32_t sleepMs = _dutyCycle.sleepMs(nowMs, holds);
+    if (sleepMs == 0) return;
+
+    if (holds) LOGW("Remote", "Awake limit reached (holds 0x%02X), sleeping anyway", holds);
+    if (!_cycleReported && sensorConfig.enableSensorSystem) {
+        if (!config.testModeEnabled) sampleSensors(nowMs);
+        transmitReport(nowMs);      // Offline: into the backlog
+    }
+    LOGI("Remote", "Deep sleep for %lu ms", (unsigned long)sleepMs);
+    if (waterFlowSensor) waterFlowSensor->prepareForSleep(config.power.wakeAfterPulses);
+    if (_backlog) _backlog->save(&g_rtcBacklog);
+    _records.flushAll(nowMs);
+    displayHal->displayOff();
+    CoreSystem::deepSleep(sleepMs, config.power.wakeButtonPin);
+}
+
+void RemoteApplicationImpl::generateTestData(Readings& readings, uint32_t nowMs) {
     // Schema-aligned test data: pd=pulse delta, tv=total volume (L), bp=%, ec=count, tsr=s
     _testPulseDelta = random(0, 20);  // Simulated pulses per interval
     _testVolume += _testPulseDelta / 450.0f;  // ~450 pulses/L
-    readings.push_back({TelemetryKeys::PulseDelta, _testPulseDelta, nowMs});
-    readings.push_back({TelemetryKeys::TotalVolume, _testVolume, nowMs});
+    readings.set(_pdField, _testPulseDelta);
+    readings.set(_tvField, _testVolume);
 
     float testBattery = random(70, 100);
-    readings.push_back({TelemetryKeys::BatteryPercent, testBattery, nowMs});
-    readings.push_back({TelemetryKeys::ErrorNoAck, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorJoinFail, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorSendFail, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorSensorRead, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorDriver, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorDisplay, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorOtaCrc, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorOtaWrite, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorOtaTimeout, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorMemory, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorQueueFull, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorTask, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorRule, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorConfig, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorPersistence, 0.0f, nowMs});
-    readings.push_back({TelemetryKeys::ErrorCount, 0.0f, nowMs});
-
-    uint32_t timeSinceResetSec = (nowMs - _lastResetMs) / 1000;
-    readings.push_back({TelemetryKeys::TimeSinceReset, (float)timeSinceResetSec, nowMs});
+    readings.set(_bpField, testBattery);
+    readings.set(_ecField, 0.0f);
+
+    uint32_t timeSinceResetSec = (CoreSystem::clockMs() - _errors.get().lastResetMs) / 1000;
+    readings.set(_tsrField, (float)timeSinceResetSec);
 
     LOGI("TestMode", "Generated test data: pd=%.0f, tv=%.1fL, bp=%.0f%%",
          _testPulseDelta, _testVolume, testBattery);
 }
 
+// Error total and time since the daily reset. The per-category counters are
+// not schema fields; they go out with diagnostics (fPort 6).
+void RemoteApplicationImpl::addSystemReadings(Readings& readings) {
+    const ErrorReporter::ErrorCounters& errors = _errors.get();
+    readings.set(_ecField, (float)errors.total());
+    readings.set(_tsrField, (float)((CoreSystem::clockMs() - errors.lastResetMs) / 1000));
+}
+
 // =============================================================================
 // Message Protocol Implementation (Phase 4: Device-centric framework)
 // =============================================================================
-// Uses simple text format instead of JSON to minimize stack usage.
-// Format is parsed by Node-RED backend which can handle both JSON and text.
-
-void RemoteApplicationImpl::sendTelemetryJson(const std::vector<SensorReading>& readings) {
-    if (readings.empty()) {
-        LOGW("Remote", "No readings to send");
-        return;
-    }
-
-    // Simple key:value format (same as original CSV but on fPort 2)
-    // Example: bp:85,pd:42,tv:1234.56,ec:0,tsr:3600
-    char buffer[128];
-    int offset = 0;
-
-    for (size_t i = 0; i < readings.size() && offset < (int)sizeof(buffer) - 20; ++i) {
-        if (isnan(readings[i].value)) continue;
-
-        if (offset > 0) {
-            buffer[offset++] = ',';
-        }
-
-        // Use integer for counters and error keys, 2 decimal places for floats
-        if (strcmp(readings[i].type, TelemetryKeys::PulseDelta) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::BatteryPercent) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorCount) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorNoAck) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorJoinFail) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorSendFail) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorSensorRead) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorDriver) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorDisplay) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorOtaCrc) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorOtaWrite) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorOtaTimeout) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorMemory) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorQueueFull) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorTask) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorRule) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorConfig) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::ErrorPersistence) == 0 ||
-            strcmp(readings[i].type, TelemetryKeys::TimeSinceReset) == 0) {
-            offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                              "%s:%d", readings[i].type, (int)readings[i].value);
-        } else {
-            offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                              "%s:%.2f", readings[i].type, readings[i].value);
-        }
+// Telemetry is schema-indexed binary (lib/telemetry_codec.h): sensors write
+// readings into their bound schema slots and they are packed by FieldType.
+// Readings that are not schema fields (error sub-counters) are reported via
+// diagnostics (fPort 6).
+// Periodic reports go through the keyframe/delta compressor; one-off reports
+// (post-join) are stateless snapshots so they never disturb the delta chain.
+
+void RemoteApplicationImpl::sendTelemetry(const Readings& readings, bool snapshot) {
+    TelemetryCodec::FieldValues values;
+    for (uint8_t i = 0; i < readings.fieldCount(); i++) {
+        if (readings.has(i)) values.set(i, readings.value(i));
     }
 
-    if (offset == 0) {
+    if (values.present == 0) {
         LOGW("Remote", "No valid readings to send");
         return;
     }
 
-    uint8_t maxPayload = 222;  // DR3 max
-    if (offset > (int)maxPayload) {
-        LOGW("Remote", "Payload %d bytes exceeds max %d, skipping", offset, maxPayload);
+    // Fit the current data rate: drop system fields first, then telemetry
+    uint8_t buffer[TelemetryCodec::MAX_FRAME_SIZE];
+    uint8_t maxPayload = _radioState ? _radioState->budget.maxPayload() : PayloadBudget::ABSOLUTE_MAX;
+    size_t cap = sizeof(buffer) < maxPayload ? sizeof(buffer) : maxPayload;
+    bool keyframe = true;
+    size_t len = 0;
+    uint8_t dropped = 0;
+    for (;;) {
+        len = snapshot
+            ? TelemetryCodec::encodeSnapshot(_schema, values, buffer, cap)
+            : _telemetryCompressor.encode(values, buffer, cap, &keyframe);
+        if (len > 0 || !TelemetryCodec::dropLowestPriority(_schema, &values)) break;
+        dropped++;
+    }
+    if (len == 0) {
+        LOGW("Remote", "Telemetry does not fit max payload %d, skipping", maxPayload);
         return;
     }
+    if (dropped > 0) {
+        LOGW("Remote", "Telemetry truncated to %d bytes for DR%u: %d fields dropped",
+             (int)len, (unsigned)_radioState->budget.dataRate, dropped);
+    }
 
-    LOGD("Remote", "Enqueue telemetry (%d bytes) on fPort %d: %s", offset, FPORT_TELEMETRY, buffer);
-    if (_radioState && _radioState->txQueue) {
+    LOGD("Remote", "Enqueue telemetry %s (%d bytes, %d fields) on fPort %d",
+         snapshot ? "snapshot" : (keyframe ? "keyframe" : "delta"),
+         (int)len, values.count(), FPORT_TELEMETRY);
+    if (_radioState && _radioState->tx) {
         LoRaWANTxMsg msg;
         msg.port = FPORT_TELEMETRY;
-        msg.len = offset;
+        msg.len = len;
         msg.confirmed = config.communication.lorawan.useConfirmedUplinks;
-        memcpy(msg.payload, buffer, offset);
+        memcpy(msg.payload, buffer, len);
         
-        if (xQueueSend(_radioState->txQueue, &msg, 0) != pdTRUE) {
-            _errQf++;
-            _persistErrorCount = true;
-            LOGW("Remote", "Failed to enqueue telemetry (queue full)");
+        // Telemetry coalesces: a frame still waiting for airtime is replaced
+        if (_radioState->tx->enqueue(TxClass::Telemetry, msg) == TxScheduler::Result::Replaced) {
+            LOGD("Remote", "Replaced stale queued telemetry");
         }
     }
 }
 
+// Feed uplink completions from the radio task back to the telemetry compressor
+void RemoteApplicationImpl::pollTxFeedback() {
+    if (!_radioState) return;
+    uint32_t count = _radioState->txCompleteCount;
+    if (count == _txCompleteSeen) return;
+    _txCompleteSeen = count;
+
+    if (_radioState->lastTxPort == FPORT_TELEMETRY) {
+        _telemetryCompressor.onUplinkComplete(_radioState->lastTxType, _radioState->lastTxSeq,
+                                              _radioState->lastTxSent, _radioState->lastTxAcked);
+    } else if (_radioState->lastTxPort == FPORT_BACKFILL && _backlog) {
+        bool delivered = config.communication.lorawan.useConfirmedUplinks ? _radioState->lastTxAcked
+                                                                          : _radioState->lastTxSent;
+        _backlog->onUplinkComplete(_radioState->lastTxSeq, delivered);
+    }
+}
+
+// One batch of the offline backlog, oldest first. Waits while a batch is
+// queued or awaiting its result, and while the last hour's airtime is past
+// BACKFILL_AIRTIME_PERCENT of the budget, so live traffic always comes first.
+// nowMs is CoreSystem::clockMs(), the clock the records are stamped with.
+void RemoteApplicationImpl::sendBackfill(uint32_t nowMs) {
+    if (!_backlog || !_radioState->tx) return;
+    if (_radioState->tx->pending(TxClass::Backfill) > 0) return;
+    if (_backlog->poll(nowMs, BACKFILL_TIMEOUT_MS) || _backlog->records() == 0) return;
+    if (_radioState->airtime.usedPercent() >= BACKFILL_AIRTIME_PERCENT) return;
+
+    LoRaWANTxMsg msg;
+    size_t len = _backlog->buildBatch(msg.payload, _radioState->budget.maxPayload(), nowMs);
+    if (len == 0) {
+        LOGD("Remote", "Backfill record does not fit max payload %u", (unsigned)_radioState->budget.maxPayload());
+        return;
+    }
+    msg.port = FPORT_BACKFILL;
+    msg.len = len;
+    msg.confirmed = config.communication.lorawan.useConfirmedUplinks;
+    if (_radioState->tx->enqueue(TxClass::Backfill, msg) == TxScheduler::Result::Full) {
+        _backlog->onUplinkComplete(msg.payload[1], false);
+        return;
+    }
+    LOGI("Remote", "Backfill batch %u: %u records, %d bytes (%lu stored, %lu dropped)",
+         (unsigned)msg.payload[1], (unsigned)msg.payload[0], (int)len,
+         (unsigned long)_backlog->records(), (unsigned long)_backlog->droppedRecords());
+}
+
 void RemoteApplicationImpl::sendCommandAck(uint8_t cmdPort, bool success) {
     char buffer[16];
     int len = snprintf(buffer, sizeof(buffer), "%d:%s", cmdPort, success ? "ok" : "err");
 
     LOGD("Remote", "Enqueue ACK on fPort %d: %s", FPORT_COMMAND_ACK, buffer);
-    if (_radioState && _radioState->txQueue) {
+    if (_radioState && _radioState->tx) {
         LoRaWANTxMsg msg;
         msg.port = FPORT_COMMAND_ACK;
         msg.len = len;
         msg.confirmed = false;
         memcpy(msg.payload, buffer, len);
         
-        if (xQueueSend(_radioState->txQueue, &msg, 0) != pdTRUE) {
-            _errQf++;
-            _persistErrorCount = true;
+        if (_radioState->tx->enqueue(TxClass::CmdAck, msg) == TxScheduler::Result::Full) {
+            reportError(ErrorReporter::Category::Sys, ErrorReporter::Sys::QueueFull);
             LOGW("Remote", "Failed to enqueue ACK (queue full)");
         }
     }
@@ -804,18 +894,17 @@ void RemoteApplicationImpl::sendDiagnostics() {
     uint32_t uplinks = _radioState ? _radioState->uplinkCount : 0;
     uint32_t downlinks = _radioState ? _radioState->downlinkCount : 0;
 
-    uint32_t errTotal = _noAckCount + _joinFailCount + _sendFailCount
-        + _errSr + _errDr + _errDp + _errCs + _errWf + _errTm
-        + _errMm + _errQf + _errTs + _errRf + _errCv + _errPf;
+    const ErrorReporter::ErrorCounters& errors = _errors.get();
+    const uint32_t (*ec)[ErrorReporter::ErrorCounters::CODES] = errors.count;
     int len = snprintf(buffer, sizeof(buffer),
         "reg:%d,err:%u,na:%u,jf:%u,sf:%u,sr:%u,dr:%u,dp:%u,cs:%u,wf:%u,tm:%u,mm:%u,qf:%u,ts:%u,rf:%u,cv:%u,pf:%u,up:%lu,bat:%d,rssi:%d,snr:%.1f,ul:%lu,dl:%lu,fw:%s",
         (registrationManager.getState() == RegistrationManager::State::Complete) ? 1 : 0,
-        (unsigned)errTotal,
-        _noAckCount, _joinFailCount, _sendFailCount,
-        (unsigned)_errSr, (unsigned)_errDr, (unsigned)_errDp,
-        (unsigned)_errCs, (unsigned)_errWf, (unsigned)_errTm,
-        (unsigned)_errMm, (unsigned)_errQf, (unsigned)_errTs,
-        (unsigned)_errRf, (unsigned)_errCv, (unsigned)_errPf,
+        (unsigned)errors.total(),
+        (unsigned)ec[0][0], (unsigned)ec[0][1], (unsigned)ec[0][2],
+        (unsigned)ec[1][0], (unsigned)ec[1][1], (unsigned)ec[1][2],
+        (unsigned)ec[2][0], (unsigned)ec[2][1], (unsigned)ec[2][2],
+        (unsigned)ec[3][0], (unsigned)ec[3][1], (unsigned)ec[3][2],
+        (unsigned)ec[4][0], (unsigned)ec[4][1], (unsigned)ec[4][2],
         uptimeSec,
         batteryPercent,
         rssi,
@@ -829,19 +918,23 @@ void RemoteApplicationImpl::sendDiagnostics() {
         len = sizeof(buffer) - 1;
     }
 
+    // Keep whole "key:value" items that fit the current data rate
+    uint8_t maxPayload = _radioState ? _radioState->budget.maxPayload() : PayloadBudget::ABSOLUTE_MAX;
+    if (len > maxPayload) {
+        len = (int)PayloadFit::fitItems(buffer, len, maxPayload);
+        LOGW("Remote", "Diagnostics truncated to %d bytes for DR%u", len, (unsigned)_radioState->budget.dataRate);
+        if (len == 0) return;
+    }
+
     LOGI("Remote", "Enqueue diagnostics (%d bytes) on fPort %d", len, FPORT_DIAGNOSTICS);
-    if (_radioState && _radioState->txQueue) {
+    if (_radioState && _radioState->tx) {
         LoRaWANTxMsg msg;
         msg.port = FPORT_DIAGNOSTICS;
         msg.len = len;
         msg.confirmed = false;
         memcpy(msg.payload, buffer, len);
         
-        if (xQueueSend(_radioState->txQueue, &msg, 0) != pdTRUE) {
-            _errQf++;
-            _persistErrorCount = true;
-            LOGW("Remote", "Failed to enqueue diagnostics (queue full)");
-        }
+        _radioState->tx->enqueue(TxClass::Diagnostics, msg);  // Coalesces with a queued report
     }
 }
 
@@ -879,28 +972,8 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
             // Note: Radio task tracks its own counters, no reset API needed
 
             // Reset all error counters and record reset time (daily reset)
-            _noAckCount = _joinFailCount = _sendFailCount = 0;
-            _errSr = _errDr = _errDp = _errCs = _errWf = _errTm = 0;
-            _errMm = _errQf = _errTs = _errRf = _errCv = _errPf = 0;
-            _lastResetMs = millis();
-            persistenceHal->begin("app_state");
-            persistenceHal->saveU32("ec_na", _noAckCount);
-            persistenceHal->saveU32("ec_jf", _joinFailCount);
-            persistenceHal->saveU32("ec_sf", _sendFailCount);
-            persistenceHal->saveU32("ec_sr", _errSr);
-            persistenceHal->saveU32("ec_dr", _errDr);
-            persistenceHal->saveU32("ec_dp", _errDp);
-            persistenceHal->saveU32("ec_cs", _errCs);
-            persistenceHal->saveU32("ec_wf", _errWf);
-            persistenceHal->saveU32("ec_tm", _errTm);
-            persistenceHal->saveU32("ec_mm", _errMm);
-            persistenceHal->saveU32("ec_qf", _errQf);
-            persistenceHal->saveU32("ec_ts", _errTs);
-            persistenceHal->saveU32("ec_rf", _errRf);
-            persistenceHal->saveU32("ec_cv", _errCv);
-            persistenceHal->saveU32("ec_pf", _errPf);
-            persistenceHal->saveU32("lastResetMs", _lastResetMs);
-            persistenceHal->end();
+            _errors.update([](ErrorReporter::ErrorCounters& c) { c.reset(CoreSystem::clockMs()); });
+            _records.flushAll(millis());
             success = true;
             break;
 
@@ -912,7 +985,9 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
                                          payload[3];
                 // Validate range (10s - 3600s = 10000ms - 3600000ms)
                 if (newIntervalMs >= 10000 && newIntervalMs <= 3600000) {
-                    if (scheduler.setTaskInterval("lorawan_tx", newIntervalMs)) {
+                    // In deep-sleep mode the interval is the sleep cycle, not a task
+                    if (_dutyCycle.enabled() || scheduler.setTaskInterval("lorawan_tx", newIntervalMs)) {
+                        _dutyCycle.setInterval(newIntervalMs);
                         config.communication.lorawan.txIntervalMs = newIntervalMs;
                         persistenceHal->begin("app_state");
                         persistenceHal->saveU32("tx_interval_ms", newIntervalMs);
@@ -935,6 +1010,7 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
             // Send ACK before reboot (won't get response otherwise)
             sendCommandAck(port, true);
             delay(100);
+            _records.flushAll(millis());
             ESP.restart();
             return;  // No further processing after reboot
 
@@ -946,26 +1022,8 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
 
         case FPORT_CMD_CLEAR_ERR:  // Clear all error counters
             LOGI("Remote", "Clear error counters command received");
-            _noAckCount = _joinFailCount = _sendFailCount = 0;
-            _errSr = _errDr = _errDp = _errCs = _errWf = _errTm = 0;
-            _errMm = _errQf = _errTs = _errRf = _errCv = _errPf = 0;
-            persistenceHal->begin("app_state");
-            persistenceHal->saveU32("ec_na", _noAckCount);
-            persistenceHal->saveU32("ec_jf", _joinFailCount);
-            persistenceHal->saveU32("ec_sf", _sendFailCount);
-            persistenceHal->saveU32("ec_sr", _errSr);
-            persistenceHal->saveU32("ec_dr", _errDr);
-            persistenceHal->saveU32("ec_dp", _errDp);
-            persistenceHal->saveU32("ec_cs", _errCs);
-            persistenceHal->saveU32("ec_wf", _errWf);
-            persistenceHal->saveU32("ec_tm", _errTm);
-            persistenceHal->saveU32("ec_mm", _errMm);
-            persistenceHal->saveU32("ec_qf", _errQf);
-            persistenceHal->saveU32("ec_ts", _errTs);
-            persistenceHal->saveU32("ec_rf", _errRf);
-            persistenceHal->saveU32("ec_cv", _errCv);
-            persistenceHal->saveU32("ec_pf", _errPf);
-            persistenceHal->end();
+            _errors.update([](ErrorReporter::ErrorCounters& c) { c.clear(); });
+            _records.flushAll(millis());
             success = true;
             break;
 
@@ -986,6 +1044,25 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
             success = true;
             break;
 
+        case FPORT_CMD_TELEMETRY_RESYNC:  // Server lost delta baseline
+            LOGI("Remote", "Telemetry resync requested");
+            _telemetryCompressor.requestKeyframe();
+            success = true;
+            break;
+
+        case FPORT_CMD_TIME_SYNC:  // Wall clock for time-of-day rule programs
+            if (_rulesEngine && length >= 4) {
+                uint32_t unixSec = payload[0] | (payload[1] << 8) | (payload[2] << 16) |
+                                   ((uint32_t)payload[3] << 24);
+                int16_t offsetMin = length >= 6 ? (int16_t)(payload[4] | (payload[5] << 8)) : 0;
+                int64_t local = (int64_t)unixSec + offsetMin * 60;
+                _rulesEngine->setTimeOfDay((uint32_t)(((local % 86400) + 86400) % 86400), millis());
+                success = true;
+            } else {
+                LOGW("Remote", "Invalid time sync payload (len=%d)", length);
+            }
+            break;
+
         case FPORT_DIRECT_CTRL:  // Direct control command (7 bytes)
             if (_rulesEngine && length >= 3) {
                 uint8_t ctrl_idx = payload[0];
@@ -1016,7 +1093,7 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
             }
             break;
 
-        case FPORT_RULE_UPDATE:  // Rule management (12 bytes per rule)
+        case FPORT_RULE_UPDATE:  // Rule management (one 20- or 12-byte rule)
             if (_rulesEngine && length >= 2) {
                 // Check for special commands
                 if (payload[0] == 0xFF && payload[1] == 0x00) {
@@ -1025,8 +1102,16 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
                     _rulesEngine->saveToFlash();
                     LOGI("Remote", "All rules cleared");
                     success = true;
-                } else if ((payload[1] & 0x80) != 0) {
-                    // Delete specific rule
+                } else if (payload[0] == EdgeRules::PROGRAM_RULE_MARKER) {
+                    // Program rule: 20-byte rule, then its bytecode
+                    if (_rulesEngine->addProgramRule(payload + 1, length - 1)) {
+                        _rulesEngine->saveToFlash();
+                        success = true;
+                    } else {
+                        LOGW("Remote", "Failed to add program rule");
+                    }
+                } else if (length == 2 && (payload[1] & 0x80) != 0) {
+                    // Delete specific rule (a rule's own 0x80 is its enabled flag)
                     uint8_t rule_id = payload[0];
                     if (_rulesEngine->deleteRule(rule_id)) {
                         _rulesEngine->saveToFlash();
@@ -1035,7 +1120,7 @@ void RemoteApplicationImpl::onDownlinkReceived(uint8_t port, const uint8_t* payl
                     } else {
                         LOGW("Remote", "Failed to delete rule %d", rule_id);
                     }
-                } else if (length >= 12) {
+                } else if (length >= EdgeRules::EdgeRule::BASE_SIZE) {
                     // Add or update rule
                     if (_rulesEngine->addOrUpdateRule(payload, length)) {
                         _rulesEngine->saveToFlash();
@@ -1067,10 +1152,16 @@ void RemoteApplication::run() { impl->run(); }
 
 // Force the Arduino build system to compile these implementation files
 #include "lib/ota_receiver.cpp"
+#include "lib/delta_patch.cpp"
+#include "lib/lzss_decoder.cpp"
+#include "lib/tx_scheduler.cpp"
 #include "lib/radio_task.cpp"
+#include "lib/flash_journal.cpp"
 #include "lib/registration_manager.cpp"
 #include "lib/core_config.cpp"
 #include "lib/core_system.cpp"
+#include "lib/pulse_source.cpp"
+#include "lib/ulp_pulse_counter.cpp"
 #include "lib/core_scheduler.cpp"
 #include "lib/svc_ui.cpp"
 #include "lib/ui_battery_icon_element.cpp"
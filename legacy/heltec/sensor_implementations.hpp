@@ -9,6 +9,7 @@
 #include <limits>
 #include "lib/telemetry_keys.h"
 #include "lib/sensor_config_types.h"
+#include "lib/pulse_source.h"
 
 // ============================================================================
 // YF-S201 Water Flow Sensor Implementation
@@ -23,17 +24,13 @@ public:
     ~YFS201WaterFlowSensor();
 
     void begin() override;
-    void read(std::vector<SensorReading>& readings) override;
+    void read(Readings& readings) override;
     const char* getName() const override { return "YFS201WaterFlow"; }
+    uint8_t getFields(FieldSlot** fields) override { *fields = _fields; return 2; }
+    uint32_t getSampleIntervalMs() const override { return _sampleIntervalMs; }
 
-    // Public static method to check and clear the interrupt flag
-    static bool getAndClearInterruptFlag() {
-        if (_interruptFired) {
-            _interruptFired = false;
-            return true;
-        }
-        return false;
-    }
+    // Public static method to check and clear the interrupt flag (ISR counting only)
+    static bool getAndClearInterruptFlag() { return IsrPulseSource::takeEdgeFlag(); }
 
     // Public method for external task to save the total volume
     void saveTotalVolume();
@@ -41,41 +38,45 @@ public:
     // Public method to reset the volume counter
     void resetTotalVolume();
 
+    // Before deep sleep: save the total and, when the ULP counts, arm its
+    // wake after wakeAfterPulses (0 = only before the counter could wrap)
+    void prepareForSleep(uint16_t wakeAfterPulses);
+
+    // Pulses are lost while asleep unless this is true
+    bool countsInDeepSleep() const { return _pulses && _pulses->countsInDeepSleep(); }
+
 private:
     const uint8_t _pin;
     const bool _enabled;
     IPersistenceHal* _persistence;
     const char* _persistence_namespace;
-    
-    // Pulse counting
-    static void IRAM_ATTR pulseCounter();
-    static volatile uint32_t _pulseCount;
-    static volatile bool _interruptFired;
-    
+    const uint32_t _sampleIntervalMs;
+    const SensorConfig::PulseBackend _backend;
+
+    // Pulse counting backend, opened in begin()
+    std::unique_ptr<IPulseSource> _pulses;
+
     unsigned long _lastReadTimeMs = 0;
     uint32_t _totalPulses = 0;
 
+    // pd, tv
+    FieldSlot _fields[2] = {FieldSlot(TelemetryKeys::PulseDelta), FieldSlot(TelemetryKeys::TotalVolume)};
+
     // YF-S201 constant: pulses per liter
     static constexpr float PULSES_PER_LITER = 450.0f;
 };
 
-// Define static members
-volatile uint32_t YFS201WaterFlowSensor::_pulseCount = 0;
-volatile bool YFS201WaterFlowSensor::_interruptFired = false;
-
 YFS201WaterFlowSensor::YFS201WaterFlowSensor(uint8_t pin, bool enabled, IPersistenceHal* persistence, const char* persistence_namespace)
-    : _pin(pin), _enabled(enabled), _persistence(persistence), _persistence_namespace(persistence_namespace) {
+    : _pin(pin), _enabled(enabled), _persistence(persistence), _persistence_namespace(persistence_namespace),
+      _sampleIntervalMs(Config().sampleIntervalMs), _backend(Config().counter) {
 }
 
 YFS201WaterFlowSensor::YFS201WaterFlowSensor(const Config& cfg, IPersistenceHal* persistence)
-    : _pin(cfg.pin), _enabled(cfg.enabled), _persistence(persistence), _persistence_namespace(cfg.persistence_namespace) {
+    : _pin(cfg.pin), _enabled(cfg.enabled), _persistence(persistence), _persistence_namespace(cfg.persistence_namespace),
+      _sampleIntervalMs(cfg.sampleIntervalMs), _backend(cfg.counter) {
 }
 
-YFS201WaterFlowSensor::~YFS201WaterFlowSensor() {
-    if (_enabled && _pin != 0) {
-        detachInterrupt(digitalPinToInterrupt(_pin));
-    }
-}
+YFS201WaterFlowSensor::~YFS201WaterFlowSensor() = default;
 
 void YFS201WaterFlowSensor::begin() {
     if (!_enabled) return;
@@ -87,42 +88,28 @@ void YFS201WaterFlowSensor::begin() {
         LOGD(getName(), "Loaded total pulses: %u", _totalPulses);
     }
 
-    pinMode(_pin, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(_pin), pulseCounter, FALLING);
     _lastReadTimeMs = millis();
+    _pulses = PulseSource::open(_backend, _pin);
+    LOGI(getName(), "Counting pulses on GPIO %u (%s)", _pin, _pulses->name());
 }
 
-void IRAM_ATTR YFS201WaterFlowSensor::pulseCounter() {
-    _pulseCount++;
-    _interruptFired = true;
-}
-
-void YFS201WaterFlowSensor::read(std::vector<SensorReading>& readings) {
-    unsigned long currentTimeMs = millis();
-
-    if (!_enabled) {
-        readings.push_back({TelemetryKeys::PulseDelta, std::numeric_limits<float>::quiet_NaN(), currentTimeMs});
-        readings.push_back({TelemetryKeys::TotalVolume, std::numeric_limits<float>::quiet_NaN(), currentTimeMs});
-        return;
-    }
+void YFS201WaterFlowSensor::read(Readings& readings) {
+    if (!_enabled) return;  // pd/tv stay absent
 
-    // Atomically get and reset the pulse count
-    noInterrupts();
-    unsigned long currentPulses = _pulseCount;
-    _pulseCount = 0;
-    interrupts();
+    // Pulses since the last read; the source never drops an edge in between
+    uint32_t currentPulses = _pulses ? _pulses->take() : 0;
 
-    _lastReadTimeMs = currentTimeMs;
+    _lastReadTimeMs = millis();
 
     // Report raw pulse delta
-    readings.push_back({TelemetryKeys::PulseDelta, (float)currentPulses, currentTimeMs});
+    readings.set(_fields[0], (float)currentPulses);
 
     // Report total volume
     _totalPulses += currentPulses;
     float totalVolumeLiters = (float)_totalPulses / PULSES_PER_LITER;
-    readings.push_back({TelemetryKeys::TotalVolume, totalVolumeLiters, currentTimeMs});
+    readings.set(_fields[1], totalVolumeLiters);
     
-    LOGD(getName(), "Read %u pulses", currentPulses);
+    if (currentPulses > 0) LOGD(getName(), "Read %u pulses", (unsigned)currentPulses);
 }
 
 void YFS201WaterFlowSensor::resetTotalVolume() {
@@ -133,6 +120,12 @@ void YFS201WaterFlowSensor::resetTotalVolume() {
     saveTotalVolume();
 }
 
+void YFS201WaterFlowSensor::prepareForSleep(uint16_t wakeAfterPulses) {
+    if (!_enabled) return;
+    saveTotalVolume();
+    if (_pulses) _pulses->prepareForSleep(wakeAfterPulses);
+}
+
 void YFS201WaterFlowSensor::saveTotalVolume() {
     if (!_enabled || !_persistence) return;
     
@@ -160,26 +153,28 @@ public:
 
     void begin() override {}
 
-    void read(std::vector<SensorReading>& readings) override {
+    void read(Readings& readings) override {
         if (_enabled && _batteryHal) {
-            readings.push_back({TelemetryKeys::BatteryPercent, (float)_batteryHal->getBatteryPercent(), millis()});
-        } else {
-            readings.push_back({TelemetryKeys::BatteryPercent, std::numeric_limits<float>::quiet_NaN(), millis()});
+            readings.set(_field, (float)_batteryHal->getBatteryPercent());
         }
     }
 
     const char* getName() const override { return "BatteryMonitor"; }
+    uint8_t getFields(FieldSlot** fields) override { *fields = &_field; return 1; }
+    uint32_t getSampleIntervalMs() const override { return _sampleIntervalMs; }
 
 private:
     IBatteryHal* _batteryHal;
     const bool _enabled;
+    const uint32_t _sampleIntervalMs;
+    FieldSlot _field{TelemetryKeys::BatteryPercent};
 };
 
 inline BatteryMonitorSensor::BatteryMonitorSensor(IBatteryHal* batteryHal, bool enabled)
-    : _batteryHal(batteryHal), _enabled(enabled) {}
+    : _batteryHal(batteryHal), _enabled(enabled), _sampleIntervalMs(Config().sampleIntervalMs) {}
 
 inline BatteryMonitorSensor::BatteryMonitorSensor(IBatteryHal* batteryHal, const Config& cfg)
-    : _batteryHal(batteryHal), _enabled(cfg.enabled) {}
+    : _batteryHal(batteryHal), _enabled(cfg.enabled), _sampleIntervalMs(cfg.sampleIntervalMs) {}
 
 // ============================================================================
 // SENSOR FACTORY
@@ -1,23 +1,115 @@
 #pragma once
 
 #include <stdint.h>
+#include <math.h>
 #include <vector>
 #include <memory> // For std::unique_ptr
+#include "lib/message_schema.h"
+#include "lib/core_logger.h"
 
-// Basic structure for a sensor reading
-struct SensorReading {
-    const char* type; // e.g., "temp", "hum"
-    float value;
-    uint32_t timestamp;
+// One schema field a sensor writes, bound to its field index once when the
+// sensor is added (SensorManager::addSensor). Readings then go straight to
+// the slot; an unbound slot (not in the schema) is never written.
+struct FieldSlot {
+    const char* key;
+    int8_t index = -1;
+
+    explicit FieldSlot(const char* k) : key(k) {}
+
+    bool bind(const MessageSchema::Schema& schema) {
+        index = schema.findFieldIndex(key);
+        return index >= 0;
+    }
+};
+
+// Schema-indexed readings for one report: slot i holds schema field i.
+// Sensors write into the frame in place through their bound FieldSlots, so a
+// telemetry tick allocates nothing and compares no strings. Absent slots
+// read as NaN (rules treat them as no data).
+template <uint8_t N>
+class ReadingFrame {
+public:
+    static_assert(N <= 16, "present mask is 16 bits");
+
+    explicit ReadingFrame(const MessageSchema::Schema& schema) : _schema(schema) { clear(0); }
+    ReadingFrame(const ReadingFrame&) = delete;
+    ReadingFrame& operator=(const ReadingFrame&) = delete;
+
+    void clear(uint32_t timestamp) {
+        _timestamp = timestamp;
+        _present = 0;
+        for (uint8_t i = 0; i < N; i++) _values[i] = NAN;
+    }
+
+    // Store a reading in its bound slot. Unbound slots are ignored (returns
+    // false); a NaN value leaves the slot absent.
+    bool set(const FieldSlot& slot, float value) {
+        if (slot.index < 0 || slot.index >= N) return false;
+        setIndex((uint8_t)slot.index, value);
+        return true;
+    }
+
+    bool has(uint8_t idx) const { return idx < N && (_present & (1u << idx)); }
+    float value(uint8_t idx) const { return idx < N ? _values[idx] : NAN; }
+    uint16_t present() const { return _present; }
+    bool empty() const { return _present == 0; }
+    uint32_t timestamp() const { return _timestamp; }
+
+    // Latest value per field: slots present in sample overwrite this frame's
+    void update(const ReadingFrame& sample) {
+        for (uint8_t i = 0; i < N; i++) {
+            if (sample.has(i)) setIndex(i, sample._values[i]);
+        }
+    }
+
+    // Folds a sample into a report window: delta fields (state class 'd') add
+    // up over the window, the others keep the latest value
+    void accumulate(const ReadingFrame& sample) {
+        for (uint8_t i = 0; i < N && i < _schema.field_count; i++) {
+            if (!sample.has(i)) continue;
+            bool delta = _schema.fields[i].state_class == MessageSchema::STATE_CLASS_DELTA;
+            setIndex(i, delta && has(i) ? _values[i] + sample._values[i] : sample._values[i]);
+        }
+    }
+
+    // All slots in schema order, for rule evaluation
+    const float* values() const { return _values; }
+    uint8_t fieldCount() const { return _schema.field_count < N ? _schema.field_count : N; }
+
+private:
+    const MessageSchema::Schema& _schema;
+    uint32_t _timestamp;
+
+    void setIndex(uint8_t idx, float value) {
+        _values[idx] = value;
+        if (isnan(value)) {
+            _present &= (uint16_t)~(1u << idx);
+        } else {
+            _present |= (uint16_t)(1u << idx);
+        }
+    }
+
+    uint16_t _present;
+    float _values[N];
 };
 
+using Readings = ReadingFrame<MessageSchema::MAX_FIELDS>;
+
 // Interface for all sensors
 class ISensor {
 public:
     virtual ~ISensor() = default;
     virtual void begin() = 0;
-    virtual void read(std::vector<SensorReading>& readings) = 0;
+    virtual void read(Readings& readings) = 0;
     virtual const char* getName() const = 0;
+
+    // Schema fields this sensor writes; *fields points at the sensor's slots
+    virtual uint8_t getFields(FieldSlot** fields) = 0;
+
+    // How often the sense task reads this sensor
+    virtual uint32_t getSampleIntervalMs() const { return DEFAULT_SAMPLE_INTERVAL_MS; }
+
+    static constexpr uint32_t DEFAULT_SAMPLE_INTERVAL_MS = 1000;
 };
 
 // Manages a collection of sensors
@@ -25,22 +117,79 @@ class SensorManager {
 public:
     SensorManager() = default;
 
-    void addSensor(std::shared_ptr<ISensor> sensor) {
-        if (sensor) {
-            sensor->begin(); // Initialize the sensor when it's added
-            _sensors.push_back(sensor);
-        }
+    // Schema the sensors' fields bind to; set before adding sensors
+    void setSchema(const MessageSchema::Schema* schema) { _schema = schema; }
+
+    // Binds the sensor's fields to schema indices, then initializes it.
+    // Returns false (and logs) when a field is not in the schema or another
+    // sensor already writes it; that field is not reported.
+    bool addSensor(std::shared_ptr<ISensor> sensor) {
+        if (!sensor) return false;
+        bool ok = bindFields(*sensor);
+        sensor->begin(); // Initialize the sensor when it's added
+        _sensors.push_back(sensor);
+        _nextSampleMs.push_back(0);  // Due on the first sample
+        return ok;
     }
 
-    // Reads from all managed sensors and returns a vector of their readings
-    std::vector<SensorReading> readAll() {
-        std::vector<SensorReading> readings;
+    // Fields that failed to bind since boot (0 = sensors match the schema)
+    uint8_t bindErrors() const { return _bindErrors; }
+
+    // Reads from all managed sensors into the caller's frame
+    void readAll(Readings& readings) {
         for (const auto& sensor : _sensors) {
             sensor->read(readings);
         }
-        return readings;
+    }
+
+    // Reads the sensors whose sample interval has elapsed into the caller's
+    // frame; false when none was due
+    bool sampleDue(Readings& readings, uint32_t nowMs) {
+        bool sampled = false;
+        for (size_t i = 0; i < _sensors.size(); i++) {
+            if ((int32_t)(nowMs - _nextSampleMs[i]) < 0) continue;
+            _nextSampleMs[i] = nowMs + _sensors[i]->getSampleIntervalMs();
+            _sensors[i]->read(readings);
+            sampled = true;
+        }
+        return sampled;
+    }
+
+    // Period for the sense task: the fastest sensor (0 = no sensors)
+    uint32_t minSampleIntervalMs() const {
+        uint32_t minMs = 0;
+        for (const auto& sensor : _sensors) {
+            uint32_t ms = sensor->getSampleIntervalMs();
+            if (minMs == 0 || ms < minMs) minMs = ms;
+        }
+        return minMs;
     }
 
 private:
     std::vector<std::shared_ptr<ISensor>> _sensors;
+    std::vector<uint32_t> _nextSampleMs;              // Per sensor, millis() when due
+    const MessageSchema::Schema* _schema = nullptr;
+    uint16_t _boundMask = 0;
+    uint8_t _bindErrors = 0;
+
+    bool bindFields(ISensor& sensor) {
+        FieldSlot* fields = nullptr;
+        uint8_t count = sensor.getFields(&fields);
+        bool ok = true;
+        for (uint8_t i = 0; i < count; i++) {
+            FieldSlot& field = fields[i];
+            if (!_schema || !field.bind(*_schema)) {
+                LOGE("Sensors", "%s: field '%s' is not in the schema", sensor.getName(), field.key);
+            } else if (_boundMask & (1u << field.index)) {
+                LOGE("Sensors", "%s: field '%s' is already written by another sensor", sensor.getName(), field.key);
+                field.index = -1;
+            } else {
+                _boundMask |= (uint16_t)(1u << field.index);
+                continue;
+            }
+            _bindErrors++;
+            ok = false;
+        }
+        return ok;
+    }
 };